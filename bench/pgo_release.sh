@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+#  ReponoDB PGO + LTO release build
+#
+#  1. Builds the workload driver the plain way (-O2) as the baseline
+#  2. Builds it with LTO and -fprofile-generate, and runs a training
+#     workload: lexing/parsing, bulk inserts, point updates and commits,
+#     branch/merge, AS OF reads, diffs and ORDER BY/LIMIT queries
+#  3. Rebuilds the library, the repono CLI and the driver with LTO and
+#     -fprofile-use
+#  4. Runs a measurement workload (different seed and size from the
+#     training one) against both drivers and reports the speedup
+#
+#  Works with GCC and Clang (Clang needs llvm-profdata and llvm-ar):
+#
+#      make release
+#      make release CXX=clang++
+#      RUNS=5 MEASURE_ARGS="--rows 200000" bench/pgo_release.sh
+#
+#  Profiles go to build/profile and the summary to release_output.json.
+
+set -e
+
+MAKE=${MAKE:-make}
+CXX=${CXX:-g++}
+RUNS=${RUNS:-3}
+TRAIN_ARGS=${TRAIN_ARGS:-"--rows 30000 --updates 1500 --commit-every 50 --branch-cycles 4 --reads 300 --diffs 20 --queries 40 --parses 20000 --seed 1"}
+MEASURE_ARGS=${MEASURE_ARGS:-"--rows 50000 --updates 2000 --branch-cycles 5 --reads 500 --diffs 20 --queries 50 --parses 50000 --seed 2"}
+OUT=${OUT:-release_output.json}
+
+step() { printf '\n==> %s\n' "$*"; }
+
+step "Baseline build ($CXX -O2)"
+$MAKE CXX="$CXX" repono_workload
+mv repono_workload build/workload-baseline
+
+step "Instrumented build (LTO, -fprofile-generate)"
+rm -rf build/profile
+$MAKE CXX="$CXX" LTO=1 PGO=gen repono_workload
+
+step "Training workload"
+./repono_workload $TRAIN_ARGS >/dev/null
+rm -f repono_workload
+
+step "Optimized build (LTO, -fprofile-use)"
+$MAKE CXX="$CXX" LTO=1 PGO=use repono repono_workload
+mv repono_workload build/workload-release
+
+# "seconds" of the fastest of $RUNS runs; per-phase figures come from that run
+best_run() {
+    driver=$1
+    name=$2
+    best=""
+    i=0
+    while [ "$i" -lt "$RUNS" ]; do
+        $driver $MEASURE_ARGS --json "build/$name-$i.json" >/dev/null
+        seconds=$(sed -n 's/^  "seconds": \([0-9.e+-]*\),$/\1/p' "build/$name-$i.json")
+        if [ -z "$best" ] || awk "BEGIN { exit !($seconds < $best) }"; then
+            best=$seconds
+            cp "build/$name-$i.json" "build/$name.json"
+        fi
+        i=$((i + 1))
+    done
+    echo "$best"
+}
+
+step "Measurement workload, best of $RUNS"
+baseline=$(best_run build/workload-baseline baseline)
+release=$(best_run build/workload-release release)
+
+# name ops_per_second for each phase of a report
+phases() {
+    sed -n 's/^    {"name": "\([a-z_]*\)", "ops": [0-9]*, "ops_per_second": \([0-9.e+-]*\),.*/\1 \2/p' "$1"
+}
+phases build/baseline.json >build/baseline.phases
+phases build/release.json >build/release.phases
+
+# phase, baseline ops/s, release ops/s
+both() {
+    awk 'NR == FNR { base[$1] = $2; next } $1 in base { print $1, base[$1], $2 }' build/baseline.phases build/release.phases
+}
+
+printf '\n%-16s %12s %12s %9s\n' phase "base ops/s" "pgo ops/s" speedup
+both | awk '{ printf "%-16s %12.1f %12.1f %8.2fx\n", $1, $2, $3, ($2 > 0 ? $3 / $2 : 0) }'
+speedup=$(awk "BEGIN { printf \"%.3f\", $baseline / $release }")
+printf '\ntotal: baseline %.2fs, PGO+LTO %.2fs, speedup %sx\n' "$baseline" "$release" "$speedup"
+
+{
+    printf '{\n  "compiler": "%s",\n  "runs": %s,\n' "$CXX" "$RUNS"
+    printf '  "train_args": "%s",\n  "measure_args": "%s",\n' "$TRAIN_ARGS" "$MEASURE_ARGS"
+    printf '  "baseline_seconds": %s,\n  "release_seconds": %s,\n  "speedup": %s,\n  "phases": [' "$baseline" "$release" "$speedup"
+    both | awk '{ printf "%s\n    {\"name\": \"%s\", \"baseline_ops_per_second\": %s, \"release_ops_per_second\": %s}", (NR > 1 ? "," : ""), $1, $2, $3 }'
+    printf '\n  ]\n}\n'
+} >"$OUT"
+echo "wrote $OUT"
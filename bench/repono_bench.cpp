@@ -0,0 +1,442 @@
+/**
+ *  ReponoDB microbenchmarks (Google Benchmark)
+ *
+ *  Build and run with `make bench`. Results are written as JSON to
+ *  bench_output.json so runs can be compared by tools rather than by eye.
+ */
+
+#include "repono/hash.h"
+#include "repono/lexer.h"
+#include "columnar.h"
+#include "export.h"
+#include "import.h"
+#include "session.h"
+
+#include <benchmark/benchmark.h>
+#include <filesystem>
+
+using namespace repono;
+
+namespace
+{
+    /**
+     * Build a SQL script of roughly n statements mixing the token kinds the
+     * lexer handles (keywords, identifiers, numbers, hex, strings, comments)
+     */
+    std::string make_query(int64_t statements)
+    {
+        std::string sql;
+        for (int64_t i = 0; i < statements; i++)
+        {
+            sql += "SELECT name, age FROM users WHERE age BETWEEN 18 AND 65 AND flags = 0xFF -- filter\n";
+            sql += "INSERT INTO `user-log` VALUES (" + std::to_string(i) + ", 'it''s \\n here', 3.25);\n";
+            sql += "/* block comment */ UPDATE users SET score = score + 1.5 WHERE id <> " + std::to_string(i) + ";\n";
+        }
+        return sql;
+    }
+
+    Schema make_schema()
+    {
+        Schema schema;
+        schema.add_column(ColumnDef("id", DataType::INTEGER, true, false));
+        schema.add_column(ColumnDef("name", DataType::VARCHAR, false, false));
+        schema.add_column(ColumnDef("score", DataType::FLOAT));
+        schema.add_column(ColumnDef("active", DataType::BOOLEAN));
+        schema.add_column(ColumnDef("created_at", DataType::TIMESTAMP));
+        return schema;
+    }
+
+    Row make_row(int64_t i)
+    {
+        return {i, "user_" + std::to_string(i), static_cast<double>(i) * 0.5, i % 2 == 0, int64_t{1703619600} + i};
+    }
+
+    Commit make_commit(int64_t tables, int64_t rows_per_table)
+    {
+        Commit commit;
+        commit.parent_hash = std::string(64, 'a');
+        commit.message = "benchmark";
+        commit.timestamp = 1703619600;
+        for (int64_t t = 0; t < tables; t++)
+        {
+            std::string name = "table_" + std::to_string(t);
+            commit.table_schemas[name] = make_schema();
+            auto &rows = commit.table_data[name];
+            for (int64_t i = 0; i < rows_per_table; i++)
+                rows.push_back(make_row(i));
+        }
+        return commit;
+    }
+}
+
+// Lexer
+
+static void BM_LexerTokenize(benchmark::State &state)
+{
+    std::string sql = make_query(state.range(0));
+    size_t tokens = 0;
+    for (auto _ : state)
+    {
+        Lexer lexer(sql);
+        auto result = lexer.tokenize();
+        tokens = result.size();
+        benchmark::DoNotOptimize(result.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * sql.size()));
+    state.counters["tokens"] = static_cast<double>(tokens);
+}
+BENCHMARK(BM_LexerTokenize)->RangeMultiplier(8)->Range(1, 4096);
+
+// Value operations
+
+static const std::vector<Value> &sample_values()
+{
+    static const std::vector<Value> values = {
+        std::monostate{}, int64_t{42}, int64_t{-7}, 3.14159, 2.0,
+        std::string("hello"), std::string("a somewhat longer string value"), true, false};
+    return values;
+}
+
+static void BM_ValueToString(benchmark::State &state)
+{
+    const Value &v = sample_values()[static_cast<size_t>(state.range(0))];
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(value_to_string(v));
+    }
+    state.SetLabel(std::to_string(v.index()));
+}
+BENCHMARK(BM_ValueToString)->DenseRange(0, 8);
+
+static void BM_ValuesEqual(benchmark::State &state)
+{
+    const auto &values = sample_values();
+    for (auto _ : state)
+    {
+        for (const auto &a : values)
+            for (const auto &b : values)
+                benchmark::DoNotOptimize(values_equal(a, b));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * values.size() * values.size()));
+}
+BENCHMARK(BM_ValuesEqual);
+
+static void BM_ValueLessThan(benchmark::State &state)
+{
+    const auto &values = sample_values();
+    for (auto _ : state)
+    {
+        for (const auto &a : values)
+            for (const auto &b : values)
+                benchmark::DoNotOptimize(value_less_than(a, b));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * values.size() * values.size()));
+}
+BENCHMARK(BM_ValueLessThan);
+
+// Schema validation
+
+static void BM_SchemaValidateRow(benchmark::State &state)
+{
+    Schema schema = make_schema();
+    std::vector<Row> rows;
+    for (int64_t i = 0; i < 1024; i++)
+        rows.push_back(make_row(i));
+    for (auto _ : state)
+    {
+        for (const auto &row : rows)
+            benchmark::DoNotOptimize(schema.validate_row(row));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * rows.size()));
+}
+BENCHMARK(BM_SchemaValidateRow);
+
+static void BM_SchemaValidateRowError(benchmark::State &state)
+{
+    Schema schema = make_schema();
+    Row bad = {int64_t{1}, std::monostate{}, 1.0, true, int64_t{0}}; // NULL in NOT NULL column
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(schema.validate_row(bad));
+    }
+}
+BENCHMARK(BM_SchemaValidateRowError);
+
+// Hashing
+
+static void BM_ComputeHash(benchmark::State &state)
+{
+    std::string data(static_cast<size_t>(state.range(0)), 'x');
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(compute_hash(data));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+}
+BENCHMARK(BM_ComputeHash)->RangeMultiplier(16)->Range(64, 1 << 20);
+
+static void BM_ComputeCommitHash(benchmark::State &state)
+{
+    Commit commit = make_commit(state.range(0), state.range(1));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(compute_commit_hash(commit));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0) * state.range(1)));
+    state.counters["rows"] = static_cast<double>(state.range(0) * state.range(1));
+}
+BENCHMARK(BM_ComputeCommitHash)
+    ->ArgNames({"tables", "rows"})
+    ->ArgsProduct({{1, 8, 64}, {10, 1000, 10000}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Commit path: chunking and storing a snapshot in a repository
+
+static void BM_RepositoryCommit(benchmark::State &state)
+{
+    Commit commit = make_commit(state.range(0), state.range(1));
+    std::unique_ptr<Repository> repo;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        repo = std::make_unique<Repository>(); // fresh store, so no chunk is deduplicated
+        Commit copy = commit;
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(repo->commit(std::move(copy)));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0) * state.range(1)));
+}
+BENCHMARK(BM_RepositoryCommit)
+    ->ArgNames({"tables", "rows"})
+    ->ArgsProduct({{1, 8}, {1000, 10000}})
+    ->Unit(benchmark::kMillisecond);
+
+// Edit and commit: one row updated in a table of state.range(0) rows, then
+// committed. The working set shares the committed chunks, so only the chunk
+// holding the row is cloned, stored and hashed.
+
+static void BM_UpdateOneRowAndCommit(benchmark::State &state)
+{
+    Repository repo;
+    Session session(repo);
+    session.execute("CREATE TABLE users (id INTEGER PRIMARY KEY, name VARCHAR, score FLOAT, active BOOLEAN, created_at TIMESTAMP)");
+    Statement insert;
+    insert.type = StatementType::INSERT;
+    insert.table = "users";
+    for (int64_t i = 0; i < state.range(0); i++)
+        insert.rows.push_back(make_row(i));
+    session.execute(insert);
+    session.execute("COMMIT 'load'");
+
+    int64_t version = 0;
+    for (auto _ : state)
+    {
+        version++;
+        QueryResult updated = session.execute("UPDATE users SET score = " + std::to_string(version) +
+                                              " WHERE id = " + std::to_string(state.range(0) / 2));
+        QueryResult committed = session.execute("COMMIT 'edit'");
+        if (!updated.ok() || !committed.ok())
+            state.SkipWithError((updated.error + committed.error).c_str());
+    }
+}
+BENCHMARK(BM_UpdateOneRowAndCommit)
+    ->ArgNames({"rows"})
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_ScatteredWritesAndCommit(benchmark::State &state)
+{
+    const int64_t rows = 10000;
+    Repository repo;
+    Session session(repo);
+    session.execute(std::string("CREATE TABLE users (id INTEGER PRIMARY KEY, name VARCHAR, score FLOAT, active BOOLEAN, created_at TIMESTAMP)") +
+                    (state.range(1) != 0 ? " USING LSM" : ""));
+    Statement insert;
+    insert.type = StatementType::INSERT;
+    insert.table = "users";
+    for (int64_t i = 0; i < rows; i++)
+        insert.rows.push_back(make_row(i));
+    session.execute(insert);
+    session.execute("COMMIT 'load'");
+
+    int64_t version = 0;
+    for (auto _ : state)
+    {
+        for (int64_t w = 0; w < state.range(0); w++)
+        {
+            version++;
+            int64_t id = (version * 7919) % rows;
+            session.execute("UPDATE users SET score = " + std::to_string(version) + " WHERE id = " + std::to_string(id));
+        }
+        QueryResult committed = session.execute("COMMIT 'batch'");
+        if (!committed.ok())
+            state.SkipWithError(committed.error.c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_ScatteredWritesAndCommit)
+    ->ArgNames({"writes", "lsm"})
+    ->ArgsProduct({{10, 100}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// Inserts of new keys into a large table, committed in batches
+static void BM_InsertBatchAndCommit(benchmark::State &state)
+{
+    const int64_t rows = 100000;
+    Repository repo;
+    Session session(repo);
+    session.execute(std::string("CREATE TABLE users (id INTEGER PRIMARY KEY, name VARCHAR, score FLOAT, active BOOLEAN, created_at TIMESTAMP)") +
+                    (state.range(0) != 0 ? " USING LSM" : ""));
+    Statement load;
+    load.type = StatementType::INSERT;
+    load.table = "users";
+    for (int64_t i = 0; i < rows; i++)
+        load.rows.push_back(make_row(i * 2));
+    session.execute(load);
+    session.execute("COMMIT 'load'");
+
+    int64_t next = 0;
+    for (auto _ : state)
+    {
+        Statement insert;
+        insert.type = StatementType::INSERT;
+        insert.table = "users";
+        for (int64_t i = 0; i < 100; i++)
+        {
+            // Odd keys, spread over the table
+            insert.rows.push_back(make_row(((next * 7919) % rows) * 2 + 1));
+            next++;
+        }
+        QueryResult inserted = session.execute(insert);
+        QueryResult committed = session.execute("COMMIT 'batch'");
+        if (!inserted.ok() || !committed.ok())
+            state.SkipWithError((inserted.error + committed.error).c_str());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 100));
+}
+BENCHMARK(BM_InsertBatchAndCommit)
+    ->ArgNames({"lsm"})
+    ->Arg(0)
+    ->Arg(1)
+    ->Iterations(50)
+    ->Unit(benchmark::kMillisecond);
+
+// Result transfer: per-cell text formatting against columnar Arrow IPC
+
+static QueryResult make_result(int64_t rows)
+{
+    QueryResult result;
+    result.columns = {"id", "name", "score", "active", "created_at", "status"};
+    static const char *statuses[] = {"active", "pending", "closed"};
+    for (int64_t i = 0; i < rows; i++)
+    {
+        Row row = make_row(i);
+        row.push_back(std::string(statuses[i % 3]));
+        result.rows.push_back(std::move(row));
+    }
+    return result;
+}
+
+static void BM_ResultToText(benchmark::State &state)
+{
+    QueryResult result = make_result(state.range(0));
+    for (auto _ : state)
+    {
+        std::string out;
+        for (const auto &row : result.rows)
+        {
+            for (const auto &v : row)
+            {
+                out += value_to_string(v);
+                out += '\t';
+            }
+            out += '\n';
+        }
+        benchmark::DoNotOptimize(out);
+        state.counters["bytes"] = static_cast<double>(out.size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_ResultToText)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_ResultToArrow(benchmark::State &state)
+{
+    QueryResult result = make_result(state.range(0));
+    for (auto _ : state)
+    {
+        std::string out = write_arrow_stream(to_columnar(result));
+        benchmark::DoNotOptimize(out);
+        state.counters["bytes"] = static_cast<double>(out.size());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_ResultToArrow)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+// COPY ... TO: rows formatted by state.range(2) threads and written to a temporary file
+
+static void BM_ExportRows(benchmark::State &state)
+{
+    QueryResult result = make_result(state.range(0));
+    std::vector<RowRange> ranges = {RowRange{result.rows.data(), result.rows.size()}};
+    ExportOptions options;
+    options.format = state.range(1) == 0 ? ExportFormat::CSV : ExportFormat::JSONL;
+    options.threads = static_cast<size_t>(state.range(2));
+    std::string path = (std::filesystem::temp_directory_path() / "repono_bench_export").string();
+    uint64_t bytes = 0;
+    for (auto _ : state)
+    {
+        ExportStats stats;
+        std::string error = export_rows(result.columns, ranges, path, options, stats);
+        if (!error.empty())
+            state.SkipWithError(error.c_str());
+        bytes += stats.bytes;
+    }
+    std::filesystem::remove(path);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_ExportRows)
+    ->ArgNames({"rows", "jsonl", "threads"})
+    ->ArgsProduct({{100000}, {0, 1}, {1, 4}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// COPY ... FROM: CSV text parsed into typed rows by state.range(1) threads
+
+static void BM_ParseCsv(benchmark::State &state)
+{
+    QueryResult result = make_result(state.range(0));
+    Schema schema;
+    schema.add_column(ColumnDef("id", DataType::INTEGER, true, false));
+    schema.add_column(ColumnDef("name", DataType::VARCHAR));
+    schema.add_column(ColumnDef("score", DataType::FLOAT));
+    schema.add_column(ColumnDef("active", DataType::BOOLEAN));
+    schema.add_column(ColumnDef("created_at", DataType::TIMESTAMP));
+    schema.add_column(ColumnDef("status", DataType::VARCHAR));
+    std::string text;
+    for (const auto &row : result.rows)
+        append_csv_row(text, row);
+
+    CsvOptions options;
+    options.header = false;
+    options.threads = static_cast<size_t>(state.range(1));
+    for (auto _ : state)
+    {
+        std::vector<std::string> columns;
+        std::vector<Row> rows;
+        std::string error = parse_csv(text.data(), text.size(), schema, options, columns, rows);
+        if (!error.empty())
+            state.SkipWithError(error.c_str());
+        benchmark::DoNotOptimize(rows);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_ParseCsv)
+    ->ArgNames({"rows", "threads"})
+    ->ArgsProduct({{100000}, {1, 4}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
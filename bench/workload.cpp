@@ -0,0 +1,756 @@
+/**
+ *  ReponoDB workload driver
+ *
+ *  Generates a synthetic table and replays a mixed workload through a
+ *  Session, the same path SQL clients take: bulk load, point updates with
+ *  frequent COMMITs, branch/merge cycles, AS OF reads, diffs,
+ *  ORDER BY/LIMIT queries, and lexing/parsing of the same kinds of
+ *  statements without running them. For each phase it reports throughput and latency
+ *  percentiles, and at the end peak RSS and storage growth per commit.
+ *
+ *  Build with `make repono_workload`, then for example:
+ *
+ *      ./repono_workload --rows 1000000 --width 12 --types int:4,varchar:4,float:2,bool:1,timestamp:1
+ *
+ *  Run `./repono_workload --help` for every option.
+ */
+
+#include "session.h"
+
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace repono;
+
+namespace
+{
+    struct Options
+    {
+        int64_t rows = 100000;
+        size_t width = 8; // columns including the id primary key
+        std::string types = "int:3,varchar:2,float:1,bool:1,timestamp:1";
+        int64_t batch = 1000;        // rows per INSERT statement
+        int64_t updates = 2000;      // point updates on main
+        int64_t commit_every = 100;  // updates per COMMIT
+        int64_t branch_cycles = 5;   // branch, change, merge back
+        int64_t branch_updates = 50; // updates per side in each cycle
+        int64_t reads = 500;         // AS OF point reads
+        int64_t diffs = 20;          // diffs between random commits
+        int64_t queries = 50;        // ORDER BY ... LIMIT queries
+        int64_t parses = 2000;       // statements lexed and parsed, not executed
+        uint64_t seed = 42;
+        std::string dir;  // repository directory ("" = temporary)
+        bool keep = false; // keep the repository afterwards
+        std::string json; // also write the report here
+    };
+
+    void print_usage()
+    {
+        Options d;
+        std::cout << "Usage: repono_workload [options]\n"
+                  << "  --rows N            rows to bulk load (" << d.rows << ")\n"
+                  << "  --width N           columns per row, including the key (" << d.width << ")\n"
+                  << "  --types MIX         column type weights (" << d.types << ")\n"
+                  << "  --batch N           rows per INSERT (" << d.batch << ")\n"
+                  << "  --updates N         point updates on main (" << d.updates << ")\n"
+                  << "  --commit-every N    updates per COMMIT (" << d.commit_every << ")\n"
+                  << "  --branch-cycles N   branch/merge cycles (" << d.branch_cycles << ")\n"
+                  << "  --branch-updates N  updates per side in each cycle (" << d.branch_updates << ")\n"
+                  << "  --reads N           AS OF point reads (" << d.reads << ")\n"
+                  << "  --diffs N           diffs between random commits (" << d.diffs << ")\n"
+                  << "  --queries N         ORDER BY/LIMIT queries (" << d.queries << ")\n"
+                  << "  --parses N          statements lexed and parsed only (" << d.parses << ")\n"
+                  << "  --seed N            random seed (" << d.seed << ")\n"
+                  << "  --dir PATH          repository directory (default: a temporary one)\n"
+                  << "  --keep              keep the repository directory\n"
+                  << "  --json PATH         also write the report as JSON\n";
+    }
+
+    /**
+     * Parse the command line
+     *
+     * @returns "" on success or an error message
+     */
+    std::string parse_options(int argc, char **argv, Options &opts)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--keep")
+            {
+                opts.keep = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+                return "Missing value for " + arg;
+            std::string value = argv[++i];
+
+            if (arg == "--types")
+                opts.types = value;
+            else if (arg == "--dir")
+                opts.dir = value;
+            else if (arg == "--json")
+                opts.json = value;
+            else
+            {
+                char *end = nullptr;
+                long long n = std::strtoll(value.c_str(), &end, 10);
+                if (end == value.c_str() || *end != '\0' || n < 0)
+                    return "Expected a non-negative number for " + arg;
+                if (arg == "--rows")
+                    opts.rows = n;
+                else if (arg == "--width")
+                    opts.width = static_cast<size_t>(n);
+                else if (arg == "--batch")
+                    opts.batch = n;
+                else if (arg == "--updates")
+                    opts.updates = n;
+                else if (arg == "--commit-every")
+                    opts.commit_every = n;
+                else if (arg == "--branch-cycles")
+                    opts.branch_cycles = n;
+                else if (arg == "--branch-updates")
+                    opts.branch_updates = n;
+                else if (arg == "--reads")
+                    opts.reads = n;
+                else if (arg == "--diffs")
+                    opts.diffs = n;
+                else if (arg == "--queries")
+                    opts.queries = n;
+                else if (arg == "--parses")
+                    opts.parses = n;
+                else if (arg == "--seed")
+                    opts.seed = static_cast<uint64_t>(n);
+                else
+                    return "Unknown option " + arg;
+            }
+        }
+        if (opts.width < 2)
+            return "--width must be at least 2";
+        if (opts.batch < 1 || opts.commit_every < 1)
+            return "--batch and --commit-every must be positive";
+        return "";
+    }
+
+    /**
+     * Expand a "type:weight,..." mix into one type per non-key column,
+     * spreading each type evenly across the row
+     */
+    std::string column_types(const std::string &mix, size_t columns, std::vector<DataType> &types)
+    {
+        std::vector<std::pair<DataType, int64_t>> weights;
+        int64_t total = 0;
+        std::istringstream iss(mix);
+        std::string item;
+        while (std::getline(iss, item, ','))
+        {
+            std::string name = item.substr(0, item.find(':'));
+            int64_t weight = 1;
+            if (item.find(':') != std::string::npos)
+                weight = std::strtoll(item.c_str() + item.find(':') + 1, nullptr, 10);
+            std::optional<DataType> type;
+            if (name == "int")
+                type = DataType::INTEGER;
+            else if (name == "float")
+                type = DataType::FLOAT;
+            else if (name == "varchar")
+                type = DataType::VARCHAR;
+            else if (name == "bool")
+                type = DataType::BOOLEAN;
+            else if (name == "timestamp")
+                type = DataType::TIMESTAMP;
+            if (!type.has_value() || weight < 0)
+                return "Bad type mix entry '" + item + "'";
+            weights.emplace_back(*type, weight);
+            total += weight;
+        }
+        if (total == 0)
+            return "Type mix has no weight";
+
+        // Weighted round robin: give each slot to the type furthest behind its share
+        std::vector<int64_t> used(weights.size(), 0);
+        for (size_t c = 0; c < columns; c++)
+        {
+            size_t best = 0;
+            double best_deficit = -1e300;
+            for (size_t w = 0; w < weights.size(); w++)
+            {
+                double deficit = static_cast<double>(weights[w].second) * static_cast<double>(c + 1) / static_cast<double>(total) - static_cast<double>(used[w]);
+                if (weights[w].second > 0 && deficit > best_deficit)
+                {
+                    best = w;
+                    best_deficit = deficit;
+                }
+            }
+            used[best]++;
+            types.push_back(weights[best].first);
+        }
+        return "";
+    }
+
+    /**
+     * Latencies of one phase
+     */
+    class LatencyRecorder
+    {
+    public:
+        explicit LatencyRecorder(std::string name) : name_(std::move(name)) {}
+
+        void add(double ms) { samples_.push_back(ms); }
+        void add_work(int64_t items) { items_ += items; }
+        void set_elapsed(double seconds) { elapsed_ = seconds; }
+
+        const std::string &name() const { return name_; }
+        size_t ops() const { return samples_.size(); }
+        double elapsed() const { return elapsed_; }
+        double ops_per_second() const { return elapsed_ > 0 ? static_cast<double>(ops()) / elapsed_ : 0; }
+        double items_per_second() const { return elapsed_ > 0 ? static_cast<double>(items_) / elapsed_ : 0; }
+        int64_t items() const { return items_; }
+
+        /**
+         * Latency at a percentile in [0, 100], in milliseconds
+         */
+        double percentile(double p)
+        {
+            if (samples_.empty())
+                return 0;
+            if (!sorted_)
+            {
+                std::sort(samples_.begin(), samples_.end());
+                sorted_ = true;
+            }
+            size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(samples_.size() - 1) + 0.5);
+            return samples_[std::min(rank, samples_.size() - 1)];
+        }
+
+    private:
+        std::string name_;
+        std::vector<double> samples_;
+        int64_t items_ = 0;
+        double elapsed_ = 0;
+        bool sorted_ = false;
+    };
+
+    struct StorageSample
+    {
+        std::string phase;
+        int64_t commits = 0;
+        uint64_t bytes_before = 0;
+        uint64_t bytes_after = 0;
+
+        double bytes_per_commit() const
+        {
+            return commits > 0 ? static_cast<double>(bytes_after - bytes_before) / static_cast<double>(commits) : 0;
+        }
+    };
+
+    uint64_t directory_bytes(const std::string &dir)
+    {
+        uint64_t total = 0;
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(dir, ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (it->is_regular_file(ec))
+                total += it->file_size(ec);
+        }
+        return total;
+    }
+
+    /**
+     * Peak resident set size of this process in bytes
+     */
+    uint64_t peak_rss_bytes()
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+    double elapsed_ms(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    class Workload
+    {
+    public:
+        Workload(const Options &opts, Repository &repo, const std::vector<DataType> &types)
+            : opts_(opts), repo_(repo), session_(repo), types_(types), rng_(opts.seed) {}
+
+        /**
+         * Run every phase
+         *
+         * @returns "" on success or the first failing statement's error
+         */
+        std::string run()
+        {
+            std::string error;
+            if (error.empty())
+                error = bulk_load();
+            if (error.empty())
+                error = point_updates();
+            if (error.empty())
+                error = branch_merge();
+            if (error.empty())
+                error = as_of_reads();
+            if (error.empty())
+                error = diffs();
+            if (error.empty())
+                error = top_k();
+            if (error.empty())
+                error = parse_only();
+            return error;
+        }
+
+        std::deque<LatencyRecorder> &phases() { return phases_; }
+        std::vector<StorageSample> &storage() { return storage_; }
+        size_t commits() const { return commit_hashes_.size(); }
+
+    private:
+        const Options &opts_;
+        Repository &repo_;
+        Session session_;
+        std::vector<DataType> types_;
+        std::mt19937_64 rng_;
+        std::deque<LatencyRecorder> phases_; // deque: phases hand out references
+        std::vector<StorageSample> storage_;
+        std::vector<std::string> commit_hashes_;
+        int64_t version_ = 0; // bumped per update so every UPDATE changes the row
+
+        /**
+         * Execute a statement, recording its latency
+         */
+        std::string timed(LatencyRecorder &phase, const std::string &sql, QueryResult *out = nullptr)
+        {
+            auto start = std::chrono::steady_clock::now();
+            QueryResult result = session_.execute(sql);
+            phase.add(elapsed_ms(start));
+            if (!result.ok())
+                return sql.substr(0, 80) + ": " + result.error;
+            if (out != nullptr)
+                *out = std::move(result);
+            return "";
+        }
+
+        std::string commit(LatencyRecorder *phase, const std::string &message)
+        {
+            std::string sql = "COMMIT '" + message + "'";
+            std::string error = phase ? timed(*phase, sql) : session_.execute(sql).error;
+            if (error.empty())
+                commit_hashes_.push_back(session_.base_hash());
+            return error;
+        }
+
+        std::string literal(size_t column, int64_t id, int64_t version)
+        {
+            int64_t v = id * 31 + version * 7 + static_cast<int64_t>(column);
+            switch (types_[column - 1])
+            {
+            case DataType::INTEGER:
+                return std::to_string(v % 1000003);
+            case DataType::FLOAT:
+                return std::to_string(static_cast<double>(v % 100003) / 8.0);
+            case DataType::VARCHAR:
+                return "'value_" + std::to_string(v % 100003) + "'";
+            case DataType::BOOLEAN:
+                return v % 2 == 0 ? "TRUE" : "FALSE";
+            case DataType::TIMESTAMP:
+                return std::to_string(1700000000 + v % 31536000);
+            default:
+                return "NULL";
+            }
+        }
+
+        int64_t random_id()
+        {
+            return static_cast<int64_t>(rng_() % static_cast<uint64_t>(std::max<int64_t>(1, opts_.rows)));
+        }
+
+        std::string update_sql(int64_t id)
+        {
+            version_++;
+            return "UPDATE bench SET c1 = " + literal(1, id, version_) + " WHERE id = " + std::to_string(id);
+        }
+
+        void begin_storage(const std::string &phase)
+        {
+            StorageSample sample;
+            sample.phase = phase;
+            sample.commits = -static_cast<int64_t>(commit_hashes_.size());
+            sample.bytes_before = directory_bytes(opts_.dir);
+            storage_.push_back(sample);
+        }
+
+        void end_storage()
+        {
+            StorageSample &sample = storage_.back();
+            sample.commits += static_cast<int64_t>(commit_hashes_.size());
+            sample.bytes_after = directory_bytes(opts_.dir);
+        }
+
+        LatencyRecorder &phase(const std::string &name)
+        {
+            phases_.emplace_back(name);
+            return phases_.back();
+        }
+
+        std::string bulk_load()
+        {
+            std::string ddl = "CREATE TABLE bench (id INTEGER PRIMARY KEY";
+            for (size_t c = 1; c < opts_.width; c++)
+                ddl += ", c" + std::to_string(c) + " " + datatype_to_string(types_[c - 1]);
+            ddl += ")";
+            QueryResult result = session_.execute(ddl);
+            if (!result.ok())
+                return result.error;
+
+            begin_storage("bulk_load");
+            auto start = std::chrono::steady_clock::now();
+            LatencyRecorder &insert = phase("bulk_load");
+            std::string sql;
+            for (int64_t id = 0; id < opts_.rows;)
+            {
+                sql = "INSERT INTO bench VALUES ";
+                int64_t end = std::min(opts_.rows, id + opts_.batch);
+                for (int64_t i = id; i < end; i++)
+                {
+                    sql += i == id ? "(" : ", (";
+                    sql += std::to_string(i);
+                    for (size_t c = 1; c < opts_.width; c++)
+                        sql += ", " + literal(c, i, 0);
+                    sql += ")";
+                }
+                std::string error = timed(insert, sql);
+                if (!error.empty())
+                    return error;
+                insert.add_work(end - id);
+                id = end;
+            }
+            std::string error = commit(&insert, "bulk load");
+            insert.set_elapsed(elapsed_ms(start) / 1000.0);
+            end_storage();
+            return error;
+        }
+
+        std::string point_updates()
+        {
+            if (opts_.updates == 0)
+                return "";
+            begin_storage("point_updates");
+            auto start = std::chrono::steady_clock::now();
+            LatencyRecorder &update = phase("point_update");
+            LatencyRecorder &commits = phase("commit");
+            for (int64_t i = 1; i <= opts_.updates; i++)
+            {
+                std::string error = timed(update, update_sql(random_id()));
+                if (error.empty() && (i % opts_.commit_every == 0 || i == opts_.updates))
+                    error = commit(&commits, "update " + std::to_string(i));
+                if (!error.empty())
+                    return error;
+            }
+            double seconds = elapsed_ms(start) / 1000.0;
+            update.set_elapsed(seconds);
+            commits.set_elapsed(seconds);
+            end_storage();
+            return "";
+        }
+
+        std::string branch_merge()
+        {
+            if (opts_.branch_cycles == 0)
+                return "";
+            begin_storage("branch_merge");
+            auto start = std::chrono::steady_clock::now();
+            LatencyRecorder &checkout = phase("checkout");
+            LatencyRecorder &merge = phase("merge");
+            int64_t half = std::max<int64_t>(1, opts_.rows / 2);
+            for (int64_t cycle = 0; cycle < opts_.branch_cycles; cycle++)
+            {
+                std::string branch = "cycle_" + std::to_string(cycle);
+                std::string error = timed(checkout, "CHECKOUT -b " + branch);
+
+                // The branch updates the lower half of the keys and main the
+                // upper half, so the merge never conflicts
+                for (int64_t i = 0; error.empty() && i < opts_.branch_updates; i++)
+                    error = session_.execute(update_sql(random_id() % half)).error;
+                if (error.empty())
+                    error = commit(nullptr, branch);
+                if (error.empty())
+                    error = timed(checkout, "CHECKOUT main");
+                for (int64_t i = 0; error.empty() && i < opts_.branch_updates; i++)
+                    error = session_.execute(update_sql(std::min(opts_.rows - 1, half + random_id() % half))).error;
+                if (error.empty())
+                    error = commit(nullptr, "main " + std::to_string(cycle));
+                if (error.empty())
+                {
+                    error = timed(merge, "MERGE " + branch);
+                    if (error.empty())
+                        commit_hashes_.push_back(session_.base_hash());
+                }
+                if (!error.empty())
+                    return branch + ": " + error;
+            }
+            double seconds = elapsed_ms(start) / 1000.0;
+            checkout.set_elapsed(seconds);
+            merge.set_elapsed(seconds);
+            end_storage();
+            return "";
+        }
+
+        std::string as_of_reads()
+        {
+            if (opts_.reads == 0 || commit_hashes_.empty())
+                return "";
+            auto start = std::chrono::steady_clock::now();
+            LatencyRecorder &reads = phase("as_of_read");
+            for (int64_t i = 0; i < opts_.reads; i++)
+            {
+                const std::string &hash = commit_hashes_[rng_() % commit_hashes_.size()];
+                std::string error = timed(reads, "SELECT * FROM bench AS OF '" + hash + "' WHERE id = " + std::to_string(random_id()));
+                if (!error.empty())
+                    return error;
+            }
+            reads.set_elapsed(elapsed_ms(start) / 1000.0);
+            return "";
+        }
+
+        std::string diffs()
+        {
+            if (opts_.diffs == 0 || commit_hashes_.size() < 2)
+                return "";
+            auto start = std::chrono::steady_clock::now();
+            LatencyRecorder &diff = phase("diff");
+            for (int64_t i = 0; i < opts_.diffs; i++)
+            {
+                size_t a = rng_() % commit_hashes_.size();
+                size_t b = rng_() % commit_hashes_.size();
+                QueryResult result;
+                std::string error = timed(diff,
+                                          "SELECT diff_type, COUNT(*) FROM diff(bench, '" + commit_hashes_[std::min(a, b)] +
+                                              "', '" + commit_hashes_[std::max(a, b)] + "') GROUP BY diff_type",
+                                          &result);
+                if (!error.empty())
+                    return error;
+                for (const auto &row : result.rows)
+                    diff.add_work(std::get<int64_t>(row[1]));
+            }
+            diff.set_elapsed(elapsed_ms(start) / 1000.0);
+            return "";
+        }
+
+        std::string top_k()
+        {
+            if (opts_.queries == 0)
+                return "";
+            auto start = std::chrono::steady_clock::now();
+            LatencyRecorder &queries = phase("order_by_limit");
+            for (int64_t i = 0; i < opts_.queries; i++)
+            {
+                size_t column = 1 + i % (opts_.width - 1);
+                std::string sql = "SELECT id, c" + std::to_string(column) + " FROM bench ORDER BY c" +
+                                  std::to_string(column) + (i % 2 ? " DESC" : "") + " LIMIT 10";
+                std::string error = timed(queries, sql);
+                if (!error.empty())
+                    return error;
+            }
+            queries.set_elapsed(elapsed_ms(start) / 1000.0);
+            return "";
+        }
+
+        /**
+         * Lex and parse statements like the ones above without running
+         * them; rows/s is SQL bytes per second
+         */
+        std::string parse_only()
+        {
+            if (opts_.parses == 0)
+                return "";
+            auto start = std::chrono::steady_clock::now();
+            LatencyRecorder &parses = phase("parse");
+            const std::string hash = commit_hashes_.empty() ? "main" : commit_hashes_.back();
+            for (int64_t i = 0; i < opts_.parses; i++)
+            {
+                int64_t id = random_id();
+                std::string sql;
+                switch (i % 4)
+                {
+                case 0:
+                    sql = "INSERT INTO bench VALUES (" + std::to_string(id);
+                    for (size_t c = 1; c < opts_.width; c++)
+                        sql += ", " + literal(c, id, i);
+                    sql += ")";
+                    break;
+                case 1:
+                    sql = update_sql(id);
+                    break;
+                case 2:
+                    sql = "SELECT * FROM bench AS OF '" + hash + "' WHERE id = " + std::to_string(id);
+                    break;
+                default:
+                    sql = "SELECT id, c1 FROM bench WHERE c1 > " + literal(1, id, 0) + " AND id BETWEEN " +
+                          std::to_string(id) + " AND " + std::to_string(id + 100) + " ORDER BY c1 DESC LIMIT 10";
+                    break;
+                }
+                auto op_start = std::chrono::steady_clock::now();
+                std::string error;
+                auto stmt = parse_sql(sql, error);
+                parses.add(elapsed_ms(op_start));
+                if (!stmt.has_value())
+                    return sql.substr(0, 80) + ": " + error;
+                parses.add_work(static_cast<int64_t>(sql.size()));
+            }
+            parses.set_elapsed(elapsed_ms(start) / 1000.0);
+            return "";
+        }
+    };
+
+    void print_report(const Options &opts, Workload &workload, uint64_t total_bytes, double seconds)
+    {
+        std::cout << "rows=" << opts.rows << " width=" << opts.width << " types=" << opts.types
+                  << " commits=" << workload.commits() << " time=" << std::fixed << std::setprecision(2) << seconds << "s\n\n";
+
+        std::cout << std::left << std::setw(16) << "phase" << std::right
+                  << std::setw(9) << "ops" << std::setw(12) << "ops/s"
+                  << std::setw(12) << "rows/s" << std::setw(11) << "p50 ms"
+                  << std::setw(11) << "p95 ms" << std::setw(11) << "p99 ms" << std::setw(11) << "max ms" << "\n";
+        for (auto &phase : workload.phases())
+        {
+            std::cout << std::left << std::setw(16) << phase.name() << std::right
+                      << std::setw(9) << phase.ops()
+                      << std::setw(12) << std::setprecision(1) << phase.ops_per_second()
+                      << std::setw(12) << std::setprecision(0) << phase.items_per_second()
+                      << std::setprecision(3)
+                      << std::setw(11) << phase.percentile(50) << std::setw(11) << phase.percentile(95)
+                      << std::setw(11) << phase.percentile(99) << std::setw(11) << phase.percentile(100) << "\n";
+        }
+
+        std::cout << "\n"
+                  << std::left << std::setw(16) << "storage" << std::right
+                  << std::setw(9) << "commits" << std::setw(16) << "bytes added" << std::setw(16) << "bytes/commit" << "\n";
+        for (const auto &sample : workload.storage())
+        {
+            std::cout << std::left << std::setw(16) << sample.phase << std::right
+                      << std::setw(9) << sample.commits
+                      << std::setw(16) << (sample.bytes_after - sample.bytes_before)
+                      << std::setw(16) << std::setprecision(0) << sample.bytes_per_commit() << "\n";
+        }
+        std::cout << "\nrepository size: " << total_bytes << " bytes\n"
+                  << "peak RSS: " << peak_rss_bytes() / (1024 * 1024) << " MiB\n";
+    }
+
+    std::string write_json(const std::string &path, const Options &opts, Workload &workload, uint64_t total_bytes, double seconds)
+    {
+        std::ostringstream out;
+        out << std::setprecision(6) << "{\n"
+            << "  \"rows\": " << opts.rows << ",\n"
+            << "  \"width\": " << opts.width << ",\n"
+            << "  \"types\": \"" << opts.types << "\",\n"
+            << "  \"commits\": " << workload.commits() << ",\n"
+            << "  \"seconds\": " << seconds << ",\n"
+            << "  \"peak_rss_bytes\": " << peak_rss_bytes() << ",\n"
+            << "  \"repository_bytes\": " << total_bytes << ",\n"
+            << "  \"phases\": [";
+        bool first = true;
+        for (auto &phase : workload.phases())
+        {
+            out << (first ? "\n" : ",\n")
+                << "    {\"name\": \"" << phase.name() << "\", \"ops\": " << phase.ops()
+                << ", \"ops_per_second\": " << phase.ops_per_second()
+                << ", \"rows_per_second\": " << phase.items_per_second()
+                << ", \"p50_ms\": " << phase.percentile(50) << ", \"p95_ms\": " << phase.percentile(95)
+                << ", \"p99_ms\": " << phase.percentile(99) << ", \"max_ms\": " << phase.percentile(100) << "}";
+            first = false;
+        }
+        out << "\n  ],\n  \"storage\": [";
+        first = true;
+        for (const auto &sample : workload.storage())
+        {
+            out << (first ? "\n" : ",\n")
+                << "    {\"phase\": \"" << sample.phase << "\", \"commits\": " << sample.commits
+                << ", \"bytes_added\": " << (sample.bytes_after - sample.bytes_before)
+                << ", \"bytes_per_commit\": " << sample.bytes_per_commit() << "}";
+            first = false;
+        }
+        out << "\n  ]\n}\n";
+        return write_file_atomic(path, out.str());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--help" || std::string(argv[i]) == "-h")
+        {
+            print_usage();
+            return 0;
+        }
+    }
+
+    Options opts;
+    std::string error = parse_options(argc, argv, opts);
+    std::vector<DataType> types;
+    if (error.empty())
+        error = column_types(opts.types, opts.width - 1, types);
+    if (!error.empty())
+    {
+        std::cerr << "error: " << error << "\n";
+        print_usage();
+        return 1;
+    }
+
+    bool temporary = opts.dir.empty();
+    if (temporary)
+    {
+        opts.dir = (std::filesystem::temp_directory_path() / ("repono_workload_" + std::to_string(getpid()))).string();
+    }
+    else if (std::filesystem::exists(opts.dir + "/refs"))
+    {
+        std::cerr << "error: " << opts.dir << " already holds a repository\n";
+        return 1;
+    }
+
+    Repository repo;
+    error = repo.open(opts.dir);
+    if (!error.empty())
+    {
+        std::cerr << "error: " << error << "\n";
+        return 1;
+    }
+
+    Workload workload(opts, repo, types);
+    auto start = std::chrono::steady_clock::now();
+    error = workload.run();
+    double seconds = elapsed_ms(start) / 1000.0;
+    if (!error.empty())
+    {
+        std::cerr << "error: " << error << "\n";
+    }
+    else
+    {
+        uint64_t total_bytes = directory_bytes(opts.dir);
+        print_report(opts, workload, total_bytes, seconds);
+        if (!opts.json.empty())
+        {
+            error = write_json(opts.json, opts, workload, total_bytes, seconds);
+            if (!error.empty())
+                std::cerr << "error: " << error << "\n";
+        }
+    }
+
+    if (temporary && !opts.keep)
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(opts.dir, ec);
+    }
+    return error.empty() ? 0 : 1;
+}
@@ -0,0 +1,626 @@
+/**
+ *  ReponoDB differential tester
+ *
+ *  Generates random schemas, data and queries, runs each query through a
+ *  repono Session and through SQLite, and reports any result that differs.
+ *  Queries cover filters (comparisons, BETWEEN, IS NULL, AND/OR/NOT with
+ *  NULLs), arithmetic, GROUP BY with aggregates, ORDER BY, LIMIT and
+ *  OFFSET; UPDATE and DELETE are checked by comparing whole tables after
+ *  running them on both sides.
+ *
+ *  The generator stays inside what both engines define the same way:
+ *  column types are never mixed in a comparison, booleans are compared
+ *  with TRUE/FALSE, and values are small enough not to overflow. repono
+ *  sorts NULLs last, so SQLite gets NULLS LAST / NULLS FIRST spelled out.
+ *  Results are compared as multisets unless a LIMIT makes order matter,
+ *  in which case the ORDER BY always ends in a unique key.
+ *
+ *  Build and run with `make difftest`, or for example:
+ *
+ *      ./repono_difftest --cases 500 --queries 50 --seed 7
+ */
+
+#include "session.h"
+
+#include <sqlite3.h>
+
+#include <cstdio>
+#include <iostream>
+#include <random>
+
+using namespace repono;
+
+namespace
+{
+    struct Options
+    {
+        int64_t cases = 200;   // random schemas + data sets
+        int64_t queries = 40;  // queries per case
+        int64_t max_rows = 60; // rows per table
+        uint64_t seed = 1;
+        bool verbose = false;
+    };
+
+    struct Column
+    {
+        std::string name;
+        DataType type;
+    };
+
+    using Rng = std::mt19937_64;
+
+    int64_t uniform(Rng &rng, int64_t lo, int64_t hi)
+    {
+        return std::uniform_int_distribution<int64_t>(lo, hi)(rng);
+    }
+
+    bool chance(Rng &rng, int percent)
+    {
+        return uniform(rng, 0, 99) < percent;
+    }
+
+    template <typename T>
+    const T &pick(Rng &rng, const std::vector<T> &items)
+    {
+        return items[static_cast<size_t>(uniform(rng, 0, static_cast<int64_t>(items.size()) - 1))];
+    }
+
+    bool is_numeric(DataType type)
+    {
+        return type == DataType::INTEGER || type == DataType::FLOAT;
+    }
+
+    /**
+     * A literal of the column's type. Floats are multiples of 0.25 so sums
+     * are exact in both engines; strings avoid quotes and backslashes,
+     * which the two lexers escape differently.
+     */
+    std::string literal(Rng &rng, DataType type)
+    {
+        static const std::vector<std::string> strings = {"", "a", "ab", "abc", "b", "B", "a b", "z", "Zz", "mm"};
+        switch (type)
+        {
+        case DataType::INTEGER:
+            return std::to_string(uniform(rng, -20, 20));
+        case DataType::FLOAT:
+        {
+            int64_t quarters = uniform(rng, -40, 40);
+            std::string text = std::to_string(std::abs(quarters) / 4) + "." +
+                               std::to_string(std::abs(quarters) % 4 * 25);
+            return (quarters < 0 ? "-" : "") + text;
+        }
+        case DataType::VARCHAR:
+            return "'" + pick(rng, strings) + "'";
+        case DataType::BOOLEAN:
+            return chance(rng, 50) ? "TRUE" : "FALSE";
+        default:
+            return "NULL";
+        }
+    }
+
+    std::string type_name(DataType type)
+    {
+        switch (type)
+        {
+        case DataType::INTEGER:
+            return "INTEGER";
+        case DataType::FLOAT:
+            return "FLOAT";
+        case DataType::VARCHAR:
+            return "VARCHAR";
+        case DataType::BOOLEAN:
+            return "BOOLEAN";
+        default:
+            return "INTEGER";
+        }
+    }
+
+    /**
+     * Canonical text for a value, so 2, 2.0 and TRUE/1 compare equal
+     * across the engines (SQLite has no boolean type and REAL columns
+     * hold integers as floats)
+     */
+    std::string canonical_number(double d)
+    {
+        if (std::floor(d) == d && std::abs(d) < 1e15)
+            return std::to_string(static_cast<int64_t>(d));
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.9g", d);
+        return buf;
+    }
+
+    std::string canonical(const Value &v)
+    {
+        if (std::holds_alternative<std::monostate>(v))
+            return "NULL";
+        if (const auto *i = std::get_if<int64_t>(&v))
+            return std::to_string(*i);
+        if (const auto *d = std::get_if<double>(&v))
+            return canonical_number(*d);
+        if (const auto *b = std::get_if<bool>(&v))
+            return *b ? "1" : "0";
+        return "'" + std::get<std::string>(v) + "'";
+    }
+
+    using Rows = std::vector<std::vector<std::string>>;
+
+    std::string format_rows(const Rows &rows)
+    {
+        std::string out;
+        for (const auto &row : rows)
+        {
+            out += "  (";
+            for (size_t i = 0; i < row.size(); i++)
+                out += (i ? ", " : "") + row[i];
+            out += ")\n";
+        }
+        return out.empty() ? "  (no rows)\n" : out;
+    }
+
+    /**
+     * One random table with the same contents in repono and SQLite
+     */
+    class Case
+    {
+    public:
+        Case(Rng &rng, const Options &opts) : rng_(rng), opts_(opts), session_(repo_)
+        {
+            sqlite3_open(":memory:", &db_);
+        }
+
+        ~Case() { sqlite3_close(db_); }
+
+        Case(const Case &) = delete;
+        Case &operator=(const Case &) = delete;
+
+        /**
+         * Create and fill the table on both sides
+         *
+         * @returns "" on success or an error message
+         */
+        std::string setup()
+        {
+            static const std::vector<DataType> types = {DataType::INTEGER, DataType::FLOAT, DataType::VARCHAR, DataType::BOOLEAN};
+            columns_.push_back({"id", DataType::INTEGER});
+            int64_t width = uniform(rng_, 1, 5);
+            for (int64_t i = 0; i < width; i++)
+                columns_.push_back({"c" + std::to_string(i), pick(rng_, types)});
+
+            std::string create = "CREATE TABLE t (id INTEGER PRIMARY KEY";
+            for (size_t i = 1; i < columns_.size(); i++)
+                create += ", " + columns_[i].name + " " + type_name(columns_[i].type);
+            create += ")";
+            std::string error = run_both(create);
+            if (!error.empty())
+                return error;
+
+            int64_t rows = uniform(rng_, 0, opts_.max_rows);
+            std::string insert;
+            for (int64_t id = 0; id < rows; id++)
+            {
+                insert += insert.empty() ? "INSERT INTO t VALUES (" : ", (";
+                insert += std::to_string(id);
+                for (size_t i = 1; i < columns_.size(); i++)
+                    insert += ", " + (chance(rng_, 15) ? std::string("NULL") : literal(rng_, columns_[i].type));
+                insert += ")";
+            }
+            if (!insert.empty())
+            {
+                error = run_both(insert);
+                if (!error.empty())
+                    return error;
+            }
+            // Half the cases query a committed snapshot, half the working set
+            if (chance(rng_, 50))
+            {
+                QueryResult result = session_.execute("COMMIT 'load'");
+                if (!result.ok() && rows > 0)
+                    return "COMMIT failed: " + result.error;
+            }
+            return "";
+        }
+
+        /**
+         * Run one random statement on both sides
+         *
+         * @returns "" if the results agree, otherwise a report
+         */
+        std::string check_random_statement()
+        {
+            if (chance(rng_, 15))
+                return check_mutation();
+            bool ordered = false;
+            auto [repono_sql, sqlite_sql] = random_select(ordered);
+            return compare(repono_sql, sqlite_sql, ordered);
+        }
+
+        std::string schema_sql() const
+        {
+            return script_;
+        }
+
+    private:
+        Rng &rng_;
+        const Options &opts_;
+        Repository repo_;
+        Session session_;
+        sqlite3 *db_ = nullptr;
+        std::vector<Column> columns_;
+        std::string script_; // statements run on both sides, for reproducing a failure
+
+        std::string run_both(const std::string &sql)
+        {
+            script_ += sql + ";\n";
+            QueryResult result = session_.execute(sql);
+            char *message = nullptr;
+            int rc = sqlite3_exec(db_, sql.c_str(), nullptr, nullptr, &message);
+            std::string sqlite_error = message ? message : "";
+            sqlite3_free(message);
+            if (result.ok() != (rc == SQLITE_OK))
+            {
+                return "Statement succeeded on one side only: " + sql +
+                       "\n  repono: " + (result.ok() ? "ok" : result.error) +
+                       "\n  sqlite: " + (rc == SQLITE_OK ? "ok" : sqlite_error);
+            }
+            return "";
+        }
+
+        const Column &random_column(bool numeric_only = false)
+        {
+            std::vector<const Column *> candidates;
+            for (const auto &col : columns_)
+            {
+                if (!numeric_only || is_numeric(col.type))
+                    candidates.push_back(&col);
+            }
+            return *pick(rng_, candidates);
+        }
+
+        /**
+         * A numeric expression over a column, or just the column
+         */
+        std::string value_expr(const Column &col)
+        {
+            if (!is_numeric(col.type) || chance(rng_, 60))
+                return col.name;
+            switch (uniform(rng_, 0, 4))
+            {
+            case 0:
+                return col.name + " + " + literal(rng_, col.type);
+            case 1:
+                return col.name + " - " + std::to_string(uniform(rng_, 0, 9));
+            case 2:
+                return col.name + " * " + std::to_string(uniform(rng_, -3, 3));
+            case 3:
+                return col.name + " / " + std::to_string(uniform(rng_, -3, 3)); // / 0 is NULL in both
+            default:
+                return "-" + col.name;
+            }
+        }
+
+        std::string predicate(int depth)
+        {
+            if (depth < 3 && chance(rng_, 35))
+            {
+                switch (uniform(rng_, 0, 2))
+                {
+                case 0:
+                    return "(" + predicate(depth + 1) + " AND " + predicate(depth + 1) + ")";
+                case 1:
+                    return "(" + predicate(depth + 1) + " OR " + predicate(depth + 1) + ")";
+                default:
+                    return "NOT (" + predicate(depth + 1) + ")";
+                }
+            }
+
+            const Column &col = random_column();
+            if (chance(rng_, 15))
+                return col.name + (chance(rng_, 50) ? " IS NULL" : " IS NOT NULL");
+            if (col.type == DataType::BOOLEAN)
+                return col.name + (chance(rng_, 50) ? " = " : " <> ") + literal(rng_, col.type);
+            if (chance(rng_, 20))
+            {
+                return value_expr(col) + (chance(rng_, 30) ? " NOT BETWEEN " : " BETWEEN ") +
+                       literal(rng_, col.type) + " AND " + literal(rng_, col.type);
+            }
+            static const std::vector<std::string> ops = {"=", "<>", "!=", "<", "<=", ">", ">="};
+            std::string rhs = chance(rng_, 10) ? "NULL" : literal(rng_, col.type);
+            return value_expr(col) + " " + pick(rng_, ops) + " " + rhs;
+        }
+
+        /**
+         * ORDER BY for both dialects; repono sorts NULLs last ascending and
+         * first descending, which SQLite has to be told
+         */
+        void order_by(const std::vector<std::string> &keys, std::string &repono_sql, std::string &sqlite_sql)
+        {
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                bool descending = chance(rng_, 40);
+                std::string sep = i == 0 ? " ORDER BY " : ", ";
+                repono_sql += sep + keys[i] + (descending ? " DESC" : "");
+                sqlite_sql += sep + keys[i] + (descending ? " DESC NULLS FIRST" : " NULLS LAST");
+            }
+        }
+
+        std::pair<std::string, std::string> random_select(bool &ordered)
+        {
+            std::string where = chance(rng_, 70) ? " WHERE " + predicate(0) : "";
+            bool limited = chance(rng_, 30);
+            std::string repono_sql, sqlite_sql;
+
+            if (chance(rng_, 35))
+            {
+                // Grouped: group columns, then aggregates
+                std::vector<std::string> groups;
+                for (int64_t n = uniform(rng_, 0, 2); n > 0; n--)
+                {
+                    const std::string &name = random_column().name;
+                    if (std::find(groups.begin(), groups.end(), name) == groups.end())
+                        groups.push_back(name);
+                }
+                std::string select;
+                for (const auto &g : groups)
+                    select += (select.empty() ? "" : ", ") + g;
+                for (int64_t n = uniform(rng_, 1, 3); n > 0; n--)
+                {
+                    std::string agg;
+                    switch (uniform(rng_, 0, 4))
+                    {
+                    case 0:
+                        agg = "COUNT(*)";
+                        break;
+                    case 1:
+                        agg = "COUNT(" + random_column().name + ")";
+                        break;
+                    case 2:
+                        agg = (chance(rng_, 50) ? "SUM(" : "AVG(") + random_column(true).name + ")";
+                        break;
+                    default:
+                    {
+                        const Column &col = random_column();
+                        if (col.type == DataType::BOOLEAN)
+                            agg = "COUNT(" + col.name + ")";
+                        else
+                            agg = (chance(rng_, 50) ? "MIN(" : "MAX(") + col.name + ")";
+                        break;
+                    }
+                    }
+                    select += (select.empty() ? "" : ", ") + agg;
+                }
+                repono_sql = sqlite_sql = "SELECT " + select + " FROM t" + where;
+                if (!groups.empty())
+                {
+                    std::string group_by = " GROUP BY ";
+                    for (size_t i = 0; i < groups.size(); i++)
+                        group_by += (i ? ", " : "") + groups[i];
+                    repono_sql += group_by;
+                    sqlite_sql += group_by;
+                }
+                // Group keys are unique per group, so ordering by all of them is total
+                if (limited && !groups.empty())
+                {
+                    order_by(groups, repono_sql, sqlite_sql);
+                    ordered = true;
+                }
+                else
+                {
+                    limited = limited && groups.empty();
+                }
+            }
+            else
+            {
+                std::string select;
+                if (chance(rng_, 30))
+                {
+                    select = "*";
+                }
+                else
+                {
+                    for (int64_t n = uniform(rng_, 1, 4); n > 0; n--)
+                        select += (select.empty() ? "" : ", ") + value_expr(random_column());
+                }
+                repono_sql = sqlite_sql = "SELECT " + select + " FROM t" + where;
+                if (limited || chance(rng_, 30))
+                {
+                    std::vector<std::string> keys;
+                    for (int64_t n = uniform(rng_, 0, 2); n > 0; n--)
+                        keys.push_back(random_column().name);
+                    keys.push_back("id"); // unique, so the order is total
+                    order_by(keys, repono_sql, sqlite_sql);
+                    ordered = limited;
+                }
+            }
+
+            if (limited)
+            {
+                std::string limit = " LIMIT " + std::to_string(uniform(rng_, 0, 10));
+                if (chance(rng_, 40))
+                    limit += " OFFSET " + std::to_string(uniform(rng_, 0, 5));
+                repono_sql += limit;
+                sqlite_sql += limit;
+            }
+            return {repono_sql, sqlite_sql};
+        }
+
+        std::string check_mutation()
+        {
+            std::string sql;
+            if (chance(rng_, 50) || columns_.size() == 1)
+            {
+                sql = "DELETE FROM t" + (chance(rng_, 85) ? " WHERE " + predicate(0) : std::string());
+            }
+            else
+            {
+                const Column *col = &columns_[static_cast<size_t>(uniform(rng_, 1, static_cast<int64_t>(columns_.size()) - 1))];
+                std::string value = chance(rng_, 10) ? "NULL" : literal(rng_, col->type);
+                if (is_numeric(col->type) && chance(rng_, 40))
+                    value = col->name + " + " + literal(rng_, col->type);
+                sql = "UPDATE t SET " + col->name + " = " + value + (chance(rng_, 85) ? " WHERE " + predicate(0) : std::string());
+            }
+            std::string error = run_both(sql);
+            if (!error.empty())
+                return error;
+            std::string check = "SELECT * FROM t";
+            return compare(check, check, false);
+        }
+
+        std::string run_repono(const std::string &sql, Rows &rows)
+        {
+            QueryResult result = session_.execute(sql);
+            if (!result.ok())
+                return result.error;
+            for (const auto &row : result.rows)
+            {
+                std::vector<std::string> out;
+                for (const auto &v : row)
+                    out.push_back(canonical(v));
+                rows.push_back(std::move(out));
+            }
+            return "";
+        }
+
+        std::string run_sqlite(const std::string &sql, Rows &rows)
+        {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+                return sqlite3_errmsg(db_);
+            int rc;
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+            {
+                std::vector<std::string> out;
+                for (int i = 0; i < sqlite3_column_count(stmt); i++)
+                {
+                    switch (sqlite3_column_type(stmt, i))
+                    {
+                    case SQLITE_NULL:
+                        out.push_back("NULL");
+                        break;
+                    case SQLITE_INTEGER:
+                        out.push_back(std::to_string(sqlite3_column_int64(stmt, i)));
+                        break;
+                    case SQLITE_FLOAT:
+                        out.push_back(canonical_number(sqlite3_column_double(stmt, i)));
+                        break;
+                    default:
+                        out.push_back("'" + std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, i))) + "'");
+                        break;
+                    }
+                }
+                rows.push_back(std::move(out));
+            }
+            std::string error = rc == SQLITE_DONE ? "" : sqlite3_errmsg(db_);
+            sqlite3_finalize(stmt);
+            return error;
+        }
+
+        std::string compare(const std::string &repono_sql, const std::string &sqlite_sql, bool ordered)
+        {
+            Rows ours, theirs;
+            std::string our_error = run_repono(repono_sql, ours);
+            std::string their_error = run_sqlite(sqlite_sql, theirs);
+            if (!our_error.empty() || !their_error.empty())
+            {
+                if (!our_error.empty() && !their_error.empty())
+                    return ""; // both reject it
+                return "Query failed on one side only: " + repono_sql +
+                       "\n  repono: " + (our_error.empty() ? "ok" : our_error) +
+                       "\n  sqlite: " + (their_error.empty() ? "ok" : their_error) + "\n";
+            }
+            if (!ordered)
+            {
+                std::sort(ours.begin(), ours.end());
+                std::sort(theirs.begin(), theirs.end());
+            }
+            if (ours == theirs)
+                return "";
+            return "Results differ for: " + repono_sql + "\n  sqlite: " + sqlite_sql +
+                   "\nrepono returned:\n" + format_rows(ours) + "sqlite returned:\n" + format_rows(theirs);
+        }
+    };
+
+    /**
+     * Parse the command line
+     *
+     * @returns "" on success or an error message
+     */
+    std::string parse_options(int argc, char **argv, Options &opts)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--verbose")
+            {
+                opts.verbose = true;
+                continue;
+            }
+            if (arg == "--help")
+            {
+                return "Usage: repono_difftest [--cases N] [--queries N] [--max-rows N] [--seed N] [--verbose]";
+            }
+            if (i + 1 >= argc)
+            {
+                return "Missing value for " + arg;
+            }
+            std::string value = argv[++i];
+            char *end = nullptr;
+            long long n = std::strtoll(value.c_str(), &end, 10);
+            if (end == value.c_str() || *end != '\0' || n < 0)
+            {
+                return "Expected a non-negative number for " + arg;
+            }
+            if (arg == "--cases")
+                opts.cases = n;
+            else if (arg == "--queries")
+                opts.queries = n;
+            else if (arg == "--max-rows")
+                opts.max_rows = n;
+            else if (arg == "--seed")
+                opts.seed = static_cast<uint64_t>(n);
+            else
+                return "Unknown option " + arg;
+        }
+        return "";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options opts;
+    std::string error = parse_options(argc, argv, opts);
+    if (!error.empty())
+    {
+        std::cerr << error << "\n";
+        return 2;
+    }
+
+    int64_t statements = 0;
+    int64_t failures = 0;
+    for (int64_t c = 0; c < opts.cases; c++)
+    {
+        // Every case has its own seed, so a failure can be replayed alone
+        uint64_t case_seed = opts.seed * 1000003 + static_cast<uint64_t>(c);
+        Rng rng(case_seed);
+        Case test(rng, opts);
+        std::string report = test.setup();
+        for (int64_t q = 0; q < opts.queries && report.empty(); q++)
+        {
+            report = test.check_random_statement();
+            statements++;
+        }
+        if (!report.empty())
+        {
+            failures++;
+            std::cout << "Case " << c << " (seed " << opts.seed << ") failed\n"
+                      << report << "Script so far:\n"
+                      << test.schema_sql() << "\n";
+        }
+        else if (opts.verbose)
+        {
+            std::cout << "Case " << c << " ok\n";
+        }
+    }
+
+    std::cout << opts.cases << " cases, " << statements << " statements, " << failures << " failing case(s)\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+/**
+ *  Fuzz target: Lexer
+ *
+ *  Any byte string must tokenize without throwing or crashing, into a
+ *  token list that ends with exactly one END_OF_FILE, with positions that
+ *  never move backwards and literal tokens carrying a value of the right
+ *  type. Numbers out of range, unterminated strings and backtick
+ *  identifiers, and unclosed comments must come out as INVALID tokens.
+ *
+ *  Build with `make fuzz_lexer` (clang + libFuzzer), then:
+ *
+ *      ./fuzz_lexer -dict=fuzz/sql.dict -max_total_time=60 corpus/
+ */
+
+#include "repono/lexer.h"
+#include "parser.h"
+
+#include "standalone.h"
+
+using namespace repono;
+
+namespace
+{
+    void check(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "Lexer invariant violated: %s\n", what);
+            std::abort();
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    std::string sql(reinterpret_cast<const char *>(data), size);
+    Lexer lexer(sql);
+    std::vector<Token> tokens = lexer.tokenize();
+
+    check(!tokens.empty(), "no tokens");
+    check(tokens.back().is(TokenType::END_OF_FILE), "last token is not END_OF_FILE");
+
+    int line = 1, column = 1;
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        const Token &token = tokens[i];
+        check(i + 1 == tokens.size() || !token.is(TokenType::END_OF_FILE), "END_OF_FILE before the end");
+        check(token.line > line || (token.line == line && token.column >= column), "position moved backwards");
+        line = token.line;
+        column = token.column;
+
+        switch (token.type)
+        {
+        case TokenType::INTEGER_LITERAL:
+            check(std::holds_alternative<int64_t>(token.value), "integer literal without an integer value");
+            break;
+        case TokenType::FLOAT_LITERAL:
+            check(std::holds_alternative<double>(token.value), "float literal without a double value");
+            check(std::isfinite(std::get<double>(token.value)), "float literal is not finite");
+            break;
+        case TokenType::STRING_LITERAL:
+            check(std::holds_alternative<std::string>(token.value), "string literal without a string value");
+            break;
+        case TokenType::INVALID:
+            check(!token.text.empty(), "INVALID token without a message");
+            break;
+        default:
+            break;
+        }
+    }
+
+    // The fingerprint used by the slow query log goes over the same tokens
+    fingerprint_sql(sql);
+    return 0;
+}
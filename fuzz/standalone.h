@@ -0,0 +1,118 @@
+/**
+ *  Driver for running the fuzz targets without libFuzzer
+ *
+ *  With clang, `make fuzz-lexer` / `make fuzz-sql` link the targets against
+ *  libFuzzer, which supplies main(). Compilers without it (gcc) define
+ *  REPONO_FUZZ_STANDALONE and get this main instead, which either replays
+ *  the given files (e.g. a crash or a corpus) or feeds the target random
+ *  splices of SQL fragments:
+ *
+ *      ./fuzz_lexer crash-1234 other-input.sql
+ *      ./fuzz_lexer --random 100000 --seed 7
+ */
+
+#ifndef REPONO_FUZZ_STANDALONE_H
+#define REPONO_FUZZ_STANDALONE_H
+
+#ifdef REPONO_FUZZ_STANDALONE
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+namespace fuzz_standalone
+{
+    // Pieces the random mode splices together; most inputs stay close to SQL
+    const std::vector<std::string> &fragments()
+    {
+        static const std::vector<std::string> pieces = {
+            "SELECT ", "INSERT INTO ", "UPDATE ", "DELETE FROM ", "CREATE TABLE ", "DROP TABLE ",
+            "COMMIT ", "CHECKOUT ", "CHECKOUT -b ", "MERGE ", "LOG", "BLAME ", "HISTORY ", "SHOW METRICS", "SHOW MEMORY",
+            "t ", "u ", "id ", "name ", "score ", "active ", "ts ", "* ", "FROM ", "WHERE ", "VALUES ", "SET ",
+            "GROUP BY ", "ORDER BY ", "LIMIT ", "OFFSET ", "AS OF ", "AS ", "DESC ", "ASC ", "FOR SYSTEM_TIME ",
+            "BETWEEN ", "AND ", "OR ", "NOT ", "IS ", "NULL ", "TRUE ", "FALSE ", "ALL ", "ROW ",
+            "COUNT(*) ", "SUM(", "MIN(", "MAX(", "AVG(", "diff(", "main ", "'msg' ",
+            "INTEGER PRIMARY KEY", "VARCHAR", "FLOAT", "BOOLEAN", "TIMESTAMP",
+            "(", ")", ",", ";", ".", "+", "-", "*", "/", "=", "<>", "!=", "<", "<=", ">", ">=",
+            "0", "1", "42", "-7", "3.25", "0x7FFFFFFFFFFFFFFF", "0xFFFFFFFFFFFFFFFFF", "9223372036854775808",
+            "99999999999999999999999.5", "'str'", "'it''s'", "'\\n'", "'unterminated", "\"dq\"",
+            "`back tick`", "`unterminated", "`new\nline`", "-- comment\n", "/* block */", "/* open",
+            " ", "\n", "\t", "\xff", "\x80", "@", "#", "?"};
+        return pieces;
+    }
+
+    std::string random_input(std::mt19937_64 &rng)
+    {
+        const auto &pieces = fragments();
+        std::string input;
+        size_t count = rng() % 24;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (rng() % 16 == 0)
+                input += static_cast<char>(rng() % 256); // a raw byte now and then
+            else
+                input += pieces[rng() % pieces.size()];
+        }
+        return input;
+    }
+
+    int run(const std::string &input)
+    {
+        return LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t runs = 0;
+    uint64_t seed = 1;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--random" && i + 1 < argc)
+            runs = std::stoull(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc)
+            seed = std::stoull(argv[++i]);
+        else
+            files.push_back(arg);
+    }
+
+    for (const auto &path : files)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "Cannot read '" << path << "'\n";
+            return 1;
+        }
+        std::string input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        fuzz_standalone::run(input);
+    }
+
+    std::mt19937_64 rng(seed);
+    for (uint64_t i = 0; i < runs; i++)
+    {
+        fuzz_standalone::run(fuzz_standalone::random_input(rng));
+    }
+
+    if (files.empty() && runs == 0)
+    {
+        std::string input((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        fuzz_standalone::run(input);
+    }
+    std::cout << "Ran " << files.size() + runs << " input(s)\n";
+    return 0;
+}
+
+#endif // REPONO_FUZZ_STANDALONE
+
+#endif // REPONO_FUZZ_STANDALONE_H
@@ -0,0 +1,115 @@
+/**
+ *  ReponoDB: Commits and diffs between them
+ */
+
+#ifndef REPONO_COMMIT_H
+#define REPONO_COMMIT_H
+
+#include "repono/schema.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * COMMIT
+     *
+     * A commit is an immutable snapshot of the database state.
+     * A unique identifier (hash)
+     * A pointer to the parent commit
+     * Metadata (message, timestamp, author)
+     * The actual data (snapshots of all tables)
+     * */
+
+    /**
+     * One sorted run of an LSM table: its level, and its rows and the keys
+     * it deletes (key values only), each in primary key order
+     */
+    struct CommitRun
+    {
+        uint32_t level = 0;
+        std::vector<Row> rows;
+        std::vector<Row> tombstones;
+    };
+
+    struct Commit
+    {
+        std::string hash;
+        std::string parent_hash;
+        std::string merge_parent_hash; // second parent of a merge commit, "" otherwise
+        std::string message;
+        int64_t timestamp;
+
+        std::unordered_map<std::string, std::vector<Row>> table_data;
+        std::unordered_map<std::string, Schema> table_schemas;
+        // LSM tables also list their runs, newest first; these, not
+        // table_data, are what such a table is stored and hashed as
+        std::unordered_map<std::string, std::vector<CommitRun>> table_runs;
+        /**
+         * Checks if this is the initial commit/root, which is when the parent_hash is empty
+         */
+        bool is_root() const
+        {
+            return parent_hash.empty();
+        }
+    };
+    /**
+     * BRANCH
+     *
+     * A branch is just a named pointer to a commit.
+     *
+     *  branches["main"] = "a3f2b7c"
+     *  After commit:
+     *  branches["main"] = "b8e4d1a"  (new commit's hash)
+     *  We just change the pointers to the main, and therefore dont need a new struct
+     */
+
+    /**
+     * DIFF RESULT
+     *
+     * When comparing two commits, we produce a diff showing:
+     * Added rows (exist in new but not old)
+     * Deleted rows (exist in old but not new)
+     * Modified rows (exist in both but different)
+     *
+     * CommitDiff = "what changed between version A and version B"
+     * TableDiff = "what changed in this specific table"
+     * RowDiff = "what changed in this specific row
+     *
+     */
+    struct RowDiff
+    {
+        enum class Type
+        {
+            ADDED,
+            DELETED,
+            MODIFIED
+        };
+        Type type;
+        Row old_row;
+        Row new_row;
+
+        RowDiff(Type t, Row old_r = {}, Row new_r = {}) : type(t), old_row(std::move(old_r)), new_row(std::move(new_r)) {}
+    };
+
+    struct TableDiff
+    {
+        std::string table_name;
+        std::vector<RowDiff> row_diffs;
+        bool schema_changed = false;
+    };
+
+    struct CommitDiff
+    {
+        std::string from_hash;
+        std::string to_hash;
+        std::vector<TableDiff> table_diffs;
+        std::vector<std::string> tables_added;
+        std::vector<std::string> tables_dropped;
+    };
+};
+
+#endif // REPONO_COMMIT_H
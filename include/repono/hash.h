@@ -0,0 +1,76 @@
+/**
+ *  ReponoDB: SHA-256 hashing of data and commits
+ */
+
+#ifndef REPONO_HASH_H
+#define REPONO_HASH_H
+
+#include "repono/commit.h"
+
+#include <cstdint>
+#include <string>
+
+namespace repono
+{
+    /**
+     * SHA-256 of a byte string
+     *
+     * @param data The bytes to hash
+     * @return The full 64-character hex digest
+     */
+    std::string compute_hash(const std::string &data);
+
+    /**
+     * Hash a commit's parents, message, timestamp and table data
+     *
+     * The table data enters the hash as the hash of each storage chunk the
+     * table is cut into (see split_into_chunks), in name order, so a commit
+     * that shares most chunks with its parent only needs the new chunks
+     * hashed. An LSM table listed in table_runs enters as each run's level
+     * followed by the chunks the run is cut into.
+     *
+     * @param commit The commit to hash (its own hash field is ignored)
+     * @return The commit hash
+     */
+    std::string compute_commit_hash(const Commit &commit);
+
+    /**
+     * Builds the same hash as compute_commit_hash from tables that are
+     * already cut into chunks
+     *
+     * Tables must be added in name order. A table stored as sorted runs
+     * (an LSM table) is hashed by its runs' levels and chunks instead.
+     */
+    class CommitHasher
+    {
+    public:
+        /**
+         * @param commit Supplies the parents, message and timestamp (its tables are ignored)
+         */
+        explicit CommitHasher(const Commit &commit);
+
+        void begin_table(const std::string &name, bool sorted_runs = false);
+
+        /**
+         * Start the next run of an LSM table; its chunks follow
+         */
+        void begin_run(uint32_t level);
+
+        void add_chunk(const std::string &chunk_hash);
+
+        std::string finish() const { return compute_hash(text_); }
+
+    private:
+        std::string text_;
+    };
+
+    /**
+     * Verify a commit's hash matches its content
+     *
+     * @param commit The commit to validate
+     * @return true if hash is correct
+     */
+    bool validate_commit(const Commit &commit);
+};
+
+#endif // REPONO_HASH_H
@@ -0,0 +1,231 @@
+/**
+ *  ReponoDB: SQL tokenizer
+ */
+
+#ifndef REPONO_LEXER_H
+#define REPONO_LEXER_H
+
+#include "repono/value.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace repono
+{
+    // TOKENIZER (LEXER)
+
+    enum class TokenType
+    {
+        INTEGER_LITERAL,
+        FLOAT_LITERAL,
+        STRING_LITERAL,
+
+        IDENTIFIER, // table_name, column_name
+
+        // SQL Keywords
+        SELECT,
+        FROM,
+        WHERE,
+        INSERT,
+        INTO,
+        VALUES,
+        UPDATE,
+        BETWEEN,
+        SET,
+        DELETE,
+
+        // Table keywords
+        CREATE,
+        TABLE,
+        DROP,
+
+        // Logical Keywords
+        AND,
+        OR,
+        NOT,
+
+        // Value Keywords
+        NULL_KEYWORD,
+        TRUE_KEYWORD,
+        FALSE_KEYWORD,
+
+        // Constraint keywords
+
+        PRIMARY,
+        KEY,
+
+        // Type keywords
+        INTEGER_TYPE,   // INTEGER, INT
+        VARCHAR_TYPE,   // VARCHAR, TEXT
+        FLOAT_TYPE,     // FLOAT, DOUBLE
+        BOOLEAN_TYPE,   // BOOLEAN, BOOL
+        TIMESTAMP_TYPE, // TIMESTAMP
+
+        // Misc keywords
+        AS,
+        IS,
+        FOR, // FOR SYSTEM_TIME
+        ALL,
+        SHOW, // SHOW METRICS / SHOW MEMORY
+        COPY, // COPY table TO 'file'
+
+        // Version control keywords
+        OF,       // AS OF
+        COMMIT,   // COMMIT 'message'
+        CHECKOUT, // CHECKOUT branch, CHECKOUT -b branch
+        MERGE,    // MERGE branch
+        LOG,
+        BLAME,   // BLAME table WHERE pk = ...
+        HISTORY, // HISTORY OF ROW table WHERE pk = ...
+        ROW,
+
+        // Ordering keywords
+        GROUP,
+        ORDER,
+        BY,
+        ASC,
+        DESC,
+        LIMIT,
+        OFFSET,
+
+        // Comparison
+        EQUALS,        // =
+        NOT_EQUALS,    // != or <>
+        LESS_THAN,     // <
+        GREATER_THAN,  // >
+        LESS_EQUAL,    // <=
+        GREATER_EQUAL, // >=
+
+        // Arithmetic
+        PLUS,     // +
+        MINUS,    // -
+        ASTERISK, // *
+        SLASH,    // /
+
+        // Punctuation
+        COMMA,       // ,
+        SEMICOLON,   // ;
+        LEFT_PAREN,  // (
+        RIGHT_PAREN, // )
+        DOT,         // .
+
+        // Special
+        END_OF_FILE, // End of input
+        INVALID      // Unknown/error token
+    };
+
+    /**
+     * Convert TokenType to a readable string (for debugging)
+     */
+    std::string token_type_to_string(TokenType type);
+
+    /**
+     * Token
+     *
+     *  Represents a single token from the input.
+     */
+    struct Token
+    {
+        TokenType type;   // What kind of token
+        std::string text; // The orginal text
+
+        // the actual value for the literals
+        std::variant<std::monostate, int64_t, double, std::string> value;
+
+        int line;   // position in source
+        int column; // position in source
+
+        // Constructor
+        Token(TokenType t = TokenType::INVALID,
+              std::string txt = "",
+              int ln = 1,
+              int col = 1)
+            : type(t), text(std::move(txt)), value(std::monostate{}), line(ln), column(col)
+        {
+        }
+
+        bool is(TokenType t) const
+        {
+            return type == t;
+        }
+
+        bool is_keyword() const
+        {
+            return type >= TokenType::SELECT && type <= TokenType::OFFSET;
+        }
+
+        bool is_comparison() const
+        {
+            return type >= TokenType::EQUALS && type <= TokenType::GREATER_EQUAL;
+        }
+
+        std::string to_string() const
+        {
+            std::string result = token_type_to_string(type);
+            if (!text.empty() && type != TokenType::END_OF_FILE)
+            {
+                result += "('" + text + "')";
+            }
+            return result;
+        }
+    };
+
+    class Lexer
+    {
+    public:
+        explicit Lexer(std::string source)
+            : source_(std::move(source)), current_(0), line_(1), column_(1)
+        {
+            init_keywords();
+        }
+
+        std::vector<Token> tokenize();
+
+    private:
+        std::string source_;                                  // input SQL
+        size_t current_;                                      // current pos
+        int line_;                                            // current line
+        int column_;                                          // current col
+        std::unordered_map<std::string, TokenType> keywords_; // keyword lookup
+
+        void init_keywords();
+        bool is_at_end() const
+        {
+            return current_ >= source_.length();
+        }
+        char peek() const;
+
+        char peek_next() const;
+
+        char advance();
+
+        bool match(char expected);
+
+        /**
+         * @returns An INVALID token for an unterminated block comment, otherwise nothing
+         */
+        std::optional<Token> skip_whitespace_and_comments();
+
+        Token scan_token();
+
+        Token make_error_token(const std::string &message, char bad_char, int line, int col)
+        {
+            std::string error_msg = message + " '" + std::string(1, bad_char) + "'" + " (ASCII " + std::to_string(static_cast<int>(bad_char)) + ")";
+            return Token(TokenType::INVALID, error_msg, line, col);
+        }
+
+        Token scan_string(char quote, int start_line, int start_column);
+
+        Token scan_number(size_t start_pos, int start_line, int start_column);
+
+        Token scan_backtick_identifier(int start_line, int start_column);
+
+        Token scan_identifier(size_t start_pos, int start_line, int start_column);
+    };
+};
+
+#endif // REPONO_LEXER_H
@@ -0,0 +1,319 @@
+/**
+ *  ReponoDB: Embedding API
+ *
+ *  Open a repository, connect, run statements and read the results in
+ *  place:
+ *
+ *      std::string error;
+ *      auto db = repono::Database::open("mydb", error);
+ *      auto conn = db->connect();
+ *      conn->execute("CREATE TABLE users (id INTEGER PRIMARY KEY, name VARCHAR)");
+ *      conn->execute("INSERT INTO users VALUES (1, 'Neel')");
+ *      conn->commit("add users");
+ *
+ *      repono::Result result = conn->scan("users");
+ *      for (const repono::RowBatch &batch : result.batches())
+ *      {
+ *          repono::ColumnView names = batch.column(1);
+ *          for (size_t i = 0; i < names.size(); i++)
+ *              std::cout << names.as_string(i) << "\n";
+ *      }
+ *
+ *  Batches borrow the rows they show: scan() hands out the repository's
+ *  own chunks, and statement results are split into batches over the rows
+ *  the executor produced. Nothing is copied per batch or per value, and a
+ *  batch keeps its rows alive on its own, even after the Result, the
+ *  Connection or a buffer pool eviction has let go of them. The rows stay
+ *  rows: a column of a batch is read field by field across them. For
+ *  contiguous column arrays, use Result::export_arrow or
+ *  Connection::export_table.
+ *
+ *  Connections share their Database's repository, including its current
+ *  branch, and calls on any of them are serialized by the Database, so
+ *  connections may be used from different threads.
+ */
+
+#ifndef REPONO_REPONO_H
+#define REPONO_REPONO_H
+
+#include "repono/arrow_abi.h"
+#include "repono/value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace repono
+{
+    class Repository;
+    class Session;
+    struct Statement;
+    struct QueryResult;
+
+    /**
+     * One column of a RowBatch, read in place: the field at one index of
+     * each row, not a contiguous array
+     */
+    class ColumnView
+    {
+    public:
+        ColumnView(const Row *rows, size_t num_rows, size_t index) : rows_(rows), num_rows_(num_rows), index_(index) {}
+
+        size_t size() const { return num_rows_; }
+        const Value &operator[](size_t row) const { return rows_[row][index_]; }
+        bool is_null(size_t row) const { return std::holds_alternative<std::monostate>((*this)[row]); }
+
+        /**
+         * Typed reads. A value of another type reads as 0, "" or false;
+         * as_double also converts integers.
+         */
+        int64_t as_int64(size_t row) const
+        {
+            const int64_t *v = std::get_if<int64_t>(&(*this)[row]);
+            return v ? *v : 0;
+        }
+
+        double as_double(size_t row) const
+        {
+            const Value &v = (*this)[row];
+            if (const double *d = std::get_if<double>(&v))
+                return *d;
+            if (const int64_t *i = std::get_if<int64_t>(&v))
+                return static_cast<double>(*i);
+            return 0;
+        }
+
+        std::string_view as_string(size_t row) const
+        {
+            const std::string *v = std::get_if<std::string>(&(*this)[row]);
+            return v ? std::string_view(*v) : std::string_view();
+        }
+
+        bool as_bool(size_t row) const
+        {
+            const bool *v = std::get_if<bool>(&(*this)[row]);
+            return v && *v;
+        }
+
+    private:
+        const Row *rows_;
+        size_t num_rows_;
+        size_t index_;
+    };
+
+    /**
+     * A run of result rows, borrowed from storage or from the executor's output
+     */
+    class RowBatch
+    {
+    public:
+        RowBatch(std::shared_ptr<const void> owner, const Row *rows, size_t num_rows, size_t num_columns)
+            : owner_(std::move(owner)), rows_(rows), num_rows_(num_rows), num_columns_(num_columns) {}
+
+        size_t num_rows() const { return num_rows_; }
+        size_t num_columns() const { return num_columns_; }
+        const Row &row(size_t index) const { return rows_[index]; }
+        const Value &value(size_t row, size_t column) const { return rows_[row][column]; }
+        ColumnView column(size_t index) const { return ColumnView(rows_, num_rows_, index); }
+
+    private:
+        std::shared_ptr<const void> owner_; // keeps rows_ alive
+        const Row *rows_;
+        size_t num_rows_;
+        size_t num_columns_;
+    };
+
+    /**
+     * Outcome of a statement: an error, or columns and batches of rows
+     */
+    class Result
+    {
+    public:
+        bool ok() const { return error_.empty(); }
+        const std::string &error() const { return error_; }
+        const std::string &message() const { return message_; }
+        size_t rows_affected() const { return rows_affected_; }
+
+        const std::vector<std::string> &columns() const { return columns_; }
+        size_t num_rows() const { return num_rows_; }
+        const std::vector<RowBatch> &batches() const { return batches_; }
+
+        /**
+         * The rows as an Arrow IPC stream, with repeated strings
+         * dictionary-encoded, for handing a large result to another process
+         */
+        std::string to_arrow() const;
+
+        /**
+         * Hand the rows to an Arrow library through the C stream interface.
+         * Column types are inferred from the values.
+         */
+        void export_arrow(ArrowArrayStream *out) const;
+
+    private:
+        friend class Connection;
+
+        std::string error_;
+        std::string message_;
+        size_t rows_affected_ = 0;
+        std::vector<std::string> columns_;
+        size_t num_rows_ = 0;
+        std::vector<RowBatch> batches_;
+    };
+
+    /**
+     * A parsed statement that can be executed many times
+     */
+    class PreparedStatement
+    {
+    public:
+        const std::string &sql() const { return sql_; }
+
+    private:
+        friend class Connection;
+
+        std::string sql_;
+        std::shared_ptr<const Statement> statement_;
+    };
+
+    class Database;
+
+    /**
+     * A session on a Database, with its own uncommitted working set
+     */
+    class Connection
+    {
+    public:
+        ~Connection();
+
+        Connection(const Connection &) = delete;
+        Connection &operator=(const Connection &) = delete;
+
+        /**
+         * Parse and run one statement
+         */
+        Result execute(const std::string &sql);
+
+        /**
+         * Parse a statement once, to run it later with execute()
+         *
+         * @param error Set to the parse error on failure
+         * @returns The statement, or nullptr if it does not parse
+         */
+        std::unique_ptr<PreparedStatement> prepare(const std::string &sql, std::string &error);
+
+        Result execute(const PreparedStatement &statement);
+
+        /**
+         * Commit the working set to the current branch
+         */
+        Result commit(const std::string &message);
+
+        /**
+         * Switch branches, creating the branch at the current commit if asked
+         */
+        Result checkout(const std::string &branch, bool create = false);
+
+        /**
+         * Switch branches and load only the given tables into the working set
+         * (all of them when tables is empty). The choice sticks for later
+         * checkouts; other tables are still readable with AS OF, diff() and
+         * scan(), and COMMIT keeps them as they are.
+         */
+        Result sparse_checkout(const std::string &branch, const std::vector<std::string> &tables);
+
+        /**
+         * Rows of a table that differ between two revisions, as diff() returns them
+         */
+        Result diff(const std::string &table, const std::string &from, const std::string &to);
+
+        /**
+         * Every committed row of a table at a revision ("" = the current
+         * branch head), one batch per storage chunk, without copying rows.
+         * Uncommitted changes are not included.
+         */
+        Result scan(const std::string &table, const std::string &revision = "");
+
+        /**
+         * A table at a revision ("" = the current branch head) as a stream of
+         * Arrow record batches, typed from the table's schema. The batches
+         * point into buffers built once from the stored rows and are not
+         * copied again.
+         *
+         * @returns "" on success or an error message
+         */
+        std::string export_table(const std::string &table, const std::string &revision, ArrowArrayStream *out);
+
+        /**
+         * Load a stream of Arrow record batches into a table and commit it.
+         * A missing table is created from the stream's schema (without a
+         * primary key); an existing one gets the rows appended, matching
+         * columns by name. Fails, changing nothing, if the working set has
+         * uncommitted changes or any row does not fit. The stream is
+         * released either way.
+         */
+        Result import_arrow(const std::string &table, ArrowArrayStream *stream, const std::string &message);
+
+        /**
+         * The commit the working set is based on ("" before the first commit)
+         */
+        std::string base_hash() const;
+        bool has_uncommitted_changes() const;
+
+    private:
+        friend class Database;
+
+        Connection(Database &db, bool read_only);
+        Result finish(std::shared_ptr<const QueryResult> result) const;
+
+        Database &db_;
+        std::unique_ptr<Session> session_;
+    };
+
+    /**
+     * A repository opened for embedding
+     */
+    class Database
+    {
+    public:
+        /**
+         * Open (or create) a repository directory; "" keeps everything in memory
+         *
+         * @param error Set to the reason on failure
+         * @returns The database, or nullptr on failure
+         */
+        static std::unique_ptr<Database> open(const std::string &dir, std::string &error);
+
+        ~Database();
+
+        Database(const Database &) = delete;
+        Database &operator=(const Database &) = delete;
+
+        /**
+         * Start a session; read-only sessions reject writes. Connections
+         * must not outlive the Database.
+         */
+        std::unique_ptr<Connection> connect(bool read_only = false);
+
+        std::string current_branch() const;
+
+        /**
+         * Head commit of the current branch ("" if it has none)
+         */
+        std::string head() const;
+
+    private:
+        friend class Connection;
+
+        Database();
+
+        std::unique_ptr<Repository> repo_;
+        mutable std::mutex mutex_;
+    };
+};
+
+#endif // REPONO_REPONO_H
@@ -0,0 +1,185 @@
+/**
+ *  ReponoDB: C API
+ *
+ *  A C ABI over the embedding API in repono.h, for other languages and
+ *  runtimes. Handles are opaque; every call that can fail reports why
+ *  through an error string. Values read from a result point into the
+ *  result's own memory (strings are not copied or terminated), and stay
+ *  valid until repono_result_free.
+ *
+ *      char *error = NULL;
+ *      repono_database *db = repono_open("mydb", &error);
+ *      repono_connection *conn = repono_connect(db, 0);
+ *      repono_result *result = repono_execute(conn, "SELECT id, name FROM users");
+ *      if (repono_result_error(result) == NULL)
+ *      {
+ *          for (size_t b = 0; b < repono_result_batch_count(result); b++)
+ *              for (size_t r = 0; r < repono_batch_row_count(result, b); r++)
+ *              {
+ *                  repono_value name = repono_batch_value(result, b, r, 1);
+ *                  printf("%.*s\n", (int)name.as.string.length, name.as.string.data);
+ *              }
+ *      }
+ *      repono_result_free(result);
+ *      repono_disconnect(conn);
+ *      repono_close(db);
+ */
+
+#ifndef REPONO_REPONO_C_H
+#define REPONO_REPONO_C_H
+
+#include "repono/arrow_abi.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct repono_database repono_database;
+    typedef struct repono_connection repono_connection;
+    typedef struct repono_statement repono_statement;
+    typedef struct repono_result repono_result;
+
+    typedef enum repono_type
+    {
+        REPONO_NULL = 0,
+        REPONO_INTEGER = 1,
+        REPONO_FLOAT = 2,
+        REPONO_STRING = 3,
+        REPONO_BOOLEAN = 4
+    } repono_type;
+
+    typedef struct repono_value
+    {
+        repono_type type;
+        union
+        {
+            int64_t integer;
+            double real;
+            int boolean;
+            struct
+            {
+                const char *data; /* borrowed, not NUL-terminated */
+                size_t length;
+            } string;
+        } as;
+    } repono_value;
+
+    /**
+     * Open (or create) a repository directory; NULL or "" keeps it in memory
+     *
+     * @param error If non-NULL, set on failure to a message to release with repono_free
+     * @returns The database, or NULL on failure
+     */
+    repono_database *repono_open(const char *dir, char **error);
+    void repono_close(repono_database *db);
+
+    /**
+     * Start a session; read_only != 0 rejects writes
+     */
+    repono_connection *repono_connect(repono_database *db, int read_only);
+    void repono_disconnect(repono_connection *conn);
+
+    /**
+     * Run statements. These always return a result (NULL only when out of
+     * memory); check repono_result_error.
+     */
+    repono_result *repono_execute(repono_connection *conn, const char *sql);
+    repono_result *repono_commit(repono_connection *conn, const char *message);
+    repono_result *repono_checkout(repono_connection *conn, const char *branch, int create);
+
+    /**
+     * Switch branches, loading only count tables into the working set (all
+     * of them when count is 0)
+     */
+    repono_result *repono_sparse_checkout(repono_connection *conn, const char *branch, const char *const *tables,
+                                          size_t count);
+    repono_result *repono_diff(repono_connection *conn, const char *table, const char *from, const char *to);
+
+    /**
+     * Committed rows of a table at a revision (NULL = current branch head),
+     * one batch per storage chunk, read without copying
+     */
+    repono_result *repono_scan(repono_connection *conn, const char *table, const char *revision);
+
+    /**
+     * Parse a statement once to run it many times
+     *
+     * @param error If non-NULL, set on failure to a message to release with repono_free
+     * @returns The statement, or NULL if it does not parse
+     */
+    repono_statement *repono_prepare(repono_connection *conn, const char *sql, char **error);
+    repono_result *repono_statement_execute(repono_statement *stmt);
+    void repono_statement_free(repono_statement *stmt);
+
+    /**
+     * NULL on success, else the error message (owned by the result)
+     */
+    const char *repono_result_error(const repono_result *result);
+    const char *repono_result_message(const repono_result *result);
+    size_t repono_result_rows_affected(const repono_result *result);
+    size_t repono_result_column_count(const repono_result *result);
+    const char *repono_result_column_name(const repono_result *result, size_t column);
+    size_t repono_result_row_count(const repono_result *result);
+    size_t repono_result_batch_count(const repono_result *result);
+    size_t repono_batch_row_count(const repono_result *result, size_t batch);
+
+    /**
+     * One value; out of range positions read as REPONO_NULL
+     */
+    repono_value repono_batch_value(const repono_result *result, size_t batch, size_t row, size_t column);
+
+    /**
+     * Gather up to capacity values of one column of a batch into out (a
+     * batch holds rows, so this reads one field of each)
+     *
+     * @returns The number of values written
+     */
+    size_t repono_batch_column(const repono_result *result, size_t batch, size_t column, repono_value *out, size_t capacity);
+
+    /**
+     * Serialize the rows as an Arrow IPC stream
+     *
+     * @param length Set to the size of the stream
+     * @returns The stream, to release with repono_free (NULL when out of memory)
+     */
+    char *repono_result_to_arrow(const repono_result *result, size_t *length);
+
+    /**
+     * Hand the rows to an Arrow library through the C stream interface;
+     * the stream stays valid after the result is freed
+     */
+    void repono_result_export(const repono_result *result, struct ArrowArrayStream *out);
+
+    /**
+     * Export a table at a revision (NULL = current branch head) through the
+     * Arrow C stream interface
+     *
+     * @param error If non-NULL, set on failure to a message to release with repono_free
+     * @returns 0 on success, -1 on failure
+     */
+    int repono_export_table(repono_connection *conn, const char *table, const char *revision,
+                            struct ArrowArrayStream *out, char **error);
+
+    /**
+     * Append an Arrow stream's rows to a table, creating it if needed, and
+     * commit them with message. The stream is consumed and released.
+     */
+    repono_result *repono_import(repono_connection *conn, const char *table, struct ArrowArrayStream *stream,
+                                 const char *message);
+
+    void repono_result_free(repono_result *result);
+
+    /**
+     * Release an error message returned through an error out-parameter
+     */
+    void repono_free(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPONO_REPONO_C_H */
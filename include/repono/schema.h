@@ -0,0 +1,165 @@
+/**
+ *  ReponoDB: Column definitions and table schemas
+ */
+
+#ifndef REPONO_SCHEMA_H
+#define REPONO_SCHEMA_H
+
+#include "repono/value.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace repono
+{
+    /*
+     * Describes one column in a table, e.g.:
+     * name: "id"
+     * type: INTEGER, VARCHAR, etc.
+     * is_primary_key: Is this the primary key?
+     * is_nullable: Can this column contain NULL?
+     */
+
+    struct ColumnDef
+    {
+        std::string name;
+        DataType type = DataType::INTEGER;
+        bool is_primary_key = false;
+        bool is_nullable = true;
+
+        ColumnDef() = default; // default constructor
+
+        ColumnDef(std::string n, DataType t, bool pk = false, bool nullable = true) : name(std::move(n)), type(t), is_primary_key(pk), is_nullable(nullable) {};
+
+        /**
+         * Validate that a value matches this column's type
+         *
+         * @param v The Value to validate
+         * @returns "" if valid or an error message if invalid
+         */
+        std::string validate(const Value &v) const
+        {
+            if (is_null(v))
+            {
+                if (!is_nullable)
+                {
+                    return "Column '" + name + "' cannot be NULL";
+                }
+                return "";
+            }
+            bool type_ok = false;
+
+            switch (type)
+            {
+            case DataType::INTEGER:
+                type_ok = std::holds_alternative<int64_t>(v);
+                break;
+            case DataType::FLOAT:
+                // Accept both int and float (int gets converted)
+                type_ok = std::holds_alternative<double>(v) || std::holds_alternative<int64_t>(v);
+                break;
+            case DataType::VARCHAR:
+                type_ok = std::holds_alternative<std::string>(v);
+                break;
+            case DataType::BOOLEAN:
+                type_ok = std::holds_alternative<bool>(v);
+                break;
+            case DataType::TIMESTAMP:
+                type_ok = std::holds_alternative<int64_t>(v); // Store as int64_t
+                break;
+            }
+
+            if (!type_ok)
+            {
+                return "Column '" + name + "' expects " +
+                       datatype_to_string(type) + ", got wrong type";
+            }
+            return "";
+        }
+    };
+
+    class Schema
+    {
+
+    public:
+        /**
+         * Add a column to the schema
+         *
+         * @param column The column to add
+         */
+
+        Schema() = default;
+
+        // Copy constructor
+        Schema(const Schema &other)
+            : columns_(other.columns_),
+              column_indices_(other.column_indices_) {}
+
+        // Copy assignment operator
+
+        Schema &operator=(const Schema &other);
+        void add_column(const ColumnDef &column)
+        {
+            column_indices_[column.name] = columns_.size();
+            columns_.push_back(column);
+        }
+
+        /**
+         * Get all the columns
+         */
+        const std::vector<ColumnDef> &get_columns() const { return columns_; }
+
+        /**
+         * Get the number of columns
+         */
+
+        size_t num_columns() const { return columns_.size(); }
+
+        /**
+         * Look up a column's index by name
+         * Returns std::nullopt if not found
+         *
+         * @param name The name of the specific column
+         * @return The index of the column, or std::nullopt if not found
+
+         */
+        std::optional<size_t> get_column_index(const std::string &name) const;
+
+        /**
+         * Get a column definition by its name
+         *
+         * @param name The name of the column
+         * @returns Pointer to the ColumnDef, or nullptr if not found
+         */
+        const ColumnDef *get_column(const std::string &name) const;
+
+        /**
+         * Check if a column exists
+         * @param name The name of the column
+         * @returns true if the column exists, false otherwise
+         */
+
+        bool has_column(const std::string &name) const
+        {
+            return column_indices_.find(name) != column_indices_.end();
+        }
+
+        /**
+         * Validates that the schema and the rows match up
+         * @param row The row of values to validate against the schema
+         */
+
+        std::string validate_row(const Row &row) const;
+
+    private:
+        std::vector<ColumnDef> columns_; // Ordered list  e.g. [ ColumnDef("id"), ColumnDef("name"), ColumnDef("age") ]
+
+        std::unordered_map<std::string, size_t> column_indices_; // Name -> index  e.g. { "id"→0, "name"→1, "age"→2 }
+    };
+};
+
+#endif // REPONO_SCHEMA_H
@@ -0,0 +1,92 @@
+/**
+ *  ReponoDB: Values and rows
+ */
+
+#ifndef REPONO_VALUE_H
+#define REPONO_VALUE_H
+
+#include <cstdint>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace repono
+{
+    using Value = std::variant< // variant actually holds data
+        std::monostate,         // Basically null
+        int64_t,
+        double,
+        std::string,
+        bool>;
+
+    using Row = std::vector<Value>;
+
+    // Row is just a collection of values
+
+    /**
+     * Convert a Value to a string for display
+     *
+     * @param v The Value to convert
+     * @return String representation of the value
+     */
+
+    std::string value_to_string(const Value &v);
+
+    /**
+     * Compare two Values for equality
+     *
+     * NULL = NULL is FALSE
+     * NULL = anything is FALSE
+     * NULL <> anything is also FALSE!
+     *
+     * @param a One of the values to compare
+     * @param b Second one of the values to compare
+     */
+
+    bool values_equal(const Value &a, const Value &b);
+
+    /**
+     * Compare two Values for ordering (less than)
+     *
+     * Used for ORDER BY and comparisons like <, >, <=, >=
+     *
+     * We put NULLs at the end (convention, could be start)
+     * This makes ORDER BY behave consistently
+     *
+     * @param a One of the values to compare
+     * @param b Second one of the values to compare
+     *
+     * @return true if a < b
+     */
+
+    bool value_less_than(const Value &a, const Value &b);
+
+    /**
+     * Check if a value is NULL
+     *
+     * @param v Value to check if its null
+     */
+    inline bool is_null(const Value &v)
+    {
+        return std::holds_alternative<std::monostate>(v);
+    }
+
+    enum class DataType
+    {
+        INTEGER,
+        FLOAT,
+        VARCHAR, // text strings (stored as std::string)
+        BOOLEAN,
+        TIMESTAMP
+    };
+
+    /**
+     * Get the string version of a datatype
+     *
+     * @param type The type to convert
+     */
+
+    std::string datatype_to_string(DataType type);
+};
+
+#endif // REPONO_VALUE_H
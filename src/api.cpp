@@ -0,0 +1,340 @@
+/**
+ *  ReponoDB: Embedding API
+ */
+
+#include "repono/repono.h"
+#include "arrow_c.h"
+#include "columnar.h"
+#include "lsm.h"
+#include "session.h"
+#include "trace.h"
+
+#include <algorithm>
+
+namespace repono
+{
+    namespace
+    {
+        constexpr size_t kResultBatchRows = 1024;
+
+        /**
+         * The schema and non-empty chunks of a table at a revision ("" = the
+         * current branch head)
+         *
+         * @returns "" on success or an error message
+         */
+        std::string table_chunks(const Repository &repo, const std::string &table, const std::string &revision,
+                                 Schema &schema, std::vector<ChunkPtr> &chunks)
+        {
+            std::string rev = revision.empty() ? repo.current_branch() : revision;
+            auto hash = resolve_revision(repo, rev);
+            const CommitRecord *record = hash.has_value() ? repo.get_record(*hash) : nullptr;
+            if (record == nullptr)
+                return "Unknown revision '" + rev + "'";
+            auto it = record->tables.find(table);
+            if (it == record->tables.end())
+                return "Table '" + table + "' does not exist at " + rev;
+
+            const TableManifest &manifest = it->second;
+            schema = manifest.schema;
+            if (manifest.storage == TableStorage::LSM)
+            {
+                // Runs overlap, so read them merged, as one chunk
+                auto merged = std::make_shared<Chunk>();
+                std::string error = read_lsm_rows(repo, manifest, merged->rows);
+                if (!error.empty())
+                    return error;
+                if (!merged->rows.empty())
+                    chunks.push_back(std::move(merged));
+                return "";
+            }
+            chunks.reserve(manifest.chunk_hashes.size());
+            for (const auto &chunk_hash : manifest.chunk_hashes)
+            {
+                ChunkPtr chunk = repo.get_chunk(chunk_hash);
+                if (!chunk)
+                    return "Missing chunk " + chunk_hash;
+                if (!chunk->rows.empty())
+                    chunks.push_back(std::move(chunk));
+            }
+            return "";
+        }
+    }
+
+    std::string Result::to_arrow() const
+    {
+        std::vector<RowRange> ranges;
+        ranges.reserve(batches_.size());
+        for (const RowBatch &batch : batches_)
+        {
+            if (batch.num_rows() > 0)
+                ranges.push_back(RowRange{&batch.row(0), batch.num_rows()});
+        }
+        return write_arrow_stream(to_columnar(columns_, ranges));
+    }
+
+    void Result::export_arrow(ArrowArrayStream *out) const
+    {
+        std::vector<RowRange> ranges;
+        ranges.reserve(batches_.size());
+        for (const RowBatch &batch : batches_)
+        {
+            if (batch.num_rows() > 0)
+                ranges.push_back(RowRange{&batch.row(0), batch.num_rows()});
+        }
+        export_arrow_stream(std::make_shared<const ColumnarResult>(to_columnar(columns_, ranges)), out);
+    }
+
+    Database::Database() : repo_(std::make_unique<Repository>()) {}
+
+    Database::~Database() = default;
+
+    std::unique_ptr<Database> Database::open(const std::string &dir, std::string &error)
+    {
+        std::unique_ptr<Database> db(new Database());
+        if (!dir.empty())
+        {
+            error = db->repo_->open(dir);
+            if (!error.empty())
+            {
+                return nullptr;
+            }
+        }
+        return db;
+    }
+
+    std::unique_ptr<Connection> Database::connect(bool read_only)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::unique_ptr<Connection>(new Connection(*this, read_only));
+    }
+
+    std::string Database::current_branch() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return repo_->current_branch();
+    }
+
+    std::string Database::head() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return repo_->head();
+    }
+
+    Connection::Connection(Database &db, bool read_only)
+        : db_(db), session_(std::make_unique<Session>(*db.repo_, read_only)) {}
+
+    Connection::~Connection()
+    {
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        session_.reset();
+    }
+
+    Result Connection::finish(std::shared_ptr<const QueryResult> result) const
+    {
+        Result out;
+        out.error_ = result->error;
+        out.message_ = result->message;
+        out.rows_affected_ = result->rows_affected;
+        out.columns_ = result->columns;
+        out.num_rows_ = result->rows.size();
+        size_t width = result->columns.size();
+        for (size_t begin = 0; begin < result->rows.size(); begin += kResultBatchRows)
+        {
+            size_t count = std::min(kResultBatchRows, result->rows.size() - begin);
+            out.batches_.emplace_back(result, result->rows.data() + begin, count, width);
+        }
+        return out;
+    }
+
+    Result Connection::execute(const std::string &sql)
+    {
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        return finish(std::make_shared<QueryResult>(session_->execute(sql)));
+    }
+
+    std::unique_ptr<PreparedStatement> Connection::prepare(const std::string &sql, std::string &error)
+    {
+        auto stmt = parse_sql(sql, error);
+        if (!stmt.has_value())
+        {
+            return nullptr;
+        }
+        auto prepared = std::make_unique<PreparedStatement>();
+        prepared->sql_ = sql;
+        prepared->statement_ = std::make_shared<const Statement>(std::move(*stmt));
+        return prepared;
+    }
+
+    Result Connection::execute(const PreparedStatement &statement)
+    {
+        // Execution binds and rewrites the statement, so each run gets its
+        // own copy; expression trees are shared and binding them is idempotent
+        Statement stmt = *statement.statement_;
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        return finish(std::make_shared<QueryResult>(session_->execute(stmt, statement.sql_)));
+    }
+
+    Result Connection::commit(const std::string &message)
+    {
+        Statement stmt;
+        stmt.type = StatementType::COMMIT;
+        stmt.message = message;
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        return finish(std::make_shared<QueryResult>(session_->execute(stmt)));
+    }
+
+    Result Connection::checkout(const std::string &branch, bool create)
+    {
+        Statement stmt;
+        stmt.type = StatementType::CHECKOUT;
+        stmt.branch = branch;
+        stmt.create_branch = create;
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        return finish(std::make_shared<QueryResult>(session_->execute(stmt)));
+    }
+
+    Result Connection::sparse_checkout(const std::string &branch, const std::vector<std::string> &tables)
+    {
+        Statement stmt;
+        stmt.type = StatementType::CHECKOUT;
+        stmt.branch = branch;
+        stmt.sparse = true;
+        stmt.sparse_tables = tables;
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        return finish(std::make_shared<QueryResult>(session_->execute(stmt)));
+    }
+
+    Result Connection::diff(const std::string &table, const std::string &from, const std::string &to)
+    {
+        Statement stmt;
+        stmt.type = StatementType::SELECT;
+        stmt.table = table;
+        stmt.source_function = "DIFF";
+        stmt.source_args = {table, from, to};
+        stmt.select_items.push_back(SelectItem{});
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        return finish(std::make_shared<QueryResult>(session_->execute(stmt)));
+    }
+
+    Result Connection::scan(const std::string &table, const std::string &revision)
+    {
+        REPONO_TRACE_SPAN("Connection::scan");
+        Result out;
+        Schema schema;
+        std::vector<ChunkPtr> chunks;
+        {
+            std::lock_guard<std::mutex> lock(db_.mutex_);
+            out.error_ = table_chunks(*db_.repo_, table, revision, schema, chunks);
+        }
+        if (!out.ok())
+            return out;
+
+        for (const auto &col : schema.get_columns())
+            out.columns_.push_back(col.name);
+        out.batches_.reserve(chunks.size());
+        for (const auto &chunk : chunks)
+        {
+            out.num_rows_ += chunk->rows.size();
+            out.batches_.emplace_back(chunk, chunk->rows.data(), chunk->rows.size(), out.columns_.size());
+        }
+        return out;
+    }
+
+    std::string Connection::export_table(const std::string &table, const std::string &revision, ArrowArrayStream *out)
+    {
+        REPONO_TRACE_SPAN("Connection::export_table");
+        Schema schema;
+        std::vector<ChunkPtr> chunks;
+        {
+            std::lock_guard<std::mutex> lock(db_.mutex_);
+            std::string error = table_chunks(*db_.repo_, table, revision, schema, chunks);
+            if (!error.empty())
+                return error;
+        }
+
+        // The chunks are immutable and held here, so the transposition runs unlocked
+        std::vector<std::string> names;
+        for (const auto &col : schema.get_columns())
+            names.push_back(col.name);
+        std::vector<RowRange> ranges;
+        for (const auto &chunk : chunks)
+            ranges.push_back(RowRange{chunk->rows.data(), chunk->rows.size()});
+        ColumnarOptions options;
+        options.types = column_types(schema);
+        export_arrow_stream(std::make_shared<const ColumnarResult>(to_columnar(names, ranges, options)), out);
+        return "";
+    }
+
+    Result Connection::import_arrow(const std::string &table, ArrowArrayStream *stream, const std::string &message)
+    {
+        REPONO_TRACE_SPAN("Connection::import_arrow");
+        Result out;
+        Schema schema;
+        std::vector<Row> rows;
+        out.error_ = import_arrow_stream(stream, schema, rows);
+        if (!out.ok())
+            return out;
+
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        if (session_->has_uncommitted_changes())
+        {
+            out.error_ = "Uncommitted changes; COMMIT before importing";
+            return out;
+        }
+        const Repository &repo = *db_.repo_;
+        const CommitRecord *head = repo.head().empty() ? nullptr : repo.get_record(repo.head());
+        bool exists = head != nullptr && head->tables.count(table) > 0;
+
+        if (!exists)
+        {
+            Statement create;
+            create.type = StatementType::CREATE_TABLE;
+            create.table = table;
+            create.schema = schema;
+            QueryResult created = session_->execute(create);
+            if (!created.ok())
+                return finish(std::make_shared<QueryResult>(std::move(created)));
+        }
+
+        Statement insert;
+        insert.type = StatementType::INSERT;
+        insert.table = table;
+        for (const auto &col : schema.get_columns())
+            insert.columns.push_back(col.name);
+        insert.rows = std::move(rows);
+        QueryResult inserted = session_->execute(insert);
+        if (!inserted.ok())
+        {
+            if (!exists)
+            {
+                Statement drop;
+                drop.type = StatementType::DROP_TABLE;
+                drop.table = table;
+                session_->execute(drop);
+            }
+            return finish(std::make_shared<QueryResult>(std::move(inserted)));
+        }
+
+        Statement commit;
+        commit.type = StatementType::COMMIT;
+        commit.message = message;
+        QueryResult committed = session_->execute(commit);
+        committed.rows_affected = inserted.rows_affected;
+        if (committed.ok())
+            committed.message = "Imported " + std::to_string(inserted.rows_affected) + " row(s) into " + table + "; " + committed.message;
+        return finish(std::make_shared<QueryResult>(std::move(committed)));
+    }
+
+    std::string Connection::base_hash() const
+    {
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        return session_->base_hash();
+    }
+
+    bool Connection::has_uncommitted_changes() const
+    {
+        std::lock_guard<std::mutex> lock(db_.mutex_);
+        return session_->has_uncommitted_changes();
+    }
+};
@@ -0,0 +1,585 @@
+/**
+ *  ReponoDB: Arrow C Data Interface export and import
+ */
+
+#include "arrow_c.h"
+#include "trace.h"
+
+#include <cstring>
+#include <limits>
+#include <optional>
+
+namespace repono
+{
+    namespace
+    {
+        // Stands in for empty buffers, which consumers may not accept as NULL
+        alignas(64) const uint8_t kEmptyBuffer[64] = {};
+
+        const void *buffer(const std::string &bytes)
+        {
+            return bytes.empty() ? static_cast<const void *>(kEmptyBuffer) : bytes.data();
+        }
+
+        // EXPORT
+
+        struct SchemaPrivate
+        {
+            std::string format;
+            std::string name;
+            std::vector<ArrowSchema *> children;
+            ArrowSchema *dictionary = nullptr;
+        };
+
+        void release_schema(ArrowSchema *schema)
+        {
+            auto *p = static_cast<SchemaPrivate *>(schema->private_data);
+            for (ArrowSchema *child : p->children)
+            {
+                if (child->release != nullptr)
+                    child->release(child);
+                delete child;
+            }
+            if (p->dictionary != nullptr)
+            {
+                if (p->dictionary->release != nullptr)
+                    p->dictionary->release(p->dictionary);
+                delete p->dictionary;
+            }
+            delete p;
+            schema->release = nullptr;
+        }
+
+        SchemaPrivate *init_schema(ArrowSchema *schema, const std::string &format, const std::string &name, int64_t flags)
+        {
+            auto *p = new SchemaPrivate{format, name, {}, nullptr};
+            schema->format = p->format.c_str();
+            schema->name = p->name.c_str();
+            schema->metadata = nullptr;
+            schema->flags = flags;
+            schema->n_children = 0;
+            schema->children = nullptr;
+            schema->dictionary = nullptr;
+            schema->release = release_schema;
+            schema->private_data = p;
+            return p;
+        }
+
+        const char *format_of(ColumnType type)
+        {
+            switch (type)
+            {
+            case ColumnType::NULLS:
+                return "n";
+            case ColumnType::INT64:
+                return "l";
+            case ColumnType::FLOAT64:
+                return "g";
+            case ColumnType::BOOLEAN:
+                return "b";
+            case ColumnType::UTF8:
+                return "u";
+            case ColumnType::DICTIONARY:
+                return "i"; // the indices; the dictionary schema says utf8
+            case ColumnType::TIMESTAMP:
+                return "tss:";
+            }
+            return "u";
+        }
+
+        void export_schema(const ColumnarResult &result, ArrowSchema *out)
+        {
+            SchemaPrivate *p = init_schema(out, "+s", "", 0);
+            for (size_t c = 0; c < result.names.size(); c++)
+            {
+                auto *child = new ArrowSchema;
+                SchemaPrivate *cp = init_schema(child, format_of(result.types[c]), result.names[c], ARROW_FLAG_NULLABLE);
+                if (result.types[c] == ColumnType::DICTIONARY)
+                {
+                    cp->dictionary = new ArrowSchema;
+                    init_schema(cp->dictionary, "u", "", ARROW_FLAG_NULLABLE);
+                    child->dictionary = cp->dictionary;
+                }
+                p->children.push_back(child);
+            }
+            out->n_children = static_cast<int64_t>(p->children.size());
+            out->children = p->children.data();
+        }
+
+        struct ArrayPrivate
+        {
+            std::shared_ptr<const ColumnarResult> owner; // keeps the buffers alive
+            std::vector<const void *> buffers;
+            std::vector<ArrowArray *> children;
+            ArrowArray *dictionary = nullptr;
+        };
+
+        void release_array(ArrowArray *array)
+        {
+            auto *p = static_cast<ArrayPrivate *>(array->private_data);
+            for (ArrowArray *child : p->children)
+            {
+                if (child->release != nullptr)
+                    child->release(child);
+                delete child;
+            }
+            if (p->dictionary != nullptr)
+            {
+                if (p->dictionary->release != nullptr)
+                    p->dictionary->release(p->dictionary);
+                delete p->dictionary;
+            }
+            delete p;
+            array->release = nullptr;
+        }
+
+        ArrayPrivate *init_array(ArrowArray *array, std::shared_ptr<const ColumnarResult> owner, size_t length, size_t null_count)
+        {
+            auto *p = new ArrayPrivate{std::move(owner), {}, {}, nullptr};
+            array->length = static_cast<int64_t>(length);
+            array->null_count = static_cast<int64_t>(null_count);
+            array->offset = 0;
+            array->n_buffers = 0;
+            array->n_children = 0;
+            array->buffers = nullptr;
+            array->children = nullptr;
+            array->dictionary = nullptr;
+            array->release = release_array;
+            array->private_data = p;
+            return p;
+        }
+
+        void export_column(const std::shared_ptr<const ColumnarResult> &owner, const ColumnBuffers &col, ColumnType type,
+                           const ColumnBuffers *dictionary, ArrowArray *out)
+        {
+            ArrayPrivate *p = init_array(out, owner, col.length, col.null_count);
+            if (type != ColumnType::NULLS)
+            {
+                p->buffers.push_back(col.validity.empty() ? nullptr : col.validity.data());
+                if (type == ColumnType::UTF8)
+                    p->buffers.push_back(buffer(col.offsets));
+                p->buffers.push_back(buffer(col.data));
+            }
+            out->n_buffers = static_cast<int64_t>(p->buffers.size());
+            out->buffers = p->buffers.data();
+            if (type == ColumnType::DICTIONARY)
+            {
+                p->dictionary = new ArrowArray;
+                export_column(owner, *dictionary, ColumnType::UTF8, nullptr, p->dictionary);
+                out->dictionary = p->dictionary;
+            }
+        }
+
+        struct StreamPrivate
+        {
+            std::shared_ptr<const ColumnarResult> result;
+            size_t next = 0;
+        };
+
+        int stream_get_schema(ArrowArrayStream *stream, ArrowSchema *out)
+        {
+            export_schema(*static_cast<StreamPrivate *>(stream->private_data)->result, out);
+            return 0;
+        }
+
+        int stream_get_next(ArrowArrayStream *stream, ArrowArray *out)
+        {
+            auto *p = static_cast<StreamPrivate *>(stream->private_data);
+            const ColumnarResult &result = *p->result;
+            if (p->next >= result.batches.size())
+            {
+                out->release = nullptr; // end of stream
+                return 0;
+            }
+            const ColumnarBatch &batch = result.batches[p->next++];
+            ArrayPrivate *ap = init_array(out, p->result, batch.num_rows, 0);
+            ap->buffers.push_back(nullptr); // a struct array has only a validity buffer
+            for (size_t c = 0; c < batch.columns.size(); c++)
+            {
+                auto *child = new ArrowArray;
+                export_column(p->result, batch.columns[c], result.types[c], &result.dictionaries[c], child);
+                ap->children.push_back(child);
+            }
+            out->n_buffers = 1;
+            out->buffers = ap->buffers.data();
+            out->n_children = static_cast<int64_t>(ap->children.size());
+            out->children = ap->children.data();
+            return 0;
+        }
+
+        const char *stream_get_last_error(ArrowArrayStream *)
+        {
+            return nullptr; // exporting cannot fail once the stream exists
+        }
+
+        void stream_release(ArrowArrayStream *stream)
+        {
+            delete static_cast<StreamPrivate *>(stream->private_data);
+            stream->release = nullptr;
+        }
+
+        // IMPORT
+
+        /**
+         * How to read one column's values out of Arrow buffers
+         */
+        struct ImportType
+        {
+            enum Kind
+            {
+                NULLS,
+                INT,
+                UINT,
+                FLOAT32,
+                FLOAT64,
+                BOOL,
+                UTF8,
+                LARGE_UTF8,
+                TIMESTAMP, // int64 in some unit, scaled to seconds
+                DATE32,    // int32 days
+                DATE64     // int64 milliseconds
+            };
+
+            Kind kind = NULLS;
+            int width = 0;       // bytes, for INT / UINT
+            int64_t divisor = 1; // units per second, for TIMESTAMP
+        };
+
+        std::optional<ImportType> parse_format(const std::string &format)
+        {
+            auto integer = [](ImportType::Kind kind, int width)
+            {
+                ImportType t;
+                t.kind = kind;
+                t.width = width;
+                return t;
+            };
+            auto simple = [](ImportType::Kind kind)
+            {
+                ImportType t;
+                t.kind = kind;
+                return t;
+            };
+            if (format.size() == 1)
+            {
+                switch (format[0])
+                {
+                case 'n':
+                    return simple(ImportType::NULLS);
+                case 'b':
+                    return simple(ImportType::BOOL);
+                case 'c':
+                    return integer(ImportType::INT, 1);
+                case 'C':
+                    return integer(ImportType::UINT, 1);
+                case 's':
+                    return integer(ImportType::INT, 2);
+                case 'S':
+                    return integer(ImportType::UINT, 2);
+                case 'i':
+                    return integer(ImportType::INT, 4);
+                case 'I':
+                    return integer(ImportType::UINT, 4);
+                case 'l':
+                    return integer(ImportType::INT, 8);
+                case 'L':
+                    return integer(ImportType::UINT, 8);
+                case 'f':
+                    return simple(ImportType::FLOAT32);
+                case 'g':
+                    return simple(ImportType::FLOAT64);
+                case 'u':
+                    return simple(ImportType::UTF8);
+                case 'U':
+                    return simple(ImportType::LARGE_UTF8);
+                }
+            }
+            if (format == "tdD")
+                return simple(ImportType::DATE32);
+            if (format == "tdm")
+                return simple(ImportType::DATE64);
+            if (format.size() >= 4 && format.compare(0, 2, "ts") == 0 && format[3] == ':')
+            {
+                ImportType t = simple(ImportType::TIMESTAMP);
+                switch (format[2])
+                {
+                case 's':
+                    t.divisor = 1;
+                    return t;
+                case 'm':
+                    t.divisor = 1000;
+                    return t;
+                case 'u':
+                    t.divisor = 1000000;
+                    return t;
+                case 'n':
+                    t.divisor = 1000000000;
+                    return t;
+                }
+            }
+            return std::nullopt;
+        }
+
+        DataType data_type(ImportType::Kind kind)
+        {
+            switch (kind)
+            {
+            case ImportType::INT:
+            case ImportType::UINT:
+                return DataType::INTEGER;
+            case ImportType::FLOAT32:
+            case ImportType::FLOAT64:
+                return DataType::FLOAT;
+            case ImportType::BOOL:
+                return DataType::BOOLEAN;
+            case ImportType::TIMESTAMP:
+            case ImportType::DATE32:
+            case ImportType::DATE64:
+                return DataType::TIMESTAMP;
+            case ImportType::NULLS:
+            case ImportType::UTF8:
+            case ImportType::LARGE_UTF8:
+                break;
+            }
+            return DataType::VARCHAR;
+        }
+
+        struct ImportColumn
+        {
+            std::string name;
+            ImportType values;
+            bool dictionary = false;
+            ImportType indices; // when dictionary-encoded
+        };
+
+        template <typename T>
+        T load(const void *buf, int64_t index)
+        {
+            T v;
+            std::memcpy(&v, static_cast<const uint8_t *>(buf) + index * static_cast<int64_t>(sizeof(T)), sizeof(T));
+            return v;
+        }
+
+        bool bit(const void *buf, int64_t index)
+        {
+            return (static_cast<const uint8_t *>(buf)[index / 8] >> (index % 8)) & 1;
+        }
+
+        int64_t floor_div(int64_t a, int64_t b)
+        {
+            int64_t q = a / b;
+            return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+        }
+
+        /**
+         * Read an integer of any width (dictionary indices and INT / UINT columns)
+         */
+        bool read_integer(const ImportType &type, const void *buf, int64_t index, int64_t &out)
+        {
+            bool is_signed = type.kind == ImportType::INT;
+            switch (type.width)
+            {
+            case 1:
+                out = is_signed ? load<int8_t>(buf, index) : load<uint8_t>(buf, index);
+                return true;
+            case 2:
+                out = is_signed ? load<int16_t>(buf, index) : load<uint16_t>(buf, index);
+                return true;
+            case 4:
+                out = is_signed ? int64_t{load<int32_t>(buf, index)} : int64_t{load<uint32_t>(buf, index)};
+                return true;
+            case 8:
+                if (is_signed)
+                {
+                    out = load<int64_t>(buf, index);
+                    return true;
+                }
+                uint64_t u = load<uint64_t>(buf, index);
+                out = static_cast<int64_t>(u);
+                return u <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+            }
+            return false;
+        }
+
+        /**
+         * One value of a (non-dictionary) array at a logical index
+         *
+         * @returns "" on success or an error message
+         */
+        std::string read_value(const ImportType &type, const ArrowArray &array, int64_t i, Value &out)
+        {
+            int64_t index = array.offset + i;
+            if (type.kind == ImportType::NULLS ||
+                (array.null_count != 0 && array.buffers[0] != nullptr && !bit(array.buffers[0], index)))
+            {
+                out = Value{};
+                return "";
+            }
+            const void *data = array.buffers[1];
+            switch (type.kind)
+            {
+            case ImportType::INT:
+            case ImportType::UINT:
+            {
+                int64_t v;
+                if (!read_integer(type, data, index, v))
+                    return "Unsigned value out of the INTEGER range";
+                out = v;
+                return "";
+            }
+            case ImportType::FLOAT32:
+                out = static_cast<double>(load<float>(data, index));
+                return "";
+            case ImportType::FLOAT64:
+                out = load<double>(data, index);
+                return "";
+            case ImportType::BOOL:
+                out = bit(data, index);
+                return "";
+            case ImportType::UTF8:
+            {
+                int32_t begin = load<int32_t>(data, index), end = load<int32_t>(data, index + 1);
+                out = std::string(static_cast<const char *>(array.buffers[2]) + begin, static_cast<size_t>(end - begin));
+                return "";
+            }
+            case ImportType::LARGE_UTF8:
+            {
+                int64_t begin = load<int64_t>(data, index), end = load<int64_t>(data, index + 1);
+                out = std::string(static_cast<const char *>(array.buffers[2]) + begin, static_cast<size_t>(end - begin));
+                return "";
+            }
+            case ImportType::TIMESTAMP:
+                out = floor_div(load<int64_t>(data, index), type.divisor);
+                return "";
+            case ImportType::DATE32:
+                out = int64_t{load<int32_t>(data, index)} * 86400;
+                return "";
+            case ImportType::DATE64:
+                out = floor_div(load<int64_t>(data, index), 1000);
+                return "";
+            case ImportType::NULLS:
+                break;
+            }
+            out = Value{};
+            return "";
+        }
+
+        /**
+         * Release Arrow structs on scope exit, whatever path is taken
+         */
+        template <typename T>
+        struct Released
+        {
+            T value{};
+            ~Released()
+            {
+                if (value.release != nullptr)
+                    value.release(&value);
+            }
+        };
+
+        std::string stream_error(ArrowArrayStream *stream, int code)
+        {
+            const char *message = stream->get_last_error(stream);
+            return "Arrow stream error: " + std::string(message ? message : std::strerror(code));
+        }
+    }
+
+    void export_arrow_stream(std::shared_ptr<const ColumnarResult> result, ArrowArrayStream *out)
+    {
+        out->get_schema = stream_get_schema;
+        out->get_next = stream_get_next;
+        out->get_last_error = stream_get_last_error;
+        out->release = stream_release;
+        out->private_data = new StreamPrivate{std::move(result), 0};
+    }
+
+    std::string import_arrow_stream(ArrowArrayStream *stream, Schema &schema, std::vector<Row> &rows)
+    {
+        REPONO_TRACE_SPAN("import_arrow_stream");
+        struct StreamGuard
+        {
+            ArrowArrayStream *stream;
+            ~StreamGuard()
+            {
+                if (stream->release != nullptr)
+                    stream->release(stream);
+            }
+        } guard{stream};
+
+        Released<ArrowSchema> top;
+        if (int code = stream->get_schema(stream, &top.value))
+            return stream_error(stream, code);
+        if (std::strcmp(top.value.format, "+s") != 0)
+            return "Expected a stream of struct arrays (record batches), got format '" + std::string(top.value.format) + "'";
+
+        std::vector<ImportColumn> columns;
+        for (int64_t c = 0; c < top.value.n_children; c++)
+        {
+            const ArrowSchema &child = *top.value.children[c];
+            ImportColumn col;
+            col.name = child.name != nullptr && child.name[0] != '\0' ? child.name : "column" + std::to_string(c);
+            auto type = parse_format(child.dictionary != nullptr ? child.dictionary->format : child.format);
+            if (!type.has_value())
+                return "Unsupported Arrow type '" + std::string(child.dictionary ? child.dictionary->format : child.format) +
+                       "' in column '" + col.name + "'";
+            col.values = *type;
+            if (child.dictionary != nullptr)
+            {
+                auto indices = parse_format(child.format);
+                if (!indices.has_value() || (indices->kind != ImportType::INT && indices->kind != ImportType::UINT))
+                    return "Unsupported dictionary index type '" + std::string(child.format) + "' in column '" + col.name + "'";
+                col.dictionary = true;
+                col.indices = *indices;
+            }
+            if (schema.has_column(col.name))
+                return "Duplicate column '" + col.name + "'";
+            schema.add_column(ColumnDef(col.name, data_type(col.values.kind), false, (child.flags & ARROW_FLAG_NULLABLE) != 0));
+            columns.push_back(std::move(col));
+        }
+
+        while (true)
+        {
+            Released<ArrowArray> batch;
+            if (int code = stream->get_next(stream, &batch.value))
+                return stream_error(stream, code);
+            if (batch.value.release == nullptr)
+                break;
+            const ArrowArray &array = batch.value;
+            if (array.n_children != static_cast<int64_t>(columns.size()))
+                return "Record batch has " + std::to_string(array.n_children) + " columns, expected " + std::to_string(columns.size());
+
+            size_t first = rows.size();
+            rows.resize(first + static_cast<size_t>(array.length), Row(columns.size()));
+            for (size_t c = 0; c < columns.size(); c++)
+            {
+                const ImportColumn &col = columns[c];
+                const ArrowArray &child = *array.children[c];
+                for (int64_t i = 0; i < array.length; i++)
+                {
+                    int64_t index = array.offset + i;
+                    Value &out = rows[first + static_cast<size_t>(i)][c];
+                    if (array.null_count != 0 && array.buffers[0] != nullptr && !bit(array.buffers[0], index))
+                        continue; // the whole row is null
+                    std::string error;
+                    if (!col.dictionary)
+                    {
+                        error = read_value(col.values, child, index, out);
+                    }
+                    else if (child.null_count == 0 || child.buffers[0] == nullptr || bit(child.buffers[0], child.offset + index))
+                    {
+                        int64_t key;
+                        if (!read_integer(col.indices, child.buffers[1], child.offset + index, key) || key < 0 ||
+                            key >= child.dictionary->length)
+                            error = "Dictionary index out of range";
+                        else
+                            error = read_value(col.values, *child.dictionary, key, out);
+                    }
+                    if (!error.empty())
+                        return error + " in column '" + col.name + "'";
+                }
+            }
+        }
+        return "";
+    }
+};
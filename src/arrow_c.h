@@ -0,0 +1,46 @@
+/**
+ *  ReponoDB: Arrow C Data Interface export and import
+ */
+
+#ifndef REPONO_ARROW_C_H
+#define REPONO_ARROW_C_H
+
+#include "repono/arrow_abi.h"
+#include "columnar.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * ARROW C DATA INTERFACE
+     *
+     * Export hands a ColumnarResult to a consumer as a stream of struct
+     * arrays, one per batch with a child per column. The arrays point
+     * straight into the result's buffers, which stay alive until the
+     * consumer has released every array and the stream, so nothing is
+     * copied after the transposition from rows.
+     *
+     * Import reads any stream of struct arrays whose columns map onto a
+     * DataType: signed and unsigned integers up to 64 bits, float and
+     * double, utf8 and large utf8 (plain or dictionary-encoded), bool,
+     * timestamps of any unit (converted to seconds) and dates.
+     */
+
+    /**
+     * Export as a stream of record batches
+     */
+    void export_arrow_stream(std::shared_ptr<const ColumnarResult> result, ArrowArrayStream *out);
+
+    /**
+     * Read a whole stream into rows; the stream is released either way
+     *
+     * @param schema Set to the columns the stream's schema maps to
+     * @returns "" on success or an error message
+     */
+    std::string import_arrow_stream(ArrowArrayStream *stream, Schema &schema, std::vector<Row> &rows);
+};
+
+#endif // REPONO_ARROW_C_H
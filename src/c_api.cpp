@@ -0,0 +1,285 @@
+/**
+ *  ReponoDB: C API
+ */
+
+#include "repono/repono_c.h"
+#include "repono/repono.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+struct repono_database
+{
+    std::unique_ptr<repono::Database> db;
+};
+
+struct repono_connection
+{
+    std::unique_ptr<repono::Connection> conn;
+};
+
+struct repono_statement
+{
+    repono_connection *conn;
+    std::unique_ptr<repono::PreparedStatement> stmt;
+};
+
+struct repono_result
+{
+    repono::Result result;
+};
+
+namespace
+{
+    /**
+     * Hand an error to C as a malloc'd string
+     */
+    void set_error(char **error, const std::string &message)
+    {
+        if (error == nullptr)
+            return;
+        *error = static_cast<char *>(std::malloc(message.size() + 1));
+        if (*error != nullptr)
+            std::memcpy(*error, message.c_str(), message.size() + 1);
+    }
+
+    repono_result *wrap(repono::Result result)
+    {
+        return new (std::nothrow) repono_result{std::move(result)};
+    }
+
+    repono_value to_c_value(const repono::Value &v)
+    {
+        repono_value out;
+        std::memset(&out, 0, sizeof(out));
+        if (const int64_t *i = std::get_if<int64_t>(&v))
+        {
+            out.type = REPONO_INTEGER;
+            out.as.integer = *i;
+        }
+        else if (const double *d = std::get_if<double>(&v))
+        {
+            out.type = REPONO_FLOAT;
+            out.as.real = *d;
+        }
+        else if (const std::string *s = std::get_if<std::string>(&v))
+        {
+            out.type = REPONO_STRING;
+            out.as.string.data = s->data();
+            out.as.string.length = s->size();
+        }
+        else if (const bool *b = std::get_if<bool>(&v))
+        {
+            out.type = REPONO_BOOLEAN;
+            out.as.boolean = *b ? 1 : 0;
+        }
+        else
+        {
+            out.type = REPONO_NULL;
+        }
+        return out;
+    }
+
+    const repono::RowBatch *find_batch(const repono_result *result, size_t batch)
+    {
+        if (result == nullptr || batch >= result->result.batches().size())
+            return nullptr;
+        return &result->result.batches()[batch];
+    }
+}
+
+extern "C"
+{
+    repono_database *repono_open(const char *dir, char **error)
+    {
+        std::string message;
+        auto db = repono::Database::open(dir ? dir : "", message);
+        if (!db)
+        {
+            set_error(error, message);
+            return nullptr;
+        }
+        return new (std::nothrow) repono_database{std::move(db)};
+    }
+
+    void repono_close(repono_database *db)
+    {
+        delete db;
+    }
+
+    repono_connection *repono_connect(repono_database *db, int read_only)
+    {
+        if (db == nullptr)
+            return nullptr;
+        return new (std::nothrow) repono_connection{db->db->connect(read_only != 0)};
+    }
+
+    void repono_disconnect(repono_connection *conn)
+    {
+        delete conn;
+    }
+
+    repono_result *repono_execute(repono_connection *conn, const char *sql)
+    {
+        return wrap(conn->conn->execute(sql ? sql : ""));
+    }
+
+    repono_result *repono_commit(repono_connection *conn, const char *message)
+    {
+        return wrap(conn->conn->commit(message ? message : ""));
+    }
+
+    repono_result *repono_checkout(repono_connection *conn, const char *branch, int create)
+    {
+        return wrap(conn->conn->checkout(branch ? branch : "", create != 0));
+    }
+
+    repono_result *repono_sparse_checkout(repono_connection *conn, const char *branch, const char *const *tables,
+                                          size_t count)
+    {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < count; i++)
+            names.push_back(tables[i] ? tables[i] : "");
+        return wrap(conn->conn->sparse_checkout(branch ? branch : "", names));
+    }
+
+    repono_result *repono_diff(repono_connection *conn, const char *table, const char *from, const char *to)
+    {
+        return wrap(conn->conn->diff(table ? table : "", from ? from : "", to ? to : ""));
+    }
+
+    repono_result *repono_scan(repono_connection *conn, const char *table, const char *revision)
+    {
+        return wrap(conn->conn->scan(table ? table : "", revision ? revision : ""));
+    }
+
+    repono_statement *repono_prepare(repono_connection *conn, const char *sql, char **error)
+    {
+        std::string message;
+        auto stmt = conn->conn->prepare(sql ? sql : "", message);
+        if (!stmt)
+        {
+            set_error(error, message);
+            return nullptr;
+        }
+        return new (std::nothrow) repono_statement{conn, std::move(stmt)};
+    }
+
+    repono_result *repono_statement_execute(repono_statement *stmt)
+    {
+        return wrap(stmt->conn->conn->execute(*stmt->stmt));
+    }
+
+    void repono_statement_free(repono_statement *stmt)
+    {
+        delete stmt;
+    }
+
+    const char *repono_result_error(const repono_result *result)
+    {
+        return result->result.ok() ? nullptr : result->result.error().c_str();
+    }
+
+    const char *repono_result_message(const repono_result *result)
+    {
+        return result->result.message().c_str();
+    }
+
+    size_t repono_result_rows_affected(const repono_result *result)
+    {
+        return result->result.rows_affected();
+    }
+
+    size_t repono_result_column_count(const repono_result *result)
+    {
+        return result->result.columns().size();
+    }
+
+    const char *repono_result_column_name(const repono_result *result, size_t column)
+    {
+        const auto &columns = result->result.columns();
+        return column < columns.size() ? columns[column].c_str() : nullptr;
+    }
+
+    size_t repono_result_row_count(const repono_result *result)
+    {
+        return result->result.num_rows();
+    }
+
+    size_t repono_result_batch_count(const repono_result *result)
+    {
+        return result->result.batches().size();
+    }
+
+    size_t repono_batch_row_count(const repono_result *result, size_t batch)
+    {
+        const repono::RowBatch *b = find_batch(result, batch);
+        return b ? b->num_rows() : 0;
+    }
+
+    repono_value repono_batch_value(const repono_result *result, size_t batch, size_t row, size_t column)
+    {
+        const repono::RowBatch *b = find_batch(result, batch);
+        if (b == nullptr || row >= b->num_rows() || column >= b->num_columns())
+            return to_c_value(repono::Value{});
+        return to_c_value(b->value(row, column));
+    }
+
+    size_t repono_batch_column(const repono_result *result, size_t batch, size_t column, repono_value *out, size_t capacity)
+    {
+        const repono::RowBatch *b = find_batch(result, batch);
+        if (b == nullptr || column >= b->num_columns())
+            return 0;
+        repono::ColumnView values = b->column(column);
+        size_t n = std::min(capacity, values.size());
+        for (size_t i = 0; i < n; i++)
+            out[i] = to_c_value(values[i]);
+        return n;
+    }
+
+    char *repono_result_to_arrow(const repono_result *result, size_t *length)
+    {
+        std::string stream = result->result.to_arrow();
+        char *out = static_cast<char *>(std::malloc(stream.size()));
+        if (out == nullptr)
+            return nullptr;
+        std::memcpy(out, stream.data(), stream.size());
+        *length = stream.size();
+        return out;
+    }
+
+    void repono_result_export(const repono_result *result, struct ArrowArrayStream *out)
+    {
+        result->result.export_arrow(out);
+    }
+
+    int repono_export_table(repono_connection *conn, const char *table, const char *revision,
+                            struct ArrowArrayStream *out, char **error)
+    {
+        std::string message = conn->conn->export_table(table ? table : "", revision ? revision : "", out);
+        if (!message.empty())
+        {
+            set_error(error, message);
+            return -1;
+        }
+        return 0;
+    }
+
+    repono_result *repono_import(repono_connection *conn, const char *table, struct ArrowArrayStream *stream,
+                                 const char *message)
+    {
+        return wrap(conn->conn->import_arrow(table ? table : "", stream, message ? message : ""));
+    }
+
+    void repono_result_free(repono_result *result)
+    {
+        delete result;
+    }
+
+    void repono_free(void *ptr)
+    {
+        std::free(ptr);
+    }
+}
@@ -0,0 +1,649 @@
+/**
+ *  ReponoDB: Columnar results and Arrow IPC serialization
+ */
+
+#include "columnar.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+namespace repono
+{
+    namespace
+    {
+        template <typename T>
+        void append_raw(std::string &buf, T v)
+        {
+            char bytes[sizeof(T)];
+            std::memcpy(bytes, &v, sizeof(T));
+            buf.append(bytes, sizeof(T));
+        }
+
+        void set_bit(std::string &bitmap, size_t i)
+        {
+            bitmap[i / 8] = static_cast<char>(static_cast<uint8_t>(bitmap[i / 8]) | (1u << (i % 8)));
+        }
+
+        /**
+         * The narrowest type that holds every value of a column
+         */
+        ColumnType infer_type(const std::vector<const Row *> &rows, size_t column)
+        {
+            bool ints = false, doubles = false, strings = false, bools = false;
+            for (const Row *row : rows)
+            {
+                if (column >= row->size())
+                    continue;
+                switch ((*row)[column].index())
+                {
+                case 1:
+                    ints = true;
+                    break;
+                case 2:
+                    doubles = true;
+                    break;
+                case 3:
+                    strings = true;
+                    break;
+                case 4:
+                    bools = true;
+                    break;
+                }
+            }
+            int kinds = (ints || doubles) + strings + bools;
+            if (kinds == 0)
+                return ColumnType::NULLS;
+            if (kinds > 1)
+                return ColumnType::UTF8;
+            if (bools)
+                return ColumnType::BOOLEAN;
+            if (strings)
+                return ColumnType::UTF8;
+            return doubles ? ColumnType::FLOAT64 : ColumnType::INT64;
+        }
+
+        const Value &cell(const Row &row, size_t column)
+        {
+            static const Value null_value;
+            return column < row.size() ? row[column] : null_value;
+        }
+
+        /**
+         * Whether a value can be stored in a column of the given type;
+         * values that cannot (only possible with declared types) are
+         * stored as NULL
+         */
+        bool fits(const Value &v, ColumnType type)
+        {
+            switch (type)
+            {
+            case ColumnType::INT64:
+            case ColumnType::TIMESTAMP:
+                return std::holds_alternative<int64_t>(v);
+            case ColumnType::FLOAT64:
+                return std::holds_alternative<double>(v) || std::holds_alternative<int64_t>(v);
+            case ColumnType::BOOLEAN:
+                return std::holds_alternative<bool>(v);
+            case ColumnType::UTF8:
+                return !is_null(v);
+            case ColumnType::DICTIONARY:
+                return std::holds_alternative<std::string>(v);
+            case ColumnType::NULLS:
+                break;
+            }
+            return false;
+        }
+
+        /**
+         * Fill one column of a batch. Dictionary indices come from dict_index.
+         */
+        ColumnBuffers build_column(const std::vector<const Row *> &rows, size_t begin, size_t end, size_t column, ColumnType type,
+                                   const std::unordered_map<std::string_view, int32_t> &dict_index)
+        {
+            ColumnBuffers col;
+            col.length = end - begin;
+            std::string validity((col.length + 7) / 8, '\0');
+
+            switch (type)
+            {
+            case ColumnType::INT64:
+            case ColumnType::FLOAT64:
+            case ColumnType::TIMESTAMP:
+                col.data.assign(col.length * 8, '\0');
+                break;
+            case ColumnType::BOOLEAN:
+                col.data.assign((col.length + 7) / 8, '\0');
+                break;
+            case ColumnType::UTF8:
+                col.offsets.reserve((col.length + 1) * 4);
+                append_raw<int32_t>(col.offsets, 0);
+                break;
+            case ColumnType::DICTIONARY:
+                col.data.assign(col.length * 4, '\0');
+                break;
+            case ColumnType::NULLS:
+                break;
+            }
+            char *out = col.data.data(); // fixed width values are stored in place
+
+            for (size_t i = 0; i < col.length; i++)
+            {
+                const Value &v = cell(*rows[begin + i], column);
+                if (!fits(v, type))
+                {
+                    col.null_count++;
+                    if (type == ColumnType::UTF8)
+                        append_raw<int32_t>(col.offsets, static_cast<int32_t>(col.data.size()));
+                    continue;
+                }
+                set_bit(validity, i);
+
+                switch (type)
+                {
+                case ColumnType::INT64:
+                case ColumnType::TIMESTAMP:
+                    std::memcpy(out + i * 8, &std::get<int64_t>(v), 8);
+                    break;
+                case ColumnType::FLOAT64:
+                {
+                    double d = 0;
+                    if (const double *p = std::get_if<double>(&v))
+                        d = *p;
+                    else if (const int64_t *p = std::get_if<int64_t>(&v))
+                        d = static_cast<double>(*p);
+                    std::memcpy(out + i * 8, &d, 8);
+                    break;
+                }
+                case ColumnType::BOOLEAN:
+                    if (std::get<bool>(v))
+                        set_bit(col.data, i);
+                    break;
+                case ColumnType::UTF8:
+                    if (const std::string *s = std::get_if<std::string>(&v))
+                        col.data += *s;
+                    else
+                        col.data += value_to_string(v);
+                    append_raw<int32_t>(col.offsets, static_cast<int32_t>(col.data.size()));
+                    break;
+                case ColumnType::DICTIONARY:
+                    std::memcpy(out + i * 4, &dict_index.at(std::get<std::string>(v)), 4);
+                    break;
+                case ColumnType::NULLS:
+                    break;
+                }
+            }
+            if (type == ColumnType::NULLS)
+                col.null_count = col.length;
+            else if (col.null_count > 0)
+                col.validity = std::move(validity);
+            return col;
+        }
+
+        /**
+         * FLATBUFFERS
+         *
+         * Arrow IPC metadata is a FlatBuffers Message. The handful of tables
+         * it needs are built as a small tree and laid out front to back:
+         * each table's vtable is written just before it, and everything a
+         * table points to is placed after it, since offsets only point forward.
+         */
+        struct FbObject;
+        using FbPtr = std::shared_ptr<FbObject>;
+
+        struct FbField
+        {
+            uint16_t id;
+            std::string scalar; // little-endian bytes; empty for an offset field
+            FbPtr object;
+        };
+
+        struct FbObject
+        {
+            enum Kind
+            {
+                TABLE,
+                STRING,
+                TABLE_VECTOR,
+                STRUCT_VECTOR // 8-byte aligned structs
+            };
+
+            Kind kind = TABLE;
+            std::vector<FbField> fields;
+            std::vector<FbPtr> items;
+            std::string bytes;
+            size_t count = 0;
+
+            template <typename T>
+            FbObject &add(uint16_t id, T v)
+            {
+                FbField f{id, {}, nullptr};
+                append_raw<T>(f.scalar, v);
+                fields.push_back(std::move(f));
+                return *this;
+            }
+
+            FbObject &add(uint16_t id, FbPtr object)
+            {
+                fields.push_back(FbField{id, {}, std::move(object)});
+                return *this;
+            }
+        };
+
+        FbPtr fb_table()
+        {
+            return std::make_shared<FbObject>();
+        }
+
+        FbPtr fb_string(const std::string &s)
+        {
+            auto o = std::make_shared<FbObject>();
+            o->kind = FbObject::STRING;
+            o->bytes = s;
+            return o;
+        }
+
+        FbPtr fb_tables(std::vector<FbPtr> items)
+        {
+            auto o = std::make_shared<FbObject>();
+            o->kind = FbObject::TABLE_VECTOR;
+            o->items = std::move(items);
+            return o;
+        }
+
+        FbPtr fb_structs(std::string bytes, size_t count)
+        {
+            auto o = std::make_shared<FbObject>();
+            o->kind = FbObject::STRUCT_VECTOR;
+            o->bytes = std::move(bytes);
+            o->count = count;
+            return o;
+        }
+
+        class FbWriter
+        {
+        public:
+            std::string finish(const FbObject &root)
+            {
+                out_.assign(4, '\0');
+                size_t pos = place(root);
+                patch(0, pos);
+                pad(8);
+                return std::move(out_);
+            }
+
+        private:
+            std::string out_;
+
+            void pad(size_t align)
+            {
+                while (out_.size() % align != 0)
+                    out_ += '\0';
+            }
+
+            void patch(size_t at, size_t target)
+            {
+                uint32_t offset = static_cast<uint32_t>(target - at);
+                std::memcpy(&out_[at], &offset, 4);
+            }
+
+            size_t place(const FbObject &o)
+            {
+                switch (o.kind)
+                {
+                case FbObject::STRING:
+                {
+                    pad(4);
+                    size_t pos = out_.size();
+                    append_raw<uint32_t>(out_, static_cast<uint32_t>(o.bytes.size()));
+                    out_ += o.bytes;
+                    out_ += '\0';
+                    return pos;
+                }
+                case FbObject::STRUCT_VECTOR:
+                {
+                    while ((out_.size() + 4) % 8 != 0)
+                        out_ += '\0';
+                    size_t pos = out_.size();
+                    append_raw<uint32_t>(out_, static_cast<uint32_t>(o.count));
+                    out_ += o.bytes;
+                    return pos;
+                }
+                case FbObject::TABLE_VECTOR:
+                {
+                    pad(4);
+                    size_t pos = out_.size();
+                    append_raw<uint32_t>(out_, static_cast<uint32_t>(o.items.size()));
+                    size_t slots = out_.size();
+                    out_.append(4 * o.items.size(), '\0');
+                    for (size_t i = 0; i < o.items.size(); i++)
+                        patch(slots + 4 * i, place(*o.items[i]));
+                    return pos;
+                }
+                case FbObject::TABLE:
+                    break;
+                }
+
+                // Lay the fields out largest first, each aligned to its size
+                std::vector<size_t> order(o.fields.size());
+                for (size_t i = 0; i < order.size(); i++)
+                    order[i] = i;
+                auto width = [&](size_t i)
+                { return o.fields[i].object ? size_t{4} : o.fields[i].scalar.size(); };
+                std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                                 { return width(a) > width(b); });
+
+                std::vector<uint16_t> field_offset(o.fields.size());
+                size_t size = 4; // the vtable soffset
+                size_t align = 4;
+                uint16_t slots = 0;
+                for (size_t i : order)
+                {
+                    size_t w = width(i);
+                    size = (size + w - 1) / w * w;
+                    field_offset[i] = static_cast<uint16_t>(size);
+                    size += w;
+                    align = std::max(align, w);
+                    slots = std::max<uint16_t>(slots, o.fields[i].id + 1);
+                }
+
+                pad(2);
+                size_t vtable = out_.size();
+                std::vector<uint16_t> entries(slots, 0);
+                for (size_t i = 0; i < o.fields.size(); i++)
+                    entries[o.fields[i].id] = field_offset[i];
+                append_raw<uint16_t>(out_, static_cast<uint16_t>(4 + 2 * slots));
+                append_raw<uint16_t>(out_, static_cast<uint16_t>(size));
+                for (uint16_t e : entries)
+                    append_raw<uint16_t>(out_, e);
+
+                pad(align);
+                size_t table = out_.size();
+                out_.append(size, '\0');
+                int32_t soffset = static_cast<int32_t>(table - vtable);
+                std::memcpy(&out_[table], &soffset, 4);
+                for (size_t i = 0; i < o.fields.size(); i++)
+                {
+                    if (!o.fields[i].object)
+                        std::memcpy(&out_[table + field_offset[i]], o.fields[i].scalar.data(), o.fields[i].scalar.size());
+                }
+                for (size_t i = 0; i < o.fields.size(); i++)
+                {
+                    if (o.fields[i].object)
+                        patch(table + field_offset[i], place(*o.fields[i].object));
+                }
+                return table;
+            }
+        };
+
+        // Arrow schema enums (format/Schema.fbs, format/Message.fbs)
+        constexpr int16_t kMetadataV5 = 4;
+        constexpr uint8_t kHeaderSchema = 1;
+        constexpr uint8_t kHeaderDictionaryBatch = 2;
+        constexpr uint8_t kHeaderRecordBatch = 3;
+        constexpr uint8_t kTypeNull = 1;
+        constexpr uint8_t kTypeInt = 2;
+        constexpr uint8_t kTypeFloatingPoint = 3;
+        constexpr uint8_t kTypeUtf8 = 5;
+        constexpr uint8_t kTypeBool = 6;
+        constexpr uint8_t kTypeTimestamp = 10;
+        constexpr int16_t kPrecisionDouble = 2;
+
+        FbPtr int_type(int32_t bits)
+        {
+            FbPtr t = fb_table();
+            t->add<int32_t>(0, bits).add<uint8_t>(1, 1);
+            return t;
+        }
+
+        FbPtr arrow_field(const std::string &name, ColumnType type, int64_t dictionary_id)
+        {
+            FbPtr field = fb_table();
+            field->add(0, fb_string(name)).add<uint8_t>(1, 1);
+            switch (type)
+            {
+            case ColumnType::NULLS:
+                field->add<uint8_t>(2, kTypeNull).add(3, fb_table());
+                break;
+            case ColumnType::INT64:
+                field->add<uint8_t>(2, kTypeInt).add(3, int_type(64));
+                break;
+            case ColumnType::FLOAT64:
+            {
+                FbPtr fp = fb_table();
+                fp->add<int16_t>(0, kPrecisionDouble);
+                field->add<uint8_t>(2, kTypeFloatingPoint).add(3, fp);
+                break;
+            }
+            case ColumnType::BOOLEAN:
+                field->add<uint8_t>(2, kTypeBool).add(3, fb_table());
+                break;
+            case ColumnType::TIMESTAMP:
+            {
+                FbPtr ts = fb_table();
+                ts->add<int16_t>(0, 0); // TimeUnit::SECOND, no time zone
+                field->add<uint8_t>(2, kTypeTimestamp).add(3, ts);
+                break;
+            }
+            case ColumnType::UTF8:
+            case ColumnType::DICTIONARY:
+                field->add<uint8_t>(2, kTypeUtf8).add(3, fb_table());
+                break;
+            }
+            if (type == ColumnType::DICTIONARY)
+            {
+                FbPtr encoding = fb_table();
+                encoding->add<int64_t>(0, dictionary_id).add(1, int_type(32)).add<uint8_t>(2, 0);
+                field->add(4, encoding);
+            }
+            field->add(5, fb_tables({}));
+            return field;
+        }
+
+        FbPtr message(uint8_t header_type, FbPtr header, size_t body_length)
+        {
+            FbPtr m = fb_table();
+            m->add<int16_t>(0, kMetadataV5).add<uint8_t>(1, header_type).add(2, std::move(header)).add<int64_t>(3, static_cast<int64_t>(body_length));
+            return m;
+        }
+
+        /**
+         * Encapsulated message: continuation marker, metadata length,
+         * metadata and body, each padded to 8 bytes
+         */
+        void write_message(std::string &out, const FbPtr &msg, const std::string &body)
+        {
+            std::string metadata = FbWriter().finish(*msg);
+            append_raw<uint32_t>(out, 0xFFFFFFFFu);
+            append_raw<int32_t>(out, static_cast<int32_t>(metadata.size()));
+            out += metadata;
+            out += body;
+        }
+
+        /**
+         * Append the buffers of some columns to a message body and describe
+         * them as a RecordBatch table
+         */
+        FbPtr record_batch(size_t length, const std::vector<std::pair<const ColumnBuffers *, ColumnType>> &columns, std::string &body)
+        {
+            std::string nodes, buffers;
+            size_t num_buffers = 0;
+            auto add_buffer = [&](const std::string &bytes)
+            {
+                append_raw<int64_t>(buffers, static_cast<int64_t>(body.size()));
+                append_raw<int64_t>(buffers, static_cast<int64_t>(bytes.size()));
+                body += bytes;
+                body.append((8 - body.size() % 8) % 8, '\0');
+                num_buffers++;
+            };
+            for (const auto &[col, type] : columns)
+            {
+                append_raw<int64_t>(nodes, static_cast<int64_t>(col->length));
+                append_raw<int64_t>(nodes, static_cast<int64_t>(col->null_count));
+                if (type == ColumnType::NULLS)
+                    continue;
+                add_buffer(col->validity);
+                if (type == ColumnType::UTF8)
+                    add_buffer(col->offsets);
+                add_buffer(col->data);
+            }
+            FbPtr batch = fb_table();
+            batch->add<int64_t>(0, static_cast<int64_t>(length))
+                .add(1, fb_structs(std::move(nodes), columns.size()))
+                .add(2, fb_structs(std::move(buffers), num_buffers));
+            return batch;
+        }
+    }
+
+    ColumnarResult to_columnar(const std::vector<std::string> &names, const std::vector<RowRange> &ranges,
+                               const ColumnarOptions &options)
+    {
+        REPONO_TRACE_SPAN("to_columnar");
+        ColumnarResult result;
+        result.names = names;
+        size_t width = names.size();
+
+        std::vector<const Row *> rows;
+        for (const auto &range : ranges)
+        {
+            for (size_t i = 0; i < range.count; i++)
+                rows.push_back(&range.rows[i]);
+        }
+
+        std::vector<std::unordered_map<std::string_view, int32_t>> dict_index(width);
+        result.types.resize(width);
+        result.dictionaries.resize(width);
+        for (size_t c = 0; c < width; c++)
+        {
+            result.types[c] = c < options.types.size() ? options.types[c] : infer_type(rows, c);
+            if (result.types[c] != ColumnType::UTF8 || !options.dictionary)
+                continue;
+
+            // Only worth it when values repeat: every string would
+            // otherwise be stored once anyway, plus an index
+            bool all_strings = true;
+            size_t non_null = 0;
+            auto &index = dict_index[c];
+            for (const Row *row : rows)
+            {
+                const Value &v = cell(*row, c);
+                if (const std::string *s = std::get_if<std::string>(&v))
+                {
+                    non_null++;
+                    index.emplace(*s, static_cast<int32_t>(index.size()));
+                    if (index.size() > 1024 && index.size() * 2 > non_null)
+                        break; // mostly distinct so far: give up early
+                }
+                else if (!is_null(v))
+                {
+                    all_strings = false;
+                    break;
+                }
+            }
+            if (!all_strings || index.size() * 2 > non_null)
+            {
+                index.clear();
+                continue;
+            }
+
+            result.types[c] = ColumnType::DICTIONARY;
+            std::vector<std::string_view> values(index.size());
+            for (const auto &[value, i] : index)
+                values[static_cast<size_t>(i)] = value;
+            ColumnBuffers &dict = result.dictionaries[c];
+            dict.length = values.size();
+            append_raw<int32_t>(dict.offsets, 0);
+            for (std::string_view value : values)
+            {
+                dict.data.append(value.data(), value.size());
+                append_raw<int32_t>(dict.offsets, static_cast<int32_t>(dict.data.size()));
+            }
+        }
+
+        size_t batch_rows = std::max<size_t>(1, options.batch_rows);
+        for (size_t begin = 0; begin < rows.size(); begin += batch_rows)
+        {
+            size_t end = std::min(rows.size(), begin + batch_rows);
+            ColumnarBatch batch;
+            batch.num_rows = end - begin;
+            for (size_t c = 0; c < width; c++)
+                batch.columns.push_back(build_column(rows, begin, end, c, result.types[c], dict_index[c]));
+            result.batches.push_back(std::move(batch));
+        }
+        return result;
+    }
+
+    ColumnType column_type(DataType type)
+    {
+        switch (type)
+        {
+        case DataType::INTEGER:
+            return ColumnType::INT64;
+        case DataType::FLOAT:
+            return ColumnType::FLOAT64;
+        case DataType::VARCHAR:
+            return ColumnType::UTF8;
+        case DataType::BOOLEAN:
+            return ColumnType::BOOLEAN;
+        case DataType::TIMESTAMP:
+            return ColumnType::TIMESTAMP;
+        }
+        return ColumnType::UTF8;
+    }
+
+    std::vector<ColumnType> column_types(const Schema &schema)
+    {
+        std::vector<ColumnType> types;
+        for (const auto &col : schema.get_columns())
+            types.push_back(column_type(col.type));
+        return types;
+    }
+
+    ColumnarResult to_columnar(const QueryResult &result, const ColumnarOptions &options)
+    {
+        return to_columnar(result.columns, {RowRange{result.rows.data(), result.rows.size()}}, options);
+    }
+
+    std::string write_arrow_stream(const ColumnarResult &result)
+    {
+        REPONO_TRACE_SPAN("write_arrow_stream");
+        std::string out;
+        size_t width = result.names.size();
+
+        std::vector<FbPtr> fields;
+        for (size_t c = 0; c < width; c++)
+            fields.push_back(arrow_field(result.names[c], result.types[c], static_cast<int64_t>(c)));
+        FbPtr schema = fb_table();
+        schema->add<int16_t>(0, 0).add(1, fb_tables(std::move(fields))); // little-endian
+        write_message(out, message(kHeaderSchema, schema, 0), "");
+
+        for (size_t c = 0; c < width; c++)
+        {
+            if (result.types[c] != ColumnType::DICTIONARY)
+                continue;
+            const ColumnBuffers &dict = result.dictionaries[c];
+            std::string body;
+            FbPtr data = record_batch(dict.length, {{&dict, ColumnType::UTF8}}, body);
+            FbPtr batch = fb_table();
+            batch->add<int64_t>(0, static_cast<int64_t>(c)).add(1, data).add<uint8_t>(2, 0);
+            write_message(out, message(kHeaderDictionaryBatch, batch, body.size()), body);
+        }
+
+        for (const auto &batch : result.batches)
+        {
+            std::vector<std::pair<const ColumnBuffers *, ColumnType>> columns;
+            for (size_t c = 0; c < width; c++)
+                columns.emplace_back(&batch.columns[c], result.types[c]);
+            std::string body;
+            FbPtr rb = record_batch(batch.num_rows, columns, body);
+            write_message(out, message(kHeaderRecordBatch, rb, body.size()), body);
+        }
+
+        append_raw<uint32_t>(out, 0xFFFFFFFFu);
+        append_raw<int32_t>(out, 0);
+        return out;
+    }
+};
@@ -0,0 +1,113 @@
+/**
+ *  ReponoDB: Columnar results and Arrow IPC serialization
+ */
+
+#ifndef REPONO_COLUMNAR_H
+#define REPONO_COLUMNAR_H
+
+#include "executor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * COLUMNAR RESULTS
+     *
+     * Rows are transposed into one buffer per column in the Arrow memory
+     * layout (validity bitmap, fixed width values or int32 offsets plus
+     * UTF-8 bytes), so that a result can be shipped as a few large memory
+     * copies instead of being formatted cell by cell. String columns with
+     * repeated values are dictionary-encoded: each batch stores int32
+     * indices into one dictionary per column.
+     *
+     * Query results carry no column types, so unless the caller declares
+     * them (e.g. from a table's schema) each column's type is inferred
+     * from its values: integers give INT64, integers mixed with floats
+     * FLOAT64, and columns mixing other types are rendered as text.
+     */
+    enum class ColumnType
+    {
+        NULLS, // every value is NULL
+        INT64,
+        FLOAT64,
+        BOOLEAN,
+        UTF8,
+        DICTIONARY, // int32 indices into a UTF8 dictionary
+        TIMESTAMP   // int64 seconds since the epoch
+    };
+
+    /**
+     * The columnar type a table column is stored as
+     */
+    ColumnType column_type(DataType type);
+
+    /**
+     * One column of a batch (or a dictionary), as Arrow buffers in host
+     * (little-endian) byte order
+     */
+    struct ColumnBuffers
+    {
+        size_t length = 0;
+        size_t null_count = 0;
+        std::string validity; // bit per value, 1 = not null; empty when nothing is null
+        std::string offsets;  // UTF8: length + 1 int32 offsets into data
+        std::string data;     // values, a bitmap for BOOLEAN, bytes for UTF8, indices for DICTIONARY
+    };
+
+    struct ColumnarBatch
+    {
+        size_t num_rows = 0;
+        std::vector<ColumnBuffers> columns;
+    };
+
+    struct ColumnarResult
+    {
+        std::vector<std::string> names;
+        std::vector<ColumnType> types;
+        std::vector<ColumnBuffers> dictionaries; // per column, set for DICTIONARY columns
+        std::vector<ColumnarBatch> batches;
+    };
+
+    /**
+     * A run of rows to convert, e.g. a storage chunk or part of a result
+     */
+    struct RowRange
+    {
+        const Row *rows;
+        size_t count;
+    };
+
+    struct ColumnarOptions
+    {
+        size_t batch_rows = 64 * 1024; // rows per output batch
+        bool dictionary = true;        // dictionary-encode strings that repeat
+        std::vector<ColumnType> types; // declared column types; inferred when empty
+    };
+
+    /**
+     * Transpose rows into columnar batches
+     */
+    ColumnarResult to_columnar(const std::vector<std::string> &names, const std::vector<RowRange> &ranges,
+                               const ColumnarOptions &options = {});
+
+    ColumnarResult to_columnar(const QueryResult &result, const ColumnarOptions &options = {});
+
+    /**
+     * Declared types for a table's columns
+     */
+    std::vector<ColumnType> column_types(const Schema &schema);
+
+    /**
+     * Serialize as an Arrow IPC stream: the schema, one dictionary batch
+     * per dictionary-encoded column, the record batches and the
+     * end-of-stream marker. Any Arrow implementation can read it
+     * (pyarrow.ipc.open_stream, arrow::ipc::RecordBatchStreamReader, ...).
+     */
+    std::string write_arrow_stream(const ColumnarResult &result);
+};
+
+#endif // REPONO_COLUMNAR_H
@@ -0,0 +1,892 @@
+/**
+ *  ReponoDB: Expression evaluation, diffs and the SELECT pipeline
+ */
+
+#include "executor.h"
+#include "lsm.h"
+#include "memory.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace repono
+{
+    std::string bind_expr(Expr &e, const Schema &schema)
+    {
+        if (e.kind == Expr::Kind::FUNCTION)
+        {
+            if (!e.aggregate_bound)
+                return "Function '" + e.name + "' is not allowed here";
+            return ""; // arguments were bound by bind_aggregates
+        }
+        if (e.kind == Expr::Kind::COLUMN)
+        {
+            auto idx = schema.get_column_index(e.name);
+            if (!idx.has_value())
+            {
+                return "Unknown column '" + e.name + "'";
+            }
+            e.column_index = *idx;
+        }
+        for (auto &arg : e.args)
+        {
+            std::string error = bind_expr(*arg, schema);
+            if (!error.empty())
+                return error;
+        }
+        return "";
+    }
+
+    int compare_values(const Value &a, const Value &b)
+    {
+        if (value_less_than(a, b))
+            return -1;
+        if (value_less_than(b, a))
+            return 1;
+        return 0;
+    }
+
+    Value evaluate_arithmetic(TokenType op, const Value &a, const Value &b)
+    {
+        if (is_null(a) || is_null(b))
+            return std::monostate{};
+
+        bool a_num = std::holds_alternative<int64_t>(a) || std::holds_alternative<double>(a);
+        bool b_num = std::holds_alternative<int64_t>(b) || std::holds_alternative<double>(b);
+        if (!a_num || !b_num)
+            return std::monostate{};
+
+        if (std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b))
+        {
+            // On overflow fall through to floating point, as SQLite does
+            int64_t x = std::get<int64_t>(a), y = std::get<int64_t>(b), out = 0;
+            switch (op)
+            {
+            case TokenType::PLUS:
+                if (!__builtin_add_overflow(x, y, &out))
+                    return out;
+                break;
+            case TokenType::MINUS:
+                if (!__builtin_sub_overflow(x, y, &out))
+                    return out;
+                break;
+            case TokenType::ASTERISK:
+                if (!__builtin_mul_overflow(x, y, &out))
+                    return out;
+                break;
+            case TokenType::SLASH:
+                if (y == 0)
+                    return std::monostate{}; // division by zero yields NULL
+                if (x != std::numeric_limits<int64_t>::min() || y != -1)
+                    return x / y;
+                break;
+            default:
+                return std::monostate{};
+            }
+        }
+
+        double x = std::holds_alternative<int64_t>(a) ? static_cast<double>(std::get<int64_t>(a)) : std::get<double>(a);
+        double y = std::holds_alternative<int64_t>(b) ? static_cast<double>(std::get<int64_t>(b)) : std::get<double>(b);
+        switch (op)
+        {
+        case TokenType::PLUS:
+            return x + y;
+        case TokenType::MINUS:
+            return x - y;
+        case TokenType::ASTERISK:
+            return x * y;
+        case TokenType::SLASH:
+            if (y == 0.0)
+                return std::monostate{};
+            return x / y;
+        default:
+            return std::monostate{};
+        }
+    }
+
+    Value evaluate(const Expr &e, const Row &row)
+    {
+        switch (e.kind)
+        {
+        case Expr::Kind::LITERAL:
+            return e.literal;
+
+        case Expr::Kind::COLUMN:
+            return e.column_index < row.size() ? row[e.column_index] : Value{};
+
+        case Expr::Kind::UNARY:
+        {
+            Value v = evaluate(*e.args[0], row);
+            if (is_null(v))
+                return v;
+            if (e.op == TokenType::NOT)
+                return std::holds_alternative<bool>(v) ? Value(!std::get<bool>(v)) : Value{};
+            return evaluate_arithmetic(TokenType::MINUS, int64_t{0}, v);
+        }
+
+        case Expr::Kind::BINARY:
+        {
+            if (e.op == TokenType::AND || e.op == TokenType::OR)
+            {
+                Value l = evaluate(*e.args[0], row);
+                bool is_and = e.op == TokenType::AND;
+                // Short circuit: FALSE AND x, TRUE OR x
+                if (std::holds_alternative<bool>(l) && std::get<bool>(l) != is_and)
+                    return l;
+                Value r = evaluate(*e.args[1], row);
+                if (std::holds_alternative<bool>(r) && std::get<bool>(r) != is_and)
+                    return r;
+                if (is_null(l) || is_null(r) || !std::holds_alternative<bool>(l) || !std::holds_alternative<bool>(r))
+                    return std::monostate{};
+                return is_and;
+            }
+
+            Value l = evaluate(*e.args[0], row);
+            Value r = evaluate(*e.args[1], row);
+
+            switch (e.op)
+            {
+            case TokenType::PLUS:
+            case TokenType::MINUS:
+            case TokenType::ASTERISK:
+            case TokenType::SLASH:
+                return evaluate_arithmetic(e.op, l, r);
+            default:
+                break;
+            }
+
+            if (is_null(l) || is_null(r))
+                return std::monostate{};
+            int cmp = compare_values(l, r);
+            switch (e.op)
+            {
+            case TokenType::EQUALS:
+                return cmp == 0;
+            case TokenType::NOT_EQUALS:
+                return cmp != 0;
+            case TokenType::LESS_THAN:
+                return cmp < 0;
+            case TokenType::GREATER_THAN:
+                return cmp > 0;
+            case TokenType::LESS_EQUAL:
+                return cmp <= 0;
+            case TokenType::GREATER_EQUAL:
+                return cmp >= 0;
+            default:
+                return std::monostate{};
+            }
+        }
+
+        case Expr::Kind::BETWEEN:
+        {
+            Value v = evaluate(*e.args[0], row);
+            Value low = evaluate(*e.args[1], row);
+            Value high = evaluate(*e.args[2], row);
+            if (is_null(v) || is_null(low) || is_null(high))
+                return std::monostate{};
+            bool inside = compare_values(v, low) >= 0 && compare_values(v, high) <= 0;
+            return inside != e.negated;
+        }
+
+        case Expr::Kind::IS_NULL:
+            return is_null(evaluate(*e.args[0], row)) != e.negated;
+
+        case Expr::Kind::FUNCTION:
+            // Aggregate results sit after the input columns of a grouped row
+            return e.column_index < row.size() ? row[e.column_index] : Value{};
+        }
+        return std::monostate{};
+    }
+
+    std::string encode_key(const Row &row, const std::vector<size_t> &key_columns)
+    {
+        ByteWriter w;
+        for (size_t idx : key_columns)
+        {
+            w.put_value(row[idx]);
+        }
+        return w.take();
+    }
+
+    std::vector<uint64_t> summarize_keys(const std::vector<Row> &rows, const std::vector<size_t> &key_columns)
+    {
+        std::vector<uint64_t> summary;
+        if (key_columns.empty())
+            return summary;
+        size_t last = *std::max_element(key_columns.begin(), key_columns.end());
+        summary.reserve(rows.size());
+        for (const auto &row : rows)
+        {
+            if (row.size() > last)
+                summary.push_back(fnv1a(encode_key(row, key_columns)));
+        }
+        std::sort(summary.begin(), summary.end());
+        return summary;
+    }
+
+    std::vector<size_t> primary_key_columns(const Schema &schema)
+    {
+        std::vector<size_t> result;
+        const auto &columns = schema.get_columns();
+        for (size_t i = 0; i < columns.size(); i++)
+        {
+            if (columns[i].is_primary_key)
+                result.push_back(i);
+        }
+        return result;
+    }
+
+    bool schemas_equal(const Schema &a, const Schema &b)
+    {
+        ByteWriter wa, wb;
+        wa.put_schema(a);
+        wb.put_schema(b);
+        return wa.data() == wb.data();
+    }
+
+    std::string diff_table_rows(const Repository &repo,
+                                const TableManifest *from,
+                                const TableManifest *to,
+                                const DiffVisitor &visit,
+                                DiffStats *stats,
+                                const KeyRange &range)
+    {
+        REPONO_TRACE_SPAN("diff_table_rows");
+        static const std::vector<std::string> no_chunks;
+        const auto &old_list = from ? from->chunk_hashes : no_chunks;
+        const auto &new_list = to ? to->chunk_hashes : no_chunks;
+
+        std::vector<size_t> key_columns;
+        if (from != nullptr && to != nullptr)
+        {
+            key_columns = primary_key_columns(to->schema);
+            if (key_columns != primary_key_columns(from->schema))
+                key_columns.clear();
+        }
+        else if (to != nullptr || from != nullptr)
+        {
+            key_columns = primary_key_columns(to ? to->schema : from->schema);
+        }
+        KeyRange key_range = key_columns.empty() ? KeyRange{} : range;
+        auto in_range = [&](const Row &row)
+        {
+            return !key_range.bounded() || (row.size() > key_columns[0] && key_range.contains(row[key_columns[0]]));
+        };
+
+        // One key with a stored summary: a changed chunk without it has nothing to diff
+        std::optional<uint64_t> point_hash;
+        if (key_columns.size() == 1 && key_range.low.has_value() && key_range.high.has_value() &&
+            compare_values(*key_range.low, *key_range.high) == 0)
+        {
+            DataType type = (to ? to->schema : from->schema).get_columns()[key_columns[0]].type;
+            if ((type == DataType::INTEGER && std::holds_alternative<int64_t>(*key_range.low)) ||
+                (type == DataType::VARCHAR && std::holds_alternative<std::string>(*key_range.low)))
+                point_hash = fnv1a(encode_key({*key_range.low}, {0}));
+        }
+        auto may_hold_key = [&](const std::string &chunk_hash)
+        {
+            if (!point_hash.has_value())
+                return true;
+            auto summary = repo.get_key_summary(chunk_hash, key_columns);
+            return !summary.has_value() || std::binary_search(summary->begin(), summary->end(), *point_hash);
+        };
+
+        std::unordered_set<std::string> old_set(old_list.begin(), old_list.end());
+        std::unordered_set<std::string> new_set(new_list.begin(), new_list.end());
+
+        // Keep the chunks alive while we hold pointers to their rows
+        std::vector<ChunkPtr> old_chunks, new_chunks;
+        bool lsm = (from != nullptr && from->storage == TableStorage::LSM) || (to != nullptr && to->storage == TableStorage::LSM);
+        if (lsm)
+        {
+            // An LSM table's rows are the merge of its runs: compare every
+            // row, as one chunk per side
+            for (auto [manifest, side] : {std::make_pair(from, &old_chunks), std::make_pair(to, &new_chunks)})
+            {
+                if (manifest == nullptr)
+                    continue;
+                auto rows = std::make_shared<Chunk>();
+                std::string error = manifest->storage == TableStorage::LSM
+                                        ? read_lsm_range(repo, *manifest, key_range, rows->rows)
+                                        : read_table_rows(repo, *manifest, rows->rows);
+                if (!error.empty())
+                    return error;
+                side->push_back(std::move(rows));
+            }
+        }
+        else
+        {
+            for (const auto &h : old_list)
+            {
+                if (new_set.count(h) || !may_hold_key(h))
+                    continue;
+                ChunkPtr chunk = repo.get_chunk(h);
+                if (chunk == nullptr)
+                    return "Missing chunk " + h;
+                old_chunks.push_back(chunk);
+            }
+            for (const auto &h : new_list)
+            {
+                if (old_set.count(h) || !may_hold_key(h))
+                    continue;
+                ChunkPtr chunk = repo.get_chunk(h);
+                if (chunk == nullptr)
+                    return "Missing chunk " + h;
+                new_chunks.push_back(chunk);
+            }
+        }
+        if (stats != nullptr)
+        {
+            stats->chunks_scanned += old_chunks.size() + new_chunks.size();
+            stats->chunks_skipped += lsm ? 0 : new_list.size() - new_chunks.size();
+        }
+
+        auto row_key = [&key_columns](const Row &row)
+        {
+            return key_columns.empty() ? encode_rows({row}) : encode_key(row, key_columns);
+        };
+
+        // Index the old side's changed rows, then match the new side against it
+        std::unordered_map<std::string, std::vector<const Row *>> old_rows;
+        for (const auto &chunk : old_chunks)
+        {
+            for (const auto &row : chunk->rows)
+            {
+                if (!in_range(row))
+                    continue;
+                std::string key = row_key(row);
+                old_rows[key].push_back(&row);
+            }
+        }
+
+        for (const auto &chunk : new_chunks)
+        {
+            for (const auto &row : chunk->rows)
+            {
+                if (!in_range(row))
+                    continue;
+                std::string key = row_key(row);
+                auto it = old_rows.find(key);
+                if (it == old_rows.end() || it->second.empty())
+                {
+                    if (!visit(RowDiff::Type::ADDED, nullptr, &row))
+                        return "";
+                    continue;
+                }
+                const Row *old_row = it->second.back();
+                it->second.pop_back();
+                if (*old_row != row && !visit(RowDiff::Type::MODIFIED, old_row, &row))
+                    return "";
+            }
+        }
+
+        // Whatever is left on the old side was deleted (in old chunk order)
+        for (const auto &chunk : old_chunks)
+        {
+            for (const auto &row : chunk->rows)
+            {
+                if (!in_range(row))
+                    continue;
+                std::string key = row_key(row);
+                auto &remaining = old_rows[key];
+                auto pos = std::find(remaining.begin(), remaining.end(), &row);
+                if (pos == remaining.end())
+                    continue;
+                remaining.erase(pos);
+                if (!visit(RowDiff::Type::DELETED, &row, nullptr))
+                    return "";
+            }
+        }
+        return "";
+    }
+
+    std::optional<CommitDiff> compute_diff(const Repository &repo, const std::string &from_hash, const std::string &to_hash)
+    {
+        REPONO_TRACE_SPAN("compute_diff");
+        const CommitRecord *from = repo.get_record(from_hash);
+        const CommitRecord *to = repo.get_record(to_hash);
+        if (from == nullptr || to == nullptr)
+        {
+            return std::nullopt;
+        }
+
+        CommitDiff diff;
+        diff.from_hash = from_hash;
+        diff.to_hash = to_hash;
+
+        for (const auto &[name, manifest] : from->tables)
+        {
+            if (to->tables.find(name) == to->tables.end())
+                diff.tables_dropped.push_back(name);
+        }
+        for (const auto &[name, manifest] : to->tables)
+        {
+            auto it = from->tables.find(name);
+            if (it == from->tables.end())
+            {
+                diff.tables_added.push_back(name);
+                continue;
+            }
+            const TableManifest &old_manifest = it->second;
+            bool schema_changed = !schemas_equal(old_manifest.schema, manifest.schema);
+            if (!schema_changed && old_manifest.chunk_hashes == manifest.chunk_hashes)
+                continue;
+
+            TableDiff table_diff;
+            table_diff.table_name = name;
+            table_diff.schema_changed = schema_changed;
+            diff_table_rows(repo, &old_manifest, &manifest,
+                            [&table_diff](RowDiff::Type type, const Row *old_row, const Row *new_row)
+                            {
+                                table_diff.row_diffs.emplace_back(type, old_row ? *old_row : Row{}, new_row ? *new_row : Row{});
+                                return true;
+                            });
+            diff.table_diffs.push_back(std::move(table_diff));
+        }
+        return diff;
+    }
+
+    bool is_aggregate_function(const std::string &name)
+    {
+        return name == "COUNT" || name == "SUM" || name == "MIN" || name == "MAX" || name == "AVG";
+    }
+
+    std::string bind_aggregates(Expr &e, const Schema &schema, std::vector<Expr *> &aggregates)
+    {
+        if (e.kind == Expr::Kind::FUNCTION)
+        {
+            if (std::find(aggregates.begin(), aggregates.end(), &e) != aggregates.end())
+                return ""; // shared with an earlier clause (ORDER BY alias)
+            if (!is_aggregate_function(e.name))
+                return "Unknown function '" + e.name + "'";
+            if (!e.star && e.args.size() != 1)
+                return e.name + " takes exactly one argument";
+            if (e.star && e.name != "COUNT")
+                return e.name + "(*) is not allowed";
+            for (auto &arg : e.args)
+            {
+                std::string error = bind_expr(*arg, schema);
+                if (!error.empty())
+                    return error;
+            }
+            e.column_index = schema.num_columns() + aggregates.size();
+            e.aggregate_bound = true;
+            aggregates.push_back(&e);
+            return "";
+        }
+        for (auto &arg : e.args)
+        {
+            std::string error = bind_aggregates(*arg, schema, aggregates);
+            if (!error.empty())
+                return error;
+        }
+        return "";
+    }
+
+    size_t rows_wanted(const Statement &stmt)
+    {
+        uint64_t limit = static_cast<uint64_t>(std::max<int64_t>(0, *stmt.limit));
+        uint64_t offset = static_cast<uint64_t>(std::max<int64_t>(0, stmt.offset));
+        return static_cast<size_t>(limit + offset); // both below 2^63, so this cannot wrap
+    }
+
+    QueryResult run_select(Statement &stmt, const Schema &schema, const RowScan &scan, bool stable_rows)
+    {
+        QueryResult result;
+
+        // ORDER BY may name a select alias
+        for (auto &item : stmt.order_by)
+        {
+            if (item.expr->kind != Expr::Kind::COLUMN || schema.has_column(item.expr->name))
+                continue;
+            for (const auto &select : stmt.select_items)
+            {
+                if (select.expr && select.alias == item.expr->name)
+                    item.expr = select.expr;
+            }
+        }
+
+        // Bind: aggregates first, so bind_expr accepts them afterwards
+        std::vector<Expr *> aggregates;
+        std::string error;
+        {
+            ScopedTimer plan_timer(engine_metrics().plan_seconds);
+            for (auto &item : stmt.select_items)
+            {
+                if (error.empty() && item.expr)
+                    error = bind_aggregates(*item.expr, schema, aggregates);
+            }
+            for (auto &item : stmt.order_by)
+            {
+                if (error.empty())
+                    error = bind_aggregates(*item.expr, schema, aggregates);
+            }
+            if (error.empty() && stmt.where)
+                error = bind_expr(*stmt.where, schema);
+            for (auto &e : stmt.group_by)
+            {
+                if (error.empty())
+                    error = bind_expr(*e, schema);
+            }
+            for (auto &item : stmt.select_items)
+            {
+                if (error.empty() && item.expr)
+                    error = bind_expr(*item.expr, schema);
+            }
+            for (auto &item : stmt.order_by)
+            {
+                if (error.empty())
+                    error = bind_expr(*item.expr, schema);
+            }
+        }
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+
+        bool grouped = !aggregates.empty() || !stmt.group_by.empty();
+        std::vector<const Row *> matched;
+        std::deque<Row> owned; // copies of streamed rows and grouped output rows
+        uint64_t scanned = 0;
+        MemoryCharge memory;   // everything the statement holds, checked against its limits
+
+        if (!grouped)
+        {
+            REPONO_TRACE_SPAN("select: scan + filter");
+            // Without ORDER BY a LIMIT lets the scan stop early
+            size_t wanted = std::numeric_limits<size_t>::max();
+            if (stmt.order_by.empty() && stmt.limit.has_value())
+                wanted = rows_wanted(stmt);
+            if (wanted > 0)
+            {
+                scan([&](const Row &row)
+                     {
+                    scanned++;
+                    if (stmt.where && !is_truthy(evaluate(*stmt.where, row)))
+                        return true;
+                    if (stable_rows)
+                    {
+                        matched.push_back(&row);
+                    }
+                    else
+                    {
+                        owned.push_back(row);
+                        matched.push_back(&owned.back());
+                    }
+                    bool within_limit = memory.add(sizeof(const Row *) + (stable_rows ? 0 : estimate_row_bytes(row)));
+                    return within_limit && matched.size() < wanted; });
+            }
+            if (!memory.flush())
+            {
+                return QueryResult::failure(memory.error());
+            }
+            if (stmt.where)
+                note_plan("Filter(" + expr_to_string(*stmt.where) + ")");
+            if (wanted != std::numeric_limits<size_t>::max())
+                note_plan("StopAfter(" + std::to_string(wanted) + ")");
+        }
+        else
+        {
+            struct Group
+            {
+                Row first_row;
+                std::vector<Aggregate> states;
+            };
+            std::vector<Group> groups;
+            std::unordered_map<std::string, size_t> group_index;
+
+            REPONO_TRACE_SPAN("select: scan + aggregate");
+            scan([&](const Row &row)
+                 {
+                scanned++;
+                if (stmt.where && !is_truthy(evaluate(*stmt.where, row)))
+                    return true;
+                ByteWriter key;
+                for (const auto &e : stmt.group_by)
+                    key.put_value(evaluate(*e, row));
+                auto [it, inserted] = group_index.emplace(key.take(), groups.size());
+                if (inserted)
+                    groups.push_back(Group{row, std::vector<Aggregate>(aggregates.size())});
+                Group &group = groups[it->second];
+                for (size_t i = 0; i < aggregates.size(); i++)
+                    group.states[i].add(*aggregates[i], row);
+                if (!inserted)
+                    return true;
+                return memory.add(sizeof(Group) + it->first.capacity() + estimate_row_bytes(group.first_row) +
+                                  aggregates.size() * sizeof(Aggregate)); });
+            if (!memory.flush())
+            {
+                return QueryResult::failure(memory.error());
+            }
+
+            // Aggregates over no rows still produce one row (COUNT(*) = 0)
+            if (groups.empty() && stmt.group_by.empty())
+            {
+                groups.push_back(Group{Row(schema.num_columns()), std::vector<Aggregate>(aggregates.size())});
+            }
+            for (auto &group : groups)
+            {
+                Row row = std::move(group.first_row);
+                row.resize(schema.num_columns());
+                for (size_t i = 0; i < aggregates.size(); i++)
+                    row.push_back(group.states[i].result(*aggregates[i]));
+                owned.push_back(std::move(row));
+                matched.push_back(&owned.back());
+            }
+            if (stmt.where)
+                note_plan("Filter(" + expr_to_string(*stmt.where) + ")");
+            note_plan("HashAggregate(" + std::to_string(aggregates.size()) + " aggregates, " +
+                      std::to_string(groups.size()) + " groups)");
+        }
+
+        // Sort; with a LIMIT only the top offset+limit rows need ordering
+        if (!stmt.order_by.empty())
+        {
+            REPONO_TRACE_SPAN("select: sort");
+            auto less = [&stmt](const Row *a, const Row *b)
+            {
+                for (const auto &item : stmt.order_by)
+                {
+                    Value va = evaluate(*item.expr, *a);
+                    Value vb = evaluate(*item.expr, *b);
+                    if (value_less_than(va, vb))
+                        return !item.descending;
+                    if (value_less_than(vb, va))
+                        return item.descending;
+                }
+                return false;
+            };
+            size_t wanted = stmt.limit.has_value() ? rows_wanted(stmt) : matched.size();
+            std::string keys;
+            for (const auto &item : stmt.order_by)
+                keys += (keys.empty() ? "" : ", ") + expr_to_string(*item.expr) + (item.descending ? " DESC" : "");
+            // stable_sort takes a buffer the size of the input
+            if (!memory.add(wanted < matched.size() ? 0 : matched.size() * sizeof(const Row *)) || !memory.flush())
+            {
+                return QueryResult::failure(memory.error());
+            }
+            if (wanted < matched.size())
+            {
+                note_plan("TopK(" + std::to_string(wanted) + " of " + std::to_string(matched.size()) + " by " + keys + ")");
+                std::partial_sort(matched.begin(), matched.begin() + wanted, matched.end(), less);
+                matched.resize(wanted);
+            }
+            else
+            {
+                std::stable_sort(matched.begin(), matched.end(), less);
+                note_plan("Sort(" + std::to_string(matched.size()) + " rows by " + keys + ")");
+            }
+        }
+
+        // Offset / limit
+        size_t begin = std::min(matched.size(), static_cast<size_t>(std::max<int64_t>(0, stmt.offset)));
+        size_t end = matched.size();
+        if (stmt.limit.has_value())
+        {
+            end = std::min(end, begin + static_cast<size_t>(std::max<int64_t>(0, *stmt.limit)));
+        }
+
+        // Project
+        REPONO_TRACE_SPAN("select: project");
+        for (const auto &item : stmt.select_items)
+        {
+            if (!item.expr)
+            {
+                for (const auto &col : schema.get_columns())
+                    result.columns.push_back(col.name);
+            }
+            else
+            {
+                result.columns.push_back(item.alias.empty() ? expr_to_string(*item.expr) : item.alias);
+            }
+        }
+        result.rows.reserve(end - begin);
+        for (size_t i = begin; i < end; i++)
+        {
+            const Row &row = *matched[i];
+            Row out;
+            out.reserve(result.columns.size());
+            for (const auto &item : stmt.select_items)
+            {
+                if (!item.expr)
+                    out.insert(out.end(), row.begin(), row.begin() + schema.num_columns());
+                else
+                    out.push_back(evaluate(*item.expr, row));
+            }
+            if (!memory.add(estimate_row_bytes(out)))
+            {
+                return QueryResult::failure(memory.error());
+            }
+            result.rows.push_back(std::move(out));
+        }
+        if (!memory.flush())
+        {
+            return QueryResult::failure(memory.error());
+        }
+
+        if (QueryStats *stats = current_query_stats())
+        {
+            note_plan("Project(" + std::to_string(result.columns.size()) + " columns, " + std::to_string(result.rows.size()) + " rows)");
+            stats->rows_scanned += scanned;
+        }
+        return result;
+    }
+
+    QueryResult run_select(Statement &stmt, const Schema &schema, const std::vector<Row> &rows)
+    {
+        return run_select(
+            stmt, schema,
+            [&rows](const RowSink &sink)
+            {
+                for (const auto &row : rows)
+                {
+                    if (!sink(row))
+                        break;
+                }
+            },
+            true);
+    }
+
+    Schema diff_source_schema(const Schema &from, const Schema &to)
+    {
+        Schema schema;
+        schema.add_column(ColumnDef("diff_type", DataType::VARCHAR, false, false));
+        for (const auto &col : from.get_columns())
+            schema.add_column(ColumnDef("from_" + col.name, col.type));
+        for (const auto &col : to.get_columns())
+            schema.add_column(ColumnDef("to_" + col.name, col.type));
+        return schema;
+    }
+
+    void narrow_key_range(const Expr *where, const std::string &column, KeyRange &range)
+    {
+        auto raise_low = [&range](const Value &v)
+        {
+            if (!range.low.has_value() || value_less_than(*range.low, v))
+                range.low = v;
+        };
+        auto lower_high = [&range](const Value &v)
+        {
+            if (!range.high.has_value() || value_less_than(v, *range.high))
+                range.high = v;
+        };
+        auto is_column = [&column](const Expr *e)
+        {
+            return e->kind == Expr::Kind::COLUMN && e->name == column;
+        };
+        auto is_value = [](const Expr *e)
+        {
+            return e->kind == Expr::Kind::LITERAL && !is_null(e->literal);
+        };
+
+        std::vector<const Expr *> pending;
+        if (where != nullptr)
+            pending.push_back(where);
+        while (!pending.empty())
+        {
+            const Expr *e = pending.back();
+            pending.pop_back();
+            if (e->kind == Expr::Kind::BINARY && e->op == TokenType::AND)
+            {
+                pending.push_back(e->args[0].get());
+                pending.push_back(e->args[1].get());
+                continue;
+            }
+            if (e->kind == Expr::Kind::BETWEEN && !e->negated && is_column(e->args[0].get()) &&
+                is_value(e->args[1].get()) && is_value(e->args[2].get()))
+            {
+                raise_low(e->args[1]->literal);
+                lower_high(e->args[2]->literal);
+                continue;
+            }
+            if (e->kind != Expr::Kind::BINARY || e->args.size() != 2)
+                continue;
+
+            // Read "5 > id" as "id < 5"
+            const Expr *col = e->args[0].get();
+            const Expr *lit = e->args[1].get();
+            TokenType op = e->op;
+            if (is_column(lit) && is_value(col))
+            {
+                std::swap(col, lit);
+                if (op == TokenType::LESS_THAN)
+                    op = TokenType::GREATER_THAN;
+                else if (op == TokenType::GREATER_THAN)
+                    op = TokenType::LESS_THAN;
+                else if (op == TokenType::LESS_EQUAL)
+                    op = TokenType::GREATER_EQUAL;
+                else if (op == TokenType::GREATER_EQUAL)
+                    op = TokenType::LESS_EQUAL;
+            }
+            if (!is_column(col) || !is_value(lit))
+                continue;
+            // Strict bounds are kept inclusive: the filter drops the bound itself
+            if (op == TokenType::EQUALS || op == TokenType::GREATER_THAN || op == TokenType::GREATER_EQUAL)
+                raise_low(lit->literal);
+            if (op == TokenType::EQUALS || op == TokenType::LESS_THAN || op == TokenType::LESS_EQUAL)
+                lower_high(lit->literal);
+        }
+    }
+
+    std::string extract_primary_key(const Expr *where, const Schema &schema, std::string &key)
+    {
+        std::vector<size_t> key_columns = primary_key_columns(schema);
+        if (key_columns.empty())
+        {
+            return "Table has no primary key";
+        }
+
+        Row row(schema.num_columns());
+        std::vector<bool> pinned(schema.num_columns(), false);
+        std::vector<const Expr *> pending;
+        if (where != nullptr)
+            pending.push_back(where);
+
+        while (!pending.empty())
+        {
+            const Expr *e = pending.back();
+            pending.pop_back();
+            if (e->kind == Expr::Kind::BINARY && e->op == TokenType::AND)
+            {
+                pending.push_back(e->args[0].get());
+                pending.push_back(e->args[1].get());
+                continue;
+            }
+            if (e->kind == Expr::Kind::BINARY && e->op == TokenType::EQUALS)
+            {
+                const Expr *col = e->args[0].get();
+                const Expr *lit = e->args[1].get();
+                if (col->kind == Expr::Kind::LITERAL)
+                    std::swap(col, lit);
+                if (col->kind == Expr::Kind::COLUMN && lit->kind == Expr::Kind::LITERAL)
+                {
+                    auto idx = schema.get_column_index(col->name);
+                    if (!idx.has_value())
+                        return "Unknown column '" + col->name + "'";
+                    if (schema.get_columns()[*idx].is_primary_key)
+                    {
+                        row[*idx] = lit->literal;
+                        pinned[*idx] = true;
+                        continue;
+                    }
+                }
+            }
+            return "Expected only 'primary_key = value' conditions, got " + expr_to_string(*e);
+        }
+
+        for (size_t idx : key_columns)
+        {
+            const ColumnDef &col = schema.get_columns()[idx];
+            if (!pinned[idx])
+                return "Primary key column '" + col.name + "' must be given";
+            if (col.type == DataType::FLOAT && std::holds_alternative<int64_t>(row[idx]))
+                row[idx] = static_cast<double>(std::get<int64_t>(row[idx]));
+        }
+        key = encode_key(row, key_columns);
+        return "";
+    }
+};
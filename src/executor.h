@@ -0,0 +1,258 @@
+/**
+ *  ReponoDB: Expression evaluation, diffs and the SELECT pipeline
+ */
+
+#ifndef REPONO_EXECUTOR_H
+#define REPONO_EXECUTOR_H
+
+#include "parser.h"
+#include "storage.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace repono
+{
+    // EXPRESSION EVALUATION
+
+    /**
+     * Resolve column names in an expression against a schema
+     *
+     * @returns "" if every column exists, or an error message
+     */
+    std::string bind_expr(Expr &e, const Schema &schema);
+
+    /**
+     * Three-way compare of two non-NULL values (ints and floats compare numerically)
+     */
+    int compare_values(const Value &a, const Value &b);
+
+    inline bool is_truthy(const Value &v)
+    {
+        return std::holds_alternative<bool>(v) && std::get<bool>(v);
+    }
+
+    Value evaluate_arithmetic(TokenType op, const Value &a, const Value &b);
+
+    /**
+     * Evaluate an expression against a row (columns must be bound)
+     *
+     * Comparisons with NULL yield NULL, and AND/OR follow SQL three-valued logic.
+     */
+    Value evaluate(const Expr &e, const Row &row);
+
+    /**
+     * QUERY RESULT
+     *
+     * What executing one statement produces. SELECT and LOG fill columns and
+     * rows; other statements fill message. error is "" on success.
+     */
+    struct QueryResult
+    {
+        std::vector<std::string> columns;
+        std::vector<Row> rows;
+        std::string message;
+        std::string error;
+        size_t rows_affected = 0;
+
+        bool ok() const { return error.empty(); }
+
+        static QueryResult failure(std::string message)
+        {
+            QueryResult result;
+            result.error = std::move(message);
+            return result;
+        }
+    };
+
+    /**
+     * Encode the primary key columns of a row (used as a hash key)
+     */
+    std::string encode_key(const Row &row, const std::vector<size_t> &key_columns);
+
+    /**
+     * Summarize the keys of a chunk's rows: the sorted fnv1a hashes of their
+     * encoded keys, so a key that is not in the summary is not in the chunk
+     */
+    std::vector<uint64_t> summarize_keys(const std::vector<Row> &rows, const std::vector<size_t> &key_columns);
+
+    std::vector<size_t> primary_key_columns(const Schema &schema);
+
+    bool schemas_equal(const Schema &a, const Schema &b);
+
+    /**
+     * DIFF
+     *
+     * Row-level diff of one table between two commits. Chunks present in
+     * both commits are skipped without being read; only rows of chunks that
+     * exist on one side are compared. Rows are matched by primary key when
+     * both sides share one (giving ADDED / DELETED / MODIFIED), otherwise by
+     * full row contents (ADDED / DELETED only).
+     *
+     * Results are streamed to a visitor, which can return false to stop.
+     */
+    using DiffVisitor = std::function<bool(RowDiff::Type type, const Row *old_row, const Row *new_row)>;
+
+    struct DiffStats
+    {
+        size_t chunks_skipped = 0; // shared by both sides
+        size_t chunks_scanned = 0;
+    };
+
+    /**
+     * Diff one table given its manifests (either may be nullptr if the table
+     * does not exist on that side)
+     *
+     * Rows are paired by primary key, so a key range limits both sides: rows
+     * outside it are neither indexed nor visited. An LSM side only reads the
+     * chunks whose fences overlap the range, and a range of one key skips
+     * changed chunks whose key summary rules the key out. Without a range an
+     * LSM side is merged in full.
+     *
+     * @param range Bounds on the leading key column (ignored if the sides' keys differ)
+     * @returns "" on success or an error message
+     */
+    std::string diff_table_rows(const Repository &repo,
+                                const TableManifest *from,
+                                const TableManifest *to,
+                                const DiffVisitor &visit,
+                                DiffStats *stats = nullptr,
+                                const KeyRange &range = {});
+
+    /**
+     * Narrow a key range by the conjuncts of a WHERE clause that compare a
+     * column with a literal (=, <, <=, >, >=, BETWEEN). Anything else,
+     * including OR, is left to the filter.
+     */
+    void narrow_key_range(const Expr *where, const std::string &column, KeyRange &range);
+
+    /**
+     * Diff two commits: tables added and dropped, plus row diffs of every
+     * table whose chunks changed
+     *
+     * @returns std::nullopt if either commit is unknown
+     */
+    std::optional<CommitDiff> compute_diff(const Repository &repo, const std::string &from_hash, const std::string &to_hash);
+
+    // SELECT PIPELINE
+
+    /**
+     * Rows are fed to the pipeline by a scan, which calls the sink once per
+     * row and stops early if the sink returns false.
+     */
+    using RowSink = std::function<bool(const Row &)>;
+    using RowScan = std::function<void(const RowSink &)>;
+
+    bool is_aggregate_function(const std::string &name);
+
+    /**
+     * Running state of one aggregate call within one group
+     */
+    struct Aggregate
+    {
+        int64_t count = 0;
+        bool has_double = false;
+        int64_t int_sum = 0;
+        double double_sum = 0;
+        Value min, max;
+
+        void add(const Expr &fn, const Row &row)
+        {
+            if (fn.star)
+            {
+                count++;
+                return;
+            }
+            Value v = evaluate(*fn.args[0], row);
+            if (is_null(v))
+                return;
+            count++;
+
+            if (std::holds_alternative<int64_t>(v))
+            {
+                if (__builtin_add_overflow(int_sum, std::get<int64_t>(v), &int_sum))
+                    has_double = true; // too big for an integer; report the floating point sum
+                double_sum += static_cast<double>(std::get<int64_t>(v));
+            }
+            else if (std::holds_alternative<double>(v))
+            {
+                has_double = true;
+                double_sum += std::get<double>(v);
+            }
+            if (is_null(min) || value_less_than(v, min))
+                min = v;
+            if (is_null(max) || value_less_than(max, v))
+                max = v;
+        }
+
+        Value result(const Expr &fn) const
+        {
+            if (fn.name == "COUNT")
+                return count;
+            if (count == 0)
+                return std::monostate{};
+            if (fn.name == "SUM")
+                return has_double ? Value(double_sum) : Value(int_sum);
+            if (fn.name == "AVG")
+                return double_sum / static_cast<double>(count);
+            if (fn.name == "MIN")
+                return min;
+            return max;
+        }
+    };
+
+    /**
+     * Assign aggregate calls found in expr to output slots
+     *
+     * Grouped rows are laid out as [input columns..., aggregate results...],
+     * so an aggregate node evaluates like a column at num_columns + slot.
+     */
+    std::string bind_aggregates(Expr &e, const Schema &schema, std::vector<Expr *> &aggregates);
+
+    /**
+     * Rows a SELECT with a LIMIT needs before the offset is applied: offset + limit
+     */
+    size_t rows_wanted(const Statement &stmt);
+
+    /**
+     * Run the SELECT pipeline (filter, group, sort, limit, project) over a scan
+     *
+     * @param stmt The SELECT statement
+     * @param schema Schema of the scanned rows
+     * @param scan Produces the rows
+     * @param stable_rows Whether rows passed to the sink outlive the scan
+     *                    (true for stored tables; streamed rows get copied)
+     */
+    QueryResult run_select(Statement &stmt, const Schema &schema, const RowScan &scan, bool stable_rows);
+
+    /**
+     * Run the SELECT pipeline over rows held in memory
+     */
+    QueryResult run_select(Statement &stmt, const Schema &schema, const std::vector<Row> &rows);
+
+    /**
+     * Schema of the diff(table, from, to) source:
+     * diff_type, then from_<col> for each old column, then to_<col> for each new column.
+     * When the table only exists on one side, that side's schema is used for both.
+     */
+    Schema diff_source_schema(const Schema &from, const Schema &to);
+
+    /**
+     * Turn "pk = value [AND pk2 = value2 ...]" into an encoded primary key
+     *
+     * Every primary key column must be pinned by an equality with a literal,
+     * and nothing else may appear in the condition.
+     *
+     * @param where The WHERE expression
+     * @param schema Schema of the table
+     * @param key Set to the encoded key (encode_key layout)
+     * @returns "" on success or an error message
+     */
+    std::string extract_primary_key(const Expr *where, const Schema &schema, std::string &key);
+};
+
+#endif // REPONO_EXECUTOR_H
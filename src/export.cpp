@@ -0,0 +1,343 @@
+/**
+ *  ReponoDB: Parallel CSV / JSON Lines export
+ */
+
+#include "export.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace repono
+{
+    namespace
+    {
+        // Pieces formatted ahead of the writer, per thread
+        constexpr size_t kPiecesAheadPerThread = 2;
+
+        void append_int(std::string &out, int64_t v)
+        {
+            char buf[24];
+            auto res = std::to_chars(buf, buf + sizeof(buf), v);
+            out.append(buf, res.ptr);
+        }
+
+        // Shortest text that reads back as the same double
+        void append_double(std::string &out, double v)
+        {
+            char buf[32];
+            auto res = std::to_chars(buf, buf + sizeof(buf), v);
+            out.append(buf, res.ptr);
+        }
+
+        void append_csv_field(std::string &out, const std::string &s)
+        {
+            // Quoted when empty too, to tell it apart from NULL
+            if (!s.empty() && s.find_first_of(",\"\r\n") == std::string::npos)
+            {
+                out += s;
+                return;
+            }
+            out += '"';
+            size_t start = 0;
+            for (size_t quote = s.find('"'); quote != std::string::npos; quote = s.find('"', start))
+            {
+                out.append(s, start, quote + 1 - start);
+                out += '"';
+                start = quote + 1;
+            }
+            out.append(s, start, std::string::npos);
+            out += '"';
+        }
+
+        void append_json_string(std::string &out, const std::string &s)
+        {
+            static const char kHex[] = "0123456789abcdef";
+            out += '"';
+            size_t run = 0; // start of the pending unescaped run
+            for (size_t i = 0; i < s.size(); i++)
+            {
+                unsigned char c = static_cast<unsigned char>(s[i]);
+                if (c >= 0x20 && c != '"' && c != '\\')
+                    continue;
+                out.append(s, run, i - run);
+                run = i + 1;
+                switch (c)
+                {
+                case '"':
+                    out += "\\\"";
+                    break;
+                case '\\':
+                    out += "\\\\";
+                    break;
+                case '\n':
+                    out += "\\n";
+                    break;
+                case '\r':
+                    out += "\\r";
+                    break;
+                case '\t':
+                    out += "\\t";
+                    break;
+                default:
+                    out += "\\u00";
+                    out += kHex[c >> 4];
+                    out += kHex[c & 0xF];
+                }
+            }
+            out.append(s, run, std::string::npos);
+            out += '"';
+        }
+
+        struct Piece
+        {
+            const Row *rows;
+            size_t count;
+        };
+
+        class PieceFormatter
+        {
+        public:
+            PieceFormatter(const std::vector<std::string> &names, ExportFormat format) : format_(format)
+            {
+                if (format_ == ExportFormat::JSONL)
+                {
+                    for (const auto &name : names)
+                    {
+                        std::string key;
+                        append_json_string(key, name);
+                        keys_.push_back(key + ":");
+                    }
+                }
+            }
+
+            void format(const Piece &piece, std::string &out) const
+            {
+                out.clear();
+                for (size_t i = 0; i < piece.count; i++)
+                {
+                    if (format_ == ExportFormat::CSV)
+                        append_csv_row(out, piece.rows[i]);
+                    else
+                        append_json_row(out, piece.rows[i], keys_);
+                }
+            }
+
+        private:
+            ExportFormat format_;
+            std::vector<std::string> keys_;
+        };
+
+        /**
+         * Format pieces on worker threads and hand them to write() in order
+         *
+         * @returns The first error write() reported, or ""
+         */
+        template <typename Write>
+        std::string format_in_order(const std::vector<Piece> &pieces, const PieceFormatter &formatter, size_t threads,
+                                    Write write)
+        {
+            if (threads <= 1 || pieces.size() <= 1)
+            {
+                std::string text;
+                for (const Piece &piece : pieces)
+                {
+                    formatter.format(piece, text);
+                    std::string error = write(text);
+                    if (!error.empty())
+                        return error;
+                }
+                return "";
+            }
+
+            size_t window = threads * kPiecesAheadPerThread;
+            std::vector<std::string> formatted(pieces.size());
+            std::vector<bool> ready(pieces.size(), false);
+            std::mutex mutex;
+            std::condition_variable piece_ready;
+            std::condition_variable space;
+            size_t next = 0;    // next piece to format
+            size_t written = 0; // pieces handed to write()
+            bool stop = false;
+
+            auto worker = [&]
+            {
+                std::string text;
+                while (true)
+                {
+                    size_t i;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        space.wait(lock, [&]
+                                   { return stop || next >= pieces.size() || next < written + window; });
+                        if (stop || next >= pieces.size())
+                            return;
+                        i = next++;
+                    }
+                    formatter.format(pieces[i], text);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        formatted[i] = std::move(text);
+                        ready[i] = true;
+                    }
+                    piece_ready.notify_one();
+                    text = std::string();
+                }
+            };
+
+            std::vector<std::thread> workers;
+            size_t count = std::min(threads, pieces.size());
+            for (size_t t = 0; t < count; t++)
+                workers.emplace_back(worker);
+
+            std::string error;
+            for (size_t i = 0; i < pieces.size() && error.empty(); i++)
+            {
+                std::string text;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    piece_ready.wait(lock, [&]
+                                     { return ready[i]; });
+                    text = std::move(formatted[i]);
+                    written = i + 1;
+                }
+                space.notify_all();
+                error = write(text);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            space.notify_all();
+            for (auto &t : workers)
+                t.join();
+            return error;
+        }
+    }
+
+    std::optional<ExportFormat> export_format(const std::string &name)
+    {
+        std::string upper = name;
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        if (upper == "CSV")
+            return ExportFormat::CSV;
+        if (upper == "JSONL" || upper == "NDJSON")
+            return ExportFormat::JSONL;
+        return std::nullopt;
+    }
+
+    void append_csv_row(std::string &out, const Row &row)
+    {
+        for (size_t c = 0; c < row.size(); c++)
+        {
+            if (c > 0)
+                out += ',';
+            const Value &v = row[c];
+            if (std::holds_alternative<int64_t>(v))
+                append_int(out, std::get<int64_t>(v));
+            else if (std::holds_alternative<std::string>(v))
+                append_csv_field(out, std::get<std::string>(v));
+            else if (std::holds_alternative<double>(v))
+                append_double(out, std::get<double>(v));
+            else if (std::holds_alternative<bool>(v))
+                out += std::get<bool>(v) ? "true" : "false";
+        }
+        out += '\n';
+    }
+
+    void append_json_row(std::string &out, const Row &row, const std::vector<std::string> &keys)
+    {
+        out += '{';
+        for (size_t c = 0; c < row.size() && c < keys.size(); c++)
+        {
+            if (c > 0)
+                out += ',';
+            out += keys[c];
+            const Value &v = row[c];
+            if (std::holds_alternative<int64_t>(v))
+                append_int(out, std::get<int64_t>(v));
+            else if (std::holds_alternative<std::string>(v))
+                append_json_string(out, std::get<std::string>(v));
+            else if (std::holds_alternative<double>(v) && std::isfinite(std::get<double>(v)))
+                append_double(out, std::get<double>(v));
+            else if (std::holds_alternative<bool>(v))
+                out += std::get<bool>(v) ? "true" : "false";
+            else
+                out += "null";
+        }
+        out += "}\n";
+    }
+
+    std::string export_rows(const std::vector<std::string> &names, const std::vector<RowRange> &ranges,
+                            const std::string &path, const ExportOptions &options, ExportStats &stats)
+    {
+        REPONO_TRACE_SPAN("export_rows");
+        stats = ExportStats{};
+        size_t piece_rows = std::max<size_t>(options.piece_rows, 1);
+        std::vector<Piece> pieces;
+        for (const RowRange &range : ranges)
+        {
+            for (size_t begin = 0; begin < range.count; begin += piece_rows)
+                pieces.push_back(Piece{range.rows + begin, std::min(piece_rows, range.count - begin)});
+            stats.rows += range.count;
+        }
+
+        std::string tmp = path + ".tmp";
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            return "Cannot write '" + tmp + "'";
+        }
+        auto write = [&](const std::string &text)
+        {
+            out.write(text.data(), static_cast<std::streamsize>(text.size()));
+            stats.bytes += text.size();
+            return out ? std::string() : "Short write to '" + tmp + "'";
+        };
+
+        std::string error;
+        if (options.format == ExportFormat::CSV && options.header)
+        {
+            std::string header;
+            for (size_t c = 0; c < names.size(); c++)
+            {
+                if (c > 0)
+                    header += ',';
+                append_csv_field(header, names[c]);
+            }
+            header += '\n';
+            error = write(header);
+        }
+
+        size_t threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        if (error.empty())
+            error = format_in_order(pieces, PieceFormatter(names, options.format), threads, write);
+        out.close();
+        if (error.empty() && !out)
+            error = "Short write to '" + tmp + "'";
+
+        std::error_code ec;
+        if (error.empty())
+        {
+            std::filesystem::rename(tmp, path, ec);
+            if (ec)
+                error = "Cannot rename '" + tmp + "': " + ec.message();
+        }
+        if (!error.empty())
+        {
+            std::filesystem::remove(tmp, ec);
+            return error;
+        }
+        engine_metrics().bytes_written.add(stats.bytes);
+        return "";
+    }
+};
@@ -0,0 +1,80 @@
+/**
+ *  ReponoDB: Parallel CSV / JSON Lines export
+ */
+
+#ifndef REPONO_EXPORT_H
+#define REPONO_EXPORT_H
+
+#include "columnar.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * EXPORT
+     *
+     * COPY ... TO writes rows as CSV or JSON Lines. The rows are cut into
+     * pieces of a few thousand rows that worker threads format (numbers with
+     * std::to_chars, no streams or per-cell allocations), while the calling
+     * thread writes the finished pieces to the file in order, one large
+     * write per piece. Workers stay at most a few pieces ahead of the
+     * writer, so memory use does not grow with the table.
+     *
+     * CSV follows RFC 4180 with a header line: NULL is an empty field and an
+     * empty string is "". JSON Lines writes one object per row, NULL as null
+     * and non-finite floats as null.
+     *
+     * The file is written next to its destination and renamed into place,
+     * so a failed export leaves no partial file.
+     */
+    enum class ExportFormat
+    {
+        CSV,
+        JSONL
+    };
+
+    /**
+     * Look up a format by name (case-insensitive): CSV, JSONL or NDJSON
+     */
+    std::optional<ExportFormat> export_format(const std::string &name);
+
+    struct ExportOptions
+    {
+        ExportFormat format = ExportFormat::CSV;
+        bool header = true;            // CSV only
+        size_t threads = 0;            // formatting threads; 0 = one per core
+        size_t piece_rows = 16 * 1024; // rows per formatted piece
+    };
+
+    struct ExportStats
+    {
+        uint64_t rows = 0;
+        uint64_t bytes = 0;
+    };
+
+    /**
+     * Format rows and write them to a file
+     *
+     * @param names Column names (CSV header, JSON keys)
+     * @param ranges The rows, in output order
+     * @param path Destination file, replaced if it exists
+     * @returns "" on success or an error message
+     */
+    std::string export_rows(const std::vector<std::string> &names, const std::vector<RowRange> &ranges,
+                            const std::string &path, const ExportOptions &options, ExportStats &stats);
+
+    /**
+     * Append one row as a CSV record or a JSON object, with its newline
+     *
+     * @param keys For JSON, each column's key already escaped and quoted, followed by ':'
+     */
+    void append_csv_row(std::string &out, const Row &row);
+    void append_json_row(std::string &out, const Row &row, const std::vector<std::string> &keys);
+};
+
+#endif // REPONO_EXPORT_H
@@ -0,0 +1,115 @@
+/**
+ *  ReponoDB: SHA-256 hashing of data and commits
+ */
+
+#include "repono/hash.h"
+#include "lsm.h"
+#include "metrics.h"
+#include "storage.h"
+#include "trace.h"
+
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <openssl/sha.h>
+
+namespace repono
+{
+    std::string compute_hash(const std::string &data)
+    {
+        EngineMetrics &stats = engine_metrics();
+        ScopedTimer timer(stats.hash_seconds);
+        stats.hashed_bytes.add(data.size());
+
+        unsigned char hash[SHA256_DIGEST_LENGTH];
+        SHA256(reinterpret_cast<const unsigned char *>(data.c_str()),
+               data.size(),
+               hash);
+
+        std::ostringstream oss;
+        for (int i = 0; i < SHA256_DIGEST_LENGTH; i++)
+        {
+            oss << std::hex << std::setfill('0') << std::setw(2)
+                << static_cast<int>(hash[i]);
+        }
+        return oss.str(); // Full 64-char hash
+    }
+
+    CommitHasher::CommitHasher(const Commit &commit)
+    {
+        // Include parent hash (or empty string for root)
+        text_ += "parent:" + commit.parent_hash + "\n";
+        if (!commit.merge_parent_hash.empty())
+        {
+            text_ += "merge:" + commit.merge_parent_hash + "\n";
+        }
+        text_ += "message:" + commit.message + "\n";
+        text_ += "timestamp:" + std::to_string(commit.timestamp) + "\n";
+    }
+
+    void CommitHasher::begin_table(const std::string &name, bool sorted_runs)
+    {
+        text_ += (sorted_runs ? "lsm-table:" : "table:") + name + "\n";
+    }
+
+    void CommitHasher::begin_run(uint32_t level)
+    {
+        text_ += "run:" + std::to_string(level) + "\n";
+    }
+
+    void CommitHasher::add_chunk(const std::string &chunk_hash)
+    {
+        text_ += "chunk:" + chunk_hash + "\n";
+    }
+
+    std::string compute_commit_hash(const Commit &commit)
+    {
+        REPONO_TRACE_SPAN("compute_commit_hash");
+        CommitHasher hasher(commit);
+
+        // Every table, with or without rows, in name order
+        std::set<std::string> table_names;
+        for (const auto &[name, _] : commit.table_data)
+        {
+            table_names.insert(name);
+        }
+        for (const auto &[name, _] : commit.table_schemas)
+        {
+            table_names.insert(name);
+        }
+
+        for (const auto &name : table_names)
+        {
+            auto runs = commit.table_runs.find(name);
+            auto schema = commit.table_schemas.find(name);
+            if (runs != commit.table_runs.end() && schema != commit.table_schemas.end())
+            {
+                // An LSM table: each run's level, then its chunks
+                hasher.begin_table(name, true);
+                for (const auto &run : runs->second)
+                {
+                    hasher.begin_run(run.level);
+                    for (const auto &chunk_hash : hash_run(schema->second, run))
+                        hasher.add_chunk(chunk_hash);
+                }
+                continue;
+            }
+            hasher.begin_table(name);
+            auto data = commit.table_data.find(name);
+            if (data == commit.table_data.end())
+                continue;
+            for (const auto &chunk : split_into_chunks(data->second))
+            {
+                hasher.add_chunk(compute_chunk_hash(chunk));
+            }
+        }
+        return hasher.finish();
+    }
+
+    bool validate_commit(const Commit &commit)
+    {
+        REPONO_TRACE_SPAN("validate_commit");
+        std::string computed = compute_commit_hash(commit);
+        return computed == commit.hash;
+    }
+};
@@ -0,0 +1,494 @@
+/**
+ *  ReponoDB: Parallel CSV loading
+ */
+
+#include "import.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace repono
+{
+    namespace
+    {
+        // Slices smaller than this are not worth a thread
+        constexpr size_t kMinSliceBytes = 1 << 20;
+        constexpr size_t kBlock = 64;
+
+        /**
+         * Bit i of each mask is set where byte i of a 64-byte block is a
+         * quote / a newline
+         */
+        struct BlockMasks
+        {
+            uint64_t quotes;
+            uint64_t newlines;
+        };
+
+#if defined(__SSE2__)
+        inline BlockMasks scan_block(const char *p)
+        {
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i newline = _mm_set1_epi8('\n');
+            BlockMasks masks{0, 0};
+            for (int i = 0; i < 4; i++)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+                masks.quotes |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << (16 * i);
+                masks.newlines |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)))) << (16 * i);
+            }
+            return masks;
+        }
+#elif defined(__ARM_NEON)
+        inline uint64_t to_bitmask(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3)
+        {
+            const uint8x16_t bits = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+            uint8x16_t sum0 = vpaddq_u8(vandq_u8(m0, bits), vandq_u8(m1, bits));
+            uint8x16_t sum1 = vpaddq_u8(vandq_u8(m2, bits), vandq_u8(m3, bits));
+            sum0 = vpaddq_u8(sum0, sum1);
+            sum0 = vpaddq_u8(sum0, sum0);
+            return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+        }
+
+        inline BlockMasks scan_block(const char *p)
+        {
+            const uint8_t *u = reinterpret_cast<const uint8_t *>(p);
+            uint8x16_t v0 = vld1q_u8(u), v1 = vld1q_u8(u + 16), v2 = vld1q_u8(u + 32), v3 = vld1q_u8(u + 48);
+            const uint8x16_t quote = vdupq_n_u8('"');
+            const uint8x16_t newline = vdupq_n_u8('\n');
+            return BlockMasks{
+                to_bitmask(vceqq_u8(v0, quote), vceqq_u8(v1, quote), vceqq_u8(v2, quote), vceqq_u8(v3, quote)),
+                to_bitmask(vceqq_u8(v0, newline), vceqq_u8(v1, newline), vceqq_u8(v2, newline), vceqq_u8(v3, newline))};
+        }
+#else
+        inline BlockMasks scan_block(const char *p)
+        {
+            BlockMasks masks{0, 0};
+            for (size_t i = 0; i < kBlock; i++)
+            {
+                masks.quotes |= static_cast<uint64_t>(p[i] == '"') << i;
+                masks.newlines |= static_cast<uint64_t>(p[i] == '\n') << i;
+            }
+            return masks;
+        }
+#endif
+
+        /**
+         * Call fn(block start, masks) for each 64-byte block of [begin, end);
+         * the last one is zero-padded
+         */
+        template <typename Fn>
+        void for_each_block(const char *data, size_t begin, size_t end, Fn fn)
+        {
+            size_t pos = begin;
+            for (; pos + kBlock <= end; pos += kBlock)
+                fn(pos, scan_block(data + pos));
+            if (pos < end)
+            {
+                char tail[kBlock] = {};
+                std::memcpy(tail, data + pos, end - pos);
+                fn(pos, scan_block(tail));
+            }
+        }
+
+        /**
+         * Run fn(0) .. fn(n - 1), each on its own thread when threads > 1
+         */
+        template <typename Fn>
+        void parallel_for(size_t n, size_t threads, Fn fn)
+        {
+            if (threads <= 1 || n <= 1)
+            {
+                for (size_t i = 0; i < n; i++)
+                    fn(i);
+                return;
+            }
+            std::vector<std::thread> workers;
+            for (size_t i = 1; i < n; i++)
+                workers.emplace_back(fn, i);
+            fn(0);
+            for (auto &t : workers)
+                t.join();
+        }
+
+        std::string quote_text(std::string_view text)
+        {
+            constexpr size_t kMax = 32;
+            return "'" + std::string(text.substr(0, kMax)) + (text.size() > kMax ? "...'" : "'");
+        }
+
+        bool iequals(std::string_view a, const char *b)
+        {
+            size_t n = std::strlen(b);
+            if (a.size() != n)
+                return false;
+            for (size_t i = 0; i < n; i++)
+            {
+                if (std::tolower(static_cast<unsigned char>(a[i])) != b[i])
+                    return false;
+            }
+            return true;
+        }
+
+        /**
+         * Convert one field to its column's type
+         *
+         * @returns false if the text is not a value of that type
+         */
+        bool convert(DataType type, std::string_view text, bool quoted, Value &out)
+        {
+            if (text.empty() && (!quoted || type != DataType::VARCHAR))
+            {
+                out = std::monostate{};
+                return true;
+            }
+            const char *first = text.data();
+            const char *last = first + text.size();
+            switch (type)
+            {
+            case DataType::INTEGER:
+            case DataType::TIMESTAMP:
+            {
+                int64_t v = 0;
+                auto res = std::from_chars(first, last, v);
+                if (res.ec != std::errc() || res.ptr != last)
+                    return false;
+                out = v;
+                return true;
+            }
+            case DataType::FLOAT:
+            {
+                double v = 0;
+                auto res = std::from_chars(first, last, v);
+                if (res.ec != std::errc() || res.ptr != last)
+                    return false;
+                out = v;
+                return true;
+            }
+            case DataType::BOOLEAN:
+                if (iequals(text, "true") || iequals(text, "t") || text == "1")
+                    out = true;
+                else if (iequals(text, "false") || iequals(text, "f") || text == "0")
+                    out = false;
+                else
+                    return false;
+                return true;
+            case DataType::VARCHAR:
+                out = std::string(text);
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * Splits records into fields and converts them. Without types every
+         * field is read as VARCHAR, however many there are (header lines).
+         */
+        class RecordParser
+        {
+        public:
+            RecordParser(const std::vector<DataType> &types, const std::vector<std::string> &names)
+                : types_(types), names_(names) {}
+
+            /**
+             * Parse the record in [p, end) (without its newline) into row;
+             * a blank line leaves row empty
+             *
+             * @returns "" on success or an error message
+             */
+            std::string parse(const char *p, const char *end, Row &row)
+            {
+                if (end > p && end[-1] == '\r')
+                    end--;
+                if (p == end)
+                    return "";
+                bool any_width = types_.empty();
+                row.clear();
+                row.reserve(types_.size());
+                const char *cur = p;
+                while (true)
+                {
+                    if (!any_width && row.size() == types_.size())
+                        return "Expected " + std::to_string(types_.size()) + " fields, got more";
+                    std::string_view text;
+                    bool quoted = cur < end && *cur == '"';
+                    if (quoted)
+                    {
+                        const char *start = cur + 1;
+                        const char *close = nullptr;
+                        bool escaped = false;
+                        scratch_.clear();
+                        while (true)
+                        {
+                            close = static_cast<const char *>(std::memchr(start, '"', end - start));
+                            if (close == nullptr)
+                                return "Unterminated quoted field";
+                            if (close + 1 < end && close[1] == '"')
+                            {
+                                scratch_.append(start, close + 1);
+                                start = close + 2;
+                                escaped = true;
+                                continue;
+                            }
+                            break;
+                        }
+                        if (escaped)
+                        {
+                            scratch_.append(start, close);
+                            text = scratch_;
+                        }
+                        else
+                        {
+                            text = std::string_view(cur + 1, close - cur - 1);
+                        }
+                        cur = close + 1;
+                        if (cur < end && *cur != ',')
+                            return "Unexpected " + quote_text(std::string_view(cur, 1)) + " after a quoted field";
+                    }
+                    else
+                    {
+                        const char *comma = static_cast<const char *>(std::memchr(cur, ',', end - cur));
+                        const char *field_end = comma != nullptr ? comma : end;
+                        text = std::string_view(cur, field_end - cur);
+                        cur = field_end;
+                    }
+
+                    size_t column = row.size();
+                    row.emplace_back();
+                    if (any_width)
+                        row.back() = std::string(text);
+                    else if (!convert(types_[column], text, quoted, row.back()))
+                        return "Column '" + names_[column] + "' expects " + datatype_to_string(types_[column]) +
+                               ", got " + quote_text(text);
+                    if (cur == end)
+                        break;
+                    cur++; // ','
+                }
+                if (!any_width && row.size() != types_.size())
+                    return "Expected " + std::to_string(types_.size()) + " fields, got " + std::to_string(row.size());
+                return "";
+            }
+
+        private:
+            const std::vector<DataType> &types_;
+            const std::vector<std::string> &names_;
+            std::string scratch_; // unescaped text of a quoted field with "" in it
+        };
+
+        /**
+         * Where each record ends: the offsets of the newlines outside quotes,
+         * plus the end of the data when the last line has no newline
+         */
+        std::string find_records(const char *data, size_t size, size_t threads, std::vector<size_t> &ends)
+        {
+            size_t slices = std::max<size_t>(1, std::min(threads, size / kMinSliceBytes));
+            size_t slice_bytes = (size + slices - 1) / slices;
+            auto slice_begin = [&](size_t i)
+            { return std::min(size, i * slice_bytes); };
+
+            // Pass 1: quotes per slice, so each knows whether it starts inside quotes
+            std::vector<uint64_t> quotes(slices, 0);
+            parallel_for(slices, threads, [&](size_t i)
+                         { for_each_block(data, slice_begin(i), slice_begin(i + 1), [&](size_t, const BlockMasks &masks)
+                                          { quotes[i] += __builtin_popcountll(masks.quotes); }); });
+
+            // Pass 2: newlines outside quotes
+            std::vector<std::vector<size_t>> slice_ends(slices);
+            std::vector<bool> starts_quoted(slices, false);
+            uint64_t total = 0;
+            for (size_t i = 0; i < slices; i++)
+            {
+                starts_quoted[i] = total % 2 == 1;
+                total += quotes[i];
+            }
+            if (total % 2 == 1)
+                return "Unterminated quoted field";
+            parallel_for(slices, threads, [&](size_t i)
+                         {
+                bool in_quotes = starts_quoted[i];
+                std::vector<size_t> &out = slice_ends[i];
+                for_each_block(data, slice_begin(i), slice_begin(i + 1), [&](size_t pos, const BlockMasks &masks)
+                               {
+                    if (masks.quotes == 0)
+                    {
+                        if (in_quotes)
+                            return;
+                        for (uint64_t bits = masks.newlines; bits != 0; bits &= bits - 1)
+                            out.push_back(pos + __builtin_ctzll(bits));
+                        return;
+                    }
+                    for (uint64_t bits = masks.quotes | masks.newlines; bits != 0; bits &= bits - 1)
+                    {
+                        unsigned bit = __builtin_ctzll(bits);
+                        if (masks.quotes & (uint64_t(1) << bit))
+                            in_quotes = !in_quotes;
+                        else if (!in_quotes)
+                            out.push_back(pos + bit);
+                    } }); });
+
+            size_t count = 0;
+            for (const auto &slice : slice_ends)
+                count += slice.size();
+            ends.clear();
+            ends.reserve(count + 1);
+            for (const auto &slice : slice_ends)
+                ends.insert(ends.end(), slice.begin(), slice.end());
+            if (size > 0 && (ends.empty() || ends.back() != size - 1))
+                ends.push_back(size);
+            return "";
+        }
+
+        class MappedFile
+        {
+        public:
+            ~MappedFile()
+            {
+                if (data_ != nullptr)
+                    munmap(data_, size_);
+            }
+
+            std::string open(const std::string &path)
+            {
+                int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0)
+                    return "Cannot open '" + path + "': " + std::strerror(errno);
+                struct stat st;
+                if (fstat(fd, &st) != 0)
+                {
+                    std::string error = "Cannot stat '" + path + "': " + std::strerror(errno);
+                    ::close(fd);
+                    return error;
+                }
+                size_ = static_cast<size_t>(st.st_size);
+                if (size_ > 0)
+                {
+                    void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (p == MAP_FAILED)
+                    {
+                        std::string error = "Cannot map '" + path + "': " + std::strerror(errno);
+                        ::close(fd);
+                        return error;
+                    }
+                    data_ = p;
+                    madvise(data_, size_, MADV_SEQUENTIAL);
+                }
+                ::close(fd);
+                return "";
+            }
+
+            const char *data() const { return static_cast<const char *>(data_); }
+            size_t size() const { return size_; }
+
+        private:
+            void *data_ = nullptr;
+            size_t size_ = 0;
+        };
+    }
+
+    std::string parse_csv(const char *data, size_t size, const Schema &schema, const CsvOptions &options,
+                          std::vector<std::string> &columns, std::vector<Row> &rows)
+    {
+        REPONO_TRACE_SPAN("parse_csv");
+        size_t threads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<size_t> ends;
+        std::string error = find_records(data, size, threads, ends);
+        if (!error.empty())
+            return error;
+        auto record_begin = [&](size_t k)
+        { return k == 0 ? size_t(0) : ends[k - 1] + 1; };
+
+        // Field types, by header name or in schema order
+        columns.clear();
+        std::vector<DataType> types;
+        std::vector<std::string> names;
+        size_t first = 0;
+        if (options.header)
+        {
+            if (ends.empty())
+                return "Missing header line";
+            Row header;
+            error = RecordParser(types, names).parse(data, data + ends[0], header);
+            if (!error.empty() || header.empty())
+                return "Cannot parse the header line" + (error.empty() ? "" : ": " + error);
+            for (const Value &v : header)
+            {
+                std::string name = std::holds_alternative<std::string>(v) ? std::get<std::string>(v) : "";
+                auto idx = schema.get_column_index(name);
+                if (!idx.has_value())
+                    return "Unknown column '" + name + "' in the header line";
+                if (std::find(columns.begin(), columns.end(), name) != columns.end())
+                    return "Column '" + name + "' appears twice in the header line";
+                columns.push_back(name);
+                types.push_back(schema.get_columns()[*idx].type);
+            }
+            names = columns;
+            first = 1;
+        }
+        else
+        {
+            for (const auto &col : schema.get_columns())
+            {
+                names.push_back(col.name);
+                types.push_back(col.type);
+            }
+        }
+
+        // Pass 3: parse records in place, an even share per thread
+        size_t records = ends.size() - std::min(first, ends.size());
+        rows.clear();
+        rows.resize(records);
+        size_t workers = std::max<size_t>(1, std::min(threads, records / 1024));
+        std::vector<std::pair<size_t, std::string>> errors(workers, {SIZE_MAX, ""});
+        parallel_for(workers, threads, [&](size_t w)
+                     {
+            RecordParser parser(types, names);
+            size_t begin = first + records * w / workers;
+            size_t end = first + records * (w + 1) / workers;
+            for (size_t k = begin; k < end; k++)
+            {
+                std::string message = parser.parse(data + record_begin(k), data + ends[k], rows[k - first]);
+                if (!message.empty())
+                {
+                    errors[w] = {k, message};
+                    return;
+                }
+            } });
+        for (const auto &e : errors)
+        {
+            if (e.first != SIZE_MAX)
+                return "Record " + std::to_string(e.first + 1) + ": " + e.second;
+        }
+
+        if (!types.empty())
+            rows.erase(std::remove_if(rows.begin(), rows.end(), [](const Row &row)
+                                      { return row.empty(); }),
+                       rows.end());
+        return "";
+    }
+
+    std::string load_csv(const std::string &path, const Schema &schema, const CsvOptions &options,
+                         std::vector<std::string> &columns, std::vector<Row> &rows)
+    {
+        MappedFile file;
+        std::string error = file.open(path);
+        if (!error.empty())
+            return error;
+        return parse_csv(file.data(), file.size(), schema, options, columns, rows);
+    }
+};
@@ -0,0 +1,61 @@
+/**
+ *  ReponoDB: Parallel CSV loading
+ */
+
+#ifndef REPONO_IMPORT_H
+#define REPONO_IMPORT_H
+
+#include "repono/schema.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * CSV LOADING
+     *
+     * COPY table FROM 'file' maps the file and parses it in three parallel
+     * passes over equal slices of it:
+     *
+     *  1. count the quote characters in each slice, 64 bytes at a time with
+     *     SIMD compares (SSE2 or NEON, a scalar loop elsewhere); a running
+     *     sum tells each slice whether it starts inside a quoted field
+     *  2. find the newlines outside quotes in each slice, which are the
+     *     record boundaries
+     *  3. split the records evenly between threads, which parse each field
+     *     straight into a Value of its column's type (std::from_chars for
+     *     numbers), in place in the output
+     *
+     * The format is the one COPY ... TO writes (RFC 4180): an unquoted empty
+     * field is NULL, "" is an empty string, and lines may end in \n or \r\n.
+     * Booleans are true/false, t/f or 1/0 in any case. Blank lines are
+     * skipped.
+     */
+    struct CsvOptions
+    {
+        bool header = true; // the first record names the columns
+        size_t threads = 0; // 0 = one per core
+    };
+
+    /**
+     * Parse CSV text into rows typed by a schema
+     *
+     * @param columns Set to the header's column names, in file order (empty
+     *                without a header: every column, in schema order)
+     * @param rows Set to the records, with values in the order of columns
+     * @returns "" on success or an error message naming the record
+     */
+    std::string parse_csv(const char *data, size_t size, const Schema &schema, const CsvOptions &options,
+                          std::vector<std::string> &columns, std::vector<Row> &rows);
+
+    /**
+     * Map a file and parse_csv it
+     */
+    std::string load_csv(const std::string &path, const Schema &schema, const CsvOptions &options,
+                         std::vector<std::string> &columns, std::vector<Row> &rows);
+};
+
+#endif // REPONO_IMPORT_H
@@ -0,0 +1,610 @@
+/**
+ *  ReponoDB: SQL tokenizer
+ */
+
+#include "repono/lexer.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+namespace repono
+{
+    std::string token_type_to_string(TokenType type)
+    {
+        switch (type)
+        {
+        case TokenType::INTEGER_LITERAL:
+            return "INTEGER_LITERAL";
+        case TokenType::FLOAT_LITERAL:
+            return "FLOAT_LITERAL";
+        case TokenType::STRING_LITERAL:
+            return "STRING_LITERAL";
+        case TokenType::IDENTIFIER:
+            return "IDENTIFIER";
+        case TokenType::SELECT:
+            return "SELECT";
+        case TokenType::FROM:
+            return "FROM";
+        case TokenType::WHERE:
+            return "WHERE";
+        case TokenType::INSERT:
+            return "INSERT";
+        case TokenType::BETWEEN:
+            return "BETWEEN";
+        case TokenType::INTO:
+            return "INTO";
+        case TokenType::VALUES:
+            return "VALUES";
+        case TokenType::UPDATE:
+            return "UPDATE";
+        case TokenType::SET:
+            return "SET";
+        case TokenType::DELETE:
+            return "DELETE";
+        case TokenType::CREATE:
+            return "CREATE";
+        case TokenType::TABLE:
+            return "TABLE";
+        case TokenType::DROP:
+            return "DROP";
+        case TokenType::AND:
+            return "AND";
+        case TokenType::OR:
+            return "OR";
+        case TokenType::NOT:
+            return "NOT";
+        case TokenType::NULL_KEYWORD:
+            return "NULL";
+        case TokenType::TRUE_KEYWORD:
+            return "TRUE";
+        case TokenType::FALSE_KEYWORD:
+            return "FALSE";
+        case TokenType::PRIMARY:
+            return "PRIMARY";
+        case TokenType::KEY:
+            return "KEY";
+        case TokenType::INTEGER_TYPE:
+            return "INTEGER_TYPE";
+        case TokenType::VARCHAR_TYPE:
+            return "VARCHAR_TYPE";
+        case TokenType::FLOAT_TYPE:
+            return "FLOAT_TYPE";
+        case TokenType::BOOLEAN_TYPE:
+            return "BOOLEAN_TYPE";
+        case TokenType::TIMESTAMP_TYPE:
+            return "TIMESTAMP_TYPE";
+        case TokenType::AS:
+            return "AS";
+        case TokenType::IS:
+            return "IS";
+        case TokenType::FOR:
+            return "FOR";
+        case TokenType::ALL:
+            return "ALL";
+        case TokenType::SHOW:
+            return "SHOW";
+        case TokenType::COPY:
+            return "COPY";
+        case TokenType::OF:
+            return "OF";
+        case TokenType::COMMIT:
+            return "COMMIT";
+        case TokenType::CHECKOUT:
+            return "CHECKOUT";
+        case TokenType::MERGE:
+            return "MERGE";
+        case TokenType::LOG:
+            return "LOG";
+        case TokenType::BLAME:
+            return "BLAME";
+        case TokenType::HISTORY:
+            return "HISTORY";
+        case TokenType::ROW:
+            return "ROW";
+        case TokenType::GROUP:
+            return "GROUP";
+        case TokenType::ORDER:
+            return "ORDER";
+        case TokenType::BY:
+            return "BY";
+        case TokenType::ASC:
+            return "ASC";
+        case TokenType::DESC:
+            return "DESC";
+        case TokenType::LIMIT:
+            return "LIMIT";
+        case TokenType::OFFSET:
+            return "OFFSET";
+        case TokenType::EQUALS:
+            return "EQUALS";
+        case TokenType::NOT_EQUALS:
+            return "NOT_EQUALS";
+        case TokenType::LESS_THAN:
+            return "LESS_THAN";
+        case TokenType::GREATER_THAN:
+            return "GREATER_THAN";
+        case TokenType::LESS_EQUAL:
+            return "LESS_EQUAL";
+        case TokenType::GREATER_EQUAL:
+            return "GREATER_EQUAL";
+        case TokenType::PLUS:
+            return "PLUS";
+        case TokenType::MINUS:
+            return "MINUS";
+        case TokenType::ASTERISK:
+            return "ASTERISK";
+        case TokenType::SLASH:
+            return "SLASH";
+        case TokenType::COMMA:
+            return "COMMA";
+        case TokenType::SEMICOLON:
+            return "SEMICOLON";
+        case TokenType::LEFT_PAREN:
+            return "LEFT_PAREN";
+        case TokenType::RIGHT_PAREN:
+            return "RIGHT_PAREN";
+        case TokenType::DOT:
+            return "DOT";
+        case TokenType::END_OF_FILE:
+            return "EOF";
+        case TokenType::INVALID:
+            return "INVALID";
+        default:
+            return "UNKNOWN";
+        }
+    }
+
+    std::vector<Token> Lexer::tokenize()
+    {
+        REPONO_TRACE_SPAN("Lexer::tokenize");
+        std::vector<Token> tokens;
+        while (!is_at_end())
+        {
+            if (auto error = skip_whitespace_and_comments())
+            {
+                tokens.push_back(*error);
+                break;
+            }
+
+            if (is_at_end())
+                break;
+
+            Token token = scan_token();
+            tokens.push_back(token);
+        }
+        tokens.push_back(Token(TokenType::END_OF_FILE, "", line_, column_));
+
+        return tokens;
+    }
+
+    void Lexer::init_keywords()
+    {
+        keywords_ = {
+            // Query keywords
+            {"SELECT", TokenType::SELECT},
+            {"FROM", TokenType::FROM},
+            {"WHERE", TokenType::WHERE},
+            {"INSERT", TokenType::INSERT},
+            {"INTO", TokenType::INTO},
+            {"VALUES", TokenType::VALUES},
+            {"UPDATE", TokenType::UPDATE},
+            {"SET", TokenType::SET},
+            {"DELETE", TokenType::DELETE},
+            {"BETWEEN", TokenType::BETWEEN},
+            // Table keywords
+            {"CREATE", TokenType::CREATE},
+            {"TABLE", TokenType::TABLE},
+            {"DROP", TokenType::DROP},
+
+            // Logical keywords
+            {"AND", TokenType::AND},
+            {"OR", TokenType::OR},
+            {"NOT", TokenType::NOT},
+
+            // Value keywords
+            {"NULL", TokenType::NULL_KEYWORD},
+            {"TRUE", TokenType::TRUE_KEYWORD},
+            {"FALSE", TokenType::FALSE_KEYWORD},
+
+            // Constraint keywords
+            {"PRIMARY", TokenType::PRIMARY},
+            {"KEY", TokenType::KEY},
+
+            // Type keywords (multiple spellings)
+            {"INTEGER", TokenType::INTEGER_TYPE},
+            {"INT", TokenType::INTEGER_TYPE},
+            {"VARCHAR", TokenType::VARCHAR_TYPE},
+            {"TEXT", TokenType::VARCHAR_TYPE},
+            {"FLOAT", TokenType::FLOAT_TYPE},
+            {"DOUBLE", TokenType::FLOAT_TYPE},
+            {"BOOLEAN", TokenType::BOOLEAN_TYPE},
+            {"BOOL", TokenType::BOOLEAN_TYPE},
+            {"TIMESTAMP", TokenType::TIMESTAMP_TYPE},
+
+            // Misc keywords
+            {"AS", TokenType::AS},
+            {"IS", TokenType::IS},
+            {"FOR", TokenType::FOR},
+            {"ALL", TokenType::ALL},
+            {"SHOW", TokenType::SHOW},
+            {"COPY", TokenType::COPY},
+
+            // Version control keywords
+            {"OF", TokenType::OF},
+            {"COMMIT", TokenType::COMMIT},
+            {"CHECKOUT", TokenType::CHECKOUT},
+            {"MERGE", TokenType::MERGE},
+            {"LOG", TokenType::LOG},
+            {"BLAME", TokenType::BLAME},
+            {"HISTORY", TokenType::HISTORY},
+            {"ROW", TokenType::ROW},
+
+            // Ordering keywords
+            {"GROUP", TokenType::GROUP},
+            {"ORDER", TokenType::ORDER},
+            {"BY", TokenType::BY},
+            {"ASC", TokenType::ASC},
+            {"DESC", TokenType::DESC},
+            {"LIMIT", TokenType::LIMIT},
+            {"OFFSET", TokenType::OFFSET}};
+    }
+
+    char Lexer::peek() const
+    {
+        if (is_at_end())
+            return '\0';
+        return source_[current_];
+    }
+
+    char Lexer::peek_next() const
+    {
+        if (current_ + 1 >= source_.length())
+            return '\0';
+        return source_[current_ + 1];
+    }
+
+    char Lexer::advance()
+    {
+        char c = source_[current_++];
+        if (c == '\n')
+        {
+            column_ = 1;
+            line_++;
+        }
+        else
+        {
+            column_++;
+        }
+        return c;
+    }
+
+    bool Lexer::match(char expected)
+    {
+        if (is_at_end())
+            return false;
+        if (expected != source_[current_])
+            return false;
+        advance();
+        return true;
+    }
+
+    std::optional<Token> Lexer::skip_whitespace_and_comments()
+    {
+        while (!is_at_end())
+        {
+            char c = peek();
+
+            // Whitespace
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                advance();
+                continue;
+            };
+
+            // Single line comment: -- ..
+            if (c == '-' && peek_next() == '-')
+            {
+                while (!is_at_end() && peek() != '\n')
+                {
+                    advance();
+                }
+                continue;
+            }
+
+            // Block comment: /* */
+            if (c == '/' && peek_next() == '*')
+            {
+                int start_line = line_;
+                int start_column = column_;
+                advance(); // Skip /
+                advance(); // Skip *
+
+                bool closed = false;
+                while (!is_at_end())
+                {
+                    if (peek() == '*' && peek_next() == '/')
+                    {
+                        advance(); // Skip *
+                        advance(); // Skip /
+                        closed = true;
+                        break;
+                    }
+                    advance();
+                }
+                if (!closed)
+                {
+                    return Token(TokenType::INVALID, "Unterminated block comment", start_line, start_column);
+                }
+                continue;
+            }
+            break;
+        }
+        return std::nullopt;
+    }
+
+    Token Lexer::scan_token()
+    {
+        int start_line = line_;
+        int start_column = column_;
+        size_t start_pos = current_;
+
+        char c = advance();
+
+        switch (c)
+        {
+        case '(':
+            return Token(TokenType::LEFT_PAREN, "(", start_line, start_column);
+        case ')':
+            return Token(TokenType::RIGHT_PAREN, ")", start_line, start_column);
+        case ',':
+            return Token(TokenType::COMMA, ",", start_line, start_column);
+        case ';':
+            return Token(TokenType::SEMICOLON, ";", start_line, start_column);
+        case '.':
+            return Token(TokenType::DOT, ".", start_line, start_column);
+        case '+':
+            return Token(TokenType::PLUS, "+", start_line, start_column);
+        case '-':
+            return Token(TokenType::MINUS, "-", start_line, start_column);
+        case '*':
+            return Token(TokenType::ASTERISK, "*", start_line, start_column);
+        case '/':
+            return Token(TokenType::SLASH, "/", start_line, start_column);
+        case '=':
+            return Token(TokenType::EQUALS, "=", start_line, start_column);
+
+        // Checking two character operators
+        case '!':
+            if (match('='))
+            {
+                return Token(TokenType::NOT_EQUALS, "!=", start_line, start_column);
+            }
+            // Just ! alone is invalid
+            return make_error_token("Unexpected character", c, start_line, start_column);
+
+        case '<':
+            if (match('='))
+            {
+                return Token(TokenType::LESS_EQUAL, "<=", start_line, start_column);
+            }
+            if (match('>'))
+            {
+                return Token(TokenType::NOT_EQUALS, "<>", start_line, start_column);
+            }
+            return Token(TokenType::LESS_THAN, "<", start_line, start_column);
+
+        case '>':
+            if (match('='))
+            {
+                return Token(TokenType::GREATER_EQUAL, ">=", start_line, start_column);
+            }
+            return Token(TokenType::GREATER_THAN, ">", start_line, start_column);
+        case '`':
+            return scan_backtick_identifier(start_line, start_column);
+
+        case '\'':
+        case '"':
+            return scan_string(c, start_line, start_column);
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)))
+        {
+            return scan_number(start_pos, start_line, start_column);
+        }
+
+        // Indentifiers and keyword
+        if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+        {
+            return scan_identifier(start_pos, start_line, start_column);
+        }
+
+        // Unknown character
+        return make_error_token("Unexpected character", c, start_line, start_column);
+    }
+
+    Token Lexer::scan_string(char quote, int start_line, int start_column)
+    {
+        std::string value;
+        while (!is_at_end() && peek() != quote)
+        {
+            if (peek() == '\\')
+            {
+                advance();
+                if (!is_at_end())
+                {
+                    char escaped = advance();
+                    switch (escaped)
+                    {
+                    case 'n':
+                        value += '\n';
+                        break;
+                    case 't':
+                        value += '\t';
+                        break;
+                    case 'r':
+                        value += '\r';
+                        break;
+                    case '\\':
+                        value += '\\';
+                        break;
+                    case '\'':
+                        value += '\'';
+                        break;
+                    case '"':
+                        value += '"';
+                        break;
+                    default:
+                        value += escaped;
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                value += advance();
+            }
+        }
+
+        if (is_at_end())
+        {
+            return Token(TokenType::INVALID, "Unterminated string", start_line, start_column);
+        };
+        advance();
+
+        Token token(TokenType::STRING_LITERAL, value, start_line, start_column);
+        token.value = value;
+        return token;
+    }
+
+    Token Lexer::scan_number(size_t start_pos, int start_line, int start_column)
+    {
+        current_ = start_pos;
+        column_ = start_column;
+
+        if (peek() == '0' && (peek_next() == 'x' || peek_next() == 'X'))
+        {
+            advance();
+            advance();
+
+            size_t hex_start = current_;
+
+            while (!is_at_end() && std::isxdigit(static_cast<unsigned char>(peek())))
+            {
+                advance();
+            }
+
+            if (current_ == hex_start)
+            {
+                return Token(TokenType::INVALID, "Invalid hex number", start_line, start_column);
+            }
+
+            // from_chars rather than stoll: no exceptions, and no locale
+            int64_t value = 0;
+            auto [end, ec] = std::from_chars(source_.data() + hex_start, source_.data() + current_, value, 16);
+            if (ec != std::errc() || end != source_.data() + current_)
+            {
+                return Token(TokenType::INVALID, "Hex number out of range", start_line, start_column);
+            }
+
+            Token token(TokenType::INTEGER_LITERAL, source_.substr(start_pos, current_ - start_pos), start_line, start_column);
+            token.value = value;
+            return token;
+        };
+
+        bool is_float = false;
+
+        while (!is_at_end() && std::isdigit(static_cast<unsigned char>(peek())))
+        {
+            advance();
+        }
+        if (!is_at_end() && peek() == '.' && std::isdigit(static_cast<unsigned char>(peek_next())))
+        {
+            is_float = true;
+            advance();
+            while (!is_at_end() && std::isdigit(static_cast<unsigned char>(peek())))
+            {
+                advance();
+            };
+        };
+        std::string text = source_.substr(start_pos, current_ - start_pos);
+        if (is_float)
+        {
+            double value = std::strtod(text.c_str(), nullptr); // string to double
+            if (std::isinf(value))
+            {
+                return Token(TokenType::INVALID, "Number out of range", start_line, start_column);
+            }
+            Token token(TokenType::FLOAT_LITERAL, text, start_line, start_column);
+            token.value = value;
+            return token;
+        }
+        else
+        {
+            int64_t value = 0;
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (ec != std::errc() || end != text.data() + text.size())
+            {
+                return Token(TokenType::INVALID, "Integer out of range", start_line, start_column);
+            }
+            Token token(TokenType::INTEGER_LITERAL, text, start_line, start_column);
+            token.value = value;
+            return token;
+        }
+    }
+
+    Token Lexer::scan_backtick_identifier(int start_line, int start_column)
+    {
+        std::string value;
+
+        while (!is_at_end() && peek() != '`')
+        {
+            if (peek() == '\n')
+            {
+                return Token(TokenType::INVALID, "Newline in backtick identifier", start_line, start_column);
+            };
+            value += advance();
+        }
+
+        if (is_at_end())
+        {
+            return Token(TokenType::INVALID, "Unterminated backtick identifier", start_line, start_column);
+        }
+        advance();
+        if (value.empty())
+        {
+            return Token(TokenType::INVALID, "Empty backtick identifier", start_line, start_column);
+        }
+        return Token(TokenType::IDENTIFIER, value, start_line, start_column);
+    }
+
+    Token Lexer::scan_identifier(size_t start_pos, int start_line, int start_column)
+    {
+        current_ = start_pos;
+        column_ = start_column;
+
+        // checks if its alphanumeric or underscore
+        while (!is_at_end() && (std::isalnum(static_cast<unsigned char>(peek())) || peek() == '_'))
+        {
+            advance();
+        };
+
+        std::string text = source_.substr(start_pos, current_ - start_pos);
+
+        // converts text to uppercase
+        std::string upper = text;
+        for (char &c : upper)
+        {
+            c = std::toupper(static_cast<unsigned char>(c));
+        };
+
+        auto it = keywords_.find(upper);
+        if (it != keywords_.end())
+        {
+            return Token(it->second, text, start_line, start_column);
+        }
+        return Token(TokenType::IDENTIFIER, text, start_line, start_column);
+    }
+};
@@ -0,0 +1,69 @@
+/**
+ *  ReponoDB: Row lineage index (BLAME / HISTORY)
+ */
+
+#include "lineage.h"
+#include "lsm.h"
+#include "trace.h"
+
+namespace repono
+{
+    std::string change_type_to_string(RowDiff::Type type)
+    {
+        switch (type)
+        {
+        case RowDiff::Type::ADDED:
+            return "ADDED";
+        case RowDiff::Type::DELETED:
+            return "DELETED";
+        case RowDiff::Type::MODIFIED:
+            return "MODIFIED";
+        default:
+            return "UNKNOWN";
+        }
+    }
+
+    const TableManifest *LineageIndex::find_manifest(const CommitRecord *record, const std::string &table)
+    {
+        if (record == nullptr)
+            return nullptr;
+        auto it = record->tables.find(table);
+        return it != record->tables.end() ? &it->second : nullptr;
+    }
+
+    const std::vector<uint64_t> &LineageIndex::key_summary(const std::string &chunk_hash, const std::vector<size_t> &key_columns)
+    {
+        std::string cache_key = chunk_hash;
+        for (size_t idx : key_columns)
+            cache_key += ":" + std::to_string(idx);
+        auto it = key_summaries_.find(cache_key);
+        if (it != key_summaries_.end())
+            return it->second;
+
+        std::vector<uint64_t> summary;
+        if (auto stored = repo_.get_key_summary(chunk_hash, key_columns))
+            summary = std::move(*stored);
+        else if (ChunkPtr chunk = decode_chunk(chunk_hash))
+            summary = summarize_keys(chunk->rows, key_columns);
+        memory_.reserve(cache_key.capacity() + summary.capacity() * sizeof(uint64_t));
+        return key_summaries_[cache_key] = std::move(summary);
+    }
+
+    std::optional<Row> LineageIndex::lookup_row(const TableManifest *manifest, const std::vector<size_t> &key_columns,
+                                                const std::string &key, uint64_t key_hash)
+    {
+        if (manifest == nullptr)
+            return std::nullopt;
+        if (manifest->storage != TableStorage::LSM)
+            return find_row(manifest->chunk_hashes, key_columns, key, key_hash);
+
+        ByteReader r(key);
+        Row key_values;
+        for (size_t i = 0; i < key_columns.size() && r.ok(); i++)
+            key_values.push_back(r.get_value());
+        std::optional<Row> row;
+        if (!r.ok() || !lsm_lookup(repo_, *manifest, key_values, row).empty())
+            return std::nullopt;
+        return row;
+    }
+};
@@ -0,0 +1,241 @@
+/**
+ *  ReponoDB: Row lineage index (BLAME / HISTORY)
+ */
+
+#ifndef REPONO_LINEAGE_H
+#define REPONO_LINEAGE_H
+
+#include "executor.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * LINEAGE
+     *
+     * Answers "which commits changed this row?" without diffing snapshots.
+     * Walking first parents back from a commit, any commit whose table has
+     * the same chunk list as its parent is skipped outright. Otherwise only
+     * the chunks that differ are looked at, and of those only the ones whose
+     * key summary says they may hold the row are decoded. Summaries are
+     * written next to each chunk when it is committed; chunks without one
+     * (fetched, or stored by Repository::commit) are decoded once to build
+     * it. Summaries and per-commit chunk deltas are immutable (keyed by
+     * hash), so they are cached and reused by later queries.
+     */
+    struct RowVersion
+    {
+        std::string commit_hash;
+        int64_t timestamp = 0;
+        std::string message;
+        RowDiff::Type change = RowDiff::Type::MODIFIED;
+        Row row; // the row after the change, or the removed row for DELETED
+    };
+
+    std::string change_type_to_string(RowDiff::Type type);
+
+    struct LineageStats
+    {
+        size_t commits_walked = 0;
+        size_t commits_skipped = 0; // table unchanged from parent
+        size_t chunks_decoded = 0; // each chunk counted once per query
+    };
+
+    class LineageIndex
+    {
+    public:
+        explicit LineageIndex(const Repository &repo) : repo_(repo) {}
+
+        /**
+         * Find the commits that changed a row, newest first
+         *
+         * @param start Commit to walk back from
+         * @param table Table name
+         * @param key_columns Primary key column indices (a table without a key has no row lineage)
+         * @param key Encoded primary key
+         * @param limit Stop after this many versions (0 = all)
+         */
+        std::vector<RowVersion> row_history(const std::string &start,
+                                            const std::string &table,
+                                            const std::vector<size_t> &key_columns,
+                                            const std::string &key,
+                                            size_t limit = 0)
+        {
+            stats_ = LineageStats{};
+            decoded_.clear();
+            std::vector<RowVersion> versions;
+            if (key_columns.empty())
+                return versions;
+            uint64_t key_hash = fnv1a(key);
+
+            std::string current = start;
+            while (!current.empty())
+            {
+                const CommitRecord *record = repo_.get_record(current);
+                if (record == nullptr)
+                    break;
+                stats_.commits_walked++;
+
+                const TableManifest *now = find_manifest(record, table);
+                const TableManifest *before = find_manifest(repo_.get_record(record->parent_hash), table);
+
+                if ((now == nullptr && before == nullptr) ||
+                    (now != nullptr && before != nullptr && now->chunk_hashes == before->chunk_hashes))
+                {
+                    stats_.commits_skipped++;
+                    current = record->parent_hash;
+                    continue;
+                }
+
+                std::optional<Row> new_row, old_row;
+                if ((now != nullptr && now->storage == TableStorage::LSM) ||
+                    (before != nullptr && before->storage == TableStorage::LSM))
+                {
+                    // Runs overlap, so a chunk delta says nothing: look the
+                    // key up on both sides
+                    new_row = lookup_row(now, key_columns, key, key_hash);
+                    old_row = lookup_row(before, key_columns, key, key_hash);
+                }
+                else
+                {
+                    const ChunkDelta &delta = chunk_delta(record->hash, table, now, before);
+                    new_row = find_row(delta.added, key_columns, key, key_hash);
+                    old_row = find_row(delta.removed, key_columns, key, key_hash);
+                }
+
+                // Keys are unique within a commit, so a row that only moved
+                // between chunks shows up in both lists with equal values
+                std::optional<RowDiff::Type> change;
+                if (new_row.has_value() && old_row.has_value())
+                {
+                    if (*new_row != *old_row)
+                        change = RowDiff::Type::MODIFIED;
+                }
+                else if (new_row.has_value())
+                {
+                    change = RowDiff::Type::ADDED;
+                }
+                else if (old_row.has_value())
+                {
+                    change = RowDiff::Type::DELETED;
+                }
+
+                if (change.has_value())
+                {
+                    RowVersion version;
+                    version.commit_hash = record->hash;
+                    version.timestamp = record->timestamp;
+                    version.message = record->message;
+                    version.change = *change;
+                    version.row = new_row.has_value() ? std::move(*new_row) : std::move(*old_row);
+                    versions.push_back(std::move(version));
+                    if (limit > 0 && versions.size() >= limit)
+                        break;
+                }
+                current = record->parent_hash;
+            }
+            return versions;
+        }
+
+        const LineageStats &last_stats() const { return stats_; }
+
+    private:
+        struct ChunkDelta
+        {
+            std::vector<std::string> added;   // chunks in the commit but not its parent
+            std::vector<std::string> removed; // chunks in the parent but not the commit
+        };
+
+        const Repository &repo_;
+        std::unordered_map<std::string, ChunkDelta> deltas_;                   // commit + table -> delta
+        std::unordered_map<std::string, std::vector<uint64_t>> key_summaries_; // chunk + key columns -> sorted key hashes
+        LineageStats stats_;
+        std::unordered_set<std::string> decoded_; // chunks decoded by the current query
+        MemoryTracker memory_{"lineage", 0, {&memory_pools().index}};
+
+        static const TableManifest *find_manifest(const CommitRecord *record, const std::string &table);
+
+        const ChunkDelta &chunk_delta(const std::string &commit_hash, const std::string &table,
+                                      const TableManifest *now, const TableManifest *before)
+        {
+            std::string cache_key = commit_hash + '\0' + table;
+            auto it = deltas_.find(cache_key);
+            if (it != deltas_.end())
+                return it->second;
+
+            ChunkDelta delta;
+            std::unordered_set<std::string> old_chunks, new_chunks;
+            if (before != nullptr)
+                old_chunks.insert(before->chunk_hashes.begin(), before->chunk_hashes.end());
+            if (now != nullptr)
+            {
+                new_chunks.insert(now->chunk_hashes.begin(), now->chunk_hashes.end());
+                for (const auto &h : now->chunk_hashes)
+                {
+                    if (!old_chunks.count(h))
+                        delta.added.push_back(h);
+                }
+            }
+            if (before != nullptr)
+            {
+                for (const auto &h : before->chunk_hashes)
+                {
+                    if (!new_chunks.count(h))
+                        delta.removed.push_back(h);
+                }
+            }
+            memory_.reserve(cache_key.capacity() + (delta.added.size() + delta.removed.size()) * (sizeof(std::string) + 65));
+            return deltas_[cache_key] = std::move(delta);
+        }
+
+        /**
+         * Load a chunk's rows, counting it in chunks_decoded the first time in a query
+         */
+        ChunkPtr decode_chunk(const std::string &chunk_hash)
+        {
+            if (decoded_.insert(chunk_hash).second)
+                stats_.chunks_decoded++;
+            return repo_.get_chunk(chunk_hash);
+        }
+
+        const std::vector<uint64_t> &key_summary(const std::string &chunk_hash, const std::vector<size_t> &key_columns);
+
+        /**
+         * A table's row with a key at one commit (by point lookup in an LSM table)
+         */
+        std::optional<Row> lookup_row(const TableManifest *manifest, const std::vector<size_t> &key_columns,
+                                      const std::string &key, uint64_t key_hash);
+
+        std::optional<Row> find_row(const std::vector<std::string> &chunk_hashes,
+                                    const std::vector<size_t> &key_columns,
+                                    const std::string &key,
+                                    uint64_t key_hash)
+        {
+            size_t last = *std::max_element(key_columns.begin(), key_columns.end());
+            for (const auto &chunk_hash : chunk_hashes)
+            {
+                const auto &summary = key_summary(chunk_hash, key_columns);
+                if (!std::binary_search(summary.begin(), summary.end(), key_hash))
+                    continue;
+                ChunkPtr chunk = decode_chunk(chunk_hash);
+                if (chunk == nullptr)
+                    continue;
+                for (const auto &row : chunk->rows)
+                {
+                    if (row.size() > last && encode_key(row, key_columns) == key)
+                        return row;
+                }
+            }
+            return std::nullopt;
+        }
+    };
+};
+
+#endif // REPONO_LINEAGE_H
@@ -0,0 +1,566 @@
+/**
+ *  ReponoDB: Sorted-run (LSM) storage for write-heavy tables
+ */
+
+#include "lsm.h"
+#include "executor.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <algorithm>
+
+namespace repono
+{
+    int compare_keys(const Row &a, const Row &b)
+    {
+        size_t n = std::min(a.size(), b.size());
+        for (size_t i = 0; i < n; i++)
+        {
+            if (value_less_than(a[i], b[i]))
+                return -1;
+            if (value_less_than(b[i], a[i]))
+                return 1;
+        }
+        return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+    }
+
+    std::string encode_key_values(const Row &key)
+    {
+        ByteWriter w;
+        for (const auto &value : key)
+            w.put_value(value);
+        return w.take();
+    }
+
+    namespace
+    {
+        uint64_t mix64(uint64_t x)
+        {
+            x ^= x >> 33;
+            x *= 0xff51afd7ed558ccdULL;
+            x ^= x >> 33;
+            x *= 0xc4ceb9fe1a85ec53ULL;
+            x ^= x >> 33;
+            return x;
+        }
+
+        /**
+         * Visit the kBloomHashes bit positions of a key (double hashing)
+         */
+        template <typename Visit>
+        void bloom_bits(const std::string &key, size_t num_bits, Visit visit)
+        {
+            uint64_t h1 = fnv1a(key);
+            uint64_t h2 = mix64(h1) | 1;
+            for (size_t i = 0; i < kBloomHashes; i++)
+                visit((h1 + i * h2) % num_bits);
+        }
+
+        Row key_of(const Row &row, const std::vector<size_t> &key_columns)
+        {
+            Row key;
+            key.reserve(key_columns.size());
+            for (size_t idx : key_columns)
+                key.push_back(row[idx]);
+            return key;
+        }
+
+        /**
+         * The level a run of this many rows and tombstones belongs on
+         */
+        uint32_t size_level(size_t entries)
+        {
+            uint32_t level = 0;
+            for (size_t limit = kLsmLevelRows; entries > limit && level < kLsmMaxLevel; limit *= kLsmRunsPerLevel)
+                level++;
+            return level;
+        }
+
+        /**
+         * Chunks of a stored table, read on first use and kept for as long
+         * as the returned ChunkRows lives
+         */
+        ChunkRows stored_chunks(const Repository &repo, const std::vector<std::string> &chunk_hashes, size_t first,
+                                std::string &error)
+        {
+            auto held = std::make_shared<std::vector<ChunkPtr>>(chunk_hashes.size() - first);
+            return [&repo, &chunk_hashes, first, held, &error](size_t i) -> const std::vector<Row> *
+            {
+                ChunkPtr &chunk = (*held)[i];
+                if (chunk == nullptr)
+                    chunk = repo.get_chunk(chunk_hashes[first + i]);
+                if (chunk == nullptr)
+                {
+                    if (error.empty())
+                        error = "Missing chunk " + chunk_hashes[first + i].substr(0, 8);
+                    return nullptr;
+                }
+                return &chunk->rows;
+            };
+        }
+
+        /**
+         * Store sorted rows and tombstones as one run
+         *
+         * @param chunk_hashes The run's chunks are appended here
+         */
+        SortedRun write_run(Repository &repo, const std::vector<size_t> &key_columns, uint32_t level,
+                            std::vector<Row> rows, std::vector<Row> tombstones,
+                            std::vector<std::string> &chunk_hashes, uint64_t &new_bytes)
+        {
+            SortedRun run;
+            run.level = level;
+            for (auto &chunk : cut_run(key_columns, std::move(rows), std::move(tombstones), run))
+                chunk_hashes.push_back(repo.put_chunk(std::move(chunk), &new_bytes));
+            return run;
+        }
+
+        /**
+         * Cut rows into chunks as split_into_chunks would, moving them
+         */
+        std::vector<std::vector<Row>> split_moving(std::vector<Row> rows)
+        {
+            std::vector<std::vector<Row>> chunks;
+            ChunkSplitter splitter;
+            for (Row &row : rows)
+            {
+                if (splitter.add(std::move(row)))
+                    chunks.push_back(splitter.take());
+            }
+            if (!splitter.at_boundary())
+                chunks.push_back(splitter.take());
+            return chunks;
+        }
+
+        /**
+         * Find a key among some sorted chunks of a run
+         *
+         * @param fences The first key of each chunk
+         * @param first Chunk number of the first of them
+         */
+        const Row *find_in_chunks(const Row &key, const std::vector<size_t> &key_columns, bool tombstones,
+                                  std::vector<Row>::const_iterator fences_begin, std::vector<Row>::const_iterator fences_end,
+                                  size_t first, const ChunkRows &chunks, size_t &chunk)
+        {
+            auto fence = std::upper_bound(fences_begin, fences_end, key,
+                                          [](const Row &k, const Row &f)
+                                          { return compare_keys(k, f) < 0; });
+            if (fence == fences_begin)
+                return nullptr;
+            chunk = first + static_cast<size_t>(fence - fences_begin) - 1;
+            const std::vector<Row> *rows = chunks(chunk);
+            if (rows == nullptr)
+                return nullptr;
+            auto row_key = [&](const Row &row)
+            {
+                return tombstones ? row : key_of(row, key_columns);
+            };
+            auto it = std::lower_bound(rows->begin(), rows->end(), key,
+                                       [&](const Row &row, const Row &k)
+                                       { return compare_keys(row_key(row), k) < 0; });
+            if (it != rows->end() && compare_keys(row_key(*it), key) == 0)
+                return &*it;
+            return nullptr;
+        }
+    }
+
+    std::string build_bloom(const std::vector<std::string> &keys)
+    {
+        size_t num_bits = std::max<size_t>(64, keys.size() * kBloomBitsPerKey);
+        std::string bloom((num_bits + 7) / 8, '\0');
+        num_bits = bloom.size() * 8;
+        for (const auto &key : keys)
+        {
+            bloom_bits(key, num_bits, [&bloom](size_t bit)
+                       { bloom[bit / 8] = static_cast<char>(bloom[bit / 8] | (1 << (bit % 8))); });
+        }
+        return bloom;
+    }
+
+    bool bloom_may_contain(const std::string &bloom, const std::string &key)
+    {
+        if (bloom.empty())
+            return true;
+        bool found = true;
+        bloom_bits(key, bloom.size() * 8, [&](size_t bit)
+                   { found = found && (bloom[bit / 8] & (1 << (bit % 8))) != 0; });
+        return found;
+    }
+
+    std::vector<std::vector<Row>> cut_run(const std::vector<size_t> &key_columns, std::vector<Row> rows,
+                                          std::vector<Row> tombstones, SortedRun &run)
+    {
+        run.rows = rows.size();
+        run.tombstones = tombstones.size();
+        std::vector<std::string> keys;
+        keys.reserve(rows.size() + tombstones.size());
+        for (const Row &row : rows)
+            keys.push_back(encode_key(row, key_columns));
+        for (const Row &key : tombstones)
+            keys.push_back(encode_key_values(key));
+
+        std::vector<Row> index;
+        std::vector<std::vector<Row>> chunks = split_moving(std::move(rows));
+        run.row_chunks = chunks.size();
+        for (const auto &chunk : chunks)
+            index.push_back(key_of(chunk.front(), key_columns));
+        for (auto &chunk : split_moving(std::move(tombstones)))
+        {
+            index.push_back(chunk.front());
+            chunks.push_back(std::move(chunk));
+        }
+        run.tombstone_chunks = chunks.size() - run.row_chunks;
+        index.push_back(Row{Value(build_bloom(keys))});
+        chunks.push_back(std::move(index));
+        return chunks;
+    }
+
+    const std::vector<Row> *run_index(const SortedRun &run, size_t first, const ChunkRows &chunks)
+    {
+        const std::vector<Row> *index = chunks(first + run.row_chunks + run.tombstone_chunks);
+        if (index == nullptr || index->size() != run.row_chunks + run.tombstone_chunks + 1 ||
+            index->back().size() != 1 || !std::holds_alternative<std::string>(index->back()[0]))
+            return nullptr;
+        return index;
+    }
+
+    std::vector<bool> chunks_in_range(const std::vector<SortedRun> &runs, const KeyRange &range,
+                                      const ChunkRows &chunks)
+    {
+        size_t total = 0;
+        for (const SortedRun &run : runs)
+            total += run.chunks();
+        std::vector<bool> wanted(total, true);
+        if (!range.bounded())
+            return wanted;
+
+        // A chunk holds keys from its fence up to the next chunk's fence
+        size_t first = 0;
+        for (const SortedRun &run : runs)
+        {
+            if (const std::vector<Row> *fences = run_index(run, first, chunks))
+            {
+                for (auto [begin, end] : {std::make_pair(size_t{0}, run.row_chunks),
+                                          std::make_pair(run.row_chunks, run.row_chunks + run.tombstone_chunks)})
+                {
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        const Row &fence = (*fences)[i];
+                        bool past = range.high.has_value() && !fence.empty() && value_less_than(*range.high, fence[0]);
+                        bool short_of = range.low.has_value() && i + 1 < end && !(*fences)[i + 1].empty() &&
+                                        value_less_than((*fences)[i + 1][0], *range.low);
+                        wanted[first + i] = !past && !short_of;
+                    }
+                }
+            }
+            first += run.chunks();
+        }
+        return wanted;
+    }
+
+    RunMerger::RunMerger(const std::vector<SortedRun> &runs, const std::vector<size_t> &key_columns, ChunkRows chunks)
+        : key_columns_(key_columns), chunks_(std::move(chunks))
+    {
+        size_t chunk = 0;
+        cursors_.reserve(runs.size() * 2);
+        for (const SortedRun &run : runs)
+        {
+            Cursor rows;
+            rows.chunk = chunk;
+            rows.end = chunk + run.row_chunks;
+            Cursor tombstones;
+            tombstones.chunk = rows.end;
+            tombstones.end = rows.end + run.tombstone_chunks;
+            tombstones.tombstones = true;
+            chunk = tombstones.end + 1; // past the index chunk
+            cursors_.push_back(std::move(rows));
+            cursors_.push_back(std::move(tombstones));
+        }
+        for (Cursor &cursor : cursors_)
+            settle(cursor);
+    }
+
+    void RunMerger::settle(Cursor &cursor)
+    {
+        while (cursor.chunk < cursor.end)
+        {
+            if (cursor.rows == nullptr)
+                cursor.rows = chunks_(cursor.chunk);
+            if (cursor.rows != nullptr && cursor.offset < cursor.rows->size())
+            {
+                cursor.entry = &(*cursor.rows)[cursor.offset];
+                return;
+            }
+            cursor.chunk++;
+            cursor.offset = 0;
+            cursor.rows = nullptr;
+        }
+        cursor.done = true;
+    }
+
+    int RunMerger::compare(const Cursor &a, const Cursor &b) const
+    {
+        for (size_t i = 0; i < key_columns_.size(); i++)
+        {
+            const Value &x = key_value(a, i);
+            const Value &y = key_value(b, i);
+            if (value_less_than(x, y))
+                return -1;
+            if (value_less_than(y, x))
+                return 1;
+        }
+        return 0;
+    }
+
+    int RunMerger::compare_key(const Row &key) const
+    {
+        for (size_t i = 0; i < key_columns_.size(); i++)
+        {
+            const Value &x = key_value(current_, i);
+            if (value_less_than(x, key[i]))
+                return -1;
+            if (value_less_than(key[i], x))
+                return 1;
+        }
+        return 0;
+    }
+
+    bool RunMerger::next(bool keep_tombstones)
+    {
+        while (true)
+        {
+            // The first cursor with the smallest key is the newest version
+            const Cursor *newest = nullptr;
+            for (const Cursor &cursor : cursors_)
+            {
+                if (!cursor.done && (newest == nullptr || compare(cursor, *newest) < 0))
+                    newest = &cursor;
+            }
+            if (newest == nullptr)
+                return false;
+            current_ = *newest;
+
+            // Older versions of the key are shadowed
+            for (Cursor &cursor : cursors_)
+            {
+                if (!cursor.done && compare(cursor, current_) == 0)
+                {
+                    cursor.offset++;
+                    settle(cursor);
+                }
+            }
+            if (!current_.tombstones || keep_tombstones)
+                return true;
+        }
+    }
+
+    const Row *lookup_runs(const std::vector<SortedRun> &runs, const std::vector<size_t> &key_columns,
+                           const Row &key, const ChunkRows &chunks, size_t *chunk)
+    {
+        std::string encoded = encode_key_values(key);
+        size_t first = 0;
+        for (const SortedRun &run : runs)
+        {
+            const std::vector<Row> *index = run_index(run, first, chunks);
+            if (index != nullptr && !bloom_may_contain(std::get<std::string>(index->back()[0]), encoded))
+            {
+                engine_metrics().lsm_bloom_skips.add();
+            }
+            else if (index != nullptr)
+            {
+                size_t found = 0;
+                auto tombstone_fences = index->begin() + static_cast<std::ptrdiff_t>(run.row_chunks);
+                if (const Row *row = find_in_chunks(key, key_columns, false, index->begin(), tombstone_fences,
+                                                    first, chunks, found))
+                {
+                    if (chunk != nullptr)
+                        *chunk = found;
+                    return row;
+                }
+                if (find_in_chunks(key, key_columns, true, tombstone_fences, index->end() - 1,
+                                   first + run.row_chunks, chunks, found) != nullptr)
+                    return nullptr;
+            }
+            first += run.chunks();
+        }
+        return nullptr;
+    }
+
+    void lsm_flush(Repository &repo, TableManifest &manifest, const std::vector<size_t> &key_columns,
+                   std::vector<Row> rows, std::vector<Row> tombstones, uint64_t &new_bytes)
+    {
+        REPONO_TRACE_SPAN("lsm_flush");
+        manifest.storage = TableStorage::LSM;
+        if (!rows.empty() || !tombstones.empty())
+        {
+            // A big flush (e.g. a bulk load) starts higher up, but never
+            // above an older run
+            uint32_t level = size_level(rows.size() + tombstones.size());
+            if (!manifest.runs.empty())
+                level = std::min(level, manifest.runs.front().level);
+            std::vector<std::string> chunk_hashes;
+            manifest.runs.insert(manifest.runs.begin(),
+                                 write_run(repo, key_columns, level, std::move(rows), std::move(tombstones), chunk_hashes, new_bytes));
+            manifest.chunk_hashes.insert(manifest.chunk_hashes.begin(), chunk_hashes.begin(), chunk_hashes.end());
+            engine_metrics().lsm_runs_flushed.add();
+        }
+
+        // Levels only grow towards older runs, so each level's runs are
+        // next to each other and merging them keeps the order. Every merge
+        // leaves fewer runs, so this ends however the levels are numbered.
+        size_t first = 0, first_chunk = 0;
+        while (first < manifest.runs.size())
+        {
+            uint32_t level = manifest.runs[first].level;
+            size_t end = first, end_chunk = first_chunk;
+            while (end < manifest.runs.size() && manifest.runs[end].level == level)
+            {
+                end_chunk += manifest.runs[end].chunks();
+                end++;
+            }
+            if (end - first < kLsmRunsPerLevel)
+            {
+                first = end;
+                first_chunk = end_chunk;
+                continue;
+            }
+
+            REPONO_TRACE_SPAN("lsm_compact");
+            bool bottom = end == manifest.runs.size(); // no older run for tombstones to hide
+            std::vector<SortedRun> level_runs(manifest.runs.begin() + first, manifest.runs.begin() + end);
+            std::string error;
+            RunMerger merger(level_runs, key_columns, stored_chunks(repo, manifest.chunk_hashes, first_chunk, error));
+            std::vector<Row> merged_rows, merged_tombstones;
+            while (merger.next(!bottom))
+            {
+                if (merger.row() != nullptr)
+                    merged_rows.push_back(*merger.row());
+                else
+                    merged_tombstones.push_back(merger.entry());
+            }
+
+            // At least one level up, and as far as its size says while
+            // staying below older runs
+            uint32_t merged_level = std::max(std::min(level + 1, kLsmMaxLevel),
+                                             size_level(merged_rows.size() + merged_tombstones.size()));
+            if (!bottom)
+                merged_level = std::min(merged_level, manifest.runs[end].level);
+            std::vector<std::string> chunk_hashes;
+            std::vector<SortedRun> output;
+            if (!merged_rows.empty() || !merged_tombstones.empty())
+                output.push_back(write_run(repo, key_columns, merged_level, std::move(merged_rows),
+                                           std::move(merged_tombstones), chunk_hashes, new_bytes));
+            manifest.runs.erase(manifest.runs.begin() + first, manifest.runs.begin() + end);
+            manifest.runs.insert(manifest.runs.begin() + first, output.begin(), output.end());
+            manifest.chunk_hashes.erase(manifest.chunk_hashes.begin() + first_chunk, manifest.chunk_hashes.begin() + end_chunk);
+            manifest.chunk_hashes.insert(manifest.chunk_hashes.begin() + first_chunk, chunk_hashes.begin(), chunk_hashes.end());
+            engine_metrics().lsm_compactions.add();
+            // The merged run is checked again on its own level
+        }
+    }
+
+    void lsm_store_runs(Repository &repo, TableManifest &manifest, std::vector<CommitRun> runs, uint64_t &new_bytes)
+    {
+        std::vector<size_t> key_columns = primary_key_columns(manifest.schema);
+        manifest.storage = TableStorage::LSM;
+        manifest.runs.clear();
+        manifest.chunk_hashes.clear();
+        for (CommitRun &run : runs)
+        {
+            manifest.runs.push_back(write_run(repo, key_columns, run.level, std::move(run.rows), std::move(run.tombstones),
+                                              manifest.chunk_hashes, new_bytes));
+        }
+    }
+
+    std::vector<std::string> hash_run(const Schema &schema, const CommitRun &run)
+    {
+        SortedRun counts;
+        std::vector<std::string> hashes;
+        for (const auto &chunk : cut_run(primary_key_columns(schema), run.rows, run.tombstones, counts))
+            hashes.push_back(compute_chunk_hash(chunk));
+        return hashes;
+    }
+
+    std::string read_lsm_runs(const Repository &repo, const TableManifest &manifest, std::vector<CommitRun> &runs)
+    {
+        size_t first = 0;
+        for (const SortedRun &run : manifest.runs)
+        {
+            CommitRun out;
+            out.level = run.level;
+            for (size_t i = 0; i < run.row_chunks + run.tombstone_chunks; i++)
+            {
+                const std::string &chunk_hash = manifest.chunk_hashes[first + i];
+                ChunkPtr chunk = repo.get_chunk(chunk_hash);
+                if (chunk == nullptr)
+                    return "Missing chunk " + chunk_hash.substr(0, 8);
+                std::vector<Row> &rows = i < run.row_chunks ? out.rows : out.tombstones;
+                rows.insert(rows.end(), chunk->rows.begin(), chunk->rows.end());
+            }
+            runs.push_back(std::move(out));
+            first += run.chunks();
+        }
+        return "";
+    }
+
+    std::string read_lsm_rows(const Repository &repo, const TableManifest &manifest, std::vector<Row> &rows)
+    {
+        REPONO_TRACE_SPAN("read_lsm_rows");
+        std::string error;
+        RunMerger merger(manifest.runs, primary_key_columns(manifest.schema),
+                         stored_chunks(repo, manifest.chunk_hashes, 0, error));
+        rows.reserve(rows.size() + manifest.row_count);
+        while (merger.next())
+            rows.push_back(*merger.row());
+        return error;
+    }
+
+    std::string read_lsm_range(const Repository &repo, const TableManifest &manifest, const KeyRange &range,
+                               std::vector<Row> &rows)
+    {
+        REPONO_TRACE_SPAN("read_lsm_range");
+        if (!range.bounded())
+            return read_lsm_rows(repo, manifest, rows);
+
+        std::string error;
+        ChunkRows stored = stored_chunks(repo, manifest.chunk_hashes, 0, error);
+        std::vector<bool> wanted = chunks_in_range(manifest.runs, range, stored);
+        static const std::vector<Row> skipped;
+        std::vector<size_t> key_columns = primary_key_columns(manifest.schema);
+        RunMerger merger(manifest.runs, key_columns,
+                         [&](size_t i)
+                         { return i < wanted.size() && !wanted[i] ? &skipped : stored(i); });
+        while (merger.next())
+        {
+            // Keys outside the range may be shadowed in a skipped chunk
+            if (range.contains((*merger.row())[key_columns[0]]))
+                rows.push_back(*merger.row());
+        }
+        return error;
+    }
+
+    std::string read_table_rows(const Repository &repo, const TableManifest &manifest, std::vector<Row> &rows)
+    {
+        if (manifest.storage == TableStorage::LSM)
+            return read_lsm_rows(repo, manifest, rows);
+        rows.reserve(rows.size() + manifest.row_count);
+        for (const auto &chunk_hash : manifest.chunk_hashes)
+        {
+            ChunkPtr chunk = repo.get_chunk(chunk_hash);
+            if (chunk == nullptr)
+                return "Missing chunk " + chunk_hash.substr(0, 8);
+            rows.insert(rows.end(), chunk->rows.begin(), chunk->rows.end());
+        }
+        return "";
+    }
+
+    std::string lsm_lookup(const Repository &repo, const TableManifest &manifest, const Row &key,
+                           std::optional<Row> &row)
+    {
+        std::string error;
+        ChunkRows chunks = stored_chunks(repo, manifest.chunk_hashes, 0, error);
+        const Row *found = lookup_runs(manifest.runs, primary_key_columns(manifest.schema), key, chunks);
+        row = found != nullptr ? std::optional<Row>(*found) : std::nullopt;
+        return error;
+    }
+};
@@ -0,0 +1,252 @@
+/**
+ *  ReponoDB: Sorted-run (LSM) storage for write-heavy tables
+ */
+
+#ifndef REPONO_LSM_H
+#define REPONO_LSM_H
+
+#include "storage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * LSM TABLES
+     *
+     * A table created with USING LSM is stored as immutable sorted runs
+     * instead of one chunk list in row order:
+     *
+     *  - writes collect in the session's delta, which is the memtable (see
+     *    WorkingRows), and COMMIT flushes it as a new level-0 run: its rows
+     *    and the keys it deleted (tombstones), each sorted by primary key
+     *    and cut into chunks, then an index chunk holding the first key of
+     *    every chunk (fences) and a bloom filter over all its keys
+     *  - reads merge the runs, newest first: the newest run holding a key
+     *    decides whether the row exists and which version it is. A scan
+     *    bounded on the leading key column only reads the chunks whose
+     *    fences overlap the bounds
+     *  - a point lookup skips the runs whose bloom filter rules the key out
+     *    and reads one chunk from each of the others, found by its fences
+     *  - compaction is size-tiered: a run's level follows its size (level 0
+     *    up to kLsmLevelRows rows and tombstones, each level above
+     *    kLsmRunsPerLevel times more). Once a level holds kLsmRunsPerLevel
+     *    runs they are merged into one run higher up, dropping tombstones
+     *    if no older run is left for them to hide. Levels never decrease
+     *    from newer runs to older ones, so a level's runs are adjacent
+     *
+     * A commit records each table's runs. The index is a chunk like any
+     * other, so a commit only writes the new run (and what compaction
+     * produced), and its hash, which covers each run's level and chunks,
+     * follows from the runs' rows (see Commit::table_runs).
+     */
+    constexpr size_t kLsmRunsPerLevel = 8;
+    constexpr size_t kLsmLevelRows = 1024;
+    constexpr uint32_t kLsmMaxLevel = 32;
+    constexpr size_t kBloomBitsPerKey = 10;
+    constexpr size_t kBloomHashes = 7;
+
+    /**
+     * The rows of chunk i of a manifest's chunk list (nullptr if it is missing)
+     */
+    using ChunkRows = std::function<const std::vector<Row> *(size_t chunk)>;
+
+    /**
+     * Order two primary keys (key values only, in key column order)
+     *
+     * @returns <0, 0 or >0
+     */
+    int compare_keys(const Row &a, const Row &b);
+
+    /**
+     * A key's bytes, as encode_key gives them for a row holding it
+     */
+    std::string encode_key_values(const Row &key);
+
+    /**
+     * Build a bloom filter over encoded keys
+     */
+    std::string build_bloom(const std::vector<std::string> &keys);
+
+    /**
+     * Whether a key may be in a bloom filter (false means it is not)
+     */
+    bool bloom_may_contain(const std::string &bloom, const std::string &key);
+
+    /**
+     * Cut a run's sorted rows and tombstones into its chunks: the rows, the
+     * tombstones, then the index chunk (each chunk's first key, and a
+     * bloom filter over every key as a last row of one value)
+     *
+     * @param run Its chunk and row counts are set (its level is left alone)
+     */
+    std::vector<std::vector<Row>> cut_run(const std::vector<size_t> &key_columns, std::vector<Row> rows,
+                                          std::vector<Row> tombstones, SortedRun &run);
+
+    /**
+     * A run's index chunk, checked against the run's chunk counts
+     *
+     * @param first Chunk number of the run's first chunk
+     * @returns The fences followed by the bloom filter row, or nullptr if
+     *          the chunk is missing or does not fit the run
+     */
+    const std::vector<Row> *run_index(const SortedRun &run, size_t first, const ChunkRows &chunks);
+
+    /**
+     * Which chunks of an LSM table may hold keys whose leading column is in
+     * a range, going by each run's fences (index chunks are not marked)
+     */
+    std::vector<bool> chunks_in_range(const std::vector<SortedRun> &runs, const KeyRange &range,
+                                      const ChunkRows &chunks);
+
+    /**
+     * Walks an LSM table's runs in key order, taking each key's version
+     * from the newest run that holds it
+     */
+    class RunMerger
+    {
+    public:
+        /**
+         * @param runs Newest first; chunk numbers count from the first run's first chunk
+         */
+        RunMerger(const std::vector<SortedRun> &runs, const std::vector<size_t> &key_columns, ChunkRows chunks);
+
+        /**
+         * Move to the next key, skipping deleted keys unless tombstones are kept
+         *
+         * @returns false once every run is used up
+         */
+        bool next(bool keep_tombstones = false);
+
+        /**
+         * Compare the current key with a key (<0 if the current one is smaller)
+         */
+        int compare_key(const Row &key) const;
+
+        /**
+         * The current row, or nullptr for a tombstone
+         */
+        const Row *row() const { return current_.tombstones ? nullptr : current_.entry; }
+
+        /**
+         * The current row or tombstone (the deleted key's values)
+         */
+        const Row &entry() const { return *current_.entry; }
+
+        /**
+         * Where the current row or tombstone is stored
+         */
+        size_t chunk() const { return current_.chunk; }
+        size_t offset() const { return current_.offset; }
+
+    private:
+        struct Cursor
+        {
+            size_t chunk = 0;
+            size_t end = 0;
+            size_t offset = 0;
+            bool tombstones = false;
+            const std::vector<Row> *rows = nullptr;
+            const Row *entry = nullptr;
+            bool done = false;
+        };
+
+        /**
+         * Point a cursor at its next entry, or mark it done
+         */
+        void settle(Cursor &cursor);
+
+        const Value &key_value(const Cursor &cursor, size_t i) const
+        {
+            return (*cursor.entry)[cursor.tombstones ? i : key_columns_[i]];
+        }
+
+        int compare(const Cursor &a, const Cursor &b) const;
+
+        std::vector<size_t> key_columns_;
+        ChunkRows chunks_;
+        std::vector<Cursor> cursors_; // newest run first; each run's rows, then its tombstones
+        Cursor current_;
+    };
+
+    /**
+     * Look a key up in the runs, newest first
+     *
+     * @param chunk Set to the chunk holding the row, if one is found
+     * @returns The row, or nullptr if no run has it or the newest that does deleted it
+     */
+    const Row *lookup_runs(const std::vector<SortedRun> &runs, const std::vector<size_t> &key_columns,
+                           const Row &key, const ChunkRows &chunks, size_t *chunk = nullptr);
+
+    /**
+     * Add a flushed memtable as the newest run of an LSM table, then compact
+     *
+     * @param manifest The table's runs and chunks, updated in place (row_count is left alone)
+     * @param rows Rows written since the last flush, sorted by key
+     * @param tombstones Keys deleted since the last flush, sorted
+     * @param new_bytes Increased by the encoded size of chunks that were new
+     */
+    void lsm_flush(Repository &repo, TableManifest &manifest, const std::vector<size_t> &key_columns,
+                   std::vector<Row> rows, std::vector<Row> tombstones, uint64_t &new_bytes);
+
+    /**
+     * Store runs as they are given (e.g. a Commit's), without compacting
+     *
+     * @param manifest Its runs and chunks are replaced; its schema gives the key
+     * @param runs Newest first
+     * @param new_bytes Increased by the encoded size of chunks that were new
+     */
+    void lsm_store_runs(Repository &repo, TableManifest &manifest, std::vector<CommitRun> runs, uint64_t &new_bytes);
+
+    /**
+     * The hashes of the chunks a run is stored as, without storing them
+     */
+    std::vector<std::string> hash_run(const Schema &schema, const CommitRun &run);
+
+    /**
+     * Read a stored LSM table's runs back as rows and tombstones
+     *
+     * @returns "" on success or an error naming a missing chunk
+     */
+    std::string read_lsm_runs(const Repository &repo, const TableManifest &manifest, std::vector<CommitRun> &runs);
+
+    /**
+     * Merge a stored LSM table's runs into its rows, in key order
+     *
+     * @returns "" on success or an error naming a missing chunk
+     */
+    std::string read_lsm_rows(const Repository &repo, const TableManifest &manifest, std::vector<Row> &rows);
+
+    /**
+     * Merge the rows of a stored LSM table whose leading key column is in a
+     * range, reading only the chunks whose fences overlap it
+     *
+     * @returns "" on success or an error naming a missing chunk
+     */
+    std::string read_lsm_range(const Repository &repo, const TableManifest &manifest, const KeyRange &range,
+                               std::vector<Row> &rows);
+
+    /**
+     * A stored table's rows, whichever way it is stored: an LSM table's
+     * runs merged in key order, or the chunks of any other
+     *
+     * @returns "" on success or an error naming a missing chunk
+     */
+    std::string read_table_rows(const Repository &repo, const TableManifest &manifest, std::vector<Row> &rows);
+
+    /**
+     * Look up one row of a stored LSM table by primary key
+     *
+     * @param row Set to the row, or std::nullopt if there is none
+     * @returns "" on success or an error naming a missing chunk
+     */
+    std::string lsm_lookup(const Repository &repo, const TableManifest &manifest, const Row &key,
+                           std::optional<Row> &row);
+};
+
+#endif // REPONO_LSM_H
@@ -0,0 +1,107 @@
+/**
+ *  ReponoDB: A Git-Versioned SQL Database
+ *  "Repono" is Latin for "to store"
+ *  Author: Neel Bansal
+ *
+ *  Command line entry point; the engine itself is librepono.
+ */
+
+#include "shell.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+    void usage()
+    {
+        std::cerr << "Usage: repono [options] [DIR]\n"
+                     "\n"
+                     "Runs SQL on the repository in DIR (in memory if none is given). Reads\n"
+                     "statements from stdin, interactively when it is a terminal.\n"
+                     "\n"
+                     "  -f, --file FILE   run a script (\"-\" for stdin) instead\n"
+                     "  -c SQL            run these statements instead\n"
+                     "  --timing          start with \\timing on\n"
+                     "  --bail            stop a script at its first error\n"
+                     "  -h, --help        show this help\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace repono;
+    std::ios::sync_with_stdio(false);
+
+    std::string dir;
+    std::string file;
+    std::string sql;
+    bool have_sql = false;
+    ShellOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if ((!std::strcmp(arg, "-f") || !std::strcmp(arg, "--file")) && i + 1 < argc)
+            file = argv[++i];
+        else if (!std::strcmp(arg, "-c") && i + 1 < argc)
+        {
+            sql = argv[++i];
+            have_sql = true;
+        }
+        else if (!std::strcmp(arg, "--timing"))
+            options.timing = true;
+        else if (!std::strcmp(arg, "--bail"))
+            options.bail = true;
+        else if (!std::strcmp(arg, "-h") || !std::strcmp(arg, "--help"))
+        {
+            usage();
+            return 0;
+        }
+        else if (arg[0] != '-' && dir.empty())
+            dir = arg;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    Repository repo;
+    if (!dir.empty())
+    {
+        std::string error = repo.open(dir);
+        if (!error.empty())
+        {
+            std::cerr << "repono: " << error << "\n";
+            return 1;
+        }
+    }
+    Session session(repo);
+    Shell shell(session, std::cout, options);
+
+    if (have_sql)
+    {
+        std::istringstream in(sql);
+        return shell.run_script(in) == 0 ? 0 : 1;
+    }
+    if (!file.empty() && file != "-")
+    {
+        std::ifstream in(file);
+        if (!in)
+        {
+            std::cerr << "repono: cannot open " << file << "\n";
+            return 1;
+        }
+        return shell.run_script(in) == 0 ? 0 : 1;
+    }
+    if (file.empty() && isatty(STDIN_FILENO))
+    {
+        shell.run_interactive(std::cin);
+        return 0;
+    }
+    return shell.run_script(std::cin) == 0 ? 0 : 1;
+}
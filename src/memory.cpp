@@ -0,0 +1,107 @@
+/**
+ *  ReponoDB: Memory and per-statement resource accounting
+ */
+
+#include "memory.h"
+#include "metrics.h"
+
+#include <cstdio>
+#include <variant>
+
+namespace repono
+{
+    std::string format_bytes(uint64_t bytes)
+    {
+        const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+        double value = static_cast<double>(bytes);
+        size_t unit = 0;
+        while (value >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0]))
+        {
+            value /= 1024;
+            unit++;
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+        return buf;
+    }
+
+    MemoryTracker::~MemoryTracker()
+    {
+        uint64_t held = used_.load(std::memory_order_relaxed);
+        for (MemoryTracker *parent : parents_)
+            parent->release(held);
+    }
+
+    std::string MemoryTracker::try_reserve(uint64_t bytes)
+    {
+        uint64_t used = used_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        uint64_t limit = limit_.load(std::memory_order_relaxed);
+        if (limit != 0 && used > limit)
+        {
+            used_.fetch_sub(bytes, std::memory_order_relaxed);
+            return "Memory limit exceeded: " + name_ + " needs " + format_bytes(used) +
+                   " but is limited to " + format_bytes(limit);
+        }
+        for (size_t i = 0; i < parents_.size(); i++)
+        {
+            std::string error = parents_[i]->try_reserve(bytes);
+            if (!error.empty())
+            {
+                for (size_t j = 0; j < i; j++)
+                    parents_[j]->release(bytes);
+                used_.fetch_sub(bytes, std::memory_order_relaxed);
+                return error;
+            }
+        }
+        raise_peak(used);
+        return "";
+    }
+
+    void MemoryTracker::reserve(uint64_t bytes)
+    {
+        raise_peak(used_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+        for (MemoryTracker *parent : parents_)
+            parent->reserve(bytes);
+    }
+
+    void MemoryTracker::release(uint64_t bytes)
+    {
+        used_.fetch_sub(bytes, std::memory_order_relaxed);
+        for (MemoryTracker *parent : parents_)
+            parent->release(bytes);
+    }
+
+    void MemoryTracker::raise_peak(uint64_t used)
+    {
+        uint64_t peak = peak_.load(std::memory_order_relaxed);
+        while (used > peak && !peak_.compare_exchange_weak(peak, used, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    MemoryPools &memory_pools()
+    {
+        static MemoryPools pools;
+        return pools;
+    }
+
+    void note_plan(std::string step)
+    {
+        if (QueryStats *stats = current_query_stats())
+            stats->plan.push_back(std::move(step));
+    }
+
+    size_t estimate_row_bytes(const Row &row)
+    {
+        size_t bytes = sizeof(Row) + row.capacity() * sizeof(Value);
+        for (const auto &v : row)
+        {
+            if (const auto *str = std::get_if<std::string>(&v))
+            {
+                if (str->size() >= sizeof(std::string)) // beyond the small-string buffer
+                    bytes += str->capacity() + 1;
+            }
+        }
+        return bytes;
+    }
+};
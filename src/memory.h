@@ -0,0 +1,235 @@
+/**
+ *  ReponoDB: Memory and per-statement resource accounting
+ */
+
+#ifndef REPONO_MEMORY_H
+#define REPONO_MEMORY_H
+
+#include "repono/value.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * MEMORY ACCOUNTING
+     *
+     * Memory is charged to trackers arranged as a small graph: a charge to a
+     * tracker is also charged to each of its parents, and fails cleanly if
+     * any of them would go over its limit. Caches charge unconditionally
+     * (they shrink by evicting instead); statements and working sets use
+     * try_reserve and turn a refusal into an error instead of running out
+     * of memory. Sizes are estimates of heap footprint, not allocator totals.
+     */
+    std::string format_bytes(uint64_t bytes);
+
+    class MemoryTracker
+    {
+    public:
+        /**
+         * @param name Shown in SHOW MEMORY and in limit errors
+         * @param limit Bytes this tracker may hold (0 = unlimited)
+         * @param parents Trackers that are charged along with this one
+         */
+        explicit MemoryTracker(std::string name, uint64_t limit = 0, std::vector<MemoryTracker *> parents = {})
+            : name_(std::move(name)), limit_(limit), parents_(std::move(parents)) {}
+
+        // Whatever is still held is given back to the parents
+        ~MemoryTracker();
+
+        MemoryTracker(const MemoryTracker &) = delete;
+        MemoryTracker &operator=(const MemoryTracker &) = delete;
+
+        /**
+         * Charge bytes if neither this tracker nor any parent goes over its limit
+         *
+         * @returns "" on success, or an error naming the tracker that refused
+         */
+        std::string try_reserve(uint64_t bytes);
+
+        /**
+         * Charge bytes regardless of limits (for memory already allocated)
+         */
+        void reserve(uint64_t bytes);
+
+        void release(uint64_t bytes);
+
+        const std::string &name() const { return name_; }
+        uint64_t used() const { return used_.load(std::memory_order_relaxed); }
+        uint64_t peak() const { return peak_.load(std::memory_order_relaxed); }
+        uint64_t limit() const { return limit_.load(std::memory_order_relaxed); }
+        void set_limit(uint64_t bytes) { limit_.store(bytes, std::memory_order_relaxed); }
+
+        /**
+         * Over its limit (only possible through reserve, e.g. a cache)
+         */
+        bool over_limit() const
+        {
+            uint64_t limit = limit_.load(std::memory_order_relaxed);
+            return limit != 0 && used() > limit;
+        }
+
+    private:
+        std::string name_;
+        std::atomic<uint64_t> used_{0};
+        std::atomic<uint64_t> peak_{0};
+        std::atomic<uint64_t> limit_;
+        std::vector<MemoryTracker *> parents_;
+
+        void raise_peak(uint64_t used);
+    };
+
+    /**
+     * Process-wide totals, one per kind of memory. Repositories and sessions
+     * hold their own trackers with these as parents.
+     */
+    struct MemoryPools
+    {
+        MemoryTracker total{"total"};
+        MemoryTracker commit_cache{"commit_cache", 0, {&total}}; // decoded commit records
+        MemoryTracker buffer_pool{"buffer_pool", 0, {&total}};   // decoded chunks
+        MemoryTracker working_set{"working_set", 0, {&total}};   // sessions' uncommitted tables
+        MemoryTracker query{"query", 0, {&total}};               // rows held by running statements
+        MemoryTracker index{"index", 0, {&total}};               // primary key sets and lineage summaries
+    };
+
+    MemoryPools &memory_pools();
+
+    /**
+     * QUERY ACCOUNTING
+     *
+     * Resources used by the statement running on the current thread.
+     * Session installs a QueryStats for each statement; storage and
+     * operators add to it when one is installed. The slow query log
+     * reports these numbers.
+     */
+    struct QueryStats
+    {
+        uint64_t rows_scanned = 0;
+        uint64_t bytes_decoded = 0; // objects read from disk and decoded
+        uint64_t memory_bytes = 0;  // rows materialized by the statement (estimate)
+        uint64_t memory_peak = 0;
+        std::vector<std::string> plan; // operators, in the order they ran
+        MemoryTracker *memory = nullptr; // enforces the statement's limits, if set
+
+        /**
+         * @returns "" or a memory limit error, in which case nothing was charged
+         */
+        std::string add_memory(uint64_t bytes)
+        {
+            if (memory != nullptr)
+            {
+                std::string error = memory->try_reserve(bytes);
+                if (!error.empty())
+                    return error;
+            }
+            memory_bytes += bytes;
+            memory_peak = std::max(memory_peak, memory_bytes);
+            return "";
+        }
+
+        void release_memory(uint64_t bytes)
+        {
+            bytes = std::min(memory_bytes, bytes);
+            memory_bytes -= bytes;
+            if (memory != nullptr)
+                memory->release(bytes);
+        }
+    };
+
+    /**
+     * The stats of the statement running on this thread, or nullptr
+     */
+    inline QueryStats *&current_query_stats()
+    {
+        thread_local QueryStats *stats = nullptr;
+        return stats;
+    }
+
+    /**
+     * Installs a QueryStats for the current thread for the lifetime of the scope
+     */
+    class QueryStatsScope
+    {
+    public:
+        explicit QueryStatsScope(QueryStats &stats) : previous_(current_query_stats())
+        {
+            current_query_stats() = &stats;
+        }
+        ~QueryStatsScope() { current_query_stats() = previous_; }
+
+        QueryStatsScope(const QueryStatsScope &) = delete;
+        QueryStatsScope &operator=(const QueryStatsScope &) = delete;
+
+    private:
+        QueryStats *previous_;
+    };
+
+    /**
+     * Record a step of the executed plan
+     */
+    void note_plan(std::string step);
+
+    /**
+     * Charges a statement's memory in batches, so per-row accounting does
+     * not touch the shared trackers for every row. What it charged is
+     * released when it goes out of scope.
+     */
+    class MemoryCharge
+    {
+    public:
+        MemoryCharge() : stats_(current_query_stats()) {}
+        ~MemoryCharge()
+        {
+            if (stats_ != nullptr)
+                stats_->release_memory(charged_);
+        }
+
+        MemoryCharge(const MemoryCharge &) = delete;
+        MemoryCharge &operator=(const MemoryCharge &) = delete;
+
+        /**
+         * @returns false once a limit has been hit (see error())
+         */
+        bool add(uint64_t bytes)
+        {
+            if (stats_ == nullptr)
+                return true;
+            pending_ += bytes;
+            return pending_ < kBatchBytes ? error_.empty() : flush();
+        }
+
+        bool flush()
+        {
+            if (stats_ != nullptr && pending_ > 0 && error_.empty())
+            {
+                error_ = stats_->add_memory(pending_);
+                if (error_.empty())
+                    charged_ += pending_;
+                pending_ = 0;
+            }
+            return error_.empty();
+        }
+
+        const std::string &error() const { return error_; }
+
+    private:
+        static constexpr uint64_t kBatchBytes = 64 * 1024;
+
+        QueryStats *stats_;
+        uint64_t pending_ = 0;
+        uint64_t charged_ = 0;
+        std::string error_;
+    };
+
+    /**
+     * Rough heap footprint of a row
+     */
+    size_t estimate_row_bytes(const Row &row);
+};
+
+#endif // REPONO_MEMORY_H
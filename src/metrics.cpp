@@ -0,0 +1,125 @@
+/**
+ *  ReponoDB: Process-wide counters and histograms
+ */
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace repono
+{
+    double HistogramSnapshot::percentile(double p) const
+    {
+        if (count == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(count)));
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+                return static_cast<double>(Histogram::bucket_upper_bound(i)) * scale;
+        }
+        return 0;
+    }
+
+    Counter &MetricsRegistry::counter(const std::string &name, const std::string &help, const std::string &labels)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry &entry = entry_for(name, help, labels);
+        if (!entry.counter)
+            entry.counter = std::make_unique<Counter>();
+        return *entry.counter;
+    }
+
+    Histogram &MetricsRegistry::histogram(const std::string &name, const std::string &help, double scale, const std::string &labels)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry &entry = entry_for(name, help, labels);
+        if (!entry.histogram)
+            entry.histogram = std::make_unique<Histogram>(scale);
+        return *entry.histogram;
+    }
+
+    void MetricsRegistry::for_each(const std::function<void(const Entry &)> &visit) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &[key, entry] : entries_)
+            visit(entry);
+    }
+
+    std::string MetricsRegistry::prometheus_text() const
+    {
+        std::ostringstream out;
+        out << std::setprecision(9);
+        std::string last_name;
+        for_each([&](const Entry &entry)
+                 {
+            if (entry.name != last_name)
+            {
+                out << "# HELP " << entry.name << " " << entry.help << "\n"
+                    << "# TYPE " << entry.name << (entry.histogram ? " histogram" : " counter") << "\n";
+                last_name = entry.name;
+            }
+            std::string braced = entry.labels.empty() ? "" : "{" + entry.labels + "}";
+            if (entry.counter)
+            {
+                out << entry.name << braced << " " << entry.counter->value() << "\n";
+                return;
+            }
+
+            HistogramSnapshot snap = entry.histogram->snapshot();
+            std::string prefix = entry.labels.empty() ? "" : entry.labels + ",";
+            size_t last = 0;
+            for (size_t i = 0; i < snap.buckets.size(); i++)
+            {
+                if (snap.buckets[i] > 0)
+                    last = i;
+            }
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < snap.buckets.size() && snap.count > 0; i++)
+            {
+                cumulative += snap.buckets[i];
+                bool boundary = i < Histogram::kSubBuckets || i % Histogram::kSubBuckets == Histogram::kSubBuckets - 1;
+                if (boundary)
+                {
+                    out << entry.name << "_bucket{" << prefix << "le=\""
+                        << static_cast<double>(Histogram::bucket_upper_bound(i)) * snap.scale << "\"} " << cumulative << "\n";
+                }
+                if (i >= last && boundary)
+                    break;
+            }
+            out << entry.name << "_bucket{" << prefix << "le=\"+Inf\"} " << snap.count << "\n"
+                << entry.name << "_sum" << braced << " " << static_cast<double>(snap.sum) * snap.scale << "\n"
+                << entry.name << "_count" << braced << " " << snap.count << "\n"; });
+        return out.str();
+    }
+
+    MetricsRegistry::Entry &MetricsRegistry::entry_for(const std::string &name, const std::string &help, const std::string &labels)
+    {
+        Entry &entry = entries_[name + '\0' + labels];
+        if (entry.name.empty())
+        {
+            entry.name = name;
+            entry.labels = labels;
+            entry.help = help;
+        }
+        return entry;
+    }
+
+    MetricsRegistry &metrics()
+    {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    EngineMetrics &engine_metrics()
+    {
+        static EngineMetrics instance;
+        return instance;
+    }
+};
@@ -0,0 +1,260 @@
+/**
+ *  ReponoDB: Process-wide counters and histograms
+ */
+
+#ifndef REPONO_METRICS_H
+#define REPONO_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * METRICS
+     *
+     * Process-wide counters and latency histograms. An update is a relaxed
+     * atomic add on the calling thread's shard, so the hot path takes no
+     * locks and threads do not fight over one cache line; reads sum the
+     * shards. Metrics are registered once, under a lock, and then used
+     * through the returned reference.
+     */
+    constexpr size_t kMetricShards = 8;
+
+    /**
+     * Shard of the calling thread (threads are spread round robin)
+     */
+    inline size_t metric_shard()
+    {
+        static std::atomic<size_t> next_shard{0};
+        thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+        return shard;
+    }
+
+    class Counter
+    {
+    public:
+        void add(uint64_t n = 1)
+        {
+            shards_[metric_shard()].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        uint64_t value() const
+        {
+            uint64_t total = 0;
+            for (const auto &shard : shards_)
+                total += shard.value.load(std::memory_order_relaxed);
+            return total;
+        }
+
+    private:
+        struct alignas(64) Shard
+        {
+            std::atomic<uint64_t> value{0};
+        };
+        Shard shards_[kMetricShards];
+    };
+
+    /**
+     * Merged view of a histogram at one point in time
+     */
+    struct HistogramSnapshot
+    {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        double scale = 1; // unit of a recorded value (1e-9 for nanoseconds -> seconds)
+
+        /**
+         * Value at a percentile in [0, 100], in scaled units
+         *
+         * Reported as the upper bound of the bucket holding that rank, so it
+         * is within one sub-bucket (12.5%) above the true value.
+         */
+        double percentile(double p) const;
+        double mean() const { return count ? static_cast<double>(sum) * scale / static_cast<double>(count) : 0; }
+    };
+
+    /**
+     * Log-linear ("HDR-style") histogram of non-negative integers
+     *
+     * Values below 8 get their own bucket; above that every power of two is
+     * split into 8 equal sub-buckets, so relative error stays under 12.5%
+     * across the whole 64-bit range with a fixed 496 buckets.
+     */
+    class Histogram
+    {
+    public:
+        static constexpr int kSubBits = 3;
+        static constexpr size_t kSubBuckets = size_t{1} << kSubBits;
+        static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+        explicit Histogram(double scale = 1) : scale_(scale) {}
+
+        static size_t bucket_of(uint64_t value)
+        {
+            if (value < kSubBuckets)
+                return static_cast<size_t>(value);
+            int exponent = 63 - __builtin_clzll(value);
+            size_t sub = static_cast<size_t>(value >> (exponent - kSubBits)) & (kSubBuckets - 1);
+            return static_cast<size_t>(exponent - kSubBits + 1) * kSubBuckets + sub;
+        }
+
+        /**
+         * Largest value that lands in a bucket
+         */
+        static uint64_t bucket_upper_bound(size_t bucket)
+        {
+            if (bucket < kSubBuckets)
+                return bucket;
+            int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+            uint64_t sub = bucket % kSubBuckets;
+            uint64_t lower = (kSubBuckets + sub) << shift;
+            return lower + ((uint64_t{1} << shift) - 1);
+        }
+
+        void record(uint64_t value)
+        {
+            Shard &shard = shards_[metric_shard()];
+            shard.buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+            shard.count.fetch_add(1, std::memory_order_relaxed);
+            shard.sum.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        HistogramSnapshot snapshot() const
+        {
+            HistogramSnapshot snap;
+            snap.buckets.assign(kBuckets, 0);
+            snap.scale = scale_;
+            for (const auto &shard : shards_)
+            {
+                for (size_t i = 0; i < kBuckets; i++)
+                    snap.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+                snap.count += shard.count.load(std::memory_order_relaxed);
+                snap.sum += shard.sum.load(std::memory_order_relaxed);
+            }
+            return snap;
+        }
+
+    private:
+        struct alignas(64) Shard
+        {
+            std::atomic<uint64_t> buckets[kBuckets] = {};
+            std::atomic<uint64_t> count{0};
+            std::atomic<uint64_t> sum{0};
+        };
+        double scale_;
+        Shard shards_[kMetricShards];
+    };
+
+    /**
+     * Records the time from construction to destruction, in nanoseconds
+     */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Histogram &histogram)
+            : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+
+        ~ScopedTimer()
+        {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            histogram_.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        Histogram &histogram_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    class MetricsRegistry
+    {
+    public:
+        struct Entry
+        {
+            std::string name;
+            std::string labels; // Prometheus label pairs without braces, e.g. type="SELECT"
+            std::string help;
+            std::unique_ptr<Counter> counter;
+            std::unique_ptr<Histogram> histogram;
+        };
+
+        /**
+         * Get or register a counter
+         *
+         * @param name Metric name (Prometheus style, e.g. repono_bytes_read_total)
+         * @param help One-line description
+         * @param labels Optional label pairs, e.g. type="SELECT"
+         */
+        Counter &counter(const std::string &name, const std::string &help, const std::string &labels = "");
+
+        /**
+         * Get or register a histogram
+         *
+         * @param scale Unit of a recorded value when exported (1e-9 for nanoseconds)
+         */
+        Histogram &histogram(const std::string &name, const std::string &help, double scale = 1, const std::string &labels = "");
+
+        /**
+         * Visit every metric, ordered by name then labels
+         */
+        void for_each(const std::function<void(const Entry &)> &visit) const;
+
+        /**
+         * Render every metric in the Prometheus text exposition format
+         *
+         * Histograms are exported with a bucket per power of two up to the
+         * largest value seen.
+         */
+        std::string prometheus_text() const;
+
+    private:
+        mutable std::mutex mutex_;
+        std::map<std::string, Entry> entries_; // name + '\0' + labels -> entry
+
+        Entry &entry_for(const std::string &name, const std::string &help, const std::string &labels);
+    };
+
+    /**
+     * The process-wide registry
+     */
+    MetricsRegistry &metrics();
+
+    /**
+     * Metrics the engine updates on its hot paths, registered once
+     */
+    struct EngineMetrics
+    {
+        Histogram &lex_seconds = metrics().histogram("repono_lex_seconds", "Time spent tokenizing SQL", 1e-9);
+        Histogram &parse_seconds = metrics().histogram("repono_parse_seconds", "Time spent parsing tokens into statements", 1e-9);
+        Histogram &plan_seconds = metrics().histogram("repono_plan_seconds", "Time spent binding SELECT expressions to columns", 1e-9);
+        Histogram &hash_seconds = metrics().histogram("repono_hash_seconds", "Time spent computing SHA-256 hashes", 1e-9);
+        Histogram &commit_rows = metrics().histogram("repono_commit_rows", "Rows in each new commit");
+        Histogram &commit_bytes = metrics().histogram("repono_commit_bytes", "Encoded bytes of new chunks written by each commit");
+        Counter &hashed_bytes = metrics().counter("repono_hashed_bytes_total", "Bytes fed to SHA-256");
+        Counter &chunk_cache_hits = metrics().counter("repono_chunk_cache_hits_total", "Chunk lookups served from memory");
+        Counter &chunk_cache_misses = metrics().counter("repono_chunk_cache_misses_total", "Chunk lookups that went to disk");
+        Counter &chunk_evictions = metrics().counter("repono_chunk_evictions_total", "Chunks dropped from memory to keep the buffer pool under its limit");
+        Counter &commit_cache_hits = metrics().counter("repono_commit_cache_hits_total", "Commit lookups served from memory");
+        Counter &commit_cache_misses = metrics().counter("repono_commit_cache_misses_total", "Commit lookups that went to disk");
+        Counter &bytes_read = metrics().counter("repono_bytes_read_total", "Bytes read from repository files");
+        Counter &bytes_written = metrics().counter("repono_bytes_written_total", "Bytes written to repository files");
+        Counter &lsm_runs_flushed = metrics().counter("repono_lsm_runs_flushed_total", "Sorted runs written by COMMIT to LSM tables");
+        Counter &lsm_compactions = metrics().counter("repono_lsm_compactions_total", "Merges of an LSM level's runs into one run");
+        Counter &lsm_bloom_skips = metrics().counter("repono_lsm_bloom_skips_total", "LSM run lookups a bloom filter ruled out");
+    };
+
+    EngineMetrics &engine_metrics();
+};
+
+#endif // REPONO_METRICS_H
@@ -0,0 +1,1119 @@
+/**
+ *  ReponoDB: SQL AST and parser
+ */
+
+#include "parser.h"
+#include "metrics.h"
+#include "memory.h"
+#include "trace.h"
+
+#include <cctype>
+#include <variant>
+
+namespace repono
+{
+    std::string expr_to_string(const Expr &e)
+    {
+        switch (e.kind)
+        {
+        case Expr::Kind::LITERAL:
+            if (std::holds_alternative<std::string>(e.literal))
+                return "'" + std::get<std::string>(e.literal) + "'";
+            return value_to_string(e.literal);
+        case Expr::Kind::COLUMN:
+            return e.name;
+        case Expr::Kind::UNARY:
+            return (e.op == TokenType::NOT ? "NOT " : "-") + expr_to_string(*e.args[0]);
+        case Expr::Kind::BINARY:
+        {
+            std::string op;
+            switch (e.op)
+            {
+            case TokenType::AND:
+                op = "AND";
+                break;
+            case TokenType::OR:
+                op = "OR";
+                break;
+            case TokenType::EQUALS:
+                op = "=";
+                break;
+            case TokenType::NOT_EQUALS:
+                op = "!=";
+                break;
+            case TokenType::LESS_THAN:
+                op = "<";
+                break;
+            case TokenType::GREATER_THAN:
+                op = ">";
+                break;
+            case TokenType::LESS_EQUAL:
+                op = "<=";
+                break;
+            case TokenType::GREATER_EQUAL:
+                op = ">=";
+                break;
+            case TokenType::PLUS:
+                op = "+";
+                break;
+            case TokenType::MINUS:
+                op = "-";
+                break;
+            case TokenType::ASTERISK:
+                op = "*";
+                break;
+            case TokenType::SLASH:
+                op = "/";
+                break;
+            default:
+                op = "?";
+            }
+            return expr_to_string(*e.args[0]) + " " + op + " " + expr_to_string(*e.args[1]);
+        }
+        case Expr::Kind::BETWEEN:
+            return expr_to_string(*e.args[0]) + (e.negated ? " NOT BETWEEN " : " BETWEEN ") +
+                   expr_to_string(*e.args[1]) + " AND " + expr_to_string(*e.args[2]);
+        case Expr::Kind::IS_NULL:
+            return expr_to_string(*e.args[0]) + (e.negated ? " IS NOT NULL" : " IS NULL");
+        case Expr::Kind::FUNCTION:
+        {
+            std::string result = e.name + "(";
+            if (e.star)
+                result += "*";
+            for (size_t i = 0; i < e.args.size(); i++)
+            {
+                if (i > 0)
+                    result += ", ";
+                result += expr_to_string(*e.args[i]);
+            }
+            return result + ")";
+        }
+        }
+        return "?";
+    }
+
+    std::string statement_type_to_string(StatementType type)
+    {
+        switch (type)
+        {
+        case StatementType::SELECT:
+            return "SELECT";
+        case StatementType::CREATE_TABLE:
+            return "CREATE_TABLE";
+        case StatementType::DROP_TABLE:
+            return "DROP_TABLE";
+        case StatementType::INSERT:
+            return "INSERT";
+        case StatementType::UPDATE:
+            return "UPDATE";
+        case StatementType::DELETE:
+            return "DELETE";
+        case StatementType::COMMIT:
+            return "COMMIT";
+        case StatementType::CHECKOUT:
+            return "CHECKOUT";
+        case StatementType::MERGE:
+            return "MERGE";
+        case StatementType::LOG:
+            return "LOG";
+        case StatementType::BLAME:
+            return "BLAME";
+        case StatementType::HISTORY:
+            return "HISTORY";
+        case StatementType::SHOW:
+            return "SHOW";
+        case StatementType::COPY:
+            return "COPY";
+        default:
+            return "UNKNOWN";
+        }
+    }
+
+    std::optional<Statement> Parser::parse()
+    {
+        for (const auto &token : tokens_)
+        {
+            if (token.is(TokenType::INVALID))
+            {
+                return fail(token, token.text);
+            }
+        }
+
+        std::optional<Statement> stmt;
+        const Token &token = peek();
+        switch (token.type)
+        {
+        case TokenType::SELECT:
+            stmt = parse_select();
+            break;
+        case TokenType::CREATE:
+            stmt = parse_create();
+            break;
+        case TokenType::DROP:
+            stmt = parse_drop();
+            break;
+        case TokenType::INSERT:
+            stmt = parse_insert();
+            break;
+        case TokenType::UPDATE:
+            stmt = parse_update();
+            break;
+        case TokenType::DELETE:
+            stmt = parse_delete();
+            break;
+        case TokenType::COMMIT:
+            stmt = parse_commit();
+            break;
+        case TokenType::CHECKOUT:
+            stmt = parse_checkout();
+            break;
+        case TokenType::MERGE:
+            stmt = parse_merge();
+            break;
+        case TokenType::LOG:
+            advance();
+            stmt = Statement{};
+            stmt->type = StatementType::LOG;
+            break;
+        case TokenType::SHOW:
+            stmt = parse_show();
+            break;
+        case TokenType::COPY:
+            stmt = parse_copy();
+            break;
+        case TokenType::BLAME:
+        case TokenType::HISTORY:
+            stmt = parse_lineage();
+            break;
+        default:
+            return fail(token, "Expected a statement");
+        }
+
+        if (!stmt.has_value())
+        {
+            return std::nullopt;
+        }
+        match(TokenType::SEMICOLON);
+        if (!check(TokenType::END_OF_FILE))
+        {
+            return fail(peek(), "Unexpected '" + peek().text + "' after statement");
+        }
+        return stmt;
+    }
+
+    const Token &Parser::advance()
+    {
+        const Token &token = tokens_[current_];
+        if (!token.is(TokenType::END_OF_FILE))
+            current_++;
+        return token;
+    }
+
+    bool Parser::match(TokenType t)
+    {
+        if (!check(t))
+            return false;
+        advance();
+        return true;
+    }
+
+    std::nullopt_t Parser::fail(const Token &token, const std::string &message)
+    {
+        if (error_.empty())
+        {
+            error_ = message + " at line " + std::to_string(token.line) +
+                     ", column " + std::to_string(token.column);
+        }
+        return std::nullopt;
+    }
+
+    bool Parser::expect(TokenType t, const std::string &what)
+    {
+        if (match(t))
+            return true;
+        fail(peek(), "Expected " + what);
+        return false;
+    }
+
+    std::optional<std::string> Parser::expect_identifier(const std::string &what)
+    {
+        if (check(TokenType::IDENTIFIER))
+        {
+            return advance().text;
+        }
+        return fail(peek(), "Expected " + what);
+    }
+
+    std::optional<Statement> Parser::parse_select()
+    {
+        advance(); // SELECT
+        Statement stmt;
+        stmt.type = StatementType::SELECT;
+
+        do
+        {
+            SelectItem item;
+            if (!match(TokenType::ASTERISK))
+            {
+                item.expr = parse_expr();
+                if (!item.expr)
+                    return std::nullopt;
+                if (match(TokenType::AS))
+                {
+                    auto alias = expect_identifier("alias after AS");
+                    if (!alias)
+                        return std::nullopt;
+                    item.alias = *alias;
+                }
+            }
+            stmt.select_items.push_back(std::move(item));
+        } while (match(TokenType::COMMA));
+
+        if (!expect(TokenType::FROM, "FROM") || !parse_source(stmt))
+            return std::nullopt;
+
+        if (!parse_where(stmt))
+            return std::nullopt;
+
+        if (match(TokenType::GROUP))
+        {
+            if (!expect(TokenType::BY, "BY after GROUP"))
+                return std::nullopt;
+            do
+            {
+                ExprPtr e = parse_expr();
+                if (!e)
+                    return std::nullopt;
+                stmt.group_by.push_back(e);
+            } while (match(TokenType::COMMA));
+        }
+
+        if (match(TokenType::ORDER))
+        {
+            if (!expect(TokenType::BY, "BY after ORDER"))
+                return std::nullopt;
+            do
+            {
+                OrderItem item;
+                item.expr = parse_expr();
+                if (!item.expr)
+                    return std::nullopt;
+                if (match(TokenType::DESC))
+                    item.descending = true;
+                else
+                    match(TokenType::ASC);
+                stmt.order_by.push_back(std::move(item));
+            } while (match(TokenType::COMMA));
+        }
+
+        if (match(TokenType::LIMIT))
+        {
+            auto n = expect_count("LIMIT");
+            if (!n)
+                return std::nullopt;
+            stmt.limit = *n;
+            if (match(TokenType::OFFSET))
+            {
+                auto m = expect_count("OFFSET");
+                if (!m)
+                    return std::nullopt;
+                stmt.offset = *m;
+            }
+        }
+        return stmt;
+    }
+
+    bool Parser::parse_source(Statement &stmt)
+    {
+        auto table = expect_identifier("table name");
+        if (!table)
+            return false;
+        stmt.table = *table;
+
+        if (match(TokenType::LEFT_PAREN))
+        {
+            stmt.source_function = *table;
+            for (char &c : stmt.source_function)
+                c = std::toupper(static_cast<unsigned char>(c));
+            stmt.table.clear();
+            do
+            {
+                if (!check(TokenType::IDENTIFIER) && !check(TokenType::STRING_LITERAL))
+                {
+                    fail(peek(), "Expected a table, commit or branch argument");
+                    return false;
+                }
+                stmt.source_args.push_back(advance().text);
+            } while (match(TokenType::COMMA));
+            return expect(TokenType::RIGHT_PAREN, "')' after arguments");
+        }
+        if (match(TokenType::AS))
+        {
+            if (!expect(TokenType::OF, "OF after AS"))
+                return false;
+            if (check(TokenType::STRING_LITERAL) || check(TokenType::IDENTIFIER))
+            {
+                stmt.as_of = advance().text;
+                return true;
+            }
+            fail(peek(), "Expected a commit or branch after AS OF");
+            return false;
+        }
+        if (match(TokenType::FOR))
+        {
+            // FOR SYSTEM_TIME BETWEEN t1 AND t2 | FOR SYSTEM_TIME ALL
+            if (!check(TokenType::IDENTIFIER) || !iequals(peek().text, "SYSTEM_TIME"))
+            {
+                fail(peek(), "Expected SYSTEM_TIME after FOR");
+                return false;
+            }
+            advance();
+            stmt.system_time = true;
+            if (!match(TokenType::ALL))
+            {
+                if (!expect(TokenType::BETWEEN, "BETWEEN or ALL after SYSTEM_TIME"))
+                    return false;
+                auto from = expect_timestamp();
+                if (!from || !expect(TokenType::AND, "AND in SYSTEM_TIME BETWEEN"))
+                    return false;
+                auto to = expect_timestamp();
+                if (!to)
+                    return false;
+                stmt.system_time_from = *from;
+                stmt.system_time_to = *to;
+            }
+        }
+        return true;
+    }
+
+    bool Parser::iequals(const std::string &a, const std::string &b)
+    {
+        return a.size() == b.size() &&
+               std::equal(a.begin(), a.end(), b.begin(), [](char x, char y)
+                          { return std::toupper(static_cast<unsigned char>(x)) == std::toupper(static_cast<unsigned char>(y)); });
+    }
+
+    std::optional<int64_t> Parser::expect_timestamp()
+    {
+        bool negative = match(TokenType::MINUS);
+        if (check(TokenType::INTEGER_LITERAL))
+        {
+            int64_t v = std::get<int64_t>(advance().value);
+            return negative ? -v : v;
+        }
+        return fail(peek(), "Expected a timestamp");
+    }
+
+    std::optional<int64_t> Parser::expect_count(const std::string &clause)
+    {
+        if (check(TokenType::INTEGER_LITERAL))
+        {
+            return std::get<int64_t>(advance().value);
+        }
+        return fail(peek(), "Expected a number after " + clause);
+    }
+
+    bool Parser::parse_where(Statement &stmt)
+    {
+        if (match(TokenType::WHERE))
+        {
+            stmt.where = parse_expr();
+            return stmt.where != nullptr;
+        }
+        return true;
+    }
+
+    std::optional<Statement> Parser::parse_create()
+    {
+        advance(); // CREATE
+        if (!expect(TokenType::TABLE, "TABLE after CREATE"))
+            return std::nullopt;
+        Statement stmt;
+        stmt.type = StatementType::CREATE_TABLE;
+        auto table = expect_identifier("table name");
+        if (!table)
+            return std::nullopt;
+        stmt.table = *table;
+        if (!expect(TokenType::LEFT_PAREN, "'(' after table name"))
+            return std::nullopt;
+
+        do
+        {
+            auto name = expect_identifier("column name");
+            if (!name)
+                return std::nullopt;
+            if (stmt.schema.has_column(*name))
+                return fail(peek(), "Duplicate column '" + *name + "'");
+
+            DataType type;
+            switch (peek().type)
+            {
+            case TokenType::INTEGER_TYPE:
+                type = DataType::INTEGER;
+                break;
+            case TokenType::FLOAT_TYPE:
+                type = DataType::FLOAT;
+                break;
+            case TokenType::VARCHAR_TYPE:
+                type = DataType::VARCHAR;
+                break;
+            case TokenType::BOOLEAN_TYPE:
+                type = DataType::BOOLEAN;
+                break;
+            case TokenType::TIMESTAMP_TYPE:
+                type = DataType::TIMESTAMP;
+                break;
+            default:
+                return fail(peek(), "Expected a type for column '" + *name + "'");
+            }
+            advance();
+
+            bool pk = false, nullable = true;
+            while (true)
+            {
+                if (match(TokenType::PRIMARY))
+                {
+                    if (!expect(TokenType::KEY, "KEY after PRIMARY"))
+                        return std::nullopt;
+                    pk = true;
+                    nullable = false;
+                }
+                else if (match(TokenType::NOT))
+                {
+                    if (!expect(TokenType::NULL_KEYWORD, "NULL after NOT"))
+                        return std::nullopt;
+                    nullable = false;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            stmt.schema.add_column(ColumnDef(*name, type, pk, nullable));
+        } while (match(TokenType::COMMA));
+
+        if (!expect(TokenType::RIGHT_PAREN, "')' after column definitions"))
+            return std::nullopt;
+
+        // USING CHUNKS | LSM
+        if (check(TokenType::IDENTIFIER) && iequals(peek().text, "USING"))
+        {
+            advance();
+            auto storage = expect_identifier("CHUNKS or LSM after USING");
+            if (!storage)
+                return std::nullopt;
+            stmt.table_storage = *storage;
+            std::transform(stmt.table_storage.begin(), stmt.table_storage.end(), stmt.table_storage.begin(), ::toupper);
+        }
+        return stmt;
+    }
+
+    std::optional<Statement> Parser::parse_drop()
+    {
+        advance(); // DROP
+        if (!expect(TokenType::TABLE, "TABLE after DROP"))
+            return std::nullopt;
+        Statement stmt;
+        stmt.type = StatementType::DROP_TABLE;
+        auto table = expect_identifier("table name");
+        if (!table)
+            return std::nullopt;
+        stmt.table = *table;
+        return stmt;
+    }
+
+    std::optional<Statement> Parser::parse_insert()
+    {
+        advance(); // INSERT
+        if (!expect(TokenType::INTO, "INTO after INSERT"))
+            return std::nullopt;
+        Statement stmt;
+        stmt.type = StatementType::INSERT;
+        auto table = expect_identifier("table name");
+        if (!table)
+            return std::nullopt;
+        stmt.table = *table;
+
+        if (match(TokenType::LEFT_PAREN))
+        {
+            do
+            {
+                auto col = expect_identifier("column name");
+                if (!col)
+                    return std::nullopt;
+                stmt.columns.push_back(*col);
+            } while (match(TokenType::COMMA));
+            if (!expect(TokenType::RIGHT_PAREN, "')' after column list"))
+                return std::nullopt;
+        }
+
+        if (!expect(TokenType::VALUES, "VALUES"))
+            return std::nullopt;
+        do
+        {
+            if (!expect(TokenType::LEFT_PAREN, "'(' before values"))
+                return std::nullopt;
+            std::vector<ExprPtr> row;
+            do
+            {
+                ExprPtr e = parse_expr();
+                if (!e)
+                    return std::nullopt;
+                row.push_back(e);
+            } while (match(TokenType::COMMA));
+            if (!expect(TokenType::RIGHT_PAREN, "')' after values"))
+                return std::nullopt;
+            stmt.values.push_back(std::move(row));
+        } while (match(TokenType::COMMA));
+        return stmt;
+    }
+
+    std::optional<Statement> Parser::parse_update()
+    {
+        advance(); // UPDATE
+        Statement stmt;
+        stmt.type = StatementType::UPDATE;
+        auto table = expect_identifier("table name");
+        if (!table)
+            return std::nullopt;
+        stmt.table = *table;
+        if (!expect(TokenType::SET, "SET"))
+            return std::nullopt;
+        do
+        {
+            auto col = expect_identifier("column name");
+            if (!col)
+                return std::nullopt;
+            if (!expect(TokenType::EQUALS, "'=' in SET"))
+                return std::nullopt;
+            ExprPtr e = parse_expr();
+            if (!e)
+                return std::nullopt;
+            stmt.assignments.emplace_back(*col, e);
+        } while (match(TokenType::COMMA));
+        if (!parse_where(stmt))
+            return std::nullopt;
+        return stmt;
+    }
+
+    std::optional<Statement> Parser::parse_delete()
+    {
+        advance(); // DELETE
+        if (!expect(TokenType::FROM, "FROM after DELETE"))
+            return std::nullopt;
+        Statement stmt;
+        stmt.type = StatementType::DELETE;
+        auto table = expect_identifier("table name");
+        if (!table)
+            return std::nullopt;
+        stmt.table = *table;
+        if (!parse_where(stmt))
+            return std::nullopt;
+        return stmt;
+    }
+
+    std::optional<Statement> Parser::parse_lineage()
+    {
+        Statement stmt;
+        if (match(TokenType::BLAME))
+        {
+            stmt.type = StatementType::BLAME;
+        }
+        else
+        {
+            advance(); // HISTORY
+            if (!expect(TokenType::OF, "OF after HISTORY") || !expect(TokenType::ROW, "ROW after HISTORY OF"))
+                return std::nullopt;
+            stmt.type = StatementType::HISTORY;
+        }
+
+        auto table = expect_identifier("table name");
+        if (!table)
+            return std::nullopt;
+        stmt.table = *table;
+
+        if (match(TokenType::AS))
+        {
+            if (!expect(TokenType::OF, "OF after AS"))
+                return std::nullopt;
+            if (!check(TokenType::STRING_LITERAL) && !check(TokenType::IDENTIFIER))
+                return fail(peek(), "Expected a commit or branch after AS OF");
+            stmt.as_of = advance().text;
+        }
+
+        if (!check(TokenType::WHERE))
+            return fail(peek(), "Expected WHERE with the row's primary key");
+        if (!parse_where(stmt))
+            return std::nullopt;
+        return stmt;
+    }
+
+    std::optional<Statement> Parser::parse_commit()
+    {
+        advance(); // COMMIT
+        Statement stmt;
+        stmt.type = StatementType::COMMIT;
+        if (check(TokenType::STRING_LITERAL))
+        {
+            stmt.message = advance().text;
+        }
+        return stmt;
+    }
+
+    std::optional<Statement> Parser::parse_checkout()
+    {
+        advance(); // CHECKOUT
+        Statement stmt;
+        stmt.type = StatementType::CHECKOUT;
+
+        // CHECKOUT -b name
+        if (check(TokenType::MINUS) && peek_next().is(TokenType::IDENTIFIER) && peek_next().text == "b")
+        {
+            advance();
+            advance();
+            stmt.create_branch = true;
+        }
+        if (!check(TokenType::IDENTIFIER) && !check(TokenType::STRING_LITERAL))
+            return fail(peek(), "Expected a branch name after CHECKOUT");
+        stmt.branch = advance().text;
+
+        // TABLES (a, b, ...) | TABLES ALL
+        if (check(TokenType::IDENTIFIER) && iequals(peek().text, "TABLES"))
+        {
+            advance();
+            stmt.sparse = true;
+            if (match(TokenType::ALL))
+                return stmt;
+            if (!expect(TokenType::LEFT_PAREN, "'(' or ALL after TABLES"))
+                return std::nullopt;
+            do
+            {
+                auto table = expect_identifier("table name");
+                if (!table)
+                    return std::nullopt;
+                stmt.sparse_tables.push_back(*table);
+            } while (match(TokenType::COMMA));
+            if (!expect(TokenType::RIGHT_PAREN, "')' after the tables"))
+                return std::nullopt;
+        }
+        return stmt;
+    }
+
+    std::optional<Statement> Parser::parse_show()
+    {
+        advance(); // SHOW
+        Statement stmt;
+        stmt.type = StatementType::SHOW;
+        if (check(TokenType::IDENTIFIER))
+        {
+            stmt.show_target = advance().text;
+            std::transform(stmt.show_target.begin(), stmt.show_target.end(), stmt.show_target.begin(), ::toupper);
+            if (stmt.show_target == "METRICS" || stmt.show_target == "MEMORY")
+                return stmt;
+        }
+        return fail(peek(), "Expected METRICS or MEMORY after SHOW");
+    }
+
+    std::optional<Statement> Parser::parse_copy()
+    {
+        advance(); // COPY
+        Statement stmt;
+        stmt.type = StatementType::COPY;
+        if (!parse_source(stmt))
+            return std::nullopt;
+        if (match(TokenType::FROM))
+        {
+            if (!stmt.source_function.empty() || !stmt.as_of.empty() || stmt.system_time)
+                return fail(peek(), "COPY ... FROM loads into a table of the working set");
+            stmt.copy_from = true;
+        }
+        else if (check(TokenType::IDENTIFIER) && iequals(peek().text, "TO"))
+        {
+            advance();
+        }
+        else
+        {
+            return fail(peek(), "Expected TO or FROM after the COPY source");
+        }
+        if (!check(TokenType::STRING_LITERAL))
+            return fail(peek(), "Expected a file name");
+        stmt.copy_path = advance().text;
+
+        // (FORMAT csv | jsonl, HEADER [true | false])
+        if (match(TokenType::LEFT_PAREN))
+        {
+            do
+            {
+                if (!check(TokenType::IDENTIFIER))
+                    return fail(peek(), "Expected FORMAT or HEADER");
+                const Token &option_token = advance();
+                const std::string &option = option_token.text;
+                if (iequals(option, "FORMAT"))
+                {
+                    auto format = expect_identifier("CSV or JSONL after FORMAT");
+                    if (!format)
+                        return std::nullopt;
+                    stmt.copy_format = *format;
+                    std::transform(stmt.copy_format.begin(), stmt.copy_format.end(), stmt.copy_format.begin(), ::toupper);
+                }
+                else if (iequals(option, "HEADER"))
+                {
+                    stmt.copy_header = !match(TokenType::FALSE_KEYWORD);
+                    if (stmt.copy_header)
+                        match(TokenType::TRUE_KEYWORD);
+                }
+                else
+                {
+                    return fail(option_token, "Unknown COPY option '" + option + "'");
+                }
+            } while (match(TokenType::COMMA));
+            if (!expect(TokenType::RIGHT_PAREN, "')' after COPY options"))
+                return std::nullopt;
+        }
+        return stmt;
+    }
+
+    std::optional<Statement> Parser::parse_merge()
+    {
+        advance(); // MERGE
+        Statement stmt;
+        stmt.type = StatementType::MERGE;
+        if (check(TokenType::IDENTIFIER) || check(TokenType::STRING_LITERAL))
+        {
+            stmt.branch = advance().text;
+            if (check(TokenType::STRING_LITERAL))
+            {
+                stmt.message = advance().text;
+            }
+            return stmt;
+        }
+        return fail(peek(), "Expected a branch name after MERGE");
+    }
+
+    ExprPtr Parser::nested(ExprPtr (Parser::*step)())
+    {
+        if (depth_ >= kMaxExprDepth)
+        {
+            fail(peek(), "Expression nested too deeply");
+            return nullptr;
+        }
+        depth_++;
+        ExprPtr e = (this->*step)();
+        depth_--;
+        return e;
+    }
+
+    ExprPtr Parser::make_binary(TokenType op, ExprPtr left, ExprPtr right)
+    {
+        auto e = std::make_shared<Expr>();
+        e->kind = Expr::Kind::BINARY;
+        e->op = op;
+        e->args = {std::move(left), std::move(right)};
+        return e;
+    }
+
+    ExprPtr Parser::parse_or()
+    {
+        ExprPtr left = parse_and();
+        while (left && check(TokenType::OR))
+        {
+            advance();
+            ExprPtr right = parse_and();
+            if (!right)
+                return nullptr;
+            left = make_binary(TokenType::OR, left, right);
+        }
+        return left;
+    }
+
+    ExprPtr Parser::parse_and()
+    {
+        ExprPtr left = parse_not();
+        while (left && check(TokenType::AND))
+        {
+            advance();
+            ExprPtr right = parse_not();
+            if (!right)
+                return nullptr;
+            left = make_binary(TokenType::AND, left, right);
+        }
+        return left;
+    }
+
+    ExprPtr Parser::parse_not()
+    {
+        if (match(TokenType::NOT))
+        {
+            ExprPtr operand = nested(&Parser::parse_not);
+            if (!operand)
+                return nullptr;
+            auto e = std::make_shared<Expr>();
+            e->kind = Expr::Kind::UNARY;
+            e->op = TokenType::NOT;
+            e->args = {operand};
+            return e;
+        }
+        return parse_comparison();
+    }
+
+    ExprPtr Parser::parse_comparison()
+    {
+        ExprPtr left = parse_additive();
+        if (!left)
+            return nullptr;
+
+        if (peek().is_comparison())
+        {
+            TokenType op = advance().type;
+            ExprPtr right = parse_additive();
+            if (!right)
+                return nullptr;
+            return make_binary(op, left, right);
+        }
+
+        if (check(TokenType::IS))
+        {
+            advance();
+            auto e = std::make_shared<Expr>();
+            e->kind = Expr::Kind::IS_NULL;
+            e->negated = match(TokenType::NOT);
+            if (!expect(TokenType::NULL_KEYWORD, "NULL after IS"))
+                return nullptr;
+            e->args = {left};
+            return e;
+        }
+
+        bool negated = false;
+        if (check(TokenType::NOT) && peek_next().is(TokenType::BETWEEN))
+        {
+            advance();
+            negated = true;
+        }
+        if (match(TokenType::BETWEEN))
+        {
+            ExprPtr low = parse_additive();
+            if (!low || !expect(TokenType::AND, "AND in BETWEEN"))
+                return nullptr;
+            ExprPtr high = parse_additive();
+            if (!high)
+                return nullptr;
+            auto e = std::make_shared<Expr>();
+            e->kind = Expr::Kind::BETWEEN;
+            e->negated = negated;
+            e->args = {left, low, high};
+            return e;
+        }
+        return left;
+    }
+
+    ExprPtr Parser::parse_additive()
+    {
+        ExprPtr left = parse_multiplicative();
+        while (left && (check(TokenType::PLUS) || check(TokenType::MINUS)))
+        {
+            TokenType op = advance().type;
+            ExprPtr right = parse_multiplicative();
+            if (!right)
+                return nullptr;
+            left = make_binary(op, left, right);
+        }
+        return left;
+    }
+
+    ExprPtr Parser::parse_multiplicative()
+    {
+        ExprPtr left = parse_unary();
+        while (left && (check(TokenType::ASTERISK) || check(TokenType::SLASH)))
+        {
+            TokenType op = advance().type;
+            ExprPtr right = parse_unary();
+            if (!right)
+                return nullptr;
+            left = make_binary(op, left, right);
+        }
+        return left;
+    }
+
+    ExprPtr Parser::parse_unary()
+    {
+        if (match(TokenType::MINUS))
+        {
+            ExprPtr operand = nested(&Parser::parse_unary);
+            if (!operand)
+                return nullptr;
+            // Fold negative literals so "-5" stays a literal
+            if (operand->kind == Expr::Kind::LITERAL && std::holds_alternative<int64_t>(operand->literal))
+            {
+                operand->literal = -std::get<int64_t>(operand->literal);
+                return operand;
+            }
+            if (operand->kind == Expr::Kind::LITERAL && std::holds_alternative<double>(operand->literal))
+            {
+                operand->literal = -std::get<double>(operand->literal);
+                return operand;
+            }
+            auto e = std::make_shared<Expr>();
+            e->kind = Expr::Kind::UNARY;
+            e->op = TokenType::MINUS;
+            e->args = {operand};
+            return e;
+        }
+        return parse_primary();
+    }
+
+    ExprPtr Parser::parse_primary()
+    {
+        const Token &token = peek();
+        auto e = std::make_shared<Expr>();
+
+        switch (token.type)
+        {
+        case TokenType::INTEGER_LITERAL:
+            e->literal = std::get<int64_t>(token.value);
+            advance();
+            return e;
+        case TokenType::FLOAT_LITERAL:
+            e->literal = std::get<double>(token.value);
+            advance();
+            return e;
+        case TokenType::STRING_LITERAL:
+            e->literal = std::get<std::string>(token.value);
+            advance();
+            return e;
+        case TokenType::TRUE_KEYWORD:
+            e->literal = true;
+            advance();
+            return e;
+        case TokenType::FALSE_KEYWORD:
+            e->literal = false;
+            advance();
+            return e;
+        case TokenType::NULL_KEYWORD:
+            advance();
+            return e;
+        case TokenType::LEFT_PAREN:
+        {
+            advance();
+            ExprPtr inner = parse_expr();
+            if (!inner || !expect(TokenType::RIGHT_PAREN, "')'"))
+                return nullptr;
+            return inner;
+        }
+        case TokenType::IDENTIFIER:
+        {
+            std::string name = advance().text;
+            if (match(TokenType::LEFT_PAREN))
+            {
+                e->kind = Expr::Kind::FUNCTION;
+                e->name = name;
+                for (char &c : e->name)
+                    c = std::toupper(static_cast<unsigned char>(c));
+                if (match(TokenType::ASTERISK))
+                {
+                    e->star = true;
+                }
+                else if (!check(TokenType::RIGHT_PAREN))
+                {
+                    do
+                    {
+                        ExprPtr arg = parse_expr();
+                        if (!arg)
+                            return nullptr;
+                        e->args.push_back(arg);
+                    } while (match(TokenType::COMMA));
+                }
+                if (!expect(TokenType::RIGHT_PAREN, "')' after function arguments"))
+                    return nullptr;
+                return e;
+            }
+            // table.column: the table qualifier is accepted and ignored
+            if (match(TokenType::DOT))
+            {
+                auto column = expect_identifier("column name after '.'");
+                if (!column)
+                    return nullptr;
+                name = *column;
+            }
+            e->kind = Expr::Kind::COLUMN;
+            e->name = name;
+            return e;
+        }
+        default:
+            fail(token, "Expected an expression");
+            return nullptr;
+        }
+    }
+
+    std::optional<Statement> parse_sql(const std::string &sql, std::string &error)
+    {
+        EngineMetrics &stats = engine_metrics();
+        std::vector<Token> tokens;
+        {
+            ScopedTimer timer(stats.lex_seconds);
+            Lexer lexer(sql);
+            tokens = lexer.tokenize();
+        }
+        ScopedTimer timer(stats.parse_seconds);
+        REPONO_TRACE_SPAN("Parser::parse");
+        Parser parser(std::move(tokens));
+        auto stmt = parser.parse();
+        error = parser.error();
+        return stmt;
+    }
+
+    std::string fingerprint_sql(const std::string &sql)
+    {
+        Lexer lexer(sql);
+        std::string out;
+        bool after_values = false;
+        bool skipping = false;
+        int depth = 0;
+        for (const auto &token : lexer.tokenize())
+        {
+            if (token.is(TokenType::END_OF_FILE))
+                break;
+            if (token.is(TokenType::LEFT_PAREN))
+                depth++;
+            if (skipping)
+            {
+                if (token.is(TokenType::RIGHT_PAREN))
+                    depth--;
+                if (depth > 0 || token.is(TokenType::RIGHT_PAREN) || token.is(TokenType::COMMA) || token.is(TokenType::LEFT_PAREN))
+                    continue;
+                skipping = false;
+            }
+            if (token.is(TokenType::RIGHT_PAREN))
+                depth--;
+            if (after_values && depth == 0 && token.is(TokenType::COMMA))
+            {
+                out += ", ...";
+                skipping = true;
+                after_values = false;
+                continue;
+            }
+            if (token.is(TokenType::VALUES))
+                after_values = true;
+
+            std::string text;
+            switch (token.type)
+            {
+            case TokenType::INTEGER_LITERAL:
+            case TokenType::FLOAT_LITERAL:
+            case TokenType::STRING_LITERAL:
+            case TokenType::TRUE_KEYWORD:
+            case TokenType::FALSE_KEYWORD:
+                text = "?";
+                break;
+            default:
+                text = token.text;
+                if (token.is_keyword())
+                    std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+                break;
+            }
+            if (!out.empty() && !token.is(TokenType::COMMA) && !token.is(TokenType::RIGHT_PAREN) && out.back() != '(')
+                out += ' ';
+            out += text;
+        }
+        return out;
+    }
+};
@@ -0,0 +1,288 @@
+/**
+ *  ReponoDB: SQL AST and parser
+ */
+
+#ifndef REPONO_PARSER_H
+#define REPONO_PARSER_H
+
+#include "repono/lexer.h"
+#include "repono/schema.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace repono
+{
+    // AST
+
+    /**
+     * Expression tree node
+     *
+     * COLUMN nodes are bound to a column index (bind_expr) before evaluation,
+     * so evaluating against a row never looks names up.
+     */
+    struct Expr;
+    using ExprPtr = std::shared_ptr<Expr>;
+
+    struct Expr
+    {
+        enum class Kind
+        {
+            LITERAL,
+            COLUMN,
+            UNARY,    // NOT x, -x
+            BINARY,   // x op y
+            BETWEEN,  // args[0] BETWEEN args[1] AND args[2]
+            IS_NULL,  // args[0] IS [NOT] NULL
+            FUNCTION, // name(args...)
+        };
+
+        Kind kind = Kind::LITERAL;
+        Value literal;
+        std::string name;                  // column or function name
+        TokenType op = TokenType::INVALID; // UNARY / BINARY operator
+        std::vector<ExprPtr> args;
+        bool negated = false; // NOT BETWEEN, IS NOT NULL
+        bool star = false;    // COUNT(*)
+
+        size_t column_index = 0;      // set by bind_expr, or by bind_aggregates for aggregates
+        bool aggregate_bound = false; // aggregate call with an output slot
+    };
+
+    /**
+     * Render an expression back to SQL-ish text (used for result column names)
+     */
+    std::string expr_to_string(const Expr &e);
+
+    enum class StatementType
+    {
+        SELECT,
+        CREATE_TABLE,
+        DROP_TABLE,
+        INSERT,
+        UPDATE,
+        DELETE,
+        COMMIT,
+        CHECKOUT,
+        MERGE,
+        LOG,
+        BLAME,
+        HISTORY,
+        SHOW,
+        COPY
+    };
+
+    std::string statement_type_to_string(StatementType type);
+
+    struct SelectItem
+    {
+        ExprPtr expr; // nullptr means *
+        std::string alias;
+    };
+
+    struct OrderItem
+    {
+        ExprPtr expr;
+        bool descending = false;
+    };
+
+    /**
+     * One parsed SQL statement. Which fields are used depends on type.
+     */
+    struct Statement
+    {
+        StatementType type = StatementType::SELECT;
+        std::string table;
+
+        // SELECT
+        std::vector<SelectItem> select_items;
+        std::string as_of; // revision for SELECT ... AS OF
+        ExprPtr where;     // also UPDATE / DELETE
+        std::vector<ExprPtr> group_by;
+        std::vector<OrderItem> order_by;
+
+        // FOR SYSTEM_TIME BETWEEN from AND to (inclusive, commit timestamps)
+        bool system_time = false;
+        int64_t system_time_from = std::numeric_limits<int64_t>::min();
+        int64_t system_time_to = std::numeric_limits<int64_t>::max();
+
+        // Table-valued source, e.g. FROM diff(users, 'abc123', main)
+        std::string source_function; // upper case, "" for a plain table
+        std::vector<std::string> source_args;
+        std::optional<int64_t> limit;
+        int64_t offset = 0;
+
+        // CREATE TABLE
+        Schema schema;
+        std::string table_storage; // USING ..., upper-cased: "" = chunks, or LSM
+
+        // INSERT
+        std::vector<std::string> columns;
+        std::vector<std::vector<ExprPtr>> values;
+        std::vector<Row> rows; // values already evaluated, for bulk loads (not produced by the parser)
+
+        // UPDATE
+        std::vector<std::pair<std::string, ExprPtr>> assignments;
+
+        // COMMIT
+        std::string message;
+
+        // CHECKOUT, MERGE
+        std::string branch;
+        bool create_branch = false;
+        bool sparse = false;                    // CHECKOUT ... TABLES given
+        std::vector<std::string> sparse_tables; // empty with sparse = TABLES ALL
+
+        // SHOW
+        std::string show_target; // upper-cased: METRICS or MEMORY
+
+        // COPY source TO 'path' (FORMAT ...); the source is a table, AS OF,
+        // FOR SYSTEM_TIME or a table function, as in SELECT.
+        // COPY table FROM 'path' loads a CSV file.
+        std::string copy_path;
+        std::string copy_format; // upper-cased; "" = CSV
+        bool copy_from = false;
+        bool copy_header = true;
+    };
+
+    /**
+     * PARSER
+     *
+     * Recursive descent over the Lexer's tokens. Parses one statement with an
+     * optional trailing semicolon. On failure parse() returns std::nullopt and
+     * error() describes the first problem.
+     */
+    class Parser
+    {
+    public:
+        explicit Parser(std::vector<Token> tokens) : tokens_(std::move(tokens)), current_(0) {}
+
+        std::optional<Statement> parse();
+
+        const std::string &error() const { return error_; }
+
+    private:
+        // Each level of expression nesting costs several stack frames here
+        // and in evaluate(); past this, input is rejected rather than
+        // risking a stack overflow
+        static constexpr int kMaxExprDepth = 200;
+
+        std::vector<Token> tokens_;
+        size_t current_;
+        std::string error_;
+        int depth_ = 0;
+
+        const Token &peek() const { return tokens_[current_]; }
+        const Token &peek_next() const { return tokens_[std::min(current_ + 1, tokens_.size() - 1)]; }
+        bool check(TokenType t) const { return peek().is(t); }
+
+        const Token &advance();
+
+        bool match(TokenType t);
+
+        std::nullopt_t fail(const Token &token, const std::string &message);
+
+        bool expect(TokenType t, const std::string &what);
+
+        std::optional<std::string> expect_identifier(const std::string &what);
+
+        std::optional<Statement> parse_select();
+
+        /**
+         * The table after FROM / COPY: a table with optional AS OF or FOR
+         * SYSTEM_TIME, or a table function call such as diff(t, a, b)
+         */
+        bool parse_source(Statement &stmt);
+
+        static bool iequals(const std::string &a, const std::string &b);
+
+        std::optional<int64_t> expect_timestamp();
+
+        std::optional<int64_t> expect_count(const std::string &clause);
+
+        bool parse_where(Statement &stmt);
+
+        std::optional<Statement> parse_create();
+
+        std::optional<Statement> parse_drop();
+
+        std::optional<Statement> parse_insert();
+
+        std::optional<Statement> parse_update();
+
+        std::optional<Statement> parse_delete();
+
+        /**
+         * BLAME table [AS OF rev] WHERE pk = ...
+         * HISTORY OF ROW table [AS OF rev] WHERE pk = ...
+         */
+        std::optional<Statement> parse_lineage();
+
+        std::optional<Statement> parse_commit();
+
+        /**
+         * CHECKOUT [-b] branch [TABLES (a, b, ...) | TABLES ALL]
+         */
+        std::optional<Statement> parse_checkout();
+
+        std::optional<Statement> parse_show();
+
+        /**
+         * COPY source TO 'file' [(FORMAT CSV | JSONL, HEADER [TRUE | FALSE])]
+         * COPY table FROM 'file' [(FORMAT CSV, HEADER [TRUE | FALSE])]
+         */
+        std::optional<Statement> parse_copy();
+
+        std::optional<Statement> parse_merge();
+
+        // Expressions, lowest precedence first
+
+        ExprPtr parse_expr() { return nested(&Parser::parse_or); }
+
+        /**
+         * Call a parse step one nesting level deeper
+         */
+        ExprPtr nested(ExprPtr (Parser::*step)());
+
+        ExprPtr make_binary(TokenType op, ExprPtr left, ExprPtr right);
+
+        ExprPtr parse_or();
+
+        ExprPtr parse_and();
+
+        ExprPtr parse_not();
+
+        ExprPtr parse_comparison();
+
+        ExprPtr parse_additive();
+
+        ExprPtr parse_multiplicative();
+
+        ExprPtr parse_unary();
+
+        ExprPtr parse_primary();
+    };
+
+    /**
+     * Parse one SQL statement
+     *
+     * @param sql The statement text
+     * @param error Set to the parse error, if any
+     */
+    std::optional<Statement> parse_sql(const std::string &sql, std::string &error);
+
+    /**
+     * Normalize a statement so that statements differing only in constants
+     * group together: literals become ?, keywords are upper-cased, comments
+     * and extra whitespace disappear, and a multi-row VALUES list keeps only
+     * its first row
+     */
+    std::string fingerprint_sql(const std::string &sql);
+};
+
+#endif // REPONO_PARSER_H
@@ -0,0 +1,803 @@
+/**
+ *  ReponoDB: Packs, remotes, and fetch / push / clone
+ */
+
+#include "remote.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace repono
+{
+    std::vector<std::string> find_missing_commits(const Repository &repo,
+                                                  const std::vector<std::string> &wants,
+                                                  const std::unordered_set<std::string> &haves,
+                                                  std::unordered_set<std::string> &common)
+    {
+        std::vector<std::string> order;
+        std::unordered_set<std::string> visited;
+        std::vector<std::string> stack(wants.begin(), wants.end());
+
+        while (!stack.empty())
+        {
+            std::string hash = stack.back();
+            stack.pop_back();
+            if (hash.empty() || visited.count(hash))
+                continue;
+            visited.insert(hash);
+
+            if (haves.count(hash))
+            {
+                common.insert(hash);
+                continue;
+            }
+            const CommitRecord *record = repo.get_record(hash);
+            if (record == nullptr)
+                continue;
+            order.push_back(hash);
+            stack.push_back(record->parent_hash);
+            stack.push_back(record->merge_parent_hash);
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+    std::string build_pack(const Repository &repo,
+                           const std::vector<std::string> &wants,
+                           const std::vector<std::string> &haves,
+                           SyncStats *stats)
+    {
+        REPONO_TRACE_SPAN("build_pack");
+        std::unordered_set<std::string> have_set(haves.begin(), haves.end());
+        std::unordered_set<std::string> common;
+        std::vector<std::string> missing = find_missing_commits(repo, wants, have_set, common);
+
+        // Chunks the receiver already holds: everything in the common commits
+        std::unordered_set<std::string> known;
+        for (const auto &hash : common)
+        {
+            const CommitRecord *record = repo.get_record(hash);
+            if (record == nullptr)
+                continue;
+            for (const auto &[name, manifest] : record->tables)
+            {
+                known.insert(manifest.chunk_hashes.begin(), manifest.chunk_hashes.end());
+            }
+        }
+
+        ByteWriter chunks_out;
+        uint32_t num_chunks = 0;
+        size_t num_delta = 0;
+
+        for (const auto &hash : missing)
+        {
+            const CommitRecord *record = repo.get_record(hash);
+            const CommitRecord *parent = repo.get_record(record->parent_hash);
+
+            for (const auto &[name, manifest] : record->tables)
+            {
+                const TableManifest *base_manifest = nullptr;
+                if (parent != nullptr)
+                {
+                    auto it = parent->tables.find(name);
+                    if (it != parent->tables.end())
+                        base_manifest = &it->second;
+                }
+
+                for (size_t i = 0; i < manifest.chunk_hashes.size(); i++)
+                {
+                    const std::string &chunk_hash = manifest.chunk_hashes[i];
+                    if (known.count(chunk_hash))
+                        continue;
+                    ChunkPtr chunk = repo.get_chunk(chunk_hash);
+                    if (chunk == nullptr)
+                        continue;
+
+                    ChunkPtr base;
+                    if (base_manifest != nullptr && !base_manifest->chunk_hashes.empty())
+                    {
+                        size_t bi = std::min(i, base_manifest->chunk_hashes.size() - 1);
+                        if (known.count(base_manifest->chunk_hashes[bi]))
+                            base = repo.get_chunk(base_manifest->chunk_hashes[bi]);
+                    }
+
+                    // Rows shared at the start and end of base and target
+                    size_t prefix = 0, suffix = 0;
+                    if (base != nullptr)
+                    {
+                        const auto &a = base->rows;
+                        const auto &b = chunk->rows;
+                        while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix])
+                            prefix++;
+                        while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+                               a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+                            suffix++;
+                    }
+
+                    if (base != nullptr && prefix + suffix > 0)
+                    {
+                        chunks_out.put_u8(1);
+                        chunks_out.put_string(chunk_hash);
+                        chunks_out.put_string(base->hash);
+                        chunks_out.put_u32(static_cast<uint32_t>(prefix));
+                        chunks_out.put_u32(static_cast<uint32_t>(suffix));
+                        std::vector<Row> middle(chunk->rows.begin() + prefix, chunk->rows.end() - suffix);
+                        chunks_out.put_rows(middle);
+                        num_delta++;
+                    }
+                    else
+                    {
+                        chunks_out.put_u8(0);
+                        chunks_out.put_string(chunk_hash);
+                        chunks_out.put_rows(chunk->rows);
+                    }
+                    known.insert(chunk_hash);
+                    num_chunks++;
+                }
+            }
+        }
+
+        ByteWriter out;
+        out.put_u8(kPackMagic[0]);
+        out.put_u8(kPackMagic[1]);
+        out.put_u8(kPackMagic[2]);
+        out.put_u8(kPackMagic[3]);
+        out.put_u32(num_chunks);
+        std::string pack = out.take() + chunks_out.take();
+
+        ByteWriter commits_out;
+        commits_out.put_u32(static_cast<uint32_t>(missing.size()));
+        for (const auto &hash : missing)
+        {
+            commits_out.put_string(encode_commit_record(*repo.get_record(hash)));
+        }
+        pack += commits_out.take();
+
+        if (stats != nullptr)
+        {
+            stats->commits_sent += missing.size();
+            stats->chunks_sent += num_chunks;
+            stats->chunks_delta += num_delta;
+            stats->pack_bytes += pack.size();
+        }
+        return pack;
+    }
+
+    std::string apply_pack(Repository &repo, const std::string &pack, std::vector<std::string> *applied)
+    {
+        REPONO_TRACE_SPAN("apply_pack");
+        if (pack.size() < 4 || pack.compare(0, 4, kPackMagic) != 0)
+        {
+            return "Not a pack";
+        }
+        std::string body = pack.substr(4);
+        ByteReader r(body);
+
+        uint32_t num_chunks = r.get_u32();
+        for (uint32_t i = 0; i < num_chunks && r.ok(); i++)
+        {
+            uint8_t kind = r.get_u8();
+            std::string hash = r.get_string();
+            std::vector<Row> rows;
+
+            if (kind == 0)
+            {
+                rows = r.get_rows();
+            }
+            else if (kind == 1)
+            {
+                std::string base_hash = r.get_string();
+                uint32_t prefix = r.get_u32();
+                uint32_t suffix = r.get_u32();
+                std::vector<Row> middle = r.get_rows();
+                if (!r.ok())
+                    break;
+                if (!is_object_hash(base_hash))
+                {
+                    return "Pack has a malformed delta base hash";
+                }
+                ChunkPtr base = repo.get_chunk(base_hash);
+                if (base == nullptr)
+                {
+                    return "Pack references missing delta base " + base_hash;
+                }
+                if (static_cast<size_t>(prefix) + suffix > base->rows.size())
+                {
+                    return "Corrupt delta for chunk " + hash;
+                }
+                rows.assign(base->rows.begin(), base->rows.begin() + prefix);
+                rows.insert(rows.end(), middle.begin(), middle.end());
+                rows.insert(rows.end(), base->rows.end() - suffix, base->rows.end());
+            }
+            else
+            {
+                return "Unknown pack entry kind " + std::to_string(kind);
+            }
+
+            if (!r.ok())
+                break;
+            if (compute_chunk_hash(rows) != hash)
+            {
+                return "Chunk " + hash + " failed hash verification";
+            }
+            repo.put_chunk(std::move(rows));
+        }
+
+        uint32_t num_commits = r.get_u32();
+        for (uint32_t i = 0; i < num_commits && r.ok(); i++)
+        {
+            std::string encoded = r.get_string();
+            ByteReader cr(encoded);
+            auto record = decode_commit_record(cr);
+            if (!record.has_value())
+            {
+                return "Corrupt commit record in pack";
+            }
+            // The hash names the file the record is stored in, so it must
+            // be a real hash of exactly this content
+            if (!is_object_hash(record->hash) || compute_record_hash(*record) != record->hash)
+            {
+                return "Commit record in pack failed hash verification";
+            }
+            // Parents come before children in a pack, so each one is here by now
+            for (const std::string *parent : {&record->parent_hash, &record->merge_parent_hash})
+            {
+                if (!parent->empty() && (!is_object_hash(*parent) || !repo.has_commit(*parent)))
+                {
+                    return "Commit " + record->hash + " references missing parent " + *parent;
+                }
+            }
+            for (const auto &[name, manifest] : record->tables)
+            {
+                for (const auto &chunk_hash : manifest.chunk_hashes)
+                {
+                    if (!is_object_hash(chunk_hash) || !repo.has_chunk(chunk_hash))
+                    {
+                        return "Commit " + record->hash + " references missing chunk " + chunk_hash;
+                    }
+                }
+            }
+            repo.put_record(*record);
+            if (applied != nullptr)
+                applied->push_back(record->hash);
+        }
+
+        if (!r.ok())
+        {
+            return "Truncated pack";
+        }
+        return "";
+    }
+
+    std::string serve_fetch(const Repository &repo,
+                            const std::vector<std::string> &wants,
+                            const std::vector<std::string> &haves,
+                            std::string &pack)
+    {
+        for (const auto *hashes : {&wants, &haves})
+        {
+            if (!std::all_of(hashes->begin(), hashes->end(), is_object_hash))
+            {
+                return "Malformed request";
+            }
+        }
+        pack = build_pack(repo, wants, haves);
+        return "";
+    }
+
+    std::string serve_push(Repository &repo,
+                           const std::string &pack,
+                           const std::map<std::string, std::pair<std::string, std::string>> &updates)
+    {
+        for (const auto &[branch, change] : updates)
+        {
+            if (!is_valid_branch_name(branch))
+            {
+                return "Invalid branch name in push";
+            }
+            if (!is_object_hash(change.second))
+            {
+                return "Push of '" + branch + "' names an invalid commit hash";
+            }
+            std::string current = repo.branch_head(branch).value_or("");
+            if (current != change.first)
+            {
+                return "Branch '" + branch + "' moved on the remote; fetch first";
+            }
+        }
+        std::string error = apply_pack(repo, pack);
+        if (!error.empty())
+        {
+            return error;
+        }
+        // Check every update before moving any branch
+        for (const auto &[branch, change] : updates)
+        {
+            if (!repo.has_commit(change.second))
+            {
+                return "Push of '" + branch + "' is missing commit " + change.second;
+            }
+            if (!repo.is_ancestor(change.first, change.second))
+            {
+                return "Rejected non-fast-forward push of '" + branch + "'";
+            }
+        }
+        for (const auto &[branch, change] : updates)
+        {
+            repo.set_branch(branch, change.second);
+        }
+        return repo.flush();
+    }
+
+    std::string DirectoryRemote::list_refs(std::map<std::string, std::string> &refs)
+    {
+        Repository repo;
+        std::string error = open(repo);
+        refs = repo.branches();
+        return error;
+    }
+
+    std::string DirectoryRemote::open(Repository &repo) const
+    {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(dir_ + "/objects/commits", ec))
+        {
+            return "No repository at '" + dir_ + "'";
+        }
+        return repo.open(dir_);
+    }
+
+    bool send_all(int fd, const std::string &data)
+    {
+#ifdef MSG_NOSIGNAL
+        constexpr int kFlags = MSG_NOSIGNAL; // a peer that hung up is an error, not SIGPIPE
+#else
+        constexpr int kFlags = 0;
+#endif
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, kFlags);
+            if (n <= 0)
+                return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool recv_all(int fd, char *buf, size_t len)
+    {
+        size_t got = 0;
+        while (got < len)
+        {
+            ssize_t n = ::recv(fd, buf + got, len - got, 0);
+            if (n <= 0)
+                return false;
+            got += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool send_frame(int fd, const std::string &payload)
+    {
+        ByteWriter w;
+        w.put_u32(static_cast<uint32_t>(payload.size()));
+        return send_all(fd, w.data()) && send_all(fd, payload);
+    }
+
+    std::string recv_frame(int fd, std::string &payload)
+    {
+        std::string header(4, '\0');
+        if (!recv_all(fd, header.data(), header.size()))
+            return "Connection lost";
+        ByteReader r(header);
+        uint32_t len = r.get_u32();
+        if (len > kMaxFrameBytes)
+            return "Frame of " + std::to_string(len) + " bytes is over the " + std::to_string(kMaxFrameBytes) + " byte limit";
+
+        constexpr size_t kStep = 1 << 20;
+        payload.clear();
+        while (payload.size() < len)
+        {
+            size_t got = payload.size();
+            payload.resize(std::min<size_t>(len, got + kStep));
+            if (!recv_all(fd, payload.data() + got, payload.size() - got))
+                return "Connection lost";
+        }
+        return "";
+    }
+
+    std::string listen_unix(const std::string &path, int &fd)
+    {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            return "Socket path too long: " + path;
+        }
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            return "Cannot create socket";
+        }
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        ::unlink(path.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+            ::listen(fd, 16) < 0)
+        {
+            ::close(fd);
+            fd = -1;
+            return "Cannot listen on " + path;
+        }
+        return "";
+    }
+
+    std::string RepositoryServer::start()
+    {
+        std::string error = listen_unix(socket_path_, listen_fd_);
+        if (!error.empty())
+        {
+            return error;
+        }
+        running_ = true;
+        thread_ = std::thread([this]
+                              { serve_loop(); });
+        return "";
+    }
+
+    void RepositoryServer::stop()
+    {
+        if (!running_.exchange(false))
+            return;
+        if (thread_.joinable())
+            thread_.join();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        ::unlink(socket_path_.c_str());
+
+        // Wake connections blocked on a slow client, then wait for them
+        std::unique_lock<std::mutex> lock(connections_mutex_);
+        for (int fd : connections_)
+            ::shutdown(fd, SHUT_RDWR);
+        connections_done_.wait(lock, [this]
+                               { return connections_.empty(); });
+    }
+
+    void RepositoryServer::serve_loop()
+    {
+        while (running_)
+        {
+            pollfd pfd{listen_fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, 100) <= 0)
+                continue;
+            int fd = ::accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0)
+                continue;
+            timeval timeout{kSocketTimeoutSeconds, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            {
+                std::lock_guard<std::mutex> lock(connections_mutex_);
+                connections_.insert(fd);
+            }
+            std::thread([this, fd]
+                        {
+                            handle(fd);
+                            std::lock_guard<std::mutex> lock(connections_mutex_);
+                            ::close(fd);
+                            connections_.erase(fd);
+                            connections_done_.notify_all(); })
+                .detach();
+        }
+    }
+
+    void RepositoryServer::handle(int fd)
+    {
+        std::string request;
+        std::string error = recv_frame(fd, request);
+        if (!error.empty())
+        {
+            ByteWriter response;
+            response.put_string(error);
+            send_frame(fd, response.data());
+            return;
+        }
+
+        ByteReader r(request);
+        ByteWriter response;
+        std::lock_guard<std::mutex> lock(repo_.mutex());
+
+        switch (static_cast<SyncOp>(r.get_u8()))
+        {
+        case SyncOp::LIST_REFS:
+        {
+            response.put_string("");
+            response.put_u32(static_cast<uint32_t>(repo_.branches().size()));
+            for (const auto &[name, hash] : repo_.branches())
+            {
+                response.put_string(name);
+                response.put_string(hash);
+            }
+            break;
+        }
+        case SyncOp::FETCH:
+        {
+            std::vector<std::string> wants, haves;
+            uint32_t n = r.get_u32();
+            for (uint32_t i = 0; i < n && r.ok(); i++)
+                wants.push_back(r.get_string());
+            n = r.get_u32();
+            for (uint32_t i = 0; i < n && r.ok(); i++)
+                haves.push_back(r.get_string());
+            std::string pack;
+            std::string error = r.ok() ? serve_fetch(repo_, wants, haves, pack) : "Malformed request";
+            response.put_string(error);
+            response.put_string(pack);
+            break;
+        }
+        case SyncOp::PUSH:
+        {
+            std::string pack = r.get_string();
+            std::map<std::string, std::pair<std::string, std::string>> updates;
+            uint32_t n = r.get_u32();
+            for (uint32_t i = 0; i < n && r.ok(); i++)
+            {
+                std::string branch = r.get_string();
+                std::string old_hash = r.get_string();
+                updates[branch] = {old_hash, r.get_string()};
+            }
+            response.put_string(r.ok() ? serve_push(repo_, pack, updates) : "Malformed request");
+            break;
+        }
+        default:
+            response.put_string("Unknown request");
+            break;
+        }
+        send_frame(fd, response.data());
+    }
+
+    std::string write_metrics_file(const std::string &path)
+    {
+        return write_file_atomic(path, metrics().prometheus_text());
+    }
+
+    std::string MetricsServer::start()
+    {
+        std::string error = listen_unix(socket_path_, listen_fd_);
+        if (!error.empty())
+        {
+            return error;
+        }
+        running_ = true;
+        thread_ = std::thread([this]
+                              { serve_loop(); });
+        return "";
+    }
+
+    void MetricsServer::stop()
+    {
+        if (!running_.exchange(false))
+            return;
+        if (thread_.joinable())
+            thread_.join();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        ::unlink(socket_path_.c_str());
+    }
+
+    void MetricsServer::serve_loop()
+    {
+        while (running_)
+        {
+            pollfd pfd{listen_fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, 100) <= 0)
+                continue;
+            int fd = ::accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0)
+                continue;
+            send_all(fd, metrics().prometheus_text());
+            ::close(fd);
+        }
+    }
+
+    std::string SocketRemote::list_refs(std::map<std::string, std::string> &refs)
+    {
+        ByteWriter request;
+        request.put_u8(static_cast<uint8_t>(SyncOp::LIST_REFS));
+        std::string response;
+        std::string error = round_trip(request.data(), response);
+        if (!error.empty())
+            return error;
+
+        ByteReader r(response);
+        error = r.get_string();
+        uint32_t n = r.get_u32();
+        refs.clear();
+        for (uint32_t i = 0; i < n && r.ok(); i++)
+        {
+            std::string name = r.get_string();
+            refs[name] = r.get_string();
+        }
+        return r.ok() ? error : "Malformed response";
+    }
+
+    std::string SocketRemote::round_trip(const std::string &request, std::string &response)
+    {
+        sockaddr_un addr{};
+        if (socket_path_.size() >= sizeof(addr.sun_path))
+        {
+            return "Socket path too long: " + socket_path_;
+        }
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            return "Cannot create socket";
+        }
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+        {
+            ::close(fd);
+            return "Cannot connect to " + socket_path_;
+        }
+        std::string error;
+        if (!send_frame(fd, request))
+        {
+            error = "Connection lost while sending";
+        }
+        else
+        {
+            error = recv_frame(fd, response);
+        }
+        ::close(fd);
+        return error;
+    }
+
+    std::string fetch(Repository &local, Remote &remote, const std::string &remote_name, SyncStats *stats)
+    {
+        std::map<std::string, std::string> refs;
+        std::string error = remote.list_refs(refs);
+        if (!error.empty())
+            return error;
+
+        std::vector<std::string> wants, haves;
+        for (const auto &[name, hash] : refs)
+        {
+            if (!is_valid_branch_name(name) || !is_object_hash(hash))
+                return "Remote sent an invalid ref";
+            if (!local.has_commit(hash))
+                wants.push_back(hash);
+        }
+        for (const auto &[name, hash] : local.branches())
+        {
+            haves.push_back(hash);
+        }
+
+        if (!wants.empty())
+        {
+            std::string pack;
+            error = remote.fetch_pack(wants, haves, pack);
+            if (!error.empty())
+                return error;
+            if (stats != nullptr)
+                stats->pack_bytes += pack.size();
+            std::vector<std::string> applied;
+            error = apply_pack(local, pack, &applied);
+            if (!error.empty())
+                return error;
+            if (stats != nullptr)
+                stats->commits_sent += applied.size();
+        }
+
+        for (const auto &[name, hash] : refs)
+        {
+            local.set_branch(remote_name + "/" + name, hash);
+        }
+        return local.flush();
+    }
+
+    std::string push(Repository &local, Remote &remote, const std::string &branch, SyncStats *stats)
+    {
+        auto local_head = local.branch_head(branch);
+        if (!local_head.has_value())
+        {
+            return "No such branch '" + branch + "'";
+        }
+
+        std::map<std::string, std::string> refs;
+        std::string error = remote.list_refs(refs);
+        if (!error.empty())
+            return error;
+
+        std::string remote_head = refs.count(branch) ? refs[branch] : "";
+        if (remote_head == *local_head)
+        {
+            return ""; // already up to date
+        }
+        if (!remote_head.empty() && !local.is_ancestor(remote_head, *local_head))
+        {
+            return "Rejected non-fast-forward push of '" + branch + "'; fetch and merge first";
+        }
+
+        std::vector<std::string> haves;
+        for (const auto &[name, hash] : refs)
+        {
+            if (local.has_commit(hash))
+                haves.push_back(hash);
+        }
+        std::string pack = build_pack(local, {*local_head}, haves, stats);
+        return remote.push_pack(pack, {{branch, {remote_head, *local_head}}});
+    }
+
+    std::string clone(Remote &remote, Repository &local, SyncStats *stats)
+    {
+        if (!local.branches().empty())
+        {
+            return "Cannot clone into a repository that already has branches";
+        }
+        std::string error = fetch(local, remote, "origin", stats);
+        if (!error.empty())
+            return error;
+
+        std::vector<std::pair<std::string, std::string>> tracking;
+        for (const auto &[name, hash] : local.branches())
+        {
+            if (name.rfind("origin/", 0) == 0)
+                tracking.emplace_back(name.substr(7), hash);
+        }
+        for (const auto &[name, hash] : tracking)
+        {
+            local.set_branch(name, hash);
+        }
+        if (!tracking.empty())
+        {
+            // tracking is sorted by name
+            local.set_current_branch(local.branch_head("main").has_value() ? "main" : tracking.front().first);
+        }
+        return local.flush();
+    }
+
+    int64_t now_ms()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    std::optional<std::string> resolve_revision(const Repository &repo, const std::string &rev)
+    {
+        if (auto head = repo.branch_head(rev))
+        {
+            return head;
+        }
+        if (is_object_hash(rev) && repo.has_commit(rev))
+        {
+            return rev;
+        }
+        // Unique prefix among commits reachable from any branch
+        std::optional<std::string> match;
+        std::unordered_set<std::string> seen;
+        for (const auto &[name, head] : repo.branches())
+        {
+            for (const auto &hash : repo.log(head))
+            {
+                if (!seen.insert(hash).second)
+                    break;
+                if (hash.rfind(rev, 0) == 0)
+                {
+                    if (match.has_value() && *match != hash)
+                        return std::nullopt; // ambiguous
+                    match = hash;
+                }
+            }
+        }
+        return match;
+    }
+};
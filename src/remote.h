@@ -0,0 +1,401 @@
+/**
+ *  ReponoDB: Packs, remotes, and fetch / push / clone
+ */
+
+#ifndef REPONO_REMOTE_H
+#define REPONO_REMOTE_H
+
+#include "storage.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * PACKS
+     *
+     * A pack carries the commits and chunks one repository is missing.
+     * Chunks are delta-encoded against the chunk at the same position in the
+     * parent commit when the receiver is known to have it (or it appears
+     * earlier in the pack): a point update then ships one row instead of a
+     * whole chunk.
+     *
+     *   "RPK1"
+     *   u32 chunk count, then per chunk:
+     *       u8 kind (0 = full, 1 = delta), hash,
+     *       full:  rows
+     *       delta: base hash, u32 prefix rows kept, u32 suffix rows kept, middle rows
+     *   u32 commit count, then encoded CommitRecords, parents first
+     */
+    constexpr const char *kPackMagic = "RPK1";
+
+    struct SyncStats
+    {
+        size_t commits_sent = 0;
+        size_t chunks_sent = 0;
+        size_t chunks_delta = 0; // how many of chunks_sent were delta-encoded
+        size_t pack_bytes = 0;
+    };
+
+    /**
+     * Find the commits reachable from wants that the other side lacks
+     *
+     * The walk stops at any commit in haves; everything behind a have is
+     * assumed to be present on the other side.
+     *
+     * @param repo The repository that has the commits
+     * @param wants Heads the other side asked for
+     * @param haves Commits the other side already has
+     * @param common Filled with the have commits the walk ran into
+     * @return Missing commit hashes, parents before children
+     */
+    std::vector<std::string> find_missing_commits(const Repository &repo,
+                                                  const std::vector<std::string> &wants,
+                                                  const std::unordered_set<std::string> &haves,
+                                                  std::unordered_set<std::string> &common);
+
+    /**
+     * Build a pack with everything reachable from wants that is not behind haves
+     *
+     * @returns The encoded pack
+     */
+    std::string build_pack(const Repository &repo,
+                           const std::vector<std::string> &wants,
+                           const std::vector<std::string> &haves,
+                           SyncStats *stats = nullptr);
+
+    /**
+     * Unpack a pack into a repository
+     *
+     * Every chunk is re-hashed after reconstruction, and every commit must
+     * reference only chunks that are now present.
+     *
+     * @param applied Filled with the hashes of the commits in the pack
+     * @returns "" on success or an error message
+     */
+    std::string apply_pack(Repository &repo, const std::string &pack, std::vector<std::string> *applied = nullptr);
+
+    /**
+     * REMOTES
+     *
+     * The other end of a fetch or push. A remote lists its refs, produces
+     * packs for what we want, and accepts packs plus ref updates from us.
+     */
+    class Remote
+    {
+    public:
+        virtual ~Remote() = default;
+
+        virtual std::string list_refs(std::map<std::string, std::string> &refs) = 0;
+
+        virtual std::string fetch_pack(const std::vector<std::string> &wants,
+                                       const std::vector<std::string> &haves,
+                                       std::string &pack) = 0;
+
+        /**
+         * Apply a pack and move each branch in updates from its expected old
+         * hash to its new hash. Fails, moving no branch, if any branch moved
+         * in the meantime or an update is not a fast-forward.
+         *
+         * updates: branch -> (expected old hash, new hash)
+         */
+        virtual std::string push_pack(const std::string &pack,
+                                      const std::map<std::string, std::pair<std::string, std::string>> &updates) = 0;
+    };
+
+    /**
+     * Server-side handling shared by every transport
+     */
+    std::string serve_fetch(const Repository &repo,
+                            const std::vector<std::string> &wants,
+                            const std::vector<std::string> &haves,
+                            std::string &pack);
+
+    std::string serve_push(Repository &repo,
+                           const std::string &pack,
+                           const std::map<std::string, std::pair<std::string, std::string>> &updates);
+
+    /**
+     * A repository in another local directory
+     *
+     * The directory is opened lazily, so building a pack only reads the
+     * commit and chunk files on the missing side of the negotiation.
+     */
+    class DirectoryRemote : public Remote
+    {
+    public:
+        explicit DirectoryRemote(std::string dir) : dir_(std::move(dir)) {}
+
+        std::string list_refs(std::map<std::string, std::string> &refs) override;
+
+        std::string fetch_pack(const std::vector<std::string> &wants,
+                               const std::vector<std::string> &haves,
+                               std::string &pack) override
+        {
+            Repository repo;
+            std::string error = open(repo);
+            if (!error.empty())
+                return error;
+            return serve_fetch(repo, wants, haves, pack);
+        }
+
+        std::string push_pack(const std::string &pack,
+                              const std::map<std::string, std::pair<std::string, std::string>> &updates) override
+        {
+            Repository repo;
+            std::string error = open(repo);
+            if (!error.empty())
+                return error;
+            return serve_push(repo, pack, updates);
+        }
+
+    private:
+        std::string dir_;
+
+        /**
+         * Open the directory, which must already hold a repository (open()
+         * alone would create one at a mistyped path)
+         */
+        std::string open(Repository &repo) const;
+    };
+
+    // Socket framing: u32 length, then payload
+
+    /**
+     * Largest frame either side accepts; a pack bigger than this has to be
+     * sent as several pushes
+     */
+    constexpr uint32_t kMaxFrameBytes = 1u << 30;
+
+    /**
+     * How long a server waits on a silent connection before dropping it
+     */
+    constexpr int kSocketTimeoutSeconds = 30;
+
+    bool send_all(int fd, const std::string &data);
+
+    bool recv_all(int fd, char *buf, size_t len);
+
+    bool send_frame(int fd, const std::string &payload);
+
+    /**
+     * Receive one frame. The payload grows as its bytes arrive, so a
+     * length the peer never sends is not allocated up front.
+     *
+     * @returns "" on success or an error message
+     */
+    std::string recv_frame(int fd, std::string &payload);
+
+    enum class SyncOp : uint8_t
+    {
+        LIST_REFS = 1,
+        FETCH = 2,
+        PUSH = 3
+    };
+
+    /**
+     * Bind and listen on a Unix domain socket, replacing a stale socket file
+     *
+     * @param fd Set to the listening descriptor
+     * @returns "" on success or an error message
+     */
+    std::string listen_unix(const std::string &path, int &fd);
+
+    /**
+     * Serves a repository over a local (Unix domain) socket
+     *
+     * Each connection carries one request frame and one response frame.
+     * The response starts with an error string ("" on success). Every
+     * connection is handled on its own thread and dropped after
+     * kSocketTimeoutSeconds of silence, so a stalled client holds up
+     * neither other clients nor stop(). Requests run one at a time under
+     * the repository's mutex.
+     */
+    class RepositoryServer
+    {
+    public:
+        RepositoryServer(Repository &repo, std::string socket_path)
+            : repo_(repo), socket_path_(std::move(socket_path)), listen_fd_(-1), running_(false) {}
+
+        ~RepositoryServer() { stop(); }
+
+        RepositoryServer(const RepositoryServer &) = delete;
+        RepositoryServer &operator=(const RepositoryServer &) = delete;
+
+        /**
+         * Bind the socket and start serving on a background thread
+         *
+         * @returns "" on success or an error message
+         */
+        std::string start();
+
+        void stop();
+
+    private:
+        Repository &repo_;
+        std::string socket_path_;
+        int listen_fd_;
+        std::atomic<bool> running_;
+        std::thread thread_;
+
+        std::mutex connections_mutex_;
+        std::condition_variable connections_done_;
+        std::set<int> connections_; // open connections, shut down by stop()
+
+        void serve_loop();
+
+        void handle(int fd);
+    };
+
+    /**
+     * Write the Prometheus text dump of every metric to a file (atomically,
+     * so a node_exporter textfile collector never reads half a dump)
+     *
+     * @returns "" on success or an error message
+     */
+    std::string write_metrics_file(const std::string &path);
+
+    /**
+     * Serves the Prometheus text dump on a local socket: every connection
+     * gets the current dump and is closed (e.g. `socat - UNIX:<path>`)
+     */
+    class MetricsServer
+    {
+    public:
+        explicit MetricsServer(std::string socket_path)
+            : socket_path_(std::move(socket_path)), listen_fd_(-1), running_(false) {}
+
+        ~MetricsServer() { stop(); }
+
+        MetricsServer(const MetricsServer &) = delete;
+        MetricsServer &operator=(const MetricsServer &) = delete;
+
+        /**
+         * Bind the socket and start serving on a background thread
+         *
+         * @returns "" on success or an error message
+         */
+        std::string start();
+
+        void stop();
+
+    private:
+        std::string socket_path_;
+        int listen_fd_;
+        std::atomic<bool> running_;
+        std::thread thread_;
+
+        void serve_loop();
+    };
+
+    /**
+     * A repository served by RepositoryServer on a local socket
+     */
+    class SocketRemote : public Remote
+    {
+    public:
+        explicit SocketRemote(std::string socket_path) : socket_path_(std::move(socket_path)) {}
+
+        std::string list_refs(std::map<std::string, std::string> &refs) override;
+
+        std::string fetch_pack(const std::vector<std::string> &wants,
+                               const std::vector<std::string> &haves,
+                               std::string &pack) override
+        {
+            ByteWriter request;
+            request.put_u8(static_cast<uint8_t>(SyncOp::FETCH));
+            request.put_u32(static_cast<uint32_t>(wants.size()));
+            for (const auto &h : wants)
+                request.put_string(h);
+            request.put_u32(static_cast<uint32_t>(haves.size()));
+            for (const auto &h : haves)
+                request.put_string(h);
+
+            std::string response;
+            std::string error = round_trip(request.data(), response);
+            if (!error.empty())
+                return error;
+            ByteReader r(response);
+            error = r.get_string();
+            pack = r.get_string();
+            return r.ok() ? error : "Malformed response";
+        }
+
+        std::string push_pack(const std::string &pack,
+                              const std::map<std::string, std::pair<std::string, std::string>> &updates) override
+        {
+            ByteWriter request;
+            request.put_u8(static_cast<uint8_t>(SyncOp::PUSH));
+            request.put_string(pack);
+            request.put_u32(static_cast<uint32_t>(updates.size()));
+            for (const auto &[branch, change] : updates)
+            {
+                request.put_string(branch);
+                request.put_string(change.first);
+                request.put_string(change.second);
+            }
+            std::string response;
+            std::string error = round_trip(request.data(), response);
+            if (!error.empty())
+                return error;
+            ByteReader r(response);
+            error = r.get_string();
+            return r.ok() ? error : "Malformed response";
+        }
+
+    private:
+        std::string socket_path_;
+
+        std::string round_trip(const std::string &request, std::string &response);
+    };
+
+    /**
+     * Fetch every branch of a remote into remote-tracking branches
+     *
+     * Remote branch "main" becomes local branch "<remote_name>/main".
+     * All local branch heads are offered as haves, so only commits and
+     * chunks we lack are transferred.
+     *
+     * @returns "" on success or an error message
+     */
+    std::string fetch(Repository &local, Remote &remote, const std::string &remote_name, SyncStats *stats = nullptr);
+
+    /**
+     * Push a local branch to the same-named branch on a remote
+     *
+     * Only fast-forward pushes are allowed: the remote head must be an
+     * ancestor of the local head.
+     *
+     * @returns "" on success or an error message
+     */
+    std::string push(Repository &local, Remote &remote, const std::string &branch, SyncStats *stats = nullptr);
+
+    /**
+     * Clone a remote into an empty repository, checking out its "main"
+     * branch (or, without one, its first branch by name)
+     *
+     * @returns "" on success or an error message, e.g. if local has branches
+     */
+    std::string clone(Remote &remote, Repository &local, SyncStats *stats = nullptr);
+
+    int64_t now_ms();
+
+    /**
+     * Resolve a revision (branch name, full commit hash or unique hash prefix)
+     *
+     * @returns The commit hash, or std::nullopt if nothing matches
+     */
+    std::optional<std::string> resolve_revision(const Repository &repo, const std::string &rev);
+};
+
+#endif // REPONO_REMOTE_H
@@ -0,0 +1,178 @@
+/**
+ *  ReponoDB: Read replicas
+ */
+
+#include "replica.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <poll.h>
+
+namespace repono
+{
+    Replica::Replica(Repository &local, std::unique_ptr<Remote> primary, std::string branch)
+        : local_(local), primary_(std::move(primary)), branch_(std::move(branch)),
+          session_(local, true), running_(false), oldest_unapplied_ms_(0)
+    {
+        std::lock_guard<std::mutex> lock(local_.mutex());
+        local_.set_current_branch(branch_);
+        status_.applied_hash = local_.head();
+    }
+
+    std::string Replica::fail(const std::string &error)
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_.last_error = error;
+        return error;
+    }
+
+    void Replica::count_behind(const std::string &head, const std::string &applied, size_t &commits,
+                               int64_t &oldest_ms) const
+    {
+        commits = 0;
+        oldest_ms = 0;
+        std::string current = head;
+        while (!current.empty() && current != applied)
+        {
+            const CommitRecord *record = local_.get_record(current);
+            if (record == nullptr)
+                break;
+            commits++;
+            oldest_ms = record->timestamp * 1000;
+            current = record->parent_hash;
+        }
+    }
+
+    std::string Replica::poll()
+    {
+        std::map<std::string, std::string> refs;
+        std::string error = primary_->list_refs(refs);
+        if (error.empty() && refs.find(branch_) == refs.end())
+        {
+            error = "Primary has no branch '" + branch_ + "'";
+        }
+        if (!error.empty())
+        {
+            return fail(error);
+        }
+        std::string primary_head = refs[branch_];
+
+        std::string applied;
+        {
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            applied = status_.applied_hash;
+            if (primary_head != status_.primary_hash && primary_head != applied)
+            {
+                // Unknown until the new commits are here to count
+                status_.lag_commits.reset();
+                status_.lag_ms.reset();
+                oldest_unapplied_ms_ = 0;
+            }
+            status_.primary_hash = primary_head;
+        }
+        if (primary_head == applied)
+        {
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            status_.last_poll_ms = now_ms();
+            status_.last_error.clear();
+            return "";
+        }
+
+        // The pack is fetched without holding the repository, so queries
+        // and status() carry on meanwhile
+        std::vector<std::string> haves;
+        bool present;
+        {
+            std::lock_guard<std::mutex> lock(local_.mutex());
+            if (!local_.head().empty())
+                haves.push_back(local_.head());
+            present = local_.has_commit(primary_head);
+        }
+        std::string pack;
+        if (!present)
+        {
+            error = primary_->fetch_pack({primary_head}, haves, pack);
+            if (!error.empty())
+                return fail(error);
+        }
+
+        // Store the objects and publish the lag before moving the branch
+        std::vector<std::string> fetched;
+        size_t behind = 0;
+        int64_t oldest_ms = 0;
+        {
+            std::lock_guard<std::mutex> lock(local_.mutex());
+            if (!pack.empty())
+                error = apply_pack(local_, pack, &fetched);
+            if (error.empty())
+                count_behind(primary_head, applied, behind, oldest_ms);
+        }
+        if (!error.empty())
+        {
+            return fail(error);
+        }
+        {
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            status_.lag_commits = behind;
+            oldest_unapplied_ms_ = oldest_ms;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(local_.mutex());
+            std::optional<std::string> previous = local_.branch_head(branch_);
+            local_.set_branch(branch_, primary_head);
+            error = local_.flush();
+            if (!error.empty() && previous.has_value())
+                local_.set_branch(branch_, *previous);
+            else if (!error.empty())
+                local_.remove_branch(branch_);
+        }
+        if (!error.empty())
+        {
+            return fail(error);
+        }
+
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_.applied_hash = primary_head;
+        status_.commits_applied += fetched.size();
+        status_.lag_commits = 0;
+        status_.lag_ms = 0;
+        oldest_unapplied_ms_ = 0;
+        status_.last_poll_ms = now_ms();
+        status_.last_error.clear();
+        return "";
+    }
+
+    void Replica::start(int interval_ms)
+    {
+        if (running_.exchange(true))
+            return;
+        thread_ = std::thread([this, interval_ms]
+                              {
+            while (running_)
+            {
+                poll();
+                for (int waited = 0; running_ && waited < interval_ms; waited += 10)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            } });
+    }
+
+    void Replica::stop()
+    {
+        if (!running_.exchange(false))
+            return;
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    ReplicationStatus Replica::status() const
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        ReplicationStatus result = status_;
+        if (result.lag_commits.value_or(0) > 0)
+            result.lag_ms = std::max<int64_t>(0, now_ms() - oldest_unapplied_ms_);
+        return result;
+    }
+};
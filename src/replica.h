@@ -0,0 +1,89 @@
+/**
+ *  ReponoDB: Read replicas
+ */
+
+#ifndef REPONO_REPLICA_H
+#define REPONO_REPLICA_H
+
+#include "remote.h"
+#include "session.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace repono
+{
+    class Replica
+    {
+    public:
+        Replica(Repository &local, std::unique_ptr<Remote> primary, std::string branch = "main");
+
+        ~Replica() { stop(); }
+
+        Replica(const Replica &) = delete;
+        Replica &operator=(const Replica &) = delete;
+
+        /**
+         * Catch up with the primary once
+         *
+         * @returns "" on success or an error message
+         */
+        std::string poll();
+
+        /**
+         * Poll the primary on a background thread every interval_ms
+         */
+        void start(int interval_ms);
+
+        void stop();
+
+        /**
+         * Run a read-only query at the latest applied commit
+         */
+        QueryResult query(const std::string &sql)
+        {
+            std::lock_guard<std::mutex> lock(session_mutex_);
+            return session_.execute(sql);
+        }
+
+        /**
+         * Replication lag as of now
+         *
+         * lag_commits counts commits between the applied commit and the
+         * primary head seen at the last poll. lag_ms is the time since the
+         * oldest of them was committed on the primary. Both are published
+         * as soon as the commits are fetched, before they are applied, and
+         * reading them never waits for a poll in progress.
+         */
+        ReplicationStatus status() const;
+
+    private:
+        Repository &local_;
+        std::unique_ptr<Remote> primary_;
+        std::string branch_;
+        Session session_;
+        std::mutex session_mutex_;
+
+        std::atomic<bool> running_;
+        std::thread thread_;
+
+        mutable std::mutex status_mutex_; // guards status_ and oldest_unapplied_ms_ only
+        ReplicationStatus status_;
+        int64_t oldest_unapplied_ms_; // primary commit time of the oldest commit not applied yet
+
+        std::string fail(const std::string &error);
+
+        /**
+         * Count the first-parent commits from head back to applied, and
+         * find when the oldest of them was made (local_ must hold them)
+         */
+        void count_behind(const std::string &head, const std::string &applied, size_t &commits,
+                          int64_t &oldest_ms) const;
+    };
+};
+
+#endif // REPONO_REPLICA_H
@@ -0,0 +1,58 @@
+/**
+ *  ReponoDB: Column definitions and table schemas
+ */
+
+#include "repono/schema.h"
+#include "trace.h"
+
+namespace repono
+{
+    Schema &Schema::operator=(const Schema &other)
+    {
+        if (this != &other)
+        { // Self-assignment check
+            columns_ = other.columns_;
+            column_indices_ = other.column_indices_;
+        }
+        return *this;
+    }
+
+    std::optional<size_t> Schema::get_column_index(const std::string &name) const
+    {
+        auto it = column_indices_.find(name);
+        if (it != column_indices_.end()) // checking that it doesnt point to the end of the array
+        {
+            return it->second;
+        }
+        return std::nullopt;
+    }
+
+    const ColumnDef *Schema::get_column(const std::string &name) const
+    {
+        auto idx = get_column_index(name);
+        if (idx.has_value())
+        {
+            return &columns_[idx.value()];
+        }
+        return nullptr;
+    }
+
+    std::string Schema::validate_row(const Row &row) const
+    {
+        REPONO_TRACE_SPAN("Schema::validate_row");
+        if (row.size() != columns_.size())
+        {
+            return "Expected " + std::to_string(columns_.size()) +
+                   " columns, got " + std::to_string(row.size());
+        }
+        for (size_t i = 0; i < row.size(); i++)
+        {
+            std::string error = columns_[i].validate(row[i]);
+            if (!error.empty())
+            {
+                return error;
+            }
+        }
+        return "";
+    }
+};
@@ -0,0 +1,1484 @@
+/**
+ *  ReponoDB: Sessions, their working set and statement execution
+ */
+
+#include "session.h"
+#include "repono/hash.h"
+#include "export.h"
+#include "import.h"
+#include "lsm.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <variant>
+
+namespace repono
+{
+    QueryResult Session::execute(const std::string &sql)
+    {
+        auto start = std::chrono::steady_clock::now();
+        QueryStats stats;
+        QueryStatsScope scope(stats);
+        std::string error;
+        auto stmt = parse_sql(sql, error);
+        QueryResult result = stmt.has_value() ? run(*stmt) : QueryResult::failure(error);
+        log_if_slow(start, stats, result, sql);
+        return result;
+    }
+
+    QueryResult Session::execute(Statement &stmt, const std::string &sql)
+    {
+        auto start = std::chrono::steady_clock::now();
+        QueryStats stats;
+        QueryStatsScope scope(stats);
+        QueryResult result = run(stmt);
+        log_if_slow(start, stats, result, sql, sql.empty() ? statement_type_to_string(stmt.type) + " " + stmt.table : "");
+        return result;
+    }
+
+    QueryResult Session::run(Statement &stmt)
+    {
+        StatementMetrics &stats = statement_metrics(stmt.type);
+        stats.executed.add();
+
+        // Everything the statement holds is given back when this goes out of scope
+        MemoryTracker memory("query", query_memory_limit_, {&session_memory_, &memory_pools().query});
+        QueryStats *query = current_query_stats();
+        if (query != nullptr)
+            query->memory = &memory;
+
+        QueryResult result;
+        {
+            ScopedTimer timer(stats.seconds);
+            result = dispatch(stmt);
+        }
+        if (!result.ok())
+            stats.failed.add();
+        if (query != nullptr)
+        {
+            query->memory = nullptr;
+            if (query->plan.empty())
+                query->plan.push_back(statement_type_to_string(stmt.type));
+        }
+        return result;
+    }
+
+    Session::StatementMetrics &Session::statement_metrics(StatementType type)
+    {
+        static std::vector<StatementMetrics> by_type = []
+        {
+            std::vector<StatementMetrics> all;
+            for (int t = 0; t <= static_cast<int>(StatementType::COPY); t++) // COPY is the last type
+            {
+                std::string labels = "type=\"" + statement_type_to_string(static_cast<StatementType>(t)) + "\"";
+                all.push_back(StatementMetrics{
+                    metrics().counter("repono_statements_total", "Statements executed, by type", labels),
+                    metrics().counter("repono_statement_errors_total", "Statements that failed, by type", labels),
+                    metrics().histogram("repono_exec_seconds", "Time spent executing statements, by type", 1e-9, labels)});
+            }
+            return all;
+        }();
+        return by_type[static_cast<size_t>(type)];
+    }
+
+    QueryResult Session::dispatch(Statement &stmt)
+    {
+        REPONO_TRACE_SPAN("Session::execute");
+        std::lock_guard<std::mutex> lock(repo_.mutex());
+
+        bool reads_only = stmt.type == StatementType::SELECT || stmt.type == StatementType::LOG ||
+                          stmt.type == StatementType::BLAME || stmt.type == StatementType::HISTORY ||
+                          stmt.type == StatementType::SHOW ||
+                          (stmt.type == StatementType::COPY && !stmt.copy_from);
+        if (read_only_ && !reads_only)
+        {
+            return QueryResult::failure("Read-only session: only queries are allowed");
+        }
+        sync_with_head();
+        if (slow_log_ != nullptr)
+            last_branch_ = repo_.current_branch();
+
+        switch (stmt.type)
+        {
+        case StatementType::SELECT:
+            return execute_select(stmt);
+        case StatementType::CREATE_TABLE:
+            return execute_create(stmt);
+        case StatementType::DROP_TABLE:
+            return execute_drop(stmt);
+        case StatementType::INSERT:
+            return execute_insert(stmt);
+        case StatementType::UPDATE:
+            return execute_update(stmt);
+        case StatementType::DELETE:
+            return execute_delete(stmt);
+        case StatementType::COMMIT:
+            return execute_commit(stmt);
+        case StatementType::CHECKOUT:
+            return execute_checkout(stmt);
+        case StatementType::MERGE:
+            return execute_merge(stmt);
+        case StatementType::LOG:
+            return execute_log();
+        case StatementType::BLAME:
+        case StatementType::HISTORY:
+            return execute_lineage(stmt);
+        case StatementType::SHOW:
+            return stmt.show_target == "MEMORY" ? execute_show_memory() : execute_show();
+        case StatementType::COPY:
+            return stmt.copy_from ? execute_copy_from(stmt) : execute_copy(stmt);
+        }
+        return QueryResult::failure("Unsupported statement");
+    }
+
+    void Session::sync_with_head()
+    {
+        std::string head = repo_.head();
+        if (loaded_ && (head == base_hash_ || dirty_))
+            return;
+        load_working_set(head);
+    }
+
+    void Session::load_working_set(const std::string &hash)
+    {
+        // Tables that may be reused: this branch's cached state, or else
+        // the working set being replaced. Neither is charged while here.
+        std::map<std::string, WorkingTable> previous;
+        auto cached = branch_cache_.find(repo_.current_branch());
+        if (cached != branch_cache_.end())
+        {
+            branch_cache_memory_.release(cached->second.bytes);
+            previous = std::move(cached->second.tables);
+            branch_cache_.erase(cached);
+            for (auto &[name, table] : tables_)
+                forget_table(table);
+        }
+        else
+        {
+            for (auto &[name, table] : tables_)
+                uncharge_table(table);
+            previous = std::move(tables_);
+        }
+        tables_.clear();
+        outside_.clear();
+        base_hash_ = hash;
+        loaded_ = true;
+        dirty_ = false;
+        if (hash.empty())
+            return;
+
+        const CommitRecord *record = repo_.get_record(hash);
+        if (record == nullptr)
+            return;
+        for (const auto &[name, manifest] : record->tables)
+        {
+            if (!sparse_tables_.empty() && sparse_tables_.count(name) == 0)
+            {
+                outside_[name] = manifest;
+                continue;
+            }
+            WorkingTable &table = tables_[name];
+            auto old = previous.find(name);
+            if (old != previous.end() && old->second.rows.references(manifest) &&
+                schemas_equal(old->second.schema, manifest.schema))
+            {
+                // Unchanged: keep the chunks read so far and the key index
+                table = std::move(old->second);
+                index_memory_.reserve(table.index_bytes);
+                continue;
+            }
+            table.schema = manifest.schema;
+            table.key_columns = primary_key_columns(manifest.schema);
+            table.rows = WorkingRows(repo_, manifest);
+            if (old != previous.end())
+                table.rows.adopt_chunks(old->second.rows);
+            for (const auto &[branch, state] : branch_cache_)
+            {
+                auto other = state.tables.find(name);
+                if (other != state.tables.end())
+                    table.rows.adopt_chunks(other->second.rows);
+            }
+        }
+    }
+
+    void Session::stash_working_set()
+    {
+        if (branch_cache_limit_ == 0 || !loaded_ || dirty_)
+            return;
+        BranchState &state = branch_cache_[repo_.current_branch()];
+        branch_cache_memory_.release(state.bytes);
+        state.bytes = 0;
+        for (auto &[name, table] : tables_)
+        {
+            state.bytes += table.index_bytes + table.rows.loaded_bytes();
+            uncharge_table(table);
+        }
+        state.tables = std::move(tables_);
+        state.last_used = ++branch_cache_clock_;
+        branch_cache_memory_.reserve(state.bytes);
+        tables_.clear();
+        outside_.clear();
+        loaded_ = false;
+    }
+
+    void Session::trim_branch_cache()
+    {
+        while (!branch_cache_.empty() && branch_cache_memory_.used() > branch_cache_limit_)
+        {
+            auto oldest = branch_cache_.begin();
+            for (auto it = branch_cache_.begin(); it != branch_cache_.end(); ++it)
+            {
+                if (it->second.last_used < oldest->second.last_used)
+                    oldest = it;
+            }
+            branch_cache_memory_.release(oldest->second.bytes);
+            branch_cache_.erase(oldest);
+        }
+    }
+
+    void Session::settle_table(WorkingTable &table)
+    {
+        uint64_t index_bytes = table.rows.index_bytes();
+        if (index_bytes != table.index_bytes)
+        {
+            index_memory_.release(table.index_bytes);
+            index_memory_.reserve(index_bytes);
+            table.index_bytes = index_bytes;
+        }
+
+        uint64_t bytes = table.rows.owned_bytes();
+        if (bytes > table.bytes)
+        {
+            working_set_memory_.reserve(bytes - table.bytes);
+            table.bytes = bytes;
+        }
+        else
+        {
+            shrink_table(table, table.bytes - bytes);
+        }
+    }
+
+    void Session::uncharge_table(WorkingTable &table)
+    {
+        shrink_table(table, table.bytes);
+        index_memory_.release(table.index_bytes);
+    }
+
+    std::string Session::grow_table(WorkingTable &table, uint64_t bytes)
+    {
+        std::string error = working_set_memory_.try_reserve(bytes);
+        if (error.empty())
+            table.bytes += bytes;
+        return error;
+    }
+
+    void Session::shrink_table(WorkingTable &table, uint64_t bytes)
+    {
+        bytes = std::min(bytes, table.bytes);
+        table.bytes -= bytes;
+        working_set_memory_.release(bytes);
+    }
+
+    void Session::note_table_scan(const Statement &stmt)
+    {
+        QueryStats *stats = current_query_stats();
+        if (stats == nullptr)
+            return;
+        stats->rows_scanned += tables_.at(stmt.table).rows.size();
+        note_plan("Scan(" + stmt.table + ", working set)");
+        if (stmt.where)
+            note_plan("Filter(" + expr_to_string(*stmt.where) + ")");
+    }
+
+    KeyRange Session::key_range(const WorkingTable &table, const Statement &stmt)
+    {
+        KeyRange range;
+        if (!table.key_columns.empty())
+            narrow_key_range(stmt.where.get(), table.schema.get_columns()[table.key_columns[0]].name, range);
+        if (range.bounded() && table.rows.storage() == TableStorage::LSM)
+            note_plan("Key range(" + table.schema.get_columns()[table.key_columns[0]].name + ")");
+        return range;
+    }
+
+    void Session::coerce_row(const Schema &schema, Row &row)
+    {
+        const auto &columns = schema.get_columns();
+        for (size_t i = 0; i < row.size() && i < columns.size(); i++)
+        {
+            if (columns[i].type == DataType::FLOAT && std::holds_alternative<int64_t>(row[i]))
+                row[i] = static_cast<double>(std::get<int64_t>(row[i]));
+        }
+    }
+
+    QueryResult Session::execute_select(Statement &stmt)
+    {
+        if (!stmt.source_function.empty())
+        {
+            return execute_table_function(stmt);
+        }
+        if (stmt.system_time)
+        {
+            return execute_history_scan(stmt);
+        }
+        if (!stmt.as_of.empty())
+        {
+            auto hash = resolve_revision(repo_, stmt.as_of);
+            if (!hash.has_value())
+            {
+                return QueryResult::failure("Unknown revision '" + stmt.as_of + "'");
+            }
+            Schema schema;
+            std::vector<Row> rows;
+            std::string error = load_table_at(*hash, stmt.table, schema, rows);
+            if (!error.empty())
+            {
+                return QueryResult::failure(error);
+            }
+            note_plan("Scan(" + stmt.table + " AS OF " + hash->substr(0, 8) + ", " + std::to_string(rows.size()) + " rows)");
+            return run_select(stmt, schema, rows);
+        }
+
+        WorkingTable *table = find_table(stmt.table);
+        if (table == nullptr)
+        {
+            return missing_table(stmt.table);
+        }
+        note_plan("Scan(" + stmt.table + ", working set, " + std::to_string(table->rows.size()) + " rows)");
+        const WorkingRows &rows = table->rows;
+        return run_select(
+            stmt, table->schema,
+            [&rows](const RowSink &sink)
+            { rows.for_each(sink); },
+            true);
+    }
+
+    QueryResult Session::execute_table_function(Statement &stmt)
+    {
+        REPONO_TRACE_SPAN("Session::execute_table_function");
+        if (stmt.source_function != "DIFF")
+        {
+            return QueryResult::failure("Unknown table function '" + stmt.source_function + "'");
+        }
+        if (stmt.source_args.size() != 3)
+        {
+            return QueryResult::failure("diff() takes (table, from, to)");
+        }
+        const std::string &table = stmt.source_args[0];
+
+        const TableManifest *sides[2] = {nullptr, nullptr};
+        for (int i = 0; i < 2; i++)
+        {
+            const std::string &rev = stmt.source_args[i + 1];
+            auto hash = resolve_revision(repo_, rev);
+            const CommitRecord *record = hash.has_value() ? repo_.get_record(*hash) : nullptr;
+            if (record == nullptr)
+            {
+                return QueryResult::failure("Unknown revision '" + rev + "'");
+            }
+            auto it = record->tables.find(table);
+            if (it != record->tables.end())
+                sides[i] = &it->second;
+        }
+        const TableManifest *from = sides[0];
+        const TableManifest *to = sides[1];
+        if (from == nullptr && to == nullptr)
+        {
+            return QueryResult::failure("Table '" + table + "' exists in neither revision");
+        }
+
+        const Schema &from_schema = from ? from->schema : to->schema;
+        const Schema &to_schema = to ? to->schema : from->schema;
+        Schema schema = diff_source_schema(from_schema, to_schema);
+        size_t from_width = from_schema.num_columns();
+        size_t to_width = to_schema.num_columns();
+
+        // Rows pair up by primary key, so a bound on either side's key bounds both
+        KeyRange key_range;
+        std::vector<size_t> key_columns = primary_key_columns(to_schema);
+        if (!key_columns.empty() && key_columns == primary_key_columns(from_schema))
+        {
+            narrow_key_range(stmt.where.get(), "from_" + from_schema.get_columns()[key_columns[0]].name, key_range);
+            narrow_key_range(stmt.where.get(), "to_" + to_schema.get_columns()[key_columns[0]].name, key_range);
+        }
+
+        QueryStats *query = current_query_stats();
+        size_t plan_step = query ? query->plan.size() : 0;
+        note_plan("DiffScan(" + table + ", " + stmt.source_args[1] + ".." + stmt.source_args[2] +
+                  (key_range.bounded() ? ", key range" : "") + ")");
+
+        std::string scan_error;
+        DiffStats diff_stats;
+        auto scan = [&](const RowSink &sink)
+        {
+            Row out;
+            scan_error = diff_table_rows(repo_, from, to, [&](RowDiff::Type type, const Row *old_row, const Row *new_row)
+                                         {
+                out.clear();
+                out.push_back(change_type_to_string(type));
+                if (old_row != nullptr)
+                    out.insert(out.end(), old_row->begin(), old_row->end());
+                out.resize(1 + from_width);
+                if (new_row != nullptr)
+                    out.insert(out.end(), new_row->begin(), new_row->end());
+                out.resize(1 + from_width + to_width);
+                return sink(out); }, &diff_stats, key_range);
+        };
+
+        QueryResult result = run_select(stmt, schema, scan, false);
+        if (query != nullptr)
+        {
+            query->plan[plan_step].pop_back();
+            query->plan[plan_step] += ", " + std::to_string(diff_stats.chunks_scanned) + " chunks read, " +
+                                      std::to_string(diff_stats.chunks_skipped) + " skipped)";
+        }
+        if (!scan_error.empty())
+        {
+            return QueryResult::failure(scan_error);
+        }
+        return result;
+    }
+
+    QueryResult Session::execute_history_scan(Statement &stmt)
+    {
+        REPONO_TRACE_SPAN("Session::execute_history_scan");
+        if (stmt.system_time_from > stmt.system_time_to)
+        {
+            return QueryResult::failure("SYSTEM_TIME range is empty");
+        }
+
+        // First-parent history, oldest first
+        std::vector<const CommitRecord *> history;
+        for (const auto &hash : repo_.log(base_hash_))
+        {
+            history.push_back(repo_.get_record(hash));
+        }
+        std::reverse(history.begin(), history.end());
+
+        // The commit in effect at t1, then the commits inside (t1, t2]
+        size_t first = 0;
+        while (first + 1 < history.size() && history[first + 1]->timestamp <= stmt.system_time_from)
+        {
+            first++;
+        }
+        size_t last = first;
+        while (last < history.size() && history[last]->timestamp <= stmt.system_time_to)
+        {
+            last++;
+        }
+        if (history.empty() || history[first]->timestamp > stmt.system_time_to)
+        {
+            last = first; // nothing in range
+        }
+
+        // Columns come from the newest schema of the table in range
+        const TableManifest *newest = nullptr;
+        for (size_t i = first; i < last; i++)
+        {
+            auto it = history[i]->tables.find(stmt.table);
+            if (it != history[i]->tables.end())
+                newest = &it->second;
+        }
+        if (newest == nullptr && !history.empty())
+        {
+            // Nothing in range: an empty result with the current columns
+            auto it = history.back()->tables.find(stmt.table);
+            if (it != history.back()->tables.end())
+                newest = &it->second;
+        }
+        if (newest == nullptr)
+        {
+            return QueryResult::failure("Table '" + stmt.table + "' does not exist in committed history");
+        }
+        Schema schema;
+        schema.add_column(ColumnDef("commit_hash", DataType::VARCHAR, false, false));
+        schema.add_column(ColumnDef("commit_timestamp", DataType::TIMESTAMP, false, false));
+        for (const auto &col : newest->schema.get_columns())
+        {
+            schema.add_column(col);
+        }
+        size_t width = schema.num_columns();
+        note_plan("HistoryScan(" + stmt.table + ", " + std::to_string(last - first) + " commits)");
+
+        std::string scan_error;
+        auto scan = [&](const RowSink &sink)
+        {
+            Row out;
+            bool keep_going = true;
+            const TableManifest *previous = nullptr;
+
+            for (size_t i = first; i < last && keep_going && scan_error.empty(); i++)
+            {
+                const CommitRecord *record = history[i];
+                auto it = record->tables.find(stmt.table);
+                const TableManifest *current = it != record->tables.end() ? &it->second : nullptr;
+
+                // previous is nullptr for the first commit, so all its rows come out as ADDED
+                if (current != nullptr &&
+                    !(previous != nullptr && previous->chunk_hashes == current->chunk_hashes))
+                {
+                    scan_error = diff_table_rows(repo_, previous, current, [&](RowDiff::Type type, const Row *, const Row *new_row)
+                                                 {
+                        if (type == RowDiff::Type::DELETED)
+                            return true;
+                        out.clear();
+                        out.push_back(record->hash);
+                        out.push_back(record->timestamp);
+                        out.insert(out.end(), new_row->begin(), new_row->end());
+                        out.resize(width);
+                        keep_going = sink(out);
+                        return keep_going; });
+                }
+                previous = current;
+            }
+        };
+
+        QueryResult result = run_select(stmt, schema, scan, false);
+        if (!scan_error.empty())
+        {
+            return QueryResult::failure(scan_error);
+        }
+        return result;
+    }
+
+    std::string Session::load_table_at(const std::string &hash, const std::string &table, Schema &schema, std::vector<Row> &rows)
+    {
+        const CommitRecord *record = repo_.get_record(hash);
+        const TableManifest *manifest = nullptr;
+        if (record != nullptr)
+        {
+            auto it = record->tables.find(table);
+            if (it != record->tables.end())
+                manifest = &it->second;
+        }
+        if (manifest == nullptr)
+            return "Table '" + table + "' does not exist at " + hash.substr(0, 8);
+        schema = manifest->schema;
+        QueryStats *stats = current_query_stats();
+        if (manifest->storage == TableStorage::LSM)
+        {
+            std::string error = read_lsm_rows(repo_, *manifest, rows);
+            if (!error.empty())
+                return error + " of table '" + table + "'";
+            if (stats != nullptr)
+            {
+                uint64_t bytes = 0;
+                for (const auto &row : rows)
+                    bytes += estimate_row_bytes(row);
+                return stats->add_memory(bytes);
+            }
+            return "";
+        }
+        rows.reserve(manifest->row_count);
+        for (const auto &chunk_hash : manifest->chunk_hashes)
+        {
+            ChunkPtr chunk = repo_.get_chunk(chunk_hash);
+            if (chunk == nullptr)
+                return "Missing chunk " + chunk_hash.substr(0, 8) + " of table '" + table + "'";
+            if (stats != nullptr)
+            {
+                uint64_t bytes = 0;
+                for (const auto &row : chunk->rows)
+                    bytes += estimate_row_bytes(row);
+                std::string error = stats->add_memory(bytes);
+                if (!error.empty())
+                    return error;
+            }
+            rows.insert(rows.end(), chunk->rows.begin(), chunk->rows.end());
+        }
+        return "";
+    }
+
+    QueryResult Session::execute_copy(Statement &stmt)
+    {
+        REPONO_TRACE_SPAN("Session::execute_copy");
+        ExportOptions options;
+        options.header = stmt.copy_header;
+        if (!stmt.copy_format.empty())
+        {
+            auto format = export_format(stmt.copy_format);
+            if (!format.has_value())
+            {
+                return QueryResult::failure("Unknown COPY format '" + stmt.copy_format + "'; expected CSV or JSONL");
+            }
+            options.format = *format;
+        }
+
+        std::vector<std::string> names;
+        std::vector<RowRange> ranges;
+        std::vector<ChunkPtr> chunks; // keeps AS OF rows alive
+        std::vector<Row> merged;      // working rows with a pending delta, or an LSM table's runs
+        QueryResult source;
+        if (!stmt.source_function.empty() || stmt.system_time)
+        {
+            Statement select = stmt;
+            select.type = StatementType::SELECT;
+            select.select_items = {SelectItem{}};
+            source = execute_select(select);
+            if (!source.ok())
+                return source;
+            names = source.columns;
+            ranges.push_back(RowRange{source.rows.data(), source.rows.size()});
+        }
+        else if (!stmt.as_of.empty())
+        {
+            auto hash = resolve_revision(repo_, stmt.as_of);
+            const CommitRecord *record = hash.has_value() ? repo_.get_record(*hash) : nullptr;
+            if (record == nullptr)
+            {
+                return QueryResult::failure("Unknown revision '" + stmt.as_of + "'");
+            }
+            auto it = record->tables.find(stmt.table);
+            if (it == record->tables.end())
+            {
+                return QueryResult::failure("Table '" + stmt.table + "' does not exist at " + hash->substr(0, 8));
+            }
+            for (const auto &col : it->second.schema.get_columns())
+                names.push_back(col.name);
+            if (it->second.storage == TableStorage::LSM)
+            {
+                std::string error = read_lsm_rows(repo_, it->second, merged);
+                if (!error.empty())
+                    return QueryResult::failure(error + " of table '" + stmt.table + "'");
+                ranges.push_back(RowRange{merged.data(), merged.size()});
+            }
+            else
+            {
+                for (const auto &chunk_hash : it->second.chunk_hashes)
+                {
+                    ChunkPtr chunk = repo_.get_chunk(chunk_hash);
+                    if (chunk == nullptr)
+                        return QueryResult::failure("Missing chunk " + chunk_hash.substr(0, 8) + " of table '" + stmt.table + "'");
+                    ranges.push_back(RowRange{chunk->rows.data(), chunk->rows.size()});
+                    chunks.push_back(std::move(chunk));
+                }
+            }
+            note_plan("Scan(" + stmt.table + " AS OF " + hash->substr(0, 8) + ", " + std::to_string(it->second.chunk_hashes.size()) + " chunks)");
+        }
+        else
+        {
+            WorkingTable *table = find_table(stmt.table);
+            if (table == nullptr)
+            {
+                return missing_table(stmt.table);
+            }
+            for (const auto &col : table->schema.get_columns())
+                names.push_back(col.name);
+            ranges = table->rows.ranges(merged);
+            note_plan("Scan(" + stmt.table + ", working set, " + std::to_string(table->rows.size()) + " rows)");
+        }
+
+        ExportStats stats;
+        std::string error = export_rows(names, ranges, stmt.copy_path, options, stats);
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+        note_plan("Export(" + std::string(options.format == ExportFormat::CSV ? "CSV" : "JSONL") + ", " +
+                  std::to_string(stats.bytes) + " bytes)");
+        QueryResult result;
+        result.rows_affected = stats.rows;
+        result.message = "Copied " + std::to_string(stats.rows) + " row(s) to '" + stmt.copy_path + "'";
+        return result;
+    }
+
+    QueryResult Session::execute_copy_from(Statement &stmt)
+    {
+        REPONO_TRACE_SPAN("Session::execute_copy_from");
+        if (!stmt.copy_format.empty() && stmt.copy_format != "CSV")
+        {
+            return QueryResult::failure("COPY ... FROM reads CSV only");
+        }
+        WorkingTable *table = find_table(stmt.table);
+        if (table == nullptr)
+        {
+            return missing_table(stmt.table);
+        }
+
+        CsvOptions options;
+        options.header = stmt.copy_header;
+        Statement insert;
+        insert.type = StatementType::INSERT;
+        insert.table = stmt.table;
+        std::string error = load_csv(stmt.copy_path, table->schema, options, insert.columns, insert.rows);
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+        note_plan("CsvLoad(" + stmt.copy_path + ", " + std::to_string(insert.rows.size()) + " rows)");
+
+        QueryResult inserted = execute_insert(insert);
+        if (!inserted.ok())
+        {
+            return inserted;
+        }
+        Statement commit;
+        commit.type = StatementType::COMMIT;
+        commit.message = "COPY " + stmt.table + " FROM '" + stmt.copy_path + "'";
+        QueryResult committed = execute_commit(commit);
+        if (!committed.ok())
+        {
+            return committed;
+        }
+        committed.rows_affected = inserted.rows_affected;
+        committed.message = "Loaded " + std::to_string(inserted.rows_affected) + " row(s) into " + stmt.table + "; " +
+                            committed.message;
+        return committed;
+    }
+
+    QueryResult Session::execute_create(Statement &stmt)
+    {
+        if (find_table(stmt.table) != nullptr || outside_.count(stmt.table) > 0)
+        {
+            return QueryResult::failure("Table '" + stmt.table + "' already exists");
+        }
+        TableStorage storage = TableStorage::CHUNKS;
+        if (stmt.table_storage == "LSM")
+        {
+            storage = TableStorage::LSM;
+            if (primary_key_columns(stmt.schema).empty())
+                return QueryResult::failure("LSM table '" + stmt.table + "' needs a primary key");
+        }
+        else if (!stmt.table_storage.empty() && stmt.table_storage != "CHUNKS")
+        {
+            return QueryResult::failure("Unknown table storage '" + stmt.table_storage + "'; expected CHUNKS or LSM");
+        }
+        WorkingTable &table = tables_[stmt.table];
+        table.schema = stmt.schema;
+        table.key_columns = primary_key_columns(stmt.schema);
+        table.rows = WorkingRows(table.key_columns, {}, storage);
+        dirty_ = true;
+
+        QueryResult result;
+        result.message = "Created table " + stmt.table;
+        return result;
+    }
+
+    QueryResult Session::execute_drop(Statement &stmt)
+    {
+        WorkingTable *table = find_table(stmt.table);
+        if (table != nullptr)
+        {
+            forget_table(*table);
+            tables_.erase(stmt.table);
+        }
+        else if (outside_.erase(stmt.table) == 0)
+        {
+            return missing_table(stmt.table);
+        }
+        dirty_ = true;
+        QueryResult result;
+        result.message = "Dropped table " + stmt.table;
+        return result;
+    }
+
+    QueryResult Session::execute_insert(Statement &stmt)
+    {
+        WorkingTable *table = find_table(stmt.table);
+        if (table == nullptr)
+        {
+            return missing_table(stmt.table);
+        }
+        const Schema &schema = table->schema;
+
+        // Map each provided value to its column position
+        std::vector<size_t> targets;
+        if (stmt.columns.empty())
+        {
+            for (size_t i = 0; i < schema.num_columns(); i++)
+                targets.push_back(i);
+        }
+        else
+        {
+            for (const auto &name : stmt.columns)
+            {
+                auto idx = schema.get_column_index(name);
+                if (!idx.has_value())
+                    return QueryResult::failure("Unknown column '" + name + "'");
+                targets.push_back(*idx);
+            }
+        }
+
+        // Validate everything first so a bad row leaves the table untouched
+        std::vector<Row> new_rows;
+        new_rows.reserve(stmt.values.size() + stmt.rows.size());
+        Row empty;
+        for (const auto &exprs : stmt.values)
+        {
+            if (exprs.size() != targets.size())
+            {
+                return QueryResult::failure("Expected " + std::to_string(targets.size()) +
+                                            " values, got " + std::to_string(exprs.size()));
+            }
+            Row row(schema.num_columns());
+            for (size_t i = 0; i < exprs.size(); i++)
+            {
+                std::string error = bind_expr(*exprs[i], Schema());
+                if (!error.empty())
+                    return QueryResult::failure(error);
+                row[targets[i]] = evaluate(*exprs[i], empty);
+            }
+            coerce_row(schema, row);
+            std::string error = schema.validate_row(row);
+            if (!error.empty())
+                return QueryResult::failure(error);
+            new_rows.push_back(std::move(row));
+        }
+        for (auto &values : stmt.rows)
+        {
+            if (values.size() != targets.size())
+            {
+                return QueryResult::failure("Expected " + std::to_string(targets.size()) +
+                                            " values, got " + std::to_string(values.size()));
+            }
+            Row row(schema.num_columns());
+            for (size_t i = 0; i < values.size(); i++)
+                row[targets[i]] = std::move(values[i]);
+            coerce_row(schema, row);
+            std::string error = schema.validate_row(row);
+            if (!error.empty())
+                return QueryResult::failure(error);
+            new_rows.push_back(std::move(row));
+        }
+
+        uint64_t bytes = 0;
+        for (const auto &row : new_rows)
+            bytes += estimate_row_bytes(row);
+        std::string error = grow_table(*table, bytes);
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+
+        if (!table->key_columns.empty())
+        {
+            // An LSM table's bloom filters rule most runs out without
+            // reading them; other tables index their stored keys once
+            std::unordered_set<std::string> batch;
+            for (const auto &row : new_rows)
+            {
+                if (!batch.insert(encode_key(row, table->key_columns)).second || table->rows.has_key(row))
+                {
+                    shrink_table(*table, bytes);
+                    settle_table(*table);
+                    return QueryResult::failure("Duplicate primary key in table '" + stmt.table + "'");
+                }
+            }
+        }
+
+        QueryResult result;
+        result.rows_affected = new_rows.size();
+        table->rows.append(std::move(new_rows));
+        settle_table(*table);
+        dirty_ = true;
+        note_plan("Insert(" + std::to_string(result.rows_affected) + " rows)");
+        result.message = "Inserted " + std::to_string(result.rows_affected) + " row(s)";
+        return result;
+    }
+
+    QueryResult Session::execute_update(Statement &stmt)
+    {
+        WorkingTable *table = find_table(stmt.table);
+        if (table == nullptr)
+        {
+            return missing_table(stmt.table);
+        }
+        const Schema &schema = table->schema;
+
+        std::string error = stmt.where ? bind_expr(*stmt.where, schema) : "";
+        std::vector<std::pair<size_t, ExprPtr>> sets;
+        bool touches_key = false;
+        for (auto &[name, expr] : stmt.assignments)
+        {
+            auto idx = schema.get_column_index(name);
+            if (!idx.has_value())
+                return QueryResult::failure("Unknown column '" + name + "'");
+            if (error.empty())
+                error = bind_expr(*expr, schema);
+            touches_key = touches_key || schema.get_columns()[*idx].is_primary_key;
+            sets.emplace_back(*idx, expr);
+        }
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+
+        // Compute all updates first so a failing row leaves the table untouched
+        note_table_scan(stmt);
+        std::vector<WorkingRows::Update> updates;
+        table->rows.for_each_slot(key_range(*table, stmt), [&](const WorkingRows::Slot &slot, const Row &row)
+                                  {
+                                      if (stmt.where && !is_truthy(evaluate(*stmt.where, row)))
+                                          return true;
+                                      Row updated = row;
+                                      for (const auto &[idx, expr] : sets)
+                                          updated[idx] = evaluate(*expr, row);
+                                      coerce_row(schema, updated);
+                                      error = schema.validate_row(updated);
+                                      if (!error.empty())
+                                          return false;
+                                      updates.push_back(WorkingRows::Update{slot, std::move(updated)});
+                                      return true;
+                                  });
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+
+        // New versions, grown rows and cloned chunks are charged up front
+        uint64_t growth = table->rows.update_bytes(updates);
+        error = grow_table(*table, growth);
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+
+        if (touches_key && !table->key_columns.empty())
+        {
+            // Only keys that change can collide. A new key is free if no row
+            // has it, or if the row that has it changes its key too.
+            std::unordered_set<std::string> freed, taken;
+            std::vector<const WorkingRows::Update *> changed;
+            for (const auto &update : updates)
+            {
+                std::string old_key = encode_key(table->rows.at(update.slot), table->key_columns);
+                if (old_key != encode_key(update.row, table->key_columns))
+                {
+                    freed.insert(std::move(old_key));
+                    changed.push_back(&update);
+                }
+            }
+            for (const WorkingRows::Update *update : changed)
+            {
+                std::string new_key = encode_key(update->row, table->key_columns);
+                if (!taken.insert(new_key).second || (!freed.count(new_key) && table->rows.has_key(update->row)))
+                {
+                    shrink_table(*table, growth);
+                    settle_table(*table);
+                    return QueryResult::failure("Duplicate primary key in table '" + stmt.table + "'");
+                }
+            }
+        }
+
+        QueryResult result;
+        result.rows_affected = updates.size();
+        table->rows.update(std::move(updates));
+        settle_table(*table);
+        dirty_ = dirty_ || result.rows_affected > 0;
+
+        note_plan("Update(" + std::to_string(result.rows_affected) + " rows)");
+        result.message = "Updated " + std::to_string(result.rows_affected) + " row(s)";
+        return result;
+    }
+
+    QueryResult Session::execute_delete(Statement &stmt)
+    {
+        WorkingTable *table = find_table(stmt.table);
+        if (table == nullptr)
+        {
+            return missing_table(stmt.table);
+        }
+        std::string error = stmt.where ? bind_expr(*stmt.where, table->schema) : "";
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+
+        note_table_scan(stmt);
+        QueryResult result;
+        result.rows_affected = table->rows.remove_if([&stmt](const Row &row)
+                                                     { return !stmt.where || is_truthy(evaluate(*stmt.where, row)); },
+                                                     key_range(*table, stmt));
+        // Tombstones and cloned chunks are charged even over the limit, like loaded rows
+        settle_table(*table);
+        if (result.rows_affected > 0)
+        {
+            dirty_ = true;
+        }
+        note_plan("Delete(" + std::to_string(result.rows_affected) + " rows)");
+        result.message = "Deleted " + std::to_string(result.rows_affected) + " row(s)";
+        return result;
+    }
+
+    QueryResult Session::execute_commit(Statement &stmt)
+    {
+        if (!dirty_)
+        {
+            return QueryResult::failure("Nothing to commit");
+        }
+        Commit commit;
+        commit.message = stmt.message;
+        commit.timestamp = now_seconds();
+        std::string error = commit_working_set(std::move(commit));
+        if (error.empty())
+        {
+            dirty_ = false;
+            error = repo_.flush();
+        }
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+
+        QueryResult result;
+        result.message = "Committed " + base_hash_.substr(0, 8);
+        return result;
+    }
+
+    std::string Session::commit_working_set(Commit commit)
+    {
+        if (repo_.head() != base_hash_)
+        {
+            return "Branch '" + repo_.current_branch() + "' moved to " + repo_.head().substr(0, 8) +
+                   " since this session loaded it; its uncommitted changes were made on " +
+                   (base_hash_.empty() ? "an empty branch" : base_hash_.substr(0, 8));
+        }
+        commit.parent_hash = base_hash_;
+        std::map<std::string, TableManifest> tables = outside_;
+        uint64_t new_bytes = 0;
+        for (auto &[name, table] : tables_)
+        {
+            TableManifest &manifest = tables[name];
+            manifest = table.rows.store(repo_, new_bytes);
+            manifest.schema = table.schema;
+            // Stored rows are shared with the repository from now on
+            settle_table(table);
+        }
+        std::string hash;
+        std::string error = repo_.commit_tables(std::move(commit), std::move(tables), hash, new_bytes);
+        if (error.empty())
+            base_hash_ = hash;
+        return error;
+    }
+
+    QueryResult Session::execute_checkout(Statement &stmt)
+    {
+        if (dirty_)
+        {
+            return QueryResult::failure("Uncommitted changes; COMMIT before CHECKOUT");
+        }
+
+        QueryResult result;
+        if (stmt.create_branch)
+        {
+            if (!is_valid_branch_name(stmt.branch))
+            {
+                return QueryResult::failure("Invalid branch name '" + stmt.branch + "'");
+            }
+            if (repo_.branch_head(stmt.branch).has_value())
+            {
+                return QueryResult::failure("Branch '" + stmt.branch + "' already exists");
+            }
+            repo_.set_branch(stmt.branch, base_hash_);
+            result.message = "Switched to new branch " + stmt.branch;
+        }
+        else
+        {
+            if (!repo_.branch_head(stmt.branch).has_value())
+            {
+                return QueryResult::failure("No such branch '" + stmt.branch + "'");
+            }
+            result.message = "Switched to branch " + stmt.branch;
+        }
+
+        if (stmt.sparse)
+        {
+            sparse_tables_ = std::set<std::string>(stmt.sparse_tables.begin(), stmt.sparse_tables.end());
+            if (!sparse_tables_.empty())
+                result.message += " (sparse: " + std::to_string(sparse_tables_.size()) + " table(s))";
+        }
+        stash_working_set();
+        repo_.set_current_branch(stmt.branch);
+        load_working_set(repo_.head());
+        trim_branch_cache(); // after loading, so every kept branch could lend its chunks
+        std::string error = repo_.flush();
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+        return result;
+    }
+
+    QueryResult Session::execute_show_memory()
+    {
+        QueryResult result;
+        result.columns = {"pool", "used_bytes", "peak_bytes", "limit_bytes", "used"};
+        auto add = [&result](const std::string &pool, uint64_t used, uint64_t peak, uint64_t limit)
+        {
+            result.rows.push_back({pool, static_cast<int64_t>(used), static_cast<int64_t>(peak),
+                                   limit == 0 ? Value(std::monostate{}) : Value(static_cast<int64_t>(limit)),
+                                   format_bytes(used)});
+        };
+        auto add_tracker = [&add](const std::string &pool, const MemoryTracker &tracker)
+        {
+            add(pool, tracker.used(), tracker.peak(), tracker.limit());
+        };
+
+        MemoryPools &pools = memory_pools();
+        for (const MemoryTracker *tracker : {&pools.total, &pools.commit_cache, &pools.buffer_pool,
+                                             &pools.working_set, &pools.query, &pools.index})
+        {
+            add_tracker(tracker->name(), *tracker);
+        }
+        add_tracker("repository.commit_cache", repo_.commit_cache_memory());
+        add_tracker("repository.buffer_pool", repo_.buffer_pool_memory());
+        add_tracker("session", session_memory_);
+        add_tracker("session.working_set", working_set_memory_);
+        add_tracker("session.index", index_memory_);
+        add("session.branch_cache", branch_cache_memory_.used(), branch_cache_memory_.peak(), branch_cache_limit_);
+        add("session.query", 0, 0, query_memory_limit_);
+        return result;
+    }
+
+    QueryResult Session::execute_show()
+    {
+        QueryResult result;
+        result.columns = {"metric", "type", "unit", "count", "sum", "p50", "p95", "p99", "max"};
+        metrics().for_each([&result](const MetricsRegistry::Entry &entry)
+                           {
+            std::string name = entry.labels.empty() ? entry.name : entry.name + "{" + entry.labels + "}";
+            if (entry.counter)
+            {
+                result.rows.push_back({name, std::string("counter"), std::string(""), static_cast<int64_t>(entry.counter->value()),
+                                       std::monostate{}, std::monostate{}, std::monostate{}, std::monostate{}, std::monostate{}});
+                return;
+            }
+            HistogramSnapshot snap = entry.histogram->snapshot();
+            bool timing = snap.scale == 1e-9;
+            double factor = timing ? 1e3 : 1;
+            result.rows.push_back({name, std::string("histogram"), std::string(timing ? "ms" : ""),
+                                   static_cast<int64_t>(snap.count), static_cast<double>(snap.sum) * snap.scale * factor,
+                                   snap.percentile(50) * factor, snap.percentile(95) * factor,
+                                   snap.percentile(99) * factor, snap.percentile(100) * factor}); });
+        return result;
+    }
+
+    QueryResult Session::execute_merge(Statement &stmt)
+    {
+        REPONO_TRACE_SPAN("Session::execute_merge");
+        if (dirty_)
+        {
+            return QueryResult::failure("Uncommitted changes; COMMIT before MERGE");
+        }
+        auto theirs = repo_.branch_head(stmt.branch);
+        if (!theirs.has_value())
+        {
+            return QueryResult::failure("No such branch '" + stmt.branch + "'");
+        }
+
+        QueryResult result;
+        if (repo_.is_ancestor(*theirs, base_hash_))
+        {
+            result.message = "Already up to date";
+            return result;
+        }
+        if (repo_.is_ancestor(base_hash_, *theirs))
+        {
+            repo_.set_branch(repo_.current_branch(), *theirs);
+            load_working_set(*theirs);
+            std::string error = repo_.flush();
+            if (!error.empty())
+            {
+                return QueryResult::failure(error);
+            }
+            result.message = "Fast-forward to " + theirs->substr(0, 8);
+            return result;
+        }
+
+        static const std::map<std::string, TableManifest> no_tables;
+        std::string base = repo_.merge_base(base_hash_, *theirs);
+        const CommitRecord *base_record = repo_.get_record(base);
+        const CommitRecord *ours_record = repo_.get_record(base_hash_);
+        const CommitRecord *theirs_record = repo_.get_record(*theirs);
+        if (ours_record == nullptr || theirs_record == nullptr)
+        {
+            return QueryResult::failure("Missing commit object");
+        }
+        const auto &base_tables = base_record ? base_record->tables : no_tables;
+        auto find = [](const std::map<std::string, TableManifest> &tables, const std::string &name) -> const TableManifest *
+        {
+            auto it = tables.find(name);
+            return it != tables.end() ? &it->second : nullptr;
+        };
+        auto same = [](const TableManifest *a, const TableManifest *b)
+        {
+            if (a == nullptr || b == nullptr)
+                return a == b;
+            return a->chunk_hashes == b->chunk_hashes && a->storage == b->storage && schemas_equal(a->schema, b->schema);
+        };
+
+        std::set<std::string> names;
+        for (const auto *tables : {&base_tables, &ours_record->tables, &theirs_record->tables})
+        {
+            for (const auto &entry : *tables)
+                names.insert(entry.first);
+        }
+
+        // Work out the merged contents first so a conflict leaves the
+        // working set untouched
+        std::map<std::string, WorkingTable> merged;
+        std::map<std::string, TableManifest> carried;
+        std::vector<std::string> dropped;
+        size_t rows_merged = 0;
+        for (const auto &name : names)
+        {
+            const TableManifest *b = find(base_tables, name);
+            const TableManifest *o = find(ours_record->tables, name);
+            const TableManifest *t = find(theirs_record->tables, name);
+            if (same(b, t) || same(o, t))
+                continue; // nothing new on their side
+            if (same(b, o))
+            {
+                // Only their side changed the table: take it as is
+                if (t == nullptr)
+                {
+                    dropped.push_back(name);
+                    continue;
+                }
+                if (outside_.count(name) > 0 || (!sparse_tables_.empty() && sparse_tables_.count(name) == 0))
+                {
+                    carried[name] = *t; // stays outside the sparse checkout
+                    continue;
+                }
+                rows_merged += t->row_count;
+                WorkingTable &table = merged[name];
+                table.schema = t->schema;
+                table.key_columns = primary_key_columns(table.schema);
+                table.rows = WorkingRows(repo_, *t); // their chunks, shared
+                continue;
+            }
+            if (o == nullptr || t == nullptr || !schemas_equal(o->schema, t->schema) ||
+                (b != nullptr && !schemas_equal(b->schema, t->schema)))
+            {
+                return QueryResult::failure("Merge conflict in table '" + name + "': changed on both sides");
+            }
+            std::vector<size_t> key_columns = primary_key_columns(t->schema);
+            if (key_columns.empty())
+            {
+                return QueryResult::failure("Merge conflict in table '" + name + "': changed on both sides and has no primary key");
+            }
+
+            // Rows changed on our side, by key (nullopt = deleted)
+            std::unordered_map<std::string, std::optional<Row>> our_changes;
+            std::string error = diff_table_rows(repo_, b, o, [&](RowDiff::Type type, const Row *old_row, const Row *new_row)
+                                                {
+                const Row *row = new_row ? new_row : old_row;
+                our_changes[encode_key(*row, key_columns)] = type == RowDiff::Type::DELETED ? std::nullopt : std::optional<Row>(*new_row);
+                return true; });
+            if (!error.empty())
+            {
+                return QueryResult::failure(error);
+            }
+
+            // Rows changed on their side that ours did not change the same way
+            std::vector<std::pair<Row, std::optional<Row>>> their_changes; // a row holding the key, its new version
+            std::string conflict;
+            error = diff_table_rows(repo_, b, t, [&](RowDiff::Type type, const Row *old_row, const Row *new_row)
+                                    {
+                const Row &key_row = new_row ? *new_row : *old_row;
+                std::optional<Row> wanted;
+                if (type != RowDiff::Type::DELETED)
+                    wanted = *new_row;
+                auto ours = our_changes.find(encode_key(key_row, key_columns));
+                if (ours != our_changes.end())
+                {
+                    if (ours->second != wanted)
+                    {
+                        conflict = ours->first;
+                        return false;
+                    }
+                    return true; // same change on both sides
+                }
+                their_changes.emplace_back(key_row, std::move(wanted));
+                return true; });
+            if (!error.empty())
+            {
+                return QueryResult::failure(error);
+            }
+            if (!conflict.empty())
+            {
+                return QueryResult::failure("Merge conflict in table '" + name + "': row changed on both sides");
+            }
+            rows_merged += their_changes.size();
+
+            WorkingTable table;
+            table.key_columns = key_columns;
+            if (o->storage == TableStorage::LSM && t->storage == TableStorage::LSM)
+            {
+                // Their changes go on top of our runs and are flushed as one
+                // new run, leaving our levels as they are
+                table.schema = o->schema;
+                table.rows = WorkingRows(repo_, *o);
+                for (auto &[key_row, wanted] : their_changes)
+                    table.rows.put(key_row, std::move(wanted));
+                merged[name] = std::move(table);
+                continue;
+            }
+
+            std::vector<Row> rows;
+            if (const WorkingTable *current = find_table(name))
+            {
+                table.schema = current->schema;
+                rows = current->rows.to_vector();
+            }
+            else
+            {
+                // Outside a sparse checkout: merge into our committed rows
+                error = load_table_at(base_hash_, name, table.schema, rows);
+                if (!error.empty())
+                {
+                    return QueryResult::failure(error);
+                }
+            }
+            std::unordered_map<std::string, size_t> positions;
+            for (size_t i = 0; i < rows.size(); i++)
+                positions[encode_key(rows[i], key_columns)] = i;
+            std::vector<bool> removed(rows.size(), false);
+            for (auto &[key_row, wanted] : their_changes)
+            {
+                std::string key = encode_key(key_row, key_columns);
+                auto pos = positions.find(key);
+                if (!wanted.has_value())
+                {
+                    if (pos != positions.end())
+                        removed[pos->second] = true;
+                }
+                else if (pos != positions.end())
+                {
+                    rows[pos->second] = std::move(*wanted);
+                    removed[pos->second] = false;
+                }
+                else
+                {
+                    positions[key] = rows.size();
+                    rows.push_back(std::move(*wanted));
+                    removed.push_back(false);
+                }
+            }
+
+            size_t kept = 0;
+            for (size_t i = 0; i < rows.size(); i++)
+            {
+                if (removed[i])
+                    continue;
+                if (kept != i)
+                    rows[kept] = std::move(rows[i]);
+                kept++;
+            }
+            rows.resize(kept);
+            table.rows = WorkingRows(key_columns, std::move(rows), t->storage);
+            merged[name] = std::move(table);
+        }
+
+        for (auto &[name, table] : merged)
+        {
+            WorkingTable &slot = tables_[name];
+            forget_table(slot);
+            slot = std::move(table);
+            slot.bytes = 0;
+            slot.index_bytes = 0;
+            settle_table(slot);
+        }
+        for (auto &[name, table] : merged)
+            outside_.erase(name);
+        for (auto &[name, manifest] : carried)
+            outside_[name] = std::move(manifest);
+        for (const auto &name : dropped)
+        {
+            if (WorkingTable *table = find_table(name))
+                forget_table(*table);
+            tables_.erase(name);
+            outside_.erase(name);
+        }
+
+        Commit commit;
+        commit.merge_parent_hash = *theirs;
+        commit.message = stmt.message.empty() ? "Merge branch '" + stmt.branch + "'" : stmt.message;
+        commit.timestamp = now_seconds();
+        std::string error = commit_working_set(std::move(commit));
+        if (!error.empty())
+        {
+            // The merged rows were never committed; nothing else was
+            // pending before the merge, so go back to our head
+            load_working_set(base_hash_);
+            return QueryResult::failure(error);
+        }
+        dirty_ = false;
+        error = repo_.flush();
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+
+        result.rows_affected = rows_merged;
+        result.message = "Merged " + stmt.branch + " as " + base_hash_.substr(0, 8);
+        return result;
+    }
+
+    QueryResult Session::execute_lineage(Statement &stmt)
+    {
+        REPONO_TRACE_SPAN("Session::execute_lineage");
+        std::string start = base_hash_;
+        if (!stmt.as_of.empty())
+        {
+            auto hash = resolve_revision(repo_, stmt.as_of);
+            if (!hash.has_value())
+            {
+                return QueryResult::failure("Unknown revision '" + stmt.as_of + "'");
+            }
+            start = *hash;
+        }
+
+        const CommitRecord *record = repo_.get_record(start);
+        auto it = record != nullptr ? record->tables.find(stmt.table) : std::map<std::string, TableManifest>::const_iterator{};
+        if (record == nullptr || it == record->tables.end())
+        {
+            return QueryResult::failure("Table '" + stmt.table + "' does not exist in committed history");
+        }
+        const Schema &schema = it->second.schema;
+        if (primary_key_columns(schema).empty())
+        {
+            return QueryResult::failure("Table '" + stmt.table + "' has no primary key to identify a row by");
+        }
+
+        std::string key;
+        std::string error = extract_primary_key(stmt.where.get(), schema, key);
+        if (!error.empty())
+        {
+            return QueryResult::failure(error);
+        }
+
+        size_t limit = stmt.type == StatementType::BLAME ? 1 : 0;
+        auto versions = lineage_.row_history(start, stmt.table, primary_key_columns(schema), key, limit);
+
+        QueryResult result;
+        result.columns = {"commit", "timestamp", "message", "change"};
+        for (const auto &col : schema.get_columns())
+        {
+            result.columns.push_back(col.name);
+        }
+        for (auto &version : versions)
+        {
+            Row row = {version.commit_hash, version.timestamp, version.message, change_type_to_string(version.change)};
+            row.insert(row.end(), version.row.begin(), version.row.end());
+            row.resize(result.columns.size());
+            result.rows.push_back(std::move(row));
+        }
+        return result;
+    }
+
+    QueryResult Session::execute_log()
+    {
+        QueryResult result;
+        result.columns = {"hash", "timestamp", "message"};
+        for (const auto &hash : repo_.log(repo_.head()))
+        {
+            const CommitRecord *record = repo_.get_record(hash);
+            result.rows.push_back({hash, record->timestamp, record->message});
+        }
+        return result;
+    }
+};
@@ -0,0 +1,420 @@
+/**
+ *  ReponoDB: Sessions, their working set and statement execution
+ */
+
+#ifndef REPONO_SESSION_H
+#define REPONO_SESSION_H
+
+#include "executor.h"
+#include "lineage.h"
+#include "remote.h"
+#include "slow_query_log.h"
+#include "working_rows.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * SESSION
+     *
+     * Executes SQL statements against a repository. The session keeps a
+     * working set (the current branch's tables plus uncommitted changes);
+     * COMMIT turns the working set into a new commit, CHECKOUT switches
+     * branches, MERGE brings another branch's changes in, and
+     * SELECT ... AS OF reads a table from any commit.
+     *
+     * A read-only session only runs SELECT and LOG and always reads the
+     * branch head, which is how replicas serve queries.
+     *
+     * Working tables are copy-on-write overlays on the base commit's chunks
+     * (see working_rows.h): loading the working set reads no rows, a write
+     * clones only the chunks it changes, and only cloned chunks count
+     * against the working set's memory. COMMIT stores and hashes just those.
+     *
+     * CHECKOUT keeps the working set of the branch it leaves, within a
+     * memory budget, least recently used branches going first. Switching
+     * back reuses the tables whose chunks are unchanged as they are, with
+     * the chunks read so far and their key indexes. The other tables
+     * reference the new head's chunks and take the ones any kept branch
+     * has already read, so only chunks that differ are read again.
+     *
+     * A sparse checkout (CHECKOUT branch TABLES (a, b)) loads only the
+     * named tables into the working set. The others stay in storage as
+     * their manifests: AS OF, diff() and history queries still read them,
+     * and COMMIT carries them into the new commit by chunk hash without
+     * decoding them into the working set.
+     */
+    class Session
+    {
+    public:
+        explicit Session(Repository &repo, bool read_only = false)
+            : repo_(repo), read_only_(read_only), dirty_(false), lineage_(repo) {}
+
+        /**
+         * Parse and execute one statement
+         */
+        QueryResult execute(const std::string &sql);
+
+        /**
+         * Execute a statement parsed ahead of time
+         *
+         * @param sql Its text, for the slow query log ("" logs the statement type and table)
+         */
+        QueryResult execute(Statement &stmt, const std::string &sql = "");
+
+        /**
+         * Send statements slower than the log's threshold to it (nullptr to stop)
+         */
+        void set_slow_query_log(SlowQueryLog *log) { slow_log_ = log; }
+
+        /**
+         * Limit what the session holds in memory: its working set, key
+         * indexes and running statement (0 = unlimited). Statements that
+         * would go over fail with an error and change nothing.
+         */
+        void set_memory_limit(uint64_t bytes) { session_memory_.set_limit(bytes); }
+
+        /**
+         * Limit the rows a single statement may hold in memory (0 = unlimited)
+         */
+        void set_query_memory_limit(uint64_t bytes) { query_memory_limit_ = bytes; }
+
+        /**
+         * Limit the memory kept for branches switched away from (0 = keep
+         * none). It is separate from the session's own limit.
+         */
+        void set_branch_cache_limit(uint64_t bytes)
+        {
+            branch_cache_limit_ = bytes;
+            trim_branch_cache();
+        }
+
+        /**
+         * The commit the working set is based on ("" before the first commit)
+         */
+        const std::string &base_hash() const { return base_hash_; }
+        bool has_uncommitted_changes() const { return dirty_; }
+
+        /**
+         * Tables the working set is limited to (empty = all of them)
+         */
+        const std::set<std::string> &sparse_tables() const { return sparse_tables_; }
+
+    private:
+        QueryResult run(Statement &stmt);
+
+        /**
+         * Queue a slow statement for the slow query log. Only cheap moves
+         * happen here; the writer thread fingerprints and formats the entry.
+         */
+        void log_if_slow(std::chrono::steady_clock::time_point start, QueryStats &stats, const QueryResult &result,
+                         const std::string &sql, std::string fingerprint = "")
+        {
+            if (slow_log_ == nullptr)
+                return;
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (ms < slow_log_->threshold_ms())
+                return;
+
+            SlowQueryEntry entry;
+            entry.timestamp_ms = now_ms();
+            entry.duration_ms = ms;
+            entry.fingerprint = std::move(fingerprint);
+            entry.sql = sql;
+            entry.branch = last_branch_;
+            entry.commit_hash = base_hash_;
+            entry.rows_scanned = stats.rows_scanned;
+            entry.rows_returned = result.rows.empty() ? result.rows_affected : result.rows.size();
+            entry.bytes_decoded = stats.bytes_decoded;
+            entry.memory_peak = stats.memory_peak;
+            entry.plan = std::move(stats.plan);
+            entry.error = result.error;
+            slow_log_->record(entry);
+        }
+
+        struct StatementMetrics
+        {
+            Counter &executed;
+            Counter &failed;
+            Histogram &seconds;
+        };
+
+        static StatementMetrics &statement_metrics(StatementType type);
+
+        QueryResult dispatch(Statement &stmt);
+
+        struct WorkingTable
+        {
+            Schema schema;
+            WorkingRows rows;
+            std::vector<size_t> key_columns;
+            uint64_t bytes = 0;       // charged to working_set_memory_
+            uint64_t index_bytes = 0; // rows.index_bytes() as last charged to index_memory_
+        };
+
+        Repository &repo_;
+        bool read_only_;
+        bool dirty_;
+        bool loaded_ = false;
+        std::string base_hash_;
+
+        // Declared before tables_ so they outlive it; the working set and
+        // index trackers give their bytes back to session_memory_ on destruction
+        MemoryTracker session_memory_{"session"};
+        MemoryTracker working_set_memory_{"working_set", 0, {&session_memory_, &memory_pools().working_set}};
+        MemoryTracker index_memory_{"index", 0, {&session_memory_, &memory_pools().index}};
+        MemoryTracker branch_cache_memory_{"branch_cache", 0, {&memory_pools().working_set}};
+        uint64_t query_memory_limit_ = 0;
+        uint64_t branch_cache_limit_ = 64 << 20;
+
+        std::map<std::string, WorkingTable> tables_;
+
+        /**
+         * The working set of a branch switched away from
+         */
+        struct BranchState
+        {
+            std::map<std::string, WorkingTable> tables; // charged to branch_cache_memory_, not the session
+            uint64_t bytes = 0;
+            uint64_t last_used = 0;
+        };
+        std::map<std::string, BranchState> branch_cache_;
+        uint64_t branch_cache_clock_ = 0;
+        std::set<std::string> sparse_tables_;              // empty = full checkout
+        std::map<std::string, TableManifest> outside_; // base commit's tables left out of a sparse checkout
+        LineageIndex lineage_;
+        SlowQueryLog *slow_log_ = nullptr;
+        std::string last_branch_; // branch the last statement ran on (kept for the slow log)
+
+        /**
+         * Reload the working set if the branch head moved (e.g. a replica
+         * applied new commits) and there is nothing uncommitted to lose
+         */
+        void sync_with_head();
+
+        /**
+         * Make a commit the working set, reusing what this branch's cached
+         * state or the current working set already holds
+         */
+        void load_working_set(const std::string &hash);
+
+        /**
+         * Move the (clean) working set into the branch cache under the current branch
+         */
+        void stash_working_set();
+
+        /**
+         * Drop least recently used branches until the cache fits its budget
+         */
+        void trim_branch_cache();
+
+        /**
+         * Bring a table's charges in line with the rows it owns (cloned and
+         * new rows and its delta) and its key index. Rows already held are
+         * charged even over the limit; grow_table stops statements adding more.
+         */
+        void settle_table(WorkingTable &table);
+
+        /**
+         * Release everything charged for a table that is being dropped or replaced
+         */
+        void forget_table(WorkingTable &table)
+        {
+            uncharge_table(table);
+            table.index_bytes = 0;
+        }
+
+        /**
+         * Release a table's charges but keep index_bytes, to charge its key
+         * index again if the table is reused
+         */
+        void uncharge_table(WorkingTable &table);
+
+        /**
+         * Charge rows about to be added to a table
+         *
+         * @returns "" on success or a memory limit error (nothing is charged)
+         */
+        std::string grow_table(WorkingTable &table, uint64_t bytes);
+
+        void shrink_table(WorkingTable &table, uint64_t bytes);
+
+        /**
+         * Account for a full pass over a working table (UPDATE / DELETE)
+         */
+        void note_table_scan(const Statement &stmt);
+
+        /**
+         * Bounds a statement's WHERE clause puts on a table's leading key
+         * column, which an LSM table scans within
+         */
+        KeyRange key_range(const WorkingTable &table, const Statement &stmt);
+
+        WorkingTable *find_table(const std::string &name)
+        {
+            auto it = tables_.find(name);
+            return it != tables_.end() ? &it->second : nullptr;
+        }
+
+        /**
+         * The error for a table that is not in the working set
+         */
+        QueryResult missing_table(const std::string &name) const
+        {
+            if (outside_.count(name) > 0)
+                return QueryResult::failure("Table '" + name + "' is outside the sparse checkout");
+            return QueryResult::failure("Table '" + name + "' does not exist");
+        }
+
+        /**
+         * FLOAT columns store doubles even when given an integer
+         */
+        static void coerce_row(const Schema &schema, Row &row);
+
+        QueryResult execute_select(Statement &stmt);
+
+        /**
+         * SELECT ... FROM diff(table, from, to)
+         *
+         * Rows stream out of diff_table_rows straight into the SELECT
+         * pipeline, which filters each one as it arrives; unchanged chunks
+         * are never read and a LIMIT without ORDER BY stops the diff early.
+         */
+        QueryResult execute_table_function(Statement &stmt);
+
+        /**
+         * SELECT ... FROM table FOR SYSTEM_TIME BETWEEN t1 AND t2
+         *
+         * Returns every version of every row that was current at some point
+         * in [t1, t2], with commit_hash / commit_timestamp columns naming the
+         * commit the version is read from. Rows current at t1 come from the
+         * last commit at or before t1 (the one snapshot we must read); after
+         * that each commit in range only contributes the rows it added or
+         * modified, found by diffing its changed chunks against its parent.
+         * Commits that did not touch the table cost one chunk list compare.
+         */
+        QueryResult execute_history_scan(Statement &stmt);
+
+        /**
+         * Load a single table from a commit without materializing the others.
+         * The rows are charged to the running statement chunk by chunk.
+         *
+         * @returns "" on success or an error message
+         */
+        std::string load_table_at(const std::string &hash, const std::string &table, Schema &schema, std::vector<Row> &rows);
+
+        QueryResult execute_create(Statement &stmt);
+
+        QueryResult execute_drop(Statement &stmt);
+
+        QueryResult execute_insert(Statement &stmt);
+
+        QueryResult execute_update(Statement &stmt);
+
+        QueryResult execute_delete(Statement &stmt);
+
+        QueryResult execute_commit(Statement &stmt);
+
+        /**
+         * Store the working set's changed chunks and commit it together
+         * with the tables outside a sparse checkout
+         *
+         * Fails, storing nothing, if the branch moved since the working set
+         * was loaded.
+         *
+         * @param commit Message, timestamp and merge parent
+         * @returns "" on success or an error message
+         */
+        std::string commit_working_set(Commit commit);
+
+        QueryResult execute_checkout(Statement &stmt);
+
+        /**
+         * SHOW MEMORY: estimated bytes held, by kind of memory. The first rows
+         * are process-wide totals, then this repository's caches, then this
+         * session. Limits of 0 are shown as NULL (unlimited).
+         */
+        QueryResult execute_show_memory();
+
+        /**
+         * SHOW METRICS: one row per counter or histogram. Timing histograms
+         * are shown in milliseconds (the Prometheus dump uses seconds).
+         */
+        QueryResult execute_show();
+
+        /**
+         * MERGE branch ['message']
+         *
+         * Fast-forwards when possible. Otherwise does a three-way merge against
+         * the nearest common ancestor: the other branch's row changes are
+         * applied to the working set by primary key and committed with both
+         * heads as parents. A row changed differently on both sides, a table
+         * changed on both sides without a primary key, or a schema changed on
+         * one side while the other changed the table is a conflict; nothing is
+         * changed in that case.
+         */
+        QueryResult execute_merge(Statement &stmt);
+
+        /**
+         * BLAME returns the latest change to a row, HISTORY OF ROW every change.
+         * Both look at committed history only, starting at AS OF or the
+         * commit the working set is based on.
+         */
+        QueryResult execute_lineage(Statement &stmt);
+
+        QueryResult execute_log();
+
+        /**
+         * COPY source TO 'file' (FORMAT CSV | JSONL)
+         *
+         * A table is written straight from the working set, and a table AS
+         * OF a revision straight from its committed chunks, without copying
+         * rows. Other sources (diff(), FOR SYSTEM_TIME) run as SELECT * and
+         * write the result.
+         */
+        QueryResult execute_copy(Statement &stmt);
+
+        /**
+         * COPY table FROM 'file': parse a CSV file (see import.h), insert its
+         * rows in one statement and commit. Earlier uncommitted changes (such
+         * as the CREATE TABLE) go into the same commit.
+         */
+        QueryResult execute_copy_from(Statement &stmt);
+    };
+
+    /**
+     * REPLICA
+     *
+     * A read-only copy of a primary repository that tails its refs and
+     * objects. Each poll lists the primary's refs, fetches the missing
+     * commits and chunks (the same negotiation as fetch), then moves the
+     * local branch to the primary's head. Queries run on a read-only
+     * Session and always see the latest applied commit.
+     *
+     * The primary is any Remote: a DirectoryRemote on a shared directory,
+     * or a SocketRemote for a primary running RepositoryServer.
+     */
+    struct ReplicationStatus
+    {
+        std::string applied_hash; // commit queries currently see
+        std::string primary_hash; // primary head as of the last poll
+        // Commits the replica is behind, and how long ago the oldest of
+        // them was made on the primary. Both are unknown (nullopt) while
+        // the primary's new commits have not been fetched yet.
+        std::optional<size_t> lag_commits = 0;
+        std::optional<int64_t> lag_ms = 0;
+        int64_t last_poll_ms = 0; // wall clock time of the last successful poll
+        size_t commits_applied = 0;
+        std::string last_error;
+    };
+};
+
+#endif // REPONO_SESSION_H
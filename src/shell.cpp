@@ -0,0 +1,432 @@
+/**
+ *  ReponoDB: Interactive shell and script runner
+ */
+
+#include "shell.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <istream>
+#include <ostream>
+#include <thread>
+
+namespace repono
+{
+    namespace
+    {
+        constexpr size_t kBatchStatements = 256; // statements handed between stages at a time
+        constexpr size_t kQueueBatches = 8;      // batches a stage may run ahead by
+
+        struct ParsedStatement
+        {
+            ScriptStatement text;
+            std::optional<Statement> stmt;
+            std::string error;
+        };
+
+        struct StatementOutput
+        {
+            int line = 0;
+            bool command = false;
+            std::string command_output;
+            QueryResult result;
+            bool timed = false;
+            double ms = 0;
+        };
+
+        std::string format_ms(double ms)
+        {
+            char buf[48];
+            std::snprintf(buf, sizeof(buf), "Time: %.3f ms\n", ms);
+            return buf;
+        }
+
+        double elapsed_ms(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    void StatementSplitter::feed_line(const std::string &line)
+    {
+        line_++;
+        for (size_t i = 0; i < line.size(); i++)
+        {
+            char c = line[i];
+            char next = i + 1 < line.size() ? line[i + 1] : '\0';
+            if (block_comment_)
+            {
+                if (has_content_)
+                    current_ += c;
+                if (c == '*' && next == '/')
+                {
+                    if (has_content_)
+                        current_ += next;
+                    i++;
+                    block_comment_ = false;
+                }
+            }
+            else if (quote_ != 0)
+            {
+                current_ += c;
+                if (c == '\\' && quote_ != '`' && next != '\0')
+                {
+                    current_ += next;
+                    i++;
+                }
+                else if (c == quote_)
+                {
+                    quote_ = 0;
+                }
+            }
+            else if (c == '-' && next == '-')
+            {
+                if (has_content_)
+                    current_.append(line, i, std::string::npos);
+                break;
+            }
+            else if (c == '/' && next == '*')
+            {
+                if (has_content_)
+                    current_ += "/*";
+                i++;
+                block_comment_ = true;
+            }
+            else if (c == ';')
+            {
+                emit();
+            }
+            else if (c == '\\' && !has_content_)
+            {
+                // Shell commands take the rest of the line
+                std::string command = line.substr(i);
+                while (!command.empty() && std::isspace(static_cast<unsigned char>(command.back())))
+                    command.pop_back();
+                ready_.push_back(ScriptStatement{std::move(command), line_, true});
+                return;
+            }
+            else if (has_content_ || !std::isspace(static_cast<unsigned char>(c)))
+            {
+                // Leading whitespace and comments are dropped, so that parse
+                // error positions count from the statement's first line
+                if (!has_content_)
+                {
+                    has_content_ = true;
+                    start_line_ = line_;
+                }
+                if (c == '\'' || c == '"' || c == '`')
+                    quote_ = c;
+                current_ += c;
+            }
+        }
+        if (has_content_)
+            current_ += '\n';
+    }
+
+    void StatementSplitter::emit()
+    {
+        if (has_content_)
+        {
+            while (!current_.empty() && std::isspace(static_cast<unsigned char>(current_.back())))
+                current_.pop_back();
+            ready_.push_back(ScriptStatement{std::move(current_), start_line_, false});
+        }
+        current_.clear();
+        has_content_ = false;
+    }
+
+    bool StatementSplitter::next(ScriptStatement &out)
+    {
+        if (ready_.empty())
+            return false;
+        out = std::move(ready_.front());
+        ready_.pop_front();
+        return true;
+    }
+
+    bool StatementSplitter::finish(ScriptStatement &out)
+    {
+        emit();
+        quote_ = 0;
+        block_comment_ = false;
+        return next(out);
+    }
+
+    std::string format_result(const QueryResult &result)
+    {
+        if (!result.ok())
+            return "Error: " + result.error + "\n";
+        if (result.columns.empty())
+            return result.message.empty() ? "" : result.message + "\n";
+
+        std::vector<std::vector<std::string>> cells;
+        cells.reserve(result.rows.size());
+        std::vector<size_t> widths;
+        for (const auto &name : result.columns)
+            widths.push_back(name.size());
+        for (const auto &row : result.rows)
+        {
+            std::vector<std::string> line;
+            line.reserve(row.size());
+            for (size_t i = 0; i < row.size(); i++)
+            {
+                line.push_back(value_to_string(row[i]));
+                if (i < widths.size())
+                    widths[i] = std::max(widths[i], line.back().size());
+            }
+            cells.push_back(std::move(line));
+        }
+
+        std::string out;
+        auto add_line = [&](const std::vector<std::string> &fields)
+        {
+            for (size_t i = 0; i < widths.size(); i++)
+            {
+                const std::string &field = i < fields.size() ? fields[i] : std::string();
+                out += i == 0 ? " " : " | ";
+                out += field;
+                if (i + 1 < widths.size())
+                    out.append(widths[i] - field.size(), ' ');
+            }
+            out += '\n';
+        };
+
+        add_line(result.columns);
+        for (size_t i = 0; i < widths.size(); i++)
+        {
+            out += i == 0 ? "-" : "-+-";
+            out.append(widths[i], '-');
+        }
+        out += "-\n";
+        for (const auto &line : cells)
+            add_line(line);
+        out += "(" + std::to_string(result.rows.size()) + (result.rows.size() == 1 ? " row)\n" : " rows)\n");
+        return out;
+    }
+
+    bool Shell::run_command(const std::string &command, std::string &output)
+    {
+        std::string name = command.substr(0, command.find(' '));
+        std::string arg = name.size() < command.size() ? command.substr(name.size() + 1) : "";
+        arg.erase(0, arg.find_first_not_of(' '));
+
+        if (name == "\\q")
+        {
+            return false;
+        }
+        if (name == "\\timing")
+        {
+            if (arg.empty())
+                options_.timing = !options_.timing;
+            else if (arg == "on" || arg == "off")
+                options_.timing = arg == "on";
+            else
+            {
+                output = "Error: \\timing takes on or off\n";
+                return true;
+            }
+            output = std::string("Timing is ") + (options_.timing ? "on.\n" : "off.\n");
+            return true;
+        }
+        if (name == "\\?")
+        {
+            output = "\\timing [on|off]    report how long each statement took\n"
+                     "\\q                  quit\n"
+                     "\\?                  show this help\n";
+            return true;
+        }
+        output = "Error: Unknown command " + name + " (\\? lists them)\n";
+        return true;
+    }
+
+    size_t Shell::run_script(std::istream &in)
+    {
+        REPONO_TRACE_SPAN("Shell::run_script");
+        BlockingQueue<std::vector<ScriptStatement>> texts(kQueueBatches);
+        BlockingQueue<std::vector<ParsedStatement>> parsed(kQueueBatches);
+        BlockingQueue<std::vector<StatementOutput>> outputs(kQueueBatches);
+
+        // Read and split. A batch is handed on when it is full or when the
+        // input has nothing buffered, so statements piped in slowly run as
+        // soon as they arrive instead of waiting for a full batch.
+        std::thread reader([&]
+                           {
+            StatementSplitter splitter;
+            std::vector<ScriptStatement> batch;
+            std::string line;
+            ScriptStatement stmt;
+            while (std::getline(in, line))
+            {
+                splitter.feed_line(line);
+                while (splitter.next(stmt))
+                    batch.push_back(std::move(stmt));
+                if (!batch.empty() && (batch.size() >= kBatchStatements || in.rdbuf()->in_avail() <= 0))
+                {
+                    if (!texts.push(std::move(batch)))
+                        return;
+                    batch.clear();
+                }
+            }
+            while (splitter.finish(stmt))
+                batch.push_back(std::move(stmt));
+            if (!batch.empty())
+                texts.push(std::move(batch));
+            texts.close(); });
+
+        // Lex and parse ahead of execution
+        std::thread lexer([&]
+                          {
+            while (auto batch = texts.pop())
+            {
+                std::vector<ParsedStatement> out;
+                out.reserve(batch->size());
+                for (auto &text : *batch)
+                {
+                    ParsedStatement p;
+                    if (!text.command)
+                        p.stmt = parse_sql(text.sql, p.error);
+                    p.text = std::move(text);
+                    out.push_back(std::move(p));
+                }
+                if (!parsed.push(std::move(out)))
+                {
+                    texts.close();
+                    return;
+                }
+            }
+            parsed.close(); });
+
+        // Format and write results in statement order
+        std::thread printer([&]
+                            {
+            std::string buf;
+            while (auto batch = outputs.pop())
+            {
+                buf.clear();
+                for (const auto &o : *batch)
+                {
+                    if (o.command)
+                        buf += o.command_output;
+                    else if (!o.result.ok())
+                        buf += "Error at line " + std::to_string(o.line) + ": " + o.result.error + "\n";
+                    else
+                        buf += format_result(o.result);
+                    if (o.timed)
+                        buf += format_ms(o.ms);
+                }
+                out_ << buf;
+                out_.flush();
+            } });
+
+        // Execute in order on this thread
+        auto started = std::chrono::steady_clock::now();
+        size_t statements = 0;
+        size_t failed = 0;
+        double executing_ms = 0;
+        bool stop = false;
+        while (!stop)
+        {
+            auto batch = parsed.pop();
+            if (!batch)
+                break;
+            std::vector<StatementOutput> done;
+            done.reserve(batch->size());
+            for (auto &p : *batch)
+            {
+                StatementOutput o;
+                o.line = p.text.line;
+                if (p.text.command)
+                {
+                    o.command = true;
+                    stop = !run_command(p.text.sql, o.command_output);
+                }
+                else
+                {
+                    statements++;
+                    if (p.stmt.has_value())
+                    {
+                        auto start = std::chrono::steady_clock::now();
+                        o.result = session_.execute(*p.stmt, p.text.sql);
+                        o.ms = elapsed_ms(start);
+                        o.timed = options_.timing;
+                        executing_ms += o.ms;
+                    }
+                    else
+                    {
+                        o.result = QueryResult::failure(p.error);
+                    }
+                    if (!o.result.ok())
+                    {
+                        failed++;
+                        stop = options_.bail;
+                    }
+                }
+                done.push_back(std::move(o));
+                if (stop)
+                    break;
+            }
+            outputs.push(std::move(done));
+        }
+        double wall_ms = elapsed_ms(started);
+
+        // Stopping early closes the queue upstream, which unwinds the lexer and reader
+        parsed.close();
+        outputs.close();
+        lexer.join();
+        reader.join();
+        printer.join();
+
+        if (options_.timing)
+        {
+            char buf[160];
+            std::snprintf(buf, sizeof(buf), "%zu statements, %zu failed: %.3f ms executing, %.3f ms total, %.0f statements/s\n",
+                          statements, failed, executing_ms, wall_ms, wall_ms > 0 ? statements * 1000.0 / wall_ms : 0.0);
+            out_ << buf;
+            out_.flush();
+        }
+        return failed;
+    }
+
+    void Shell::run_interactive(std::istream &in)
+    {
+        StatementSplitter splitter;
+        ScriptStatement stmt;
+        std::string line;
+        bool running = true;
+        auto run = [&](const ScriptStatement &s)
+        {
+            if (s.command)
+            {
+                std::string output;
+                running = run_command(s.sql, output);
+                out_ << output;
+                return;
+            }
+            auto start = std::chrono::steady_clock::now();
+            QueryResult result = session_.execute(s.sql);
+            double ms = elapsed_ms(start);
+            out_ << format_result(result);
+            if (options_.timing)
+                out_ << format_ms(ms);
+        };
+
+        while (running)
+        {
+            out_ << (splitter.pending() ? "   ...> " : "repono> ") << std::flush;
+            if (!std::getline(in, line))
+            {
+                out_ << "\n";
+                while (running && splitter.finish(stmt))
+                    run(stmt);
+                break;
+            }
+            splitter.feed_line(line);
+            while (running && splitter.next(stmt))
+                run(stmt);
+        }
+        out_.flush();
+    }
+};
@@ -0,0 +1,195 @@
+/**
+ *  ReponoDB: Interactive shell and script runner
+ */
+
+#ifndef REPONO_SHELL_H
+#define REPONO_SHELL_H
+
+#include "session.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <iosfwd>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * SHELL
+     *
+     * Reads statements from a terminal, a pipe or a file and runs them on a
+     * Session. Scripts are run as a pipeline of four threads: one reads and
+     * splits the input into statements, one lexes and parses them, the
+     * calling thread executes them in order and one formats and writes the
+     * results. Parsing needs no session state, so it runs ahead of
+     * execution, and the stages hand each other batches of statements, so
+     * a large script keeps the executor busy instead of waiting on input.
+     *
+     * Lines starting with a backslash are shell commands:
+     *
+     *     \timing [on|off]    report how long each statement took
+     *     \q                  stop reading
+     *     \?                  list the commands
+     */
+
+    /**
+     * One statement (without its ';') or shell command from the input
+     */
+    struct ScriptStatement
+    {
+        std::string sql;
+        int line = 0;         // line the statement starts on
+        bool command = false; // a backslash command rather than SQL
+    };
+
+    /**
+     * Splits input lines into statements at top-level semicolons, skipping
+     * over semicolons in strings, quoted identifiers and comments.
+     * Statements that are only whitespace and comments are dropped.
+     */
+    class StatementSplitter
+    {
+    public:
+        /**
+         * Add the next line of input (without its newline)
+         */
+        void feed_line(const std::string &line);
+
+        /**
+         * Take the next complete statement, if any
+         */
+        bool next(ScriptStatement &out);
+
+        /**
+         * At end of input: take the unterminated last statement, if any
+         */
+        bool finish(ScriptStatement &out);
+
+        /**
+         * Whether a statement has been started but not terminated
+         */
+        bool pending() const { return has_content_ || block_comment_; }
+
+    private:
+        std::deque<ScriptStatement> ready_;
+        std::string current_;
+        int line_ = 0;
+        int start_line_ = 0;
+        char quote_ = 0; // ', " or ` while inside one
+        bool block_comment_ = false;
+        bool has_content_ = false;
+
+        void emit();
+    };
+
+    /**
+     * Bounded blocking queue between pipeline stages. close() ends the
+     * stream in both directions: push fails from then on, and pop returns
+     * what is left and then nothing.
+     */
+    template <typename T>
+    class BlockingQueue
+    {
+    public:
+        explicit BlockingQueue(size_t capacity) : capacity_(capacity) {}
+
+        /**
+         * @returns false if the queue was closed
+         */
+        bool push(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [&]
+                           { return closed_ || items_.size() < capacity_; });
+            if (closed_)
+                return false;
+            items_.push_back(std::move(item));
+            not_empty_.notify_one();
+            return true;
+        }
+
+        /**
+         * @returns The next item, or nothing once the queue is closed and empty
+         */
+        std::optional<T> pop()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [&]
+                            { return closed_ || !items_.empty(); });
+            if (items_.empty())
+                return std::nullopt;
+            T item = std::move(items_.front());
+            items_.pop_front();
+            not_full_.notify_one();
+            return item;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            not_empty_.notify_all();
+            not_full_.notify_all();
+        }
+
+    private:
+        size_t capacity_;
+        std::deque<T> items_;
+        bool closed_ = false;
+        std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::condition_variable not_full_;
+    };
+
+    /**
+     * Render a result as a table, its message or its error
+     */
+    std::string format_result(const QueryResult &result);
+
+    struct ShellOptions
+    {
+        bool timing = false; // \timing on from the start
+        bool bail = false;   // stop a script at its first failing statement
+    };
+
+    class Shell
+    {
+    public:
+        Shell(Session &session, std::ostream &out, ShellOptions options = {})
+            : session_(session), out_(out), options_(options) {}
+
+        /**
+         * Run every statement of a script through the pipeline. Errors are
+         * reported with the line the statement starts on. With \timing on,
+         * each statement's execution time is printed after its result,
+         * and a summary at the end.
+         *
+         * @returns The number of statements that failed
+         */
+        size_t run_script(std::istream &in);
+
+        /**
+         * Read-eval-print loop with prompts, one statement at a time
+         */
+        void run_interactive(std::istream &in);
+
+    private:
+        Session &session_;
+        std::ostream &out_;
+        ShellOptions options_;
+
+        /**
+         * Run a backslash command
+         *
+         * @param output Set to what the command prints
+         * @returns false if the command ends the session
+         */
+        bool run_command(const std::string &command, std::string &output);
+    };
+};
+
+#endif // REPONO_SHELL_H
@@ -0,0 +1,143 @@
+/**
+ *  ReponoDB: Asynchronous slow query log
+ */
+
+#include "slow_query_log.h"
+#include "parser.h"
+#include "storage.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <unistd.h>
+
+namespace repono
+{
+    std::string json_escape(const std::string &s)
+    {
+        std::string out;
+        out.reserve(s.size() + 2);
+        for (char c : s)
+        {
+            switch (c)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                }
+                else
+                {
+                    out += c;
+                }
+            }
+        }
+        return out;
+    }
+
+    std::string SlowQueryLog::start()
+    {
+        out_.open(path_, std::ios::app);
+        if (!out_)
+        {
+            return "Cannot open '" + path_ + "'";
+        }
+        running_ = true;
+        thread_ = std::thread([this]
+                              { writer_loop(); });
+        return "";
+    }
+
+    void SlowQueryLog::stop()
+    {
+        if (!running_.exchange(false))
+            return;
+        if (thread_.joinable())
+            thread_.join();
+        // A record() that saw running_ before the exchange may push after
+        // the writer's last pass: wait for it, then write what it queued
+        while (recording_.load() > 0)
+            std::this_thread::yield();
+        drain();
+        out_.close();
+    }
+
+    bool SlowQueryLog::record(SlowQueryEntry &entry)
+    {
+        recording_.fetch_add(1);
+        bool queued = running_.load() && queue_.try_push(entry);
+        recording_.fetch_sub(1);
+        if (!queued)
+        {
+            dropped_.add();
+            return false;
+        }
+        return true;
+    }
+
+    void SlowQueryLog::drain()
+    {
+        SlowQueryEntry entry;
+        bool wrote = false;
+        while (queue_.try_pop(entry))
+        {
+            write(entry);
+            wrote = true;
+        }
+        if (wrote)
+            out_.flush();
+    }
+
+    void SlowQueryLog::writer_loop()
+    {
+        while (true)
+        {
+            bool stopping = !running_.load(std::memory_order_acquire);
+            drain();
+            if (stopping)
+                return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+
+    void SlowQueryLog::write(const SlowQueryEntry &e)
+    {
+        std::string fingerprint = e.fingerprint.empty() ? fingerprint_sql(e.sql) : e.fingerprint;
+        std::string plan;
+        for (const auto &step : e.plan)
+            plan += (plan.empty() ? "" : " -> ") + step;
+        out_ << std::fixed << std::setprecision(3)
+             << "{\"timestamp_ms\":" << e.timestamp_ms
+             << ",\"duration_ms\":" << e.duration_ms
+             << ",\"fingerprint\":\"" << json_escape(fingerprint) << "\""
+             << ",\"fingerprint_hash\":\"" << std::hex << std::setw(16) << std::setfill('0') << fnv1a(fingerprint)
+             << std::dec << std::setfill(' ') << "\""
+             << ",\"sql\":\"" << json_escape(e.sql) << "\""
+             << ",\"branch\":\"" << json_escape(e.branch) << "\""
+             << ",\"commit\":\"" << e.commit_hash << "\""
+             << ",\"rows_scanned\":" << e.rows_scanned
+             << ",\"rows_returned\":" << e.rows_returned
+             << ",\"bytes_decoded\":" << e.bytes_decoded
+             << ",\"memory_peak\":" << e.memory_peak
+             << ",\"plan\":\"" << json_escape(plan) << "\""
+             << ",\"error\":\"" << json_escape(e.error) << "\"}\n";
+        logged_.add();
+    }
+};
@@ -0,0 +1,214 @@
+/**
+ *  ReponoDB: Asynchronous slow query log
+ */
+
+#ifndef REPONO_SLOW_QUERY_LOG_H
+#define REPONO_SLOW_QUERY_LOG_H
+
+#include "memory.h"
+#include "metrics.h"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * SLOW QUERY LOG
+     *
+     * Statements slower than a threshold are handed to a background writer
+     * through a bounded lock-free ring buffer, so logging costs the
+     * statement one slot claim (a CAS) and never waits on the disk. When
+     * the buffer is full the entry is dropped and counted instead.
+     */
+
+    /**
+     * Bounded multi-producer multi-consumer queue (Vyukov's design): each
+     * slot carries a sequence number telling producers and consumers whose
+     * turn it is, so neither side takes a lock
+     */
+    template <typename T>
+    class RingBuffer
+    {
+    public:
+        /**
+         * @param capacity Number of slots, rounded up to a power of two
+         */
+        explicit RingBuffer(size_t capacity)
+        {
+            size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+            mask_ = size - 1;
+            slots_ = std::make_unique<Slot[]>(size);
+            for (size_t i = 0; i < size; i++)
+                slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        /**
+         * @returns false (leaving item untouched) if the buffer is full
+         */
+        bool try_push(T &item)
+        {
+            size_t pos = head_.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Slot &slot = slots_[pos & mask_];
+                size_t seq = slot.sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+                if (diff == 0)
+                {
+                    if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        slot.item = std::move(item);
+                        slot.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = head_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /**
+         * @returns false if the buffer is empty
+         */
+        bool try_pop(T &item)
+        {
+            size_t pos = tail_.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Slot &slot = slots_[pos & mask_];
+                size_t seq = slot.sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        item = std::move(slot.item);
+                        slot.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = tail_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> sequence{0};
+            T item;
+        };
+
+        std::unique_ptr<Slot[]> slots_;
+        size_t mask_ = 0;
+        alignas(64) std::atomic<size_t> head_{0}; // next slot to fill
+        alignas(64) std::atomic<size_t> tail_{0}; // next slot to drain
+    };
+
+    struct SlowQueryEntry
+    {
+        int64_t timestamp_ms = 0;
+        double duration_ms = 0;
+        std::string fingerprint;
+        std::string sql;
+        std::string branch;
+        std::string commit_hash; // commit the working set was based on
+        uint64_t rows_scanned = 0;
+        uint64_t rows_returned = 0;
+        uint64_t bytes_decoded = 0;
+        uint64_t memory_peak = 0;
+        std::vector<std::string> plan;
+        std::string error;
+    };
+
+    std::string json_escape(const std::string &s);
+
+    /**
+     * Writes slow statements as JSON lines to a file
+     *
+     *   SlowQueryLog log("slow.jsonl", 100); // statements over 100 ms
+     *   log.start();
+     *   session.set_slow_query_log(&log);
+     */
+    class SlowQueryLog
+    {
+    public:
+        SlowQueryLog(std::string path, double threshold_ms, size_t capacity = 1024)
+            : path_(std::move(path)), threshold_us_(static_cast<int64_t>(threshold_ms * 1000)),
+              queue_(capacity), running_(false),
+              logged_(metrics().counter("repono_slow_queries_total", "Statements written to the slow query log")),
+              dropped_(metrics().counter("repono_slow_queries_dropped_total", "Slow statements dropped because the log buffer was full")) {}
+
+        ~SlowQueryLog() { stop(); }
+
+        SlowQueryLog(const SlowQueryLog &) = delete;
+        SlowQueryLog &operator=(const SlowQueryLog &) = delete;
+
+        /**
+         * Open the log file for appending and start the writer thread
+         *
+         * @returns "" on success or an error message
+         */
+        std::string start();
+
+        /**
+         * Write out everything queued and stop the writer
+         *
+         * An entry recorded while stopping is either written or counted
+         * as dropped, never left in the buffer.
+         */
+        void stop();
+
+        double threshold_ms() const { return static_cast<double>(threshold_us_.load(std::memory_order_relaxed)) / 1000.0; }
+        void set_threshold_ms(double ms) { threshold_us_.store(static_cast<int64_t>(ms * 1000), std::memory_order_relaxed); }
+
+        /**
+         * Queue an entry without blocking
+         *
+         * @returns false if the buffer was full and the entry was dropped
+         */
+        bool record(SlowQueryEntry &entry);
+
+    private:
+        std::string path_;
+        std::atomic<int64_t> threshold_us_;
+        RingBuffer<SlowQueryEntry> queue_;
+        std::atomic<bool> running_;
+        std::atomic<int> recording_{0}; // record() calls that saw running_ and may still push
+        std::thread thread_;
+        std::ofstream out_;
+        Counter &logged_;
+        Counter &dropped_;
+
+        void writer_loop();
+
+        /**
+         * Write every queued entry, then flush the file
+         */
+        void drain();
+
+        void write(const SlowQueryEntry &e);
+    };
+};
+
+#endif // REPONO_SLOW_QUERY_LOG_H
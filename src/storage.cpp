@@ -0,0 +1,741 @@
+/**
+ *  ReponoDB: Binary encoding, chunks, commit records and the repository
+ */
+
+#include "storage.h"
+#include "repono/hash.h"
+#include "lsm.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+namespace repono
+{
+    size_t estimate_chunk_bytes(const Chunk &chunk)
+    {
+        size_t bytes = sizeof(Chunk) + chunk.hash.capacity();
+        for (const auto &row : chunk.rows)
+            bytes += estimate_row_bytes(row);
+        return bytes;
+    }
+
+    uint64_t fnv1a(const std::string &data)
+    {
+        uint64_t h = 14695981039346656037ULL;
+        for (unsigned char c : data)
+        {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    std::string encode_rows(const std::vector<Row> &rows)
+    {
+        ByteWriter w;
+        w.put_rows(rows);
+        return w.take();
+    }
+
+    std::string compute_chunk_hash(const std::vector<Row> &rows)
+    {
+        return compute_hash(encode_rows(rows));
+    }
+
+    namespace
+    {
+        bool is_boundary_row(const Row &row)
+        {
+            ByteWriter w;
+            w.put_row(row);
+            return (fnv1a(w.data()) & kChunkBoundaryMask) == 0;
+        }
+    }
+
+    std::vector<std::vector<Row>> split_into_chunks(const std::vector<Row> &rows)
+    {
+        REPONO_TRACE_SPAN("split_into_chunks");
+        std::vector<std::vector<Row>> chunks;
+        ChunkSplitter splitter;
+        for (const auto &row : rows)
+        {
+            if (splitter.add(row))
+                chunks.push_back(splitter.take());
+        }
+        if (!splitter.at_boundary())
+        {
+            chunks.push_back(splitter.take());
+        }
+        return chunks;
+    }
+
+    bool ChunkSplitter::add(Row row)
+    {
+        bool boundary = is_boundary_row(row);
+        current_.push_back(std::move(row));
+        return (boundary && current_.size() >= kChunkMinRows) || current_.size() >= kChunkMaxRows;
+    }
+
+    bool ends_at_boundary(const std::vector<Row> &chunk)
+    {
+        if (chunk.size() >= kChunkMaxRows)
+            return true;
+        return chunk.size() >= kChunkMinRows && is_boundary_row(chunk.back());
+    }
+
+    size_t estimate_record_bytes(const CommitRecord &record)
+    {
+        constexpr size_t kHashBytes = sizeof(std::string) + 65; // hex SHA-256 on the heap
+        size_t bytes = sizeof(CommitRecord) + 3 * kHashBytes + record.message.capacity();
+        for (const auto &[name, manifest] : record.tables)
+        {
+            bytes += 64 + name.capacity() + sizeof(TableManifest); // map node
+            bytes += manifest.schema.num_columns() * (sizeof(ColumnDef) + 16);
+            bytes += manifest.chunk_hashes.size() * kHashBytes;
+            bytes += manifest.runs.size() * sizeof(SortedRun);
+        }
+        return bytes;
+    }
+
+    std::string encode_commit_record(const CommitRecord &record)
+    {
+        ByteWriter w;
+        w.put_string(record.hash);
+        w.put_string(record.parent_hash);
+        w.put_string(record.merge_parent_hash);
+        w.put_string(record.message);
+        w.put_i64(record.timestamp);
+        w.put_u32(static_cast<uint32_t>(record.tables.size()));
+        for (const auto &[name, manifest] : record.tables)
+        {
+            w.put_string(name);
+            w.put_schema(manifest.schema);
+            w.put_u64(manifest.row_count);
+            w.put_u32(static_cast<uint32_t>(manifest.chunk_hashes.size()));
+            for (const auto &h : manifest.chunk_hashes)
+            {
+                w.put_string(h);
+            }
+        }
+
+        // LSM tables follow as a trailer, which records from before them lack
+        std::vector<const std::pair<const std::string, TableManifest> *> lsm_tables;
+        for (const auto &entry : record.tables)
+        {
+            if (entry.second.storage == TableStorage::LSM)
+                lsm_tables.push_back(&entry);
+        }
+        if (!lsm_tables.empty())
+        {
+            w.put_u32(static_cast<uint32_t>(lsm_tables.size()));
+            for (const auto *entry : lsm_tables)
+            {
+                w.put_string(entry->first);
+                w.put_u32(static_cast<uint32_t>(entry->second.runs.size()));
+                for (const auto &run : entry->second.runs)
+                {
+                    w.put_u32(run.level);
+                    w.put_u64(run.row_chunks);
+                    w.put_u64(run.tombstone_chunks);
+                    w.put_u64(run.rows);
+                    w.put_u64(run.tombstones);
+                }
+            }
+        }
+        return w.take();
+    }
+
+    std::optional<CommitRecord> decode_commit_record(ByteReader &r)
+    {
+        CommitRecord record;
+        record.hash = r.get_string();
+        record.parent_hash = r.get_string();
+        record.merge_parent_hash = r.get_string();
+        record.message = r.get_string();
+        record.timestamp = r.get_i64();
+        uint32_t num_tables = r.get_u32();
+        for (uint32_t i = 0; i < num_tables && r.ok(); i++)
+        {
+            std::string name = r.get_string();
+            TableManifest manifest;
+            manifest.schema = r.get_schema();
+            manifest.row_count = r.get_u64();
+            uint32_t num_chunks = r.get_u32();
+            for (uint32_t j = 0; j < num_chunks && r.ok(); j++)
+            {
+                manifest.chunk_hashes.push_back(r.get_string());
+            }
+            record.tables[name] = std::move(manifest);
+        }
+        if (r.ok() && !r.at_end())
+        {
+            uint32_t num_lsm = r.get_u32();
+            for (uint32_t i = 0; i < num_lsm && r.ok(); i++)
+            {
+                auto it = record.tables.find(r.get_string());
+                uint32_t num_runs = r.get_u32();
+                if (it == record.tables.end())
+                    return std::nullopt;
+                TableManifest &manifest = it->second;
+                const auto &columns = manifest.schema.get_columns();
+                if (manifest.storage == TableStorage::LSM ||
+                    std::none_of(columns.begin(), columns.end(), [](const ColumnDef &c)
+                                 { return c.is_primary_key; }))
+                    return std::nullopt;
+                manifest.storage = TableStorage::LSM;
+
+                // Levels never decrease from newer runs to older ones (see
+                // lsm_flush), and every run's chunks are in the list
+                size_t chunks = 0;
+                for (uint32_t j = 0; j < num_runs && r.ok(); j++)
+                {
+                    SortedRun run;
+                    run.level = r.get_u32();
+                    run.row_chunks = r.get_u64();
+                    run.tombstone_chunks = r.get_u64();
+                    run.rows = r.get_u64();
+                    run.tombstones = r.get_u64();
+                    size_t limit = manifest.chunk_hashes.size();
+                    if (run.level > kLsmMaxLevel || (!manifest.runs.empty() && run.level < manifest.runs.back().level) ||
+                        run.row_chunks > limit || run.tombstone_chunks > limit || run.chunks() > limit - std::min(chunks, limit))
+                        return std::nullopt;
+                    chunks += run.chunks();
+                    manifest.runs.push_back(std::move(run));
+                }
+                if (chunks != manifest.chunk_hashes.size())
+                    return std::nullopt;
+            }
+        }
+        if (!r.ok())
+        {
+            return std::nullopt;
+        }
+        return record;
+    }
+
+    int64_t now_seconds()
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    std::optional<std::string> read_file(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            return std::nullopt;
+        }
+        std::ostringstream oss;
+        oss << in.rdbuf();
+        std::string data = oss.str();
+        engine_metrics().bytes_read.add(data.size());
+        return data;
+    }
+
+    std::string write_file_atomic(const std::string &path, const std::string &data)
+    {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                return "Cannot write '" + tmp + "'";
+            }
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!out)
+            {
+                return "Short write to '" + tmp + "'";
+            }
+        }
+        engine_metrics().bytes_written.add(data.size());
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        if (ec)
+        {
+            return "Cannot rename '" + tmp + "': " + ec.message();
+        }
+        return "";
+    }
+
+    std::string Repository::open(const std::string &dir)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(dir + "/objects/commits", ec);
+        std::filesystem::create_directories(dir + "/objects/chunks", ec);
+        std::filesystem::create_directories(dir + "/objects/keys", ec);
+        if (ec)
+        {
+            return "Cannot create repository at '" + dir + "': " + ec.message();
+        }
+        root_ = dir;
+
+        auto head = read_file(root_ + "/HEAD");
+        if (head.has_value() && !head->empty())
+        {
+            current_branch_ = head->substr(0, head->find('\n'));
+        }
+        return reload_refs();
+    }
+
+    std::string Repository::reload_refs()
+    {
+        if (root_.empty())
+        {
+            return "";
+        }
+        auto data = read_file(root_ + "/refs");
+        if (!data.has_value())
+        {
+            return ""; // fresh repository, no refs yet
+        }
+        std::map<std::string, std::string> refs;
+        std::istringstream iss(*data);
+        std::string name, hash;
+        while (iss >> name >> hash)
+        {
+            refs[name] = hash;
+        }
+        branches_ = std::move(refs);
+        return "";
+    }
+
+    std::string Repository::flush()
+    {
+        REPONO_TRACE_SPAN("Repository::flush");
+        if (root_.empty())
+        {
+            return "";
+        }
+        for (const auto &hash : unflushed_chunks_)
+        {
+            std::string error = write_file_atomic(chunk_path(hash), encode_rows(chunks_.at(hash)->rows));
+            if (!error.empty())
+                return error;
+        }
+        unflushed_chunks_.clear();
+        evict_chunks();
+
+        for (const auto &[name, summary] : key_summaries_)
+        {
+            ByteWriter w;
+            w.put_u32(static_cast<uint32_t>(summary.size()));
+            for (uint64_t key_hash : summary)
+                w.put_u64(key_hash);
+            std::string error = write_file_atomic(key_summary_path(name), w.take());
+            if (!error.empty())
+                return error;
+        }
+        key_summaries_.clear();
+
+        for (const auto &hash : unflushed_commits_)
+        {
+            std::string error = write_file_atomic(commit_path(hash), encode_commit_record(commits_.at(hash)));
+            if (!error.empty())
+                return error;
+        }
+        unflushed_commits_.clear();
+
+        std::ostringstream refs;
+        for (const auto &[name, hash] : branches_)
+        {
+            refs << name << " " << hash << "\n";
+        }
+        std::string error = write_file_atomic(root_ + "/refs", refs.str());
+        if (!error.empty())
+            return error;
+        return write_file_atomic(root_ + "/HEAD", current_branch_ + "\n");
+    }
+
+    std::string Repository::commit(Commit commit)
+    {
+        REPONO_TRACE_SPAN("Repository::commit");
+        std::map<std::string, TableManifest> tables;
+        uint64_t new_bytes = 0;
+        for (auto &[name, schema] : commit.table_schemas)
+        {
+            tables[name].schema = std::move(schema);
+        }
+        for (auto &[name, rows] : commit.table_data)
+        {
+            TableManifest &manifest = tables[name];
+            manifest.row_count = rows.size();
+            auto runs = commit.table_runs.find(name);
+            if (runs != commit.table_runs.end())
+            {
+                lsm_store_runs(*this, manifest, std::move(runs->second), new_bytes);
+                continue;
+            }
+            for (auto &chunk_rows : split_into_chunks(rows))
+            {
+                manifest.chunk_hashes.push_back(put_chunk(std::move(chunk_rows), &new_bytes));
+            }
+        }
+        commit.table_data.clear();
+        commit.table_schemas.clear();
+        commit.table_runs.clear();
+        commit.parent_hash = head();
+        std::string hash;
+        commit_tables(std::move(commit), std::move(tables), hash, new_bytes);
+        return hash;
+    }
+
+    std::string compute_record_hash(const CommitRecord &record)
+    {
+        Commit header;
+        header.parent_hash = record.parent_hash;
+        header.merge_parent_hash = record.merge_parent_hash;
+        header.message = record.message;
+        header.timestamp = record.timestamp;
+        CommitHasher hasher(header);
+        for (const auto &[name, manifest] : record.tables)
+        {
+            bool lsm = manifest.storage == TableStorage::LSM;
+            hasher.begin_table(name, lsm);
+            size_t next_run = 0, run_end = 0;
+            for (size_t i = 0; i < manifest.chunk_hashes.size(); i++)
+            {
+                while (lsm && i == run_end && next_run < manifest.runs.size())
+                {
+                    const SortedRun &run = manifest.runs[next_run++];
+                    hasher.begin_run(run.level);
+                    run_end += run.chunks();
+                }
+                hasher.add_chunk(manifest.chunk_hashes[i]);
+            }
+        }
+        return hasher.finish();
+    }
+
+    bool is_object_hash(const std::string &hash)
+    {
+        return hash.size() == 64 &&
+               std::all_of(hash.begin(), hash.end(), [](char c)
+                           { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+    }
+
+    bool is_valid_branch_name(const std::string &name)
+    {
+        if (name.empty())
+            return false;
+        for (unsigned char c : name)
+        {
+            if (c <= ' ' || c == 0x7f)
+                return false;
+        }
+        size_t start = 0;
+        while (start <= name.size())
+        {
+            size_t end = name.find('/', start);
+            if (end == std::string::npos)
+                end = name.size();
+            std::string part = name.substr(start, end - start);
+            if (part.empty() || part == "." || part == "..")
+                return false;
+            start = end + 1;
+        }
+        return true;
+    }
+
+    std::string Repository::commit_tables(Commit commit, std::map<std::string, TableManifest> tables, std::string &hash,
+                                          uint64_t new_bytes)
+    {
+        REPONO_TRACE_SPAN("Repository::commit_tables");
+        if (commit.parent_hash != head())
+        {
+            return "Branch '" + current_branch_ + "' moved to " + head().substr(0, 8) + " since " +
+                   (commit.parent_hash.empty() ? "it was created" : commit.parent_hash.substr(0, 8)) +
+                   "; reload and commit again";
+        }
+        uint64_t rows_total = 0;
+        for (const auto &[name, manifest] : tables)
+        {
+            rows_total += manifest.row_count;
+        }
+
+        CommitRecord record;
+        record.parent_hash = commit.parent_hash;
+        record.merge_parent_hash = commit.merge_parent_hash;
+        record.message = commit.message;
+        record.timestamp = commit.timestamp;
+        record.tables = std::move(tables);
+        record.hash = compute_record_hash(record);
+
+        put_record(record);
+        branches_[current_branch_] = record.hash;
+        engine_metrics().commit_rows.record(rows_total);
+        engine_metrics().commit_bytes.record(new_bytes);
+        hash = record.hash;
+        return "";
+    }
+
+    std::string Repository::put_chunk(std::vector<Row> rows, uint64_t *new_bytes)
+    {
+        std::string encoded = encode_rows(rows);
+        std::string hash = compute_hash(encoded);
+        if (!has_chunk(hash))
+        {
+            if (new_bytes != nullptr)
+                *new_bytes += encoded.size();
+            auto chunk = std::make_shared<Chunk>();
+            chunk->hash = hash;
+            chunk->rows = std::move(rows);
+            unflushed_chunks_.insert(hash);
+            cache_chunk(std::move(chunk));
+        }
+        return hash;
+    }
+
+    static std::string key_summary_name(const std::string &chunk_hash, const std::vector<size_t> &key_columns)
+    {
+        std::string name = chunk_hash;
+        for (size_t i = 0; i < key_columns.size(); i++)
+            name += (i == 0 ? "-" : ".") + std::to_string(key_columns[i]);
+        return name;
+    }
+
+    void Repository::put_key_summary(const std::string &chunk_hash, const std::vector<size_t> &key_columns,
+                                     std::vector<uint64_t> summary)
+    {
+        std::string name = key_summary_name(chunk_hash, key_columns);
+        if (!root_.empty() && std::filesystem::exists(key_summary_path(name)))
+            return;
+        key_summaries_.emplace(std::move(name), std::move(summary));
+    }
+
+    std::optional<std::vector<uint64_t>> Repository::get_key_summary(const std::string &chunk_hash,
+                                                                     const std::vector<size_t> &key_columns) const
+    {
+        std::string name = key_summary_name(chunk_hash, key_columns);
+        auto it = key_summaries_.find(name);
+        if (it != key_summaries_.end())
+            return it->second;
+        if (root_.empty())
+            return std::nullopt;
+        auto data = read_file(key_summary_path(name));
+        if (!data.has_value())
+            return std::nullopt;
+        ByteReader r(*data);
+        uint32_t count = r.get_u32();
+        if (count > data->size() / 8)
+            return std::nullopt;
+        std::vector<uint64_t> summary(count);
+        for (auto &key_hash : summary)
+            key_hash = r.get_u64();
+        if (!r.ok())
+            return std::nullopt;
+        return summary;
+    }
+
+    void Repository::put_record(const CommitRecord &record)
+    {
+        if (commits_.find(record.hash) == commits_.end())
+        {
+            commit_memory_.reserve(estimate_record_bytes(record));
+            commits_[record.hash] = record;
+            unflushed_commits_.insert(record.hash);
+        }
+    }
+
+    const CommitRecord *Repository::get_record(const std::string &hash) const
+    {
+        auto it = commits_.find(hash);
+        if (it != commits_.end())
+        {
+            engine_metrics().commit_cache_hits.add();
+            return &it->second;
+        }
+        if (root_.empty() || !is_object_hash(hash))
+        {
+            return nullptr; // anything else would name a path outside objects/
+        }
+        engine_metrics().commit_cache_misses.add();
+        auto data = read_file(commit_path(hash));
+        if (!data.has_value())
+        {
+            return nullptr;
+        }
+        if (QueryStats *stats = current_query_stats())
+            stats->bytes_decoded += data->size();
+        ByteReader r(*data);
+        auto record = decode_commit_record(r);
+        if (!record.has_value() || record->hash != hash)
+        {
+            return nullptr;
+        }
+        commit_memory_.reserve(estimate_record_bytes(*record));
+        return &(commits_[hash] = std::move(*record));
+    }
+
+    ChunkPtr Repository::get_chunk(const std::string &hash) const
+    {
+        auto it = chunks_.find(hash);
+        if (it != chunks_.end())
+        {
+            engine_metrics().chunk_cache_hits.add();
+            return it->second;
+        }
+        if (root_.empty() || !is_object_hash(hash))
+        {
+            return nullptr;
+        }
+        engine_metrics().chunk_cache_misses.add();
+        auto data = read_file(chunk_path(hash));
+        if (!data.has_value())
+        {
+            return nullptr;
+        }
+        if (QueryStats *stats = current_query_stats())
+            stats->bytes_decoded += data->size();
+        ByteReader r(*data);
+        auto chunk = std::make_shared<Chunk>();
+        chunk->hash = hash;
+        chunk->rows = r.get_rows();
+        if (!r.ok())
+        {
+            return nullptr;
+        }
+        cache_chunk(chunk);
+        evict_chunks();
+        return chunk;
+    }
+
+    std::optional<Commit> Repository::get_commit(const std::string &hash) const
+    {
+        const CommitRecord *record = get_record(hash);
+        if (record == nullptr)
+        {
+            return std::nullopt;
+        }
+        Commit commit;
+        commit.hash = record->hash;
+        commit.parent_hash = record->parent_hash;
+        commit.merge_parent_hash = record->merge_parent_hash;
+        commit.message = record->message;
+        commit.timestamp = record->timestamp;
+
+        for (const auto &[name, manifest] : record->tables)
+        {
+            commit.table_schemas[name] = manifest.schema;
+            if (!read_table_rows(*this, manifest, commit.table_data[name]).empty())
+            {
+                return std::nullopt;
+            }
+            if (manifest.storage == TableStorage::LSM &&
+                !read_lsm_runs(*this, manifest, commit.table_runs[name]).empty())
+            {
+                return std::nullopt;
+            }
+        }
+        return commit;
+    }
+
+    std::vector<std::string> Repository::log(const std::string &hash) const
+    {
+        std::vector<std::string> result;
+        std::string current = hash;
+        while (!current.empty())
+        {
+            const CommitRecord *record = get_record(current);
+            if (record == nullptr)
+                break;
+            result.push_back(current);
+            current = record->parent_hash;
+        }
+        return result;
+    }
+
+    bool Repository::is_ancestor(const std::string &ancestor, const std::string &descendant) const
+    {
+        if (ancestor.empty())
+        {
+            return true;
+        }
+        bool found = false;
+        walk_ancestors(descendant, [&](const std::string &hash)
+                       { found = hash == ancestor;
+                         return !found; });
+        return found;
+    }
+
+    void Repository::walk_ancestors(const std::string &start, const std::function<bool(const std::string &)> &visit) const
+    {
+        std::unordered_set<std::string> seen;
+        std::deque<std::string> queue = {start};
+        while (!queue.empty())
+        {
+            std::string hash = queue.front();
+            queue.pop_front();
+            if (hash.empty() || !seen.insert(hash).second)
+                continue;
+            const CommitRecord *record = get_record(hash);
+            if (record == nullptr)
+                continue;
+            if (!visit(hash))
+                return;
+            queue.push_back(record->parent_hash);
+            queue.push_back(record->merge_parent_hash);
+        }
+    }
+
+    std::string Repository::merge_base(const std::string &a, const std::string &b) const
+    {
+        std::unordered_set<std::string> ancestors_of_a;
+        walk_ancestors(a, [&](const std::string &hash)
+                       { ancestors_of_a.insert(hash);
+                         return true; });
+        std::string base;
+        walk_ancestors(b, [&](const std::string &hash)
+                       {
+            if (ancestors_of_a.count(hash))
+            {
+                base = hash;
+                return false;
+            }
+            return true; });
+        return base;
+    }
+
+    std::optional<std::string> Repository::branch_head(const std::string &name) const
+    {
+        auto it = branches_.find(name);
+        if (it != branches_.end())
+        {
+            return it->second;
+        }
+        return std::nullopt;
+    }
+
+    void Repository::cache_chunk(ChunkPtr chunk) const
+    {
+        chunk_memory_.reserve(estimate_chunk_bytes(*chunk));
+        chunk_order_.push_back(chunk->hash);
+        chunks_[chunk->hash] = std::move(chunk);
+    }
+
+    void Repository::evict_chunks() const
+    {
+        if (root_.empty())
+            return; // in-memory: nowhere to read them back from
+        for (size_t n = chunk_order_.size(); n > 0 && chunk_memory_.over_limit(); n--)
+        {
+            std::string hash = std::move(chunk_order_.front());
+            chunk_order_.pop_front();
+            auto it = chunks_.find(hash);
+            if (it == chunks_.end())
+                continue;
+            if (unflushed_chunks_.count(hash))
+            {
+                chunk_order_.push_back(std::move(hash));
+                continue;
+            }
+            chunk_memory_.release(estimate_chunk_bytes(*it->second));
+            chunks_.erase(it);
+            engine_metrics().chunk_evictions.add();
+        }
+    }
+};
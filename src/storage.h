@@ -0,0 +1,716 @@
+/**
+ *  ReponoDB: Binary encoding, chunks, commit records and the repository
+ */
+
+#ifndef REPONO_STORAGE_H
+#define REPONO_STORAGE_H
+
+#include "repono/commit.h"
+#include "memory.h"
+#include "metrics.h"
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace repono
+{
+    // BINARY ENCODING
+
+    /**
+     * ByteWriter
+     *
+     * Appends little-endian integers, strings and Values to a byte buffer.
+     * Used for repository objects on disk and for packs sent between repositories.
+     */
+    class ByteWriter
+    {
+    public:
+        void put_u8(uint8_t v) { buf_.push_back(static_cast<char>(v)); }
+
+        void put_u32(uint32_t v)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                buf_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+            }
+        }
+
+        void put_u64(uint64_t v)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                buf_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+            }
+        }
+
+        void put_i64(int64_t v) { put_u64(static_cast<uint64_t>(v)); }
+
+        void put_f64(double v)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            put_u64(bits);
+        }
+
+        void put_string(const std::string &s)
+        {
+            put_u32(static_cast<uint32_t>(s.size()));
+            buf_.append(s);
+        }
+
+        /**
+         * Values are written as their variant index followed by the payload
+         */
+        void put_value(const Value &v)
+        {
+            put_u8(static_cast<uint8_t>(v.index()));
+            if (std::holds_alternative<int64_t>(v))
+            {
+                put_i64(std::get<int64_t>(v));
+            }
+            else if (std::holds_alternative<double>(v))
+            {
+                put_f64(std::get<double>(v));
+            }
+            else if (std::holds_alternative<std::string>(v))
+            {
+                put_string(std::get<std::string>(v));
+            }
+            else if (std::holds_alternative<bool>(v))
+            {
+                put_u8(std::get<bool>(v) ? 1 : 0);
+            }
+        }
+
+        void put_row(const Row &row)
+        {
+            put_u32(static_cast<uint32_t>(row.size()));
+            for (const auto &v : row)
+            {
+                put_value(v);
+            }
+        }
+
+        void put_rows(const std::vector<Row> &rows)
+        {
+            put_u32(static_cast<uint32_t>(rows.size()));
+            for (const auto &row : rows)
+            {
+                put_row(row);
+            }
+        }
+
+        void put_schema(const Schema &schema)
+        {
+            put_u32(static_cast<uint32_t>(schema.num_columns()));
+            for (const auto &col : schema.get_columns())
+            {
+                put_string(col.name);
+                put_u8(static_cast<uint8_t>(col.type));
+                put_u8(col.is_primary_key ? 1 : 0);
+                put_u8(col.is_nullable ? 1 : 0);
+            }
+        }
+
+        size_t size() const { return buf_.size(); }
+        const std::string &data() const { return buf_; }
+        std::string take() { return std::move(buf_); }
+
+    private:
+        std::string buf_;
+    };
+
+    /**
+     * ByteReader
+     *
+     * Reads back what ByteWriter wrote. Instead of throwing on truncated or
+     * corrupt input, the reader flips ok() to false and returns zero values,
+     * so callers check ok() once after decoding a whole object.
+     */
+    class ByteReader
+    {
+    public:
+        explicit ByteReader(const std::string &data) : data_(data), pos_(0), ok_(true) {}
+
+        uint8_t get_u8()
+        {
+            if (!need(1))
+                return 0;
+            return static_cast<uint8_t>(data_[pos_++]);
+        }
+
+        uint32_t get_u32()
+        {
+            if (!need(4))
+                return 0;
+            uint32_t v = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                v |= static_cast<uint32_t>(static_cast<uint8_t>(data_[pos_++])) << (8 * i);
+            }
+            return v;
+        }
+
+        uint64_t get_u64()
+        {
+            if (!need(8))
+                return 0;
+            uint64_t v = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                v |= static_cast<uint64_t>(static_cast<uint8_t>(data_[pos_++])) << (8 * i);
+            }
+            return v;
+        }
+
+        int64_t get_i64() { return static_cast<int64_t>(get_u64()); }
+
+        double get_f64()
+        {
+            uint64_t bits = get_u64();
+            double v;
+            std::memcpy(&v, &bits, sizeof(v));
+            return v;
+        }
+
+        std::string get_string()
+        {
+            uint32_t len = get_u32();
+            if (!need(len))
+                return "";
+            std::string s = data_.substr(pos_, len);
+            pos_ += len;
+            return s;
+        }
+
+        Value get_value()
+        {
+            switch (get_u8())
+            {
+            case 0:
+                return std::monostate{};
+            case 1:
+                return get_i64();
+            case 2:
+                return get_f64();
+            case 3:
+                return get_string();
+            case 4:
+                return get_u8() != 0;
+            default:
+                ok_ = false;
+                return std::monostate{};
+            }
+        }
+
+        Row get_row()
+        {
+            uint32_t n = get_u32();
+            Row row;
+            if (!need(n)) // every value takes at least one byte
+                return row;
+            row.reserve(n);
+            for (uint32_t i = 0; i < n && ok_; i++)
+            {
+                row.push_back(get_value());
+            }
+            return row;
+        }
+
+        std::vector<Row> get_rows()
+        {
+            uint32_t n = get_u32();
+            std::vector<Row> rows;
+            if (!need(n))
+                return rows;
+            rows.reserve(n);
+            for (uint32_t i = 0; i < n && ok_; i++)
+            {
+                rows.push_back(get_row());
+            }
+            return rows;
+        }
+
+        Schema get_schema()
+        {
+            Schema schema;
+            uint32_t n = get_u32();
+            for (uint32_t i = 0; i < n && ok_; i++)
+            {
+                std::string name = get_string();
+                uint8_t type = get_u8();
+                bool pk = get_u8() != 0;
+                bool nullable = get_u8() != 0;
+                if (type > static_cast<uint8_t>(DataType::TIMESTAMP))
+                {
+                    ok_ = false;
+                    break;
+                }
+                schema.add_column(ColumnDef(name, static_cast<DataType>(type), pk, nullable));
+            }
+            return schema;
+        }
+
+        bool ok() const { return ok_; }
+        bool at_end() const { return pos_ >= data_.size(); }
+
+    private:
+        const std::string &data_;
+        size_t pos_;
+        bool ok_;
+
+        bool need(size_t n)
+        {
+            if (!ok_ || data_.size() - pos_ < n)
+            {
+                ok_ = false;
+                return false;
+            }
+            return true;
+        }
+    };
+
+    /**
+     * CHUNKS
+     *
+     * Table data is stored as a sequence of content-addressed chunks of rows.
+     * Boundaries are picked from the row contents (content-defined chunking),
+     * so inserting a row only changes the chunk it lands in instead of shifting
+     * every chunk after it. Unchanged chunks keep their hash across commits,
+     * which is what lets sync, diff and history skip them.
+     */
+    constexpr size_t kChunkMinRows = 16;
+    constexpr size_t kChunkMaxRows = 256;
+    constexpr uint64_t kChunkBoundaryMask = 63; // ~64 rows per chunk on average
+
+    struct Chunk
+    {
+        std::string hash;
+        std::vector<Row> rows;
+    };
+
+    using ChunkPtr = std::shared_ptr<const Chunk>;
+
+    /**
+     * Rough heap footprint of a decoded chunk
+     */
+    size_t estimate_chunk_bytes(const Chunk &chunk);
+
+    /**
+     * 64-bit FNV-1a, used where we need a fast non-cryptographic hash
+     */
+    uint64_t fnv1a(const std::string &data);
+
+    std::string encode_rows(const std::vector<Row> &rows);
+
+    std::string compute_chunk_hash(const std::vector<Row> &rows);
+
+    /**
+     * Split a table's rows into chunks
+     *
+     * A chunk ends after a row whose encoded hash hits the boundary mask,
+     * subject to the min/max chunk sizes.
+     *
+     * @param rows The rows of one table, in storage order
+     * @return The rows grouped into chunks
+     */
+    std::vector<std::vector<Row>> split_into_chunks(const std::vector<Row> &rows);
+
+    /**
+     * split_into_chunks one row at a time, for rows that are not in a
+     * single vector. Fed the same rows, it finds the same boundaries.
+     */
+    class ChunkSplitter
+    {
+    public:
+        /**
+         * Add the next row
+         *
+         * @returns true if the row ends a chunk, which take() then returns
+         */
+        bool add(Row row);
+
+        /**
+         * The rows added since the last take(): a finished chunk, or the
+         * last chunk of a table once its rows run out
+         */
+        std::vector<Row> take() { return std::exchange(current_, {}); }
+
+        /**
+         * Whether the next row starts a new chunk
+         */
+        bool at_boundary() const { return current_.empty(); }
+
+    private:
+        std::vector<Row> current_;
+    };
+
+    /**
+     * Whether split_into_chunks would end a chunk after these rows even if
+     * more followed (false for a table's last chunk cut short by its end)
+     */
+    bool ends_at_boundary(const std::vector<Row> &chunk);
+
+    /**
+     * COMMIT RECORD
+     *
+     * How a commit is stored inside a Repository: the same metadata as Commit,
+     * but each table is a schema plus the list of chunk hashes holding its rows.
+     * Commit (with full table_data) is produced from a record on demand.
+     */
+    enum class TableStorage : uint8_t
+    {
+        CHUNKS, // the rows, in order, cut into chunks
+        LSM     // immutable sorted runs, merged on read (see lsm.h)
+    };
+
+    /**
+     * One immutable run of an LSM table: rows and the keys deleted since
+     * older runs (tombstones), each sorted by primary key and cut into
+     * chunks, followed by one index chunk that point lookups use to find a
+     * key without reading the run (see lsm.h)
+     */
+    struct SortedRun
+    {
+        uint32_t level = 0;
+        size_t row_chunks = 0;       // chunks of rows, then
+        size_t tombstone_chunks = 0; // chunks of deleted keys, then the index chunk
+        size_t rows = 0;
+        size_t tombstones = 0;
+
+        size_t chunks() const { return row_chunks + tombstone_chunks + 1; }
+    };
+
+    struct TableManifest
+    {
+        Schema schema;
+        std::vector<std::string> chunk_hashes; // LSM: the chunks of every run, newest run first
+        size_t row_count = 0;
+        TableStorage storage = TableStorage::CHUNKS;
+        std::vector<SortedRun> runs; // LSM only, newest first
+    };
+
+    /**
+     * Bounds on the leading primary key column of a table, as a WHERE
+     * clause implies them (both inclusive; an unset bound is open). Scans
+     * use it to pass over rows and chunks that cannot match.
+     */
+    struct KeyRange
+    {
+        std::optional<Value> low, high;
+
+        bool bounded() const { return low.has_value() || high.has_value(); }
+
+        bool contains(const Value &v) const
+        {
+            if (!bounded())
+                return true;
+            if (is_null(v))
+                return false;
+            return !(low.has_value() && value_less_than(v, *low)) && !(high.has_value() && value_less_than(*high, v));
+        }
+    };
+
+    struct CommitRecord
+    {
+        std::string hash;
+        std::string parent_hash;
+        std::string merge_parent_hash;
+        std::string message;
+        int64_t timestamp = 0;
+
+        std::map<std::string, TableManifest> tables; // ordered, so encoding is deterministic
+
+        bool is_root() const
+        {
+            return parent_hash.empty();
+        }
+    };
+
+    /**
+     * Rough heap footprint of a decoded commit record
+     */
+    size_t estimate_record_bytes(const CommitRecord &record);
+
+    std::string encode_commit_record(const CommitRecord &record);
+
+    std::optional<CommitRecord> decode_commit_record(ByteReader &r);
+
+    /**
+     * The hash a record's content gives it (see CommitHasher), ignoring
+     * its hash field
+     */
+    std::string compute_record_hash(const CommitRecord &record);
+
+    /**
+     * Whether a string is a full object hash: 64 lowercase hex characters
+     */
+    bool is_object_hash(const std::string &hash);
+
+    /**
+     * Whether a branch name can be stored in the refs file and used in a
+     * path: non-empty, no whitespace or control characters, and no "."
+     * or ".." component
+     */
+    bool is_valid_branch_name(const std::string &name);
+
+    int64_t now_seconds();
+
+    /**
+     * Read a whole file into a string
+     *
+     * @returns std::nullopt if the file cannot be opened
+     */
+    std::optional<std::string> read_file(const std::string &path);
+
+    /**
+     * Write a file atomically (write to a temp file, then rename over the target)
+     * so concurrent readers of a shared repository never see half an object.
+     *
+     * @returns "" on success or an error message
+     */
+    std::string write_file_atomic(const std::string &path, const std::string &data);
+
+    /**
+     * REPOSITORY
+     *
+     * Holds the commit graph, the content-addressed chunk store and the
+     * branch pointers. A repository is either purely in memory or attached
+     * to a directory with open(), in which case objects are read lazily
+     * from disk the first time they are needed and new objects are written
+     * back by flush().
+     *
+     * On-disk layout:
+     *   <dir>/HEAD                     current branch name
+     *   <dir>/refs                     one "branch hash" line per branch
+     *   <dir>/objects/commits/<hash>   encoded CommitRecord
+     *   <dir>/objects/chunks/<hash>    encoded rows
+     *   <dir>/objects/keys/<hash>-<k>  key summary of a chunk for key columns k
+     *
+     * The repository is not internally synchronized. Code that shares one
+     * across threads (e.g. RepositoryServer) holds mutex() while using it.
+     */
+    class Repository
+    {
+    public:
+        Repository() : current_branch_("main") {}
+
+        /**
+         * Attach this repository to a directory, creating the layout if needed
+         *
+         * @param dir The repository directory
+         * @returns "" on success or an error message
+         */
+        std::string open(const std::string &dir);
+
+        /**
+         * Re-read the refs file from disk (used when another process updates it)
+         */
+        std::string reload_refs();
+
+        /**
+         * Write objects created since the last flush, then the refs
+         *
+         * Objects go first so a reader that sees the new refs can always
+         * find the objects they point to.
+         */
+        std::string flush();
+
+        /**
+         * Create a new commit on the current branch
+         *
+         * The parent is the current branch head; hash is computed here.
+         *
+         * @param commit Commit with message, timestamp, table_data and table_schemas filled in
+         * @return The new commit's hash
+         */
+        std::string commit(Commit commit);
+
+        /**
+         * Create a new commit from tables whose chunks are already stored
+         *
+         * The hash covers the chunk hashes (see compute_commit_hash), so no
+         * rows are read here. The commit's parent is the commit its tables
+         * were built on, which has to still be the current branch's head:
+         * if the branch moved meanwhile (another session, a replica or a
+         * push), committing would silently drop the commits it moved to.
+         *
+         * @param commit Supplies the parent, message, timestamp and merge parent (its tables are ignored)
+         * @param tables Every table of the new commit
+         * @param hash Set to the new commit's hash
+         * @param new_bytes Encoded size of the chunks stored for this commit (for metrics)
+         * @returns "" on success or an error if the branch head is not commit.parent_hash
+         */
+        std::string commit_tables(Commit commit, std::map<std::string, TableManifest> tables, std::string &hash,
+                                  uint64_t new_bytes = 0);
+
+        /**
+         * Store a chunk, returning its hash. Storing an existing chunk is a no-op.
+         *
+         * @param new_bytes If given, increased by the encoded size when the chunk is new
+         */
+        std::string put_chunk(std::vector<Row> rows, uint64_t *new_bytes = nullptr);
+
+        /**
+         * Store a commit record under its hash field
+         *
+         * The hash is not checked here. Records from another repository
+         * go through apply_pack, which re-hashes them first.
+         */
+        void put_record(const CommitRecord &record);
+
+        /**
+         * Look up a commit record, loading it from disk if needed
+         *
+         * @returns Pointer to the record, or nullptr if not found
+         */
+        const CommitRecord *get_record(const std::string &hash) const;
+
+        /**
+         * Look up a chunk, loading it from disk if needed
+         *
+         * @returns The chunk, or nullptr if not found
+         */
+        ChunkPtr get_chunk(const std::string &hash) const;
+
+        /**
+         * Store the key summary of a chunk (see summarize_keys), written
+         * alongside the chunk so lineage queries can rule the chunk out
+         * without decoding it
+         */
+        void put_key_summary(const std::string &chunk_hash, const std::vector<size_t> &key_columns,
+                             std::vector<uint64_t> summary);
+
+        /**
+         * Look up a chunk's key summary, loading it from disk if needed
+         *
+         * @returns The summary, or std::nullopt if none was stored (e.g. the
+         *          chunk was fetched, or written by Repository::commit)
+         */
+        std::optional<std::vector<uint64_t>> get_key_summary(const std::string &chunk_hash,
+                                                             const std::vector<size_t> &key_columns) const;
+
+        bool has_commit(const std::string &hash) const
+        {
+            return commits_.count(hash) > 0 ||
+                   (!root_.empty() && is_object_hash(hash) && std::filesystem::exists(commit_path(hash)));
+        }
+
+        bool has_chunk(const std::string &hash) const
+        {
+            return chunks_.count(hash) > 0 ||
+                   (!root_.empty() && is_object_hash(hash) && std::filesystem::exists(chunk_path(hash)));
+        }
+
+        /**
+         * Materialize a full Commit (all table rows) from its record
+         *
+         * @returns The commit, or std::nullopt if it or one of its chunks is missing
+         */
+        std::optional<Commit> get_commit(const std::string &hash) const;
+
+        /**
+         * Walk first parents from a commit back to the root
+         *
+         * @param hash Starting commit (included)
+         * @return Commit hashes, newest first
+         */
+        std::vector<std::string> log(const std::string &hash) const;
+
+        /**
+         * Check whether ancestor is reachable from descendant (or equal to it)
+         */
+        bool is_ancestor(const std::string &ancestor, const std::string &descendant) const;
+
+        /**
+         * Visit a commit and all its ancestors (both parents of merges), each
+         * once, nearest first. The visitor returns false to stop.
+         */
+        void walk_ancestors(const std::string &start, const std::function<bool(const std::string &)> &visit) const;
+
+        /**
+         * Nearest common ancestor of two commits ("" if they share no history)
+         */
+        std::string merge_base(const std::string &a, const std::string &b) const;
+
+        // Branches
+
+        std::string head() const
+        {
+            auto it = branches_.find(current_branch_);
+            return it != branches_.end() ? it->second : "";
+        }
+
+        std::optional<std::string> branch_head(const std::string &name) const;
+
+        void set_branch(const std::string &name, const std::string &hash) { branches_[name] = hash; }
+        void remove_branch(const std::string &name) { branches_.erase(name); }
+        const std::map<std::string, std::string> &branches() const { return branches_; }
+
+        const std::string &current_branch() const { return current_branch_; }
+        void set_current_branch(const std::string &name) { current_branch_ = name; }
+
+        const std::string &root() const { return root_; }
+        std::mutex &mutex() const { return mutex_; }
+
+        /**
+         * Cap the memory held by decoded chunks (0 = unlimited). Chunks that
+         * are already on disk are dropped, oldest first, to stay under it and
+         * are read back when next needed; chunks not yet flushed stay in
+         * memory until the next flush.
+         */
+        void set_buffer_pool_limit(uint64_t bytes)
+        {
+            chunk_memory_.set_limit(bytes);
+            evict_chunks();
+        }
+
+        const MemoryTracker &commit_cache_memory() const { return commit_memory_; }
+        const MemoryTracker &buffer_pool_memory() const { return chunk_memory_; }
+
+    private:
+        std::string root_; // directory, or "" for in-memory
+        std::string current_branch_;
+        std::map<std::string, std::string> branches_; // branch name -> commit hash
+
+        // Caches of loaded objects; mutable so lookups can load lazily
+        mutable std::unordered_map<std::string, CommitRecord> commits_;
+        mutable std::unordered_map<std::string, ChunkPtr> chunks_;
+
+        std::unordered_set<std::string> unflushed_commits_;
+        std::unordered_set<std::string> unflushed_chunks_;
+        std::unordered_map<std::string, std::vector<uint64_t>> key_summaries_; // not yet flushed (all, in memory)
+
+        mutable MemoryTracker commit_memory_{"commit_cache", 0, {&memory_pools().commit_cache}};
+        mutable MemoryTracker chunk_memory_{"buffer_pool", 0, {&memory_pools().buffer_pool}};
+        mutable std::deque<std::string> chunk_order_; // cached chunks, oldest first
+
+        mutable std::mutex mutex_;
+
+        void cache_chunk(ChunkPtr chunk) const;
+
+        /**
+         * Drop flushed chunks, oldest first, until the buffer pool is under its limit
+         */
+        void evict_chunks() const;
+
+        std::string commit_path(const std::string &hash) const { return root_ + "/objects/commits/" + hash; }
+        std::string chunk_path(const std::string &hash) const { return root_ + "/objects/chunks/" + hash; }
+        std::string key_summary_path(const std::string &name) const { return root_ + "/objects/keys/" + name; }
+    };
+};
+
+#endif // REPONO_STORAGE_H
@@ -0,0 +1,16 @@
+/**
+ *  ReponoDB: Tracing spans (Chrome trace events)
+ */
+
+#include "trace.h"
+
+namespace repono
+{
+#ifdef REPONO_TRACING
+    std::string start_tracing(const std::string &path) { return Tracer::instance().start(path); }
+    std::string stop_tracing() { return Tracer::instance().stop(); }
+#else
+    std::string start_tracing(const std::string &) { return "Tracing is not compiled in (build with -DREPONO_TRACING)"; }
+    std::string stop_tracing() { return "Tracing is not compiled in (build with -DREPONO_TRACING)"; }
+#endif
+};
@@ -0,0 +1,198 @@
+/**
+ *  ReponoDB: Tracing spans (Chrome trace events)
+ */
+
+#ifndef REPONO_TRACE_H
+#define REPONO_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace repono
+{
+    /**
+     * TRACING
+     *
+     * Scoped spans recorded as Chrome trace events, viewable in
+     * chrome://tracing or ui.perfetto.dev. Spans are compiled in only with
+     * -DREPONO_TRACING (make TRACE=1); otherwise REPONO_TRACE_SPAN expands
+     * to nothing, so the spans can stay in release builds. When compiled in,
+     * a span costs one relaxed load unless a trace is being recorded.
+     *
+     *   start_tracing("trace.json");
+     *   ... run statements ...
+     *   stop_tracing(); // writes the file
+     */
+#ifdef REPONO_TRACING
+    class Tracer
+    {
+    public:
+        static Tracer &instance()
+        {
+            static Tracer tracer;
+            return tracer;
+        }
+
+        bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+        std::string start(const std::string &path)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (enabled())
+            {
+                return "Already tracing to '" + path_ + "'";
+            }
+            for (auto &buffer : buffers_)
+            {
+                std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+                buffer->events.clear();
+            }
+            path_ = path;
+            epoch_ = std::chrono::steady_clock::now();
+            enabled_.store(true, std::memory_order_release);
+            return "";
+        }
+
+        /**
+         * Stop recording and write the trace file
+         *
+         * @returns "" on success or an error message
+         */
+        std::string stop()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!enabled())
+            {
+                return "Not tracing";
+            }
+            enabled_.store(false, std::memory_order_release);
+
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+            bool first = true;
+            int pid = static_cast<int>(::getpid());
+            for (auto &buffer : buffers_)
+            {
+                std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+                for (const auto &event : buffer->events)
+                {
+                    out << (first ? "\n" : ",\n")
+                        << "{\"name\":\"" << event.name << "\",\"cat\":\"repono\",\"ph\":\"X\",\"ts\":"
+                        << static_cast<double>(event.start_ns) / 1000.0 << ",\"dur\":"
+                        << static_cast<double>(event.duration_ns) / 1000.0 << ",\"pid\":" << pid
+                        << ",\"tid\":" << buffer->tid << "}";
+                    first = false;
+                }
+                buffer->events.clear();
+            }
+            out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+            std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+            file << out.str();
+            return file ? "" : "Cannot write '" + path_ + "'";
+        }
+
+        /**
+         * Record a finished span on the calling thread's buffer
+         */
+        void record(const char *name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+        {
+            ThreadBuffer &buffer = local_buffer();
+            std::lock_guard<std::mutex> lock(buffer.mutex); // only contended by stop()
+            buffer.events.push_back(TraceEvent{
+                name,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch_).count(),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()});
+        }
+
+    private:
+        struct TraceEvent
+        {
+            const char *name; // string literal
+            int64_t start_ns;
+            int64_t duration_ns;
+        };
+
+        struct ThreadBuffer
+        {
+            std::mutex mutex;
+            uint64_t tid = 0;
+            std::vector<TraceEvent> events;
+        };
+
+        std::mutex mutex_;
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers_; // shared so events outlive their thread
+        std::atomic<bool> enabled_{false};
+        std::string path_;
+        std::chrono::steady_clock::time_point epoch_;
+
+        ThreadBuffer &local_buffer()
+        {
+            thread_local std::shared_ptr<ThreadBuffer> buffer;
+            if (!buffer)
+            {
+                buffer = std::make_shared<ThreadBuffer>();
+                std::lock_guard<std::mutex> lock(mutex_);
+                buffer->tid = buffers_.size() + 1;
+                buffers_.push_back(buffer);
+            }
+            return *buffer;
+        }
+    };
+
+    class TraceSpan
+    {
+    public:
+        explicit TraceSpan(const char *name) : name_(name), active_(Tracer::instance().enabled())
+        {
+            if (active_)
+                start_ = std::chrono::steady_clock::now();
+        }
+
+        ~TraceSpan()
+        {
+            if (active_ && Tracer::instance().enabled())
+                Tracer::instance().record(name_, start_, std::chrono::steady_clock::now());
+        }
+
+        TraceSpan(const TraceSpan &) = delete;
+        TraceSpan &operator=(const TraceSpan &) = delete;
+
+    private:
+        const char *name_;
+        bool active_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+#define REPONO_TRACE_CONCAT_(a, b) a##b
+#define REPONO_TRACE_CONCAT(a, b) REPONO_TRACE_CONCAT_(a, b)
+#define REPONO_TRACE_SPAN(name) ::repono::TraceSpan REPONO_TRACE_CONCAT(trace_span_, __LINE__)(name)
+#else
+#define REPONO_TRACE_SPAN(name) ((void)0)
+#endif
+
+    /**
+     * Start recording spans to a Chrome trace file
+     *
+     * @returns "" on success, or an error (already tracing, or tracing not compiled in)
+     */
+    std::string start_tracing(const std::string &path);
+
+    /**
+     * Stop recording and write the trace file
+     *
+     * @returns "" on success, or an error
+     */
+    std::string stop_tracing();
+};
+
+#endif // REPONO_TRACE_H
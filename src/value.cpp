@@ -0,0 +1,120 @@
+/**
+ *  ReponoDB: Values and rows
+ */
+
+#include "repono/value.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace repono
+{
+    std::string value_to_string(const Value &v)
+    {
+        if (std::holds_alternative<std::monostate>(v))
+        {
+            return "NULL";
+        }
+
+        if (std::holds_alternative<std::int64_t>(v))
+        {
+            return std::to_string(std::get<int64_t>(v));
+        }
+
+        if (std::holds_alternative<double>(v))
+        {
+            std::ostringstream oss;
+
+            oss << std::fixed << std::setprecision(2) << std::get<double>(v);
+            return oss.str();
+        }
+
+        if (std::holds_alternative<std::string>(v))
+        {
+            return std::get<std::string>(v);
+        }
+
+        if (std::holds_alternative<bool>(v))
+        {
+            return std::get<bool>(v) ? "true" : "false";
+        }
+
+        return "???";
+    }
+
+    bool values_equal(const Value &a, const Value &b)
+    {
+        if (std::holds_alternative<std::monostate>(a) || std::holds_alternative<std::monostate>(b))
+        {
+            return false;
+        }
+        if (a.index() != b.index())
+        {
+            return false;
+        }
+
+        return a == b; // using inbuilt variant checker
+    }
+
+    bool value_less_than(const Value &a, const Value &b)
+    {
+        if (std::holds_alternative<std::monostate>(a))
+            return false;
+        if (std::holds_alternative<std::monostate>(b))
+            return true;
+        if (std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b))
+        {
+            return std::get<int64_t>(a) < std::get<int64_t>(b);
+        }
+
+        if (std::holds_alternative<double>(a) && std::holds_alternative<double>(b))
+        {
+            return std::get<double>(a) < std::get<double>(b);
+        }
+
+        if ((std::holds_alternative<int64_t>(a) || std::holds_alternative<double>(a)) &&
+            (std::holds_alternative<int64_t>(b) || std::holds_alternative<double>(b)))
+        {
+            double da = std::holds_alternative<int64_t>(a) ? static_cast<double>(std::get<int64_t>(a)) : std::get<double>(a);
+
+            double db = std::holds_alternative<int64_t>(b)
+                            ? static_cast<double>(std::get<int64_t>(b))
+                            : std::get<double>(b);
+            return da < db;
+        }
+
+        if (std::holds_alternative<std::string>(a) && std::holds_alternative<std::string>(b))
+        {
+            return std::get<std::string>(a) < std::get<std::string>(b);
+        }
+
+        if (std::holds_alternative<bool>(a) && std::holds_alternative<bool>(b))
+        {
+            return !std::get<bool>(a) && std::get<bool>(b);
+            // false < true
+        }
+
+        // compare by type index (arbitrary but consistent)
+
+        return a.index() < b.index();
+    }
+
+    std::string datatype_to_string(DataType type)
+    {
+        switch (type)
+        {
+        case DataType::INTEGER:
+            return "INTEGER";
+        case DataType::FLOAT:
+            return "FLOAT";
+        case DataType::VARCHAR:
+            return "VARCHAR";
+        case DataType::BOOLEAN:
+            return "BOOLEAN";
+        case DataType::TIMESTAMP:
+            return "TIMESTAMP";
+        default:
+            return "UNKNOWN";
+        }
+    };
+};
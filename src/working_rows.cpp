@@ -0,0 +1,725 @@
+/**
+ *  ReponoDB: Copy-on-write rows of a working table
+ */
+
+#include "working_rows.h"
+#include "trace.h"
+
+#include <unordered_map>
+
+namespace repono
+{
+    WorkingRows::WorkingRows(const Repository &repo, const TableManifest &manifest)
+        : repo_(&repo), key_columns_(primary_key_columns(manifest.schema)), size_(manifest.row_count),
+          storage_(manifest.storage), runs_(manifest.runs)
+    {
+        segments_.reserve(manifest.chunk_hashes.size());
+        for (const auto &chunk_hash : manifest.chunk_hashes)
+        {
+            segments_.push_back(Segment{chunk_hash, nullptr, {}, std::nullopt});
+        }
+    }
+
+    WorkingRows::WorkingRows(std::vector<size_t> key_columns, std::vector<Row> rows, TableStorage storage)
+        : key_columns_(std::move(key_columns)), size_(rows.size()), storage_(storage)
+    {
+        if (storage_ == TableStorage::LSM)
+        {
+            // No runs yet: the rows are all memtable
+            size_ = 0;
+            append(std::move(rows));
+            return;
+        }
+        for (const Row &row : rows)
+            owned_bytes_ += estimate_row_bytes(row);
+        if (!rows.empty())
+            segments_.push_back(Segment{"", nullptr, std::move(rows), std::nullopt});
+    }
+
+    const std::vector<Row> &WorkingRows::segment(size_t i) const
+    {
+        static const std::vector<Row> no_rows;
+        const Segment &seg = segments_[i];
+        if (seg.chunk_hash.empty())
+            return seg.rows;
+        if (seg.chunk == nullptr && repo_ != nullptr)
+            seg.chunk = repo_->get_chunk(seg.chunk_hash);
+        return seg.chunk != nullptr ? seg.chunk->rows : no_rows;
+    }
+
+    std::vector<Row> &WorkingRows::mutable_segment(size_t i)
+    {
+        Segment &seg = segments_[i];
+        if (!seg.chunk_hash.empty())
+        {
+            owned_bytes_ += clone_bytes(i);
+            seg.rows = segment(i);
+            seg.chunk_hash.clear();
+            seg.chunk.reset();
+        }
+        seg.keys.reset(); // the caller is about to change the rows
+        return seg.rows;
+    }
+
+    uint64_t WorkingRows::clone_bytes(size_t i) const
+    {
+        if (segments_[i].chunk_hash.empty())
+            return 0;
+        uint64_t bytes = 0;
+        for (const Row &row : segment(i))
+            bytes += estimate_row_bytes(row);
+        return bytes;
+    }
+
+    uint64_t WorkingRows::loaded_bytes() const
+    {
+        uint64_t bytes = owned_bytes_;
+        for (const Segment &seg : segments_)
+        {
+            if (seg.chunk != nullptr)
+                bytes += estimate_chunk_bytes(*seg.chunk);
+        }
+        return bytes;
+    }
+
+    bool WorkingRows::references(const TableManifest &manifest) const
+    {
+        const std::vector<std::string> &chunk_hashes = manifest.chunk_hashes;
+        if (!delta_.empty() || segments_.size() != chunk_hashes.size() || storage_ != manifest.storage ||
+            runs_.size() != manifest.runs.size())
+            return false;
+        for (size_t i = 0; i < runs_.size(); i++)
+        {
+            if (runs_[i].level != manifest.runs[i].level || runs_[i].row_chunks != manifest.runs[i].row_chunks)
+                return false;
+        }
+        for (size_t i = 0; i < segments_.size(); i++)
+        {
+            if (segments_[i].chunk_hash.empty() || segments_[i].chunk_hash != chunk_hashes[i])
+                return false;
+        }
+        return true;
+    }
+
+    void WorkingRows::adopt_chunks(const WorkingRows &other)
+    {
+        std::unordered_map<std::string, const Segment *> loaded;
+        for (const Segment &seg : other.segments_)
+        {
+            if (!seg.chunk_hash.empty() && (seg.chunk != nullptr || seg.keys.has_value()))
+                loaded.emplace(seg.chunk_hash, &seg);
+        }
+        if (loaded.empty())
+            return;
+        bool same_key = other.key_columns_ == key_columns_;
+        for (Segment &seg : segments_)
+        {
+            if (seg.chunk_hash.empty())
+                continue;
+            auto it = loaded.find(seg.chunk_hash);
+            if (it == loaded.end())
+                continue;
+            if (seg.chunk == nullptr)
+                seg.chunk = it->second->chunk;
+            if (!seg.keys.has_value() && same_key)
+                seg.keys = it->second->keys;
+        }
+    }
+
+    bool WorkingRows::has_key(const Row &row) const
+    {
+        if (key_columns_.empty())
+            return false;
+        Row key = key_of(row);
+        auto it = delta_.find(key);
+        if (it != delta_.end())
+            return it->second.row.has_value();
+        if (storage_ == TableStorage::LSM)
+            return lookup_runs(runs_, key_columns_, key, segment_rows()) != nullptr;
+
+        std::string encoded = encode_key_values(key);
+        uint64_t key_hash = fnv1a(encoded);
+        if (!key_hashes_built_)
+        {
+            // Probing every summary again and again soon costs more than
+            // indexing each key once
+            key_probes_ += segments_.size();
+            if (key_probes_ > size_)
+            {
+                for (size_t i = 0; i < segments_.size(); i++)
+                {
+                    for (uint64_t h : segment_keys(i))
+                        key_hashes_.insert(h);
+                }
+                key_hashes_built_ = true;
+            }
+        }
+        if (key_hashes_built_ && key_hashes_.count(key_hash) == 0)
+            return false;
+        for (size_t i = 0; i < segments_.size(); i++)
+        {
+            const std::vector<uint64_t> &keys = segment_keys(i);
+            if (!std::binary_search(keys.begin(), keys.end(), key_hash))
+                continue;
+            for (const Row &stored : segment(i))
+            {
+                if (encode_key(stored, key_columns_) == encoded)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    const std::vector<uint64_t> &WorkingRows::segment_keys(size_t i) const
+    {
+        const Segment &seg = segments_[i];
+        if (!seg.keys.has_value())
+        {
+            std::optional<std::vector<uint64_t>> stored;
+            if (!seg.chunk_hash.empty() && repo_ != nullptr)
+                stored = repo_->get_key_summary(seg.chunk_hash, key_columns_);
+            seg.keys = stored.has_value() ? std::move(*stored) : summarize_keys(segment(i), key_columns_);
+        }
+        return *seg.keys;
+    }
+
+    uint64_t WorkingRows::index_bytes() const
+    {
+        uint64_t bytes = key_hashes_.bucket_count() * sizeof(void *) +
+                         key_hashes_.size() * (sizeof(uint64_t) + 2 * sizeof(void *));
+        for (const Segment &seg : segments_)
+        {
+            if (seg.keys.has_value())
+                bytes += seg.keys->capacity() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+    void WorkingRows::index_key(const Row &key, bool present)
+    {
+        if (!key_hashes_built_)
+            return;
+        uint64_t key_hash = fnv1a(encode_key_values(key));
+        if (present)
+        {
+            key_hashes_.insert(key_hash);
+            return;
+        }
+        auto it = key_hashes_.find(key_hash);
+        if (it != key_hashes_.end())
+            key_hashes_.erase(it);
+    }
+
+    void WorkingRows::for_each_merged(const KeyRange &range,
+                                      const std::function<bool(const Slot &, const Row &)> &visit) const
+    {
+        static const std::vector<Row> skipped;
+        std::vector<bool> wanted;
+        if (range.bounded())
+            wanted = chunks_in_range(runs_, range, segment_rows());
+        RunMerger runs(runs_, key_columns_, [this, &wanted](size_t i)
+                       { return i < wanted.size() && !wanted[i] ? &skipped : &segment(i); });
+        bool more = runs.next();
+        auto delta = delta_.begin();
+        Slot slot;
+        while (more || delta != delta_.end())
+        {
+            int order = !more ? 1 : delta == delta_.end() ? -1 : runs.compare_key(delta->first);
+            if (order < 0)
+            {
+                // Keys outside the range may be shadowed in a skipped chunk
+                const Row &row = *runs.row();
+                slot.segment = runs.chunk();
+                slot.offset = runs.offset();
+                slot.key = nullptr;
+                if (range.contains(row[key_columns_[0]]) && !visit(slot, row))
+                    return;
+                more = runs.next();
+                continue;
+            }
+            // The delta's version replaces the runs'
+            if (order == 0)
+                more = runs.next();
+            if (delta->second.row.has_value() && range.contains(delta->first[0]))
+            {
+                slot.key = &delta->first;
+                if (!visit(slot, *delta->second.row))
+                    return;
+            }
+            ++delta;
+        }
+    }
+
+    void WorkingRows::put_delta(const Row &key, std::optional<Row> row, size_t segment)
+    {
+        auto [it, inserted] = delta_.try_emplace(key);
+        DeltaEntry &entry = it->second;
+        if (inserted)
+        {
+            owned_bytes_ += estimate_row_bytes(key);
+            entry.segment = segment;
+            if (segment != kNoSegment)
+            {
+                if (patched_.size() < segments_.size())
+                    patched_.resize(segments_.size(), 0);
+                patched_[segment]++;
+            }
+        }
+        if (entry.row.has_value())
+            owned_bytes_ -= estimate_row_bytes(*entry.row);
+        if (!row.has_value() && entry.segment == kNoSegment)
+        {
+            // Never stored: forget the key altogether
+            owned_bytes_ -= estimate_row_bytes(key);
+            delta_.erase(it);
+            return;
+        }
+        if (row.has_value())
+            owned_bytes_ += estimate_row_bytes(*row);
+        entry.row = std::move(row);
+    }
+
+    uint64_t WorkingRows::update_bytes(const std::vector<Update> &updates) const
+    {
+        uint64_t bytes = 0;
+        size_t last_segment = kNoSegment;
+        for (const Update &update : updates)
+        {
+            if (!key_columns_.empty())
+            {
+                // The new version, and a tombstone if the key changes
+                bytes += estimate_row_bytes(update.row) + 2 * estimate_row_bytes(key_of(update.row));
+                continue;
+            }
+            if (update.slot.segment != last_segment)
+                bytes += clone_bytes(update.slot.segment);
+            last_segment = update.slot.segment;
+            uint64_t old_bytes = estimate_row_bytes(at(update.slot));
+            uint64_t new_bytes = estimate_row_bytes(update.row);
+            bytes += new_bytes > old_bytes ? new_bytes - old_bytes : 0;
+        }
+        return bytes;
+    }
+
+    void WorkingRows::update(std::vector<Update> updates)
+    {
+        if (key_columns_.empty())
+        {
+            for (Update &update : updates)
+            {
+                std::vector<Row> &rows = mutable_segment(update.slot.segment);
+                Row &row = rows[update.slot.offset];
+                owned_bytes_ -= estimate_row_bytes(row);
+                owned_bytes_ += estimate_row_bytes(update.row);
+                row = std::move(update.row);
+            }
+            return;
+        }
+
+        // Look up every old key before the delta changes, then remove the
+        // keys that change before setting any new one, so rows that swap
+        // keys do not overwrite each other
+        struct Pending
+        {
+            Row old_key;
+            Row new_key;
+            size_t segment;
+            Row row;
+        };
+        std::vector<Pending> pending;
+        pending.reserve(updates.size());
+        for (Update &update : updates)
+        {
+            Pending p;
+            if (update.slot.key != nullptr)
+            {
+                p.old_key = *update.slot.key;
+                p.segment = delta_.at(p.old_key).segment;
+            }
+            else
+            {
+                p.old_key = key_of(segment(update.slot.segment)[update.slot.offset]);
+                p.segment = update.slot.segment;
+            }
+            p.new_key = key_of(update.row);
+            p.row = std::move(update.row);
+            pending.push_back(std::move(p));
+        }
+        KeyLess less;
+        auto same_key = [&less](const Pending &p)
+        {
+            return !less(p.old_key, p.new_key) && !less(p.new_key, p.old_key);
+        };
+        for (const Pending &p : pending)
+        {
+            if (!same_key(p))
+                put_delta(p.old_key, std::nullopt, p.segment);
+        }
+        for (Pending &p : pending)
+        {
+            put_delta(p.new_key, std::move(p.row), same_key(p) ? p.segment : kNoSegment);
+        }
+    }
+
+    void WorkingRows::append(std::vector<Row> rows)
+    {
+        if (rows.empty())
+            return;
+        size_ += rows.size();
+        if (!key_columns_.empty())
+        {
+            for (Row &row : rows)
+            {
+                Row key = key_of(row);
+                put_delta(key, std::move(row), kNoSegment);
+            }
+            return;
+        }
+        for (const Row &row : rows)
+            owned_bytes_ += estimate_row_bytes(row);
+        if (!segments_.empty() && segments_.back().chunk_hash.empty())
+        {
+            std::vector<Row> &tail = segments_.back().rows;
+            tail.insert(tail.end(), std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+            return;
+        }
+        segments_.push_back(Segment{"", nullptr, std::move(rows), std::nullopt});
+    }
+
+    void WorkingRows::put(const Row &key_row, std::optional<Row> row)
+    {
+        Row key = key_of(key_row);
+        size_t segment = kNoSegment;
+        bool exists = false;
+        auto it = delta_.find(key);
+        if (it != delta_.end())
+        {
+            exists = it->second.row.has_value();
+            segment = it->second.segment;
+        }
+        else
+        {
+            exists = lookup_runs(runs_, key_columns_, key, segment_rows(), &segment) != nullptr;
+        }
+        if (!exists && !row.has_value())
+            return;
+        if (!exists)
+            size_++;
+        else if (!row.has_value())
+            size_--;
+        put_delta(key, std::move(row), segment);
+    }
+
+    size_t WorkingRows::remove_if(const std::function<bool(const Row &)> &pred, const KeyRange &range)
+    {
+        if (storage_ == TableStorage::LSM)
+        {
+            // Runs are immutable: every removed row becomes a tombstone
+            std::vector<std::pair<Row, size_t>> removed;
+            for_each_slot(range, [&](const Slot &slot, const Row &row)
+                          {
+                              if (!pred(row))
+                                  return true;
+                              if (slot.key != nullptr)
+                                  removed.emplace_back(*slot.key, delta_.at(*slot.key).segment);
+                              else
+                                  removed.emplace_back(key_of(row), slot.segment);
+                              return true;
+                          });
+            for (const auto &[key, seg] : removed)
+                put_delta(key, std::nullopt, seg);
+            size_ -= removed.size();
+            return removed.size();
+        }
+
+        size_t count = 0;
+        std::vector<bool> matches;
+        for (size_t i = 0; i < segments_.size(); i++)
+        {
+            const std::vector<Row> &rows = segment(i);
+            bool patched = patched_count(i) > 0;
+            matches.assign(rows.size(), false);
+            size_t matched = 0;
+            for (size_t r = 0; r < rows.size(); r++)
+            {
+                // Rows the delta replaced are checked in its version below
+                if (patched && delta_.count(key_of(rows[r])) > 0)
+                    continue;
+                if (pred(rows[r]))
+                {
+                    matches[r] = true;
+                    matched++;
+                }
+            }
+            if (matched == 0)
+                continue;
+            count += matched;
+            if (matched == rows.size())
+            {
+                // Nothing left: drop the segment's rows without cloning them
+                if (!key_columns_.empty())
+                {
+                    for (const Row &row : rows)
+                        index_key(key_of(row), false);
+                }
+                Segment &seg = segments_[i];
+                for (const Row &row : seg.rows)
+                    owned_bytes_ -= estimate_row_bytes(row);
+                seg = Segment{};
+                continue;
+            }
+            if (!key_columns_.empty())
+            {
+                for (size_t r = 0; r < rows.size(); r++)
+                {
+                    if (matches[r])
+                        put_delta(key_of(rows[r]), std::nullopt, i);
+                }
+                continue;
+            }
+            std::vector<Row> &own = mutable_segment(i);
+            size_t kept = 0;
+            for (size_t r = 0; r < own.size(); r++)
+            {
+                if (matches[r])
+                {
+                    owned_bytes_ -= estimate_row_bytes(own[r]);
+                    continue;
+                }
+                if (kept != r)
+                    own[kept] = std::move(own[r]);
+                kept++;
+            }
+            own.resize(kept);
+        }
+
+        for (auto it = delta_.begin(); it != delta_.end();)
+        {
+            auto next = std::next(it);
+            if (it->second.row.has_value() && pred(*it->second.row))
+            {
+                count++;
+                put_delta(it->first, std::nullopt, it->second.segment);
+            }
+            it = next;
+        }
+
+        size_ -= count;
+        // With a delta, segment numbers must hold until it is applied
+        if (delta_.empty())
+            drop_empty_segments();
+        return count;
+    }
+
+    void WorkingRows::apply_delta()
+    {
+        if (delta_.empty())
+            return;
+        REPONO_TRACE_SPAN("WorkingRows::apply_delta");
+        for (size_t i = 0; i < segments_.size(); i++)
+        {
+            if (patched_count(i) == 0)
+                continue;
+            std::vector<Row> &rows = mutable_segment(i);
+            size_t kept = 0;
+            for (size_t r = 0; r < rows.size(); r++)
+            {
+                auto it = delta_.find(key_of(rows[r]));
+                if (it != delta_.end())
+                {
+                    // The delta's version is already counted in owned_bytes_
+                    owned_bytes_ -= estimate_row_bytes(rows[r]);
+                    if (!it->second.row.has_value())
+                        continue;
+                    rows[r] = std::move(*it->second.row);
+                }
+                if (kept != r)
+                    rows[kept] = std::move(rows[r]);
+                kept++;
+            }
+            rows.resize(kept);
+        }
+
+        // New keys go at the end, in key order
+        std::vector<Row> added;
+        for (auto &[key, entry] : delta_)
+        {
+            owned_bytes_ -= estimate_row_bytes(key);
+            if (entry.segment == kNoSegment && entry.row.has_value())
+            {
+                index_key(key, true);
+                added.push_back(std::move(*entry.row));
+            }
+            else if (entry.segment != kNoSegment && !entry.row.has_value())
+            {
+                index_key(key, false);
+            }
+        }
+        delta_.clear();
+        patched_.clear();
+        if (!added.empty())
+            segments_.push_back(Segment{"", nullptr, std::move(added), std::nullopt});
+        drop_empty_segments();
+    }
+
+    void WorkingRows::drop_empty_segments()
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < segments_.size(); i++)
+        {
+            if (segments_[i].chunk_hash.empty() && segments_[i].rows.empty())
+                continue;
+            if (kept != i)
+                segments_[kept] = std::move(segments_[i]);
+            kept++;
+        }
+        segments_.resize(kept);
+    }
+
+    std::vector<Row> WorkingRows::to_vector() const
+    {
+        std::vector<Row> rows;
+        rows.reserve(size_);
+        for_each([&rows](const Row &row)
+                 {
+                     rows.push_back(row);
+                     return true;
+                 });
+        return rows;
+    }
+
+    std::vector<RowRange> WorkingRows::ranges(std::vector<Row> &scratch) const
+    {
+        std::vector<RowRange> ranges;
+        if (!delta_.empty() || storage_ == TableStorage::LSM)
+        {
+            scratch = to_vector();
+            ranges.push_back(RowRange{scratch.data(), scratch.size()});
+            return ranges;
+        }
+        for (size_t i = 0; i < segments_.size(); i++)
+        {
+            const std::vector<Row> &seg = segment(i);
+            ranges.push_back(RowRange{seg.data(), seg.size()});
+        }
+        return ranges;
+    }
+
+    TableManifest WorkingRows::store(Repository &repo, uint64_t &new_bytes)
+    {
+        REPONO_TRACE_SPAN("WorkingRows::store");
+        repo_ = &repo;
+        if (storage_ == TableStorage::LSM)
+            return store_runs(repo, new_bytes);
+        apply_delta();
+        TableManifest manifest;
+        manifest.row_count = size_;
+        std::vector<Segment> stored;
+        stored.reserve(segments_.size());
+        auto emit = [&](std::vector<Row> rows)
+        {
+            // New chunks of keyed tables get a key summary for lineage queries
+            std::vector<uint64_t> keys = summarize_keys(rows, key_columns_);
+            uint64_t bytes_before = new_bytes;
+            std::string chunk_hash = repo.put_chunk(std::move(rows), &new_bytes);
+            if (!key_columns_.empty() && new_bytes != bytes_before)
+                repo.put_key_summary(chunk_hash, key_columns_, keys);
+            manifest.chunk_hashes.push_back(chunk_hash);
+            stored.push_back(Segment{std::move(chunk_hash), nullptr, {}, std::move(keys)});
+        };
+
+        ChunkSplitter splitter;
+        for (size_t i = 0; i < segments_.size(); i++)
+        {
+            Segment &seg = segments_[i];
+            if (!seg.chunk_hash.empty() && splitter.at_boundary())
+            {
+                // A chunk that a full split would cut the same way, unless
+                // it was the old last chunk and rows now follow it
+                bool next_cloned = i + 1 < segments_.size() && segments_[i + 1].chunk_hash.empty();
+                if (!next_cloned || ends_at_boundary(segment(i)))
+                {
+                    manifest.chunk_hashes.push_back(seg.chunk_hash);
+                    stored.push_back(std::move(seg));
+                    continue;
+                }
+            }
+
+            // Part of a run being re-cut: cloned rows move, referenced ones are copied
+            if (seg.chunk_hash.empty())
+            {
+                for (Row &row : seg.rows)
+                {
+                    if (splitter.add(std::move(row)))
+                        emit(splitter.take());
+                }
+            }
+            else
+            {
+                for (const Row &row : segment(i))
+                {
+                    if (splitter.add(row))
+                        emit(splitter.take());
+                }
+            }
+        }
+        if (!splitter.at_boundary())
+        {
+            emit(splitter.take());
+        }
+        segments_ = std::move(stored);
+        owned_bytes_ = 0;
+        return manifest;
+    }
+
+    TableManifest WorkingRows::store_runs(Repository &repo, uint64_t &new_bytes)
+    {
+        TableManifest manifest;
+        manifest.runs = std::move(runs_);
+        manifest.chunk_hashes.reserve(segments_.size());
+        for (const Segment &seg : segments_)
+            manifest.chunk_hashes.push_back(seg.chunk_hash);
+
+        std::vector<Row> rows, tombstones;
+        for (auto &[key, entry] : delta_)
+        {
+            if (entry.row.has_value())
+                rows.push_back(std::move(*entry.row));
+            else
+                tombstones.push_back(key);
+        }
+        lsm_flush(repo, manifest, key_columns_, std::move(rows), std::move(tombstones), new_bytes);
+        manifest.row_count = size_;
+
+        // The flush adds chunks at the front and compaction replaces runs,
+        // so the old segments at the end of the list carry over with any
+        // chunks they read; the rest are looked up by hash
+        std::vector<Segment> old = std::move(segments_);
+        size_t kept = 0;
+        while (kept < old.size() && kept < manifest.chunk_hashes.size() &&
+               old[old.size() - 1 - kept].chunk_hash == manifest.chunk_hashes[manifest.chunk_hashes.size() - 1 - kept])
+            kept++;
+        std::unordered_map<std::string, ChunkPtr> loaded;
+        for (size_t i = 0; i + kept < old.size(); i++)
+        {
+            if (old[i].chunk != nullptr)
+                loaded.emplace(old[i].chunk_hash, std::move(old[i].chunk));
+        }
+        size_t fresh = manifest.chunk_hashes.size() - kept;
+        segments_.clear();
+        segments_.reserve(manifest.chunk_hashes.size());
+        for (size_t i = 0; i < fresh; i++)
+        {
+            auto it = loaded.find(manifest.chunk_hashes[i]);
+            segments_.push_back(Segment{manifest.chunk_hashes[i], it != loaded.end() ? it->second : nullptr, {}, std::nullopt});
+        }
+        for (size_t i = old.size() - kept; i < old.size(); i++)
+            segments_.push_back(std::move(old[i]));
+
+        runs_ = manifest.runs;
+        delta_.clear();
+        patched_.clear();
+        owned_bytes_ = 0;
+        return manifest;
+    }
+};
@@ -0,0 +1,387 @@
+/**
+ *  ReponoDB: Copy-on-write rows of a working table
+ */
+
+#ifndef REPONO_WORKING_ROWS_H
+#define REPONO_WORKING_ROWS_H
+
+#include "columnar.h"
+#include "executor.h"
+#include "lsm.h"
+#include "storage.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace repono
+{
+    /**
+     * WORKING ROWS
+     *
+     * A working table's rows as an overlay on the chunks of the commit it
+     * was checked out from. The rows are a list of segments, each either a
+     * reference to a stored chunk or rows the session owns:
+     *
+     *  - checkout only copies the table's chunk list; a referenced chunk is
+     *    read from the repository the first time one of its rows is
+     *  - COMMIT (store()) cuts the owned rows into chunks and stores them,
+     *    while referenced segments keep their chunk hash. Cutting resumes
+     *    from the chunk boundary before each owned run and stops at the
+     *    first boundary that falls on a referenced segment again, so the
+     *    chunks are exactly those split_into_chunks would cut from all the
+     *    rows, and so is the commit hash
+     *
+     * How writes land depends on the table:
+     *
+     *  - with a primary key, the segments stay as they are until COMMIT and
+     *    writes go to a delta: a map from primary key to the row's new
+     *    version (or a tombstone), sorted by key, LSM style. Reads merge it
+     *    with the segments; only segments the delta patches have their
+     *    rows' keys looked up. COMMIT applies the delta in one pass: each
+     *    patched chunk is rewritten once however many writes it took, and
+     *    new rows are appended in key order. Key checks ask the delta, then
+     *    each segment's key summary (the sorted key hashes stored next to
+     *    its chunk), reading a chunk only if its summary has the key's hash.
+     *    Once the checks have probed as many summaries as the table has
+     *    rows, the summaries are merged into one hash index, which only
+     *    changes when a whole segment is deleted or the delta is applied
+     *  - without one, the first write to a referenced segment clones that
+     *    chunk alone and writes change it in place; inserts go to an owned
+     *    segment at the end
+     *  - an LSM table (see lsm.h) has a segment per chunk of its sorted
+     *    runs, which reads merge by key. The delta is its memtable: COMMIT
+     *    flushes it as a new run instead of rewriting the chunks it patches
+     *
+     * Afterwards every segment references the stored chunks, so the next
+     * round of edits starts from shared rows again.
+     */
+    class WorkingRows
+    {
+    public:
+        /**
+         * Where a row lives, for update(): a delta entry (key is set) or a
+         * row of a segment
+         */
+        struct Slot
+        {
+            size_t segment = 0;
+            size_t offset = 0;
+            const Row *key = nullptr;
+        };
+
+        struct Update
+        {
+            Slot slot;
+            Row row;
+        };
+
+        WorkingRows() = default;
+
+        /**
+         * Reference a committed table's chunks; none are read yet
+         */
+        WorkingRows(const Repository &repo, const TableManifest &manifest);
+
+        /**
+         * Own the given rows (e.g. the result of a merge)
+         *
+         * @param key_columns The primary key (empty = none; LSM tables need one)
+         */
+        explicit WorkingRows(std::vector<size_t> key_columns, std::vector<Row> rows = {},
+                             TableStorage storage = TableStorage::CHUNKS);
+
+        size_t size() const { return size_; }
+
+        TableStorage storage() const { return storage_; }
+
+        /**
+         * Estimated bytes of rows the session holds beyond the stored chunks:
+         * cloned and new rows and the delta
+         */
+        uint64_t owned_bytes() const { return owned_bytes_; }
+
+        /**
+         * Estimated bytes of the rows held in memory: chunks read so far
+         * plus owned_bytes()
+         */
+        uint64_t loaded_bytes() const;
+
+        /**
+         * Whether the rows are exactly a stored table's chunks (and runs),
+         * with nothing cloned, added or pending in the delta
+         */
+        bool references(const TableManifest &manifest) const;
+
+        /**
+         * Take chunks another WorkingRows has already read, for segments
+         * referencing the same chunk that have not been read yet
+         */
+        void adopt_chunks(const WorkingRows &other);
+
+        /**
+         * Visit every row in order until visit returns false
+         */
+        template <typename Visit>
+        void for_each(Visit visit) const
+        {
+            for_each_slot([&visit](const Slot &, const Row &row)
+                          { return visit(row); });
+        }
+
+        /**
+         * for_each, also passing each row's Slot
+         */
+        template <typename Visit>
+        void for_each_slot(Visit visit) const
+        {
+            if (storage_ == TableStorage::LSM)
+            {
+                for_each_merged({}, [&visit](const Slot &slot, const Row &row)
+                                { return visit(slot, row); });
+                return;
+            }
+            Slot slot;
+            for (slot.segment = 0; slot.segment < segments_.size(); slot.segment++)
+            {
+                const std::vector<Row> &rows = segment(slot.segment);
+                bool patched = patched_count(slot.segment) > 0;
+                for (slot.offset = 0; slot.offset < rows.size(); slot.offset++)
+                {
+                    slot.key = nullptr;
+                    const Row *row = &rows[slot.offset];
+                    if (patched)
+                    {
+                        auto it = delta_.find(key_of(*row));
+                        if (it != delta_.end())
+                        {
+                            if (!it->second.row.has_value())
+                                continue;
+                            slot.key = &it->first;
+                            row = &*it->second.row;
+                        }
+                    }
+                    if (!visit(slot, *row))
+                        return;
+                }
+            }
+            for (const auto &[key, entry] : delta_)
+            {
+                if (entry.segment != kNoSegment || !entry.row.has_value())
+                    continue;
+                slot.key = &key;
+                if (!visit(slot, *entry.row))
+                    return;
+            }
+        }
+
+        /**
+         * for_each_slot for a caller that only wants the rows whose leading
+         * key column is in a range: an LSM table reads just the chunks
+         * whose fences overlap it. Other tables may visit rows outside it.
+         */
+        template <typename Visit>
+        void for_each_slot(const KeyRange &range, Visit visit) const
+        {
+            if (storage_ != TableStorage::LSM)
+            {
+                for_each_slot(visit);
+                return;
+            }
+            for_each_merged(range, [&visit](const Slot &slot, const Row &row)
+                            { return visit(slot, row); });
+        }
+
+        /**
+         * The row a slot refers to
+         */
+        const Row &at(const Slot &slot) const
+        {
+            return slot.key != nullptr ? *delta_.at(*slot.key).row : segment(slot.segment)[slot.offset];
+        }
+
+        /**
+         * Whether a row with the same primary key as row exists. The delta
+         * answers for keys written since checkout; otherwise an LSM table
+         * looks the key up in its runs, and any other table in the key
+         * summaries of its segments (or their hash index, once built).
+         */
+        bool has_key(const Row &row) const;
+
+        /**
+         * Estimated bytes of the key summaries read and the key hash index
+         */
+        uint64_t index_bytes() const;
+
+        /**
+         * Extra bytes update() would hold (an upper bound)
+         */
+        uint64_t update_bytes(const std::vector<Update> &updates) const;
+
+        /**
+         * Replace rows found by for_each_slot. The new primary keys must be
+         * unique among the table's rows once the updates are applied.
+         */
+        void update(std::vector<Update> updates);
+
+        /**
+         * Add rows; with a primary key, their keys must not be in use
+         */
+        void append(std::vector<Row> rows);
+
+        /**
+         * Set the version of the row with a primary key, adding it if there
+         * is none, or delete it (LSM tables). MERGE lays the other side's
+         * changes over our runs this way.
+         *
+         * @param key_row A row holding the key
+         * @param row The new version, or std::nullopt to delete the row
+         */
+        void put(const Row &key_row, std::optional<Row> row);
+
+        /**
+         * Remove the rows matching a predicate
+         *
+         * @param range Bounds on the leading key column that every matching
+         *              row is within; an LSM table skips the chunks outside it
+         * @returns The number of rows removed
+         */
+        size_t remove_if(const std::function<bool(const Row &)> &pred, const KeyRange &range = {});
+
+        /**
+         * Copy every row into one vector
+         */
+        std::vector<Row> to_vector() const;
+
+        /**
+         * The rows as ranges for export, one per segment
+         *
+         * @param scratch Holds the merged rows when a delta is pending
+         */
+        std::vector<RowRange> ranges(std::vector<Row> &scratch) const;
+
+        /**
+         * Apply the delta, cut the cloned and new rows into chunks and
+         * store them (an LSM table flushes the delta as a run instead);
+         * all segments reference stored chunks afterwards
+         *
+         * @param new_bytes Increased by the encoded size of chunks that were new
+         * @returns The table's chunk list and row count (the schema is left empty)
+         */
+        TableManifest store(Repository &repo, uint64_t &new_bytes);
+
+    private:
+        static constexpr size_t kNoSegment = static_cast<size_t>(-1);
+
+        struct Segment
+        {
+            std::string chunk_hash; // "" once cloned, or for new rows
+            mutable ChunkPtr chunk; // referenced chunk, read on first use
+            std::vector<Row> rows;  // cloned or new rows
+            mutable std::optional<std::vector<uint64_t>> keys; // key summary, read on first key check
+        };
+
+        struct DeltaEntry
+        {
+            std::optional<Row> row;      // nullopt = deleted
+            size_t segment = kNoSegment; // segment holding the stored row with this key, if any
+        };
+
+        struct KeyLess
+        {
+            bool operator()(const Row &a, const Row &b) const
+            {
+                return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), value_less_than);
+            }
+        };
+
+        /**
+         * A segment's rows, reading a referenced chunk on first use (a
+         * chunk missing from the repository reads as no rows)
+         */
+        const std::vector<Row> &segment(size_t i) const;
+
+        /**
+         * A segment's rows for writing, cloning a referenced chunk first
+         */
+        std::vector<Row> &mutable_segment(size_t i);
+
+        uint64_t clone_bytes(size_t i) const;
+
+        size_t patched_count(size_t i) const { return i < patched_.size() ? patched_[i] : 0; }
+
+        Row key_of(const Row &row) const
+        {
+            Row key;
+            key.reserve(key_columns_.size());
+            for (size_t idx : key_columns_)
+                key.push_back(row[idx]);
+            return key;
+        }
+
+        /**
+         * Set the delta's version of a key (nullopt deletes it)
+         *
+         * @param segment Segment holding the key's stored row (kNoSegment if none)
+         */
+        void put_delta(const Row &key, std::optional<Row> row, size_t segment);
+
+        /**
+         * Merge the delta into the segments
+         */
+        void apply_delta();
+
+        /**
+         * store() of an LSM table
+         */
+        TableManifest store_runs(Repository &repo, uint64_t &new_bytes);
+
+        /**
+         * for_each_slot of an LSM table: the runs merged by key, then
+         * merged with the delta, keeping only keys in range
+         */
+        void for_each_merged(const KeyRange &range, const std::function<bool(const Slot &, const Row &)> &visit) const;
+
+        ChunkRows segment_rows() const
+        {
+            return [this](size_t i)
+            { return &segment(i); };
+        }
+
+        void drop_empty_segments();
+
+        /**
+         * A segment's key summary (see summarize_keys): the one stored with
+         * its chunk if there is one, else summarized from its rows
+         */
+        const std::vector<uint64_t> &segment_keys(size_t i) const;
+
+        /**
+         * Add or remove a key in the key hash index, if it is built
+         */
+        void index_key(const Row &key, bool present);
+
+        const Repository *repo_ = nullptr;
+        std::vector<size_t> key_columns_; // non-empty: writes go to the delta
+        std::vector<Segment> segments_;
+        std::map<Row, DeltaEntry, KeyLess> delta_;
+        std::vector<size_t> patched_; // delta entries per segment
+        size_t size_ = 0;
+        uint64_t owned_bytes_ = 0;
+        TableStorage storage_ = TableStorage::CHUNKS;
+        std::vector<SortedRun> runs_; // LSM: one segment per chunk of these, in order
+
+        // Key hashes of the segments' rows (keyed non-LSM tables), whatever the delta says
+        mutable std::unordered_multiset<uint64_t> key_hashes_;
+        mutable bool key_hashes_built_ = false;
+        mutable size_t key_probes_ = 0; // summaries probed before key_hashes_ was built
+    };
+};
+
+#endif // REPONO_WORKING_ROWS_H
@@ -0,0 +1,176 @@
+/**
+ *  Arrow C stream interface: tables exported with export_table load back
+ *  with import_arrow type for type, and an import that fails changes nothing
+ */
+
+#include "check.h"
+#include "repono/repono.h"
+
+#include <cerrno>
+
+using namespace repono;
+
+namespace
+{
+    std::vector<Row> rows_of(const Result &result)
+    {
+        std::vector<Row> rows;
+        for (const RowBatch &batch : result.batches())
+            for (size_t r = 0; r < batch.num_rows(); r++)
+                rows.push_back(batch.row(r));
+        return rows;
+    }
+
+    /**
+     * The Arrow formats of a stream's columns (the value format for
+     * dictionary-encoded ones); consumes the stream
+     */
+    std::vector<std::string> column_formats(ArrowArrayStream &stream)
+    {
+        std::vector<std::string> formats;
+        ArrowSchema schema;
+        if (stream.get_schema(&stream, &schema) == 0)
+        {
+            for (int64_t c = 0; c < schema.n_children; c++)
+            {
+                const ArrowSchema &child = *schema.children[c];
+                formats.push_back(child.dictionary != nullptr ? child.dictionary->format : child.format);
+            }
+            schema.release(&schema);
+        }
+        stream.release(&stream);
+        return formats;
+    }
+
+    /**
+     * A producer whose schema cannot be read
+     */
+    struct BrokenStream
+    {
+        static int get_schema(ArrowArrayStream *, ArrowSchema *) { return EIO; }
+        static int get_next(ArrowArrayStream *, ArrowArray *) { return EIO; }
+        static const char *get_last_error(ArrowArrayStream *) { return "disk on fire"; }
+
+        static void release(ArrowArrayStream *stream)
+        {
+            (*static_cast<int *>(stream->private_data))++;
+            stream->release = nullptr;
+        }
+
+        static ArrowArrayStream make(int *releases)
+        {
+            ArrowArrayStream stream;
+            stream.get_schema = get_schema;
+            stream.get_next = get_next;
+            stream.get_last_error = get_last_error;
+            stream.release = release;
+            stream.private_data = releases;
+            return stream;
+        }
+    };
+
+    std::unique_ptr<Database> open_with_table(std::unique_ptr<Connection> &conn)
+    {
+        std::string error;
+        std::unique_ptr<Database> db = Database::open("", error);
+        conn = db->connect();
+        conn->execute("CREATE TABLE t (id INTEGER PRIMARY KEY, n INTEGER, f FLOAT, s VARCHAR, b BOOLEAN, ts TIMESTAMP)");
+        conn->execute("INSERT INTO t VALUES (1, 10, 1.5, 'one', true, 1700000000), "
+                      "(2, NULL, NULL, NULL, NULL, NULL), (3, -7, -0.25, '', false, 0), "
+                      "(4, 9007199254740993, 12345.125, 'one', NULL, -86400)");
+        conn->commit("load");
+        return db;
+    }
+};
+
+REPONO_TEST(arrow_export_then_import_round_trips_every_type_with_nulls)
+{
+    std::unique_ptr<Connection> conn;
+    std::unique_ptr<Database> db = open_with_table(conn);
+    CHECK(!db->head().empty());
+
+    ArrowArrayStream stream;
+    CHECK_EQ(conn->export_table("t", "", &stream), "");
+    std::vector<std::string> exported = column_formats(stream);
+    CHECK_EQ(exported, (std::vector<std::string>{"l", "l", "g", "u", "b", "tss:"}));
+
+    // Into a new table of another database, which takes its schema from the stream
+    std::string error;
+    std::unique_ptr<Database> other = Database::open("", error);
+    std::unique_ptr<Connection> copy = other->connect();
+    CHECK_EQ(conn->export_table("t", "", &stream), "");
+    Result imported = copy->import_arrow("u", &stream, "import");
+    CHECK(imported.ok());
+    CHECK_EQ(imported.rows_affected(), size_t{4});
+    CHECK(!copy->has_uncommitted_changes());
+    CHECK_EQ(copy->base_hash(), other->head());
+
+    Result t = conn->execute("SELECT * FROM t ORDER BY id");
+    Result u = copy->execute("SELECT * FROM u ORDER BY id");
+    CHECK_EQ(u.columns(), t.columns());
+    CHECK(rows_of(u) == rows_of(t));
+    CHECK_EQ(rows_of(u).at(1), (Row{int64_t{2}, Value(), Value(), Value(), Value(), Value()}));
+
+    CHECK_EQ(copy->export_table("u", "", &stream), "");
+    CHECK_EQ(column_formats(stream), exported);
+
+    // Into the existing table, columns matched by name
+    conn->execute("DELETE FROM t WHERE id > 2");
+    conn->commit("trim");
+    conn->execute("CREATE TABLE part (ts TIMESTAMP, id INTEGER, s VARCHAR)");
+    conn->execute("INSERT INTO part VALUES (5, 3, 'three'), (NULL, 4, NULL)");
+    conn->commit("part");
+    CHECK_EQ(conn->export_table("part", "", &stream), "");
+    CHECK(conn->import_arrow("t", &stream, "append").ok());
+    Result appended = conn->execute("SELECT id, n, s, ts FROM t WHERE id > 2 ORDER BY id");
+    CHECK(rows_of(appended) == (std::vector<Row>{{int64_t{3}, Value(), std::string("three"), int64_t{5}},
+                                                 {int64_t{4}, Value(), Value(), Value()}}));
+}
+
+REPONO_TEST(arrow_import_that_fails_changes_nothing)
+{
+    std::unique_ptr<Connection> conn;
+    std::unique_ptr<Database> db = open_with_table(conn);
+    std::string head = db->head();
+    ArrowArrayStream stream;
+
+    // Keys already in the table
+    CHECK_EQ(conn->export_table("t", "", &stream), "");
+    Result duplicate = conn->import_arrow("t", &stream, "again");
+    CHECK(!duplicate.ok());
+    CHECK(stream.release == nullptr);
+    CHECK_EQ(db->head(), head);
+    CHECK(!conn->has_uncommitted_changes());
+    CHECK_EQ(rows_of(conn->execute("SELECT * FROM t")).size(), size_t{4});
+
+    // A column the table does not have
+    conn->execute("CREATE TABLE extra (id INTEGER, nope VARCHAR)");
+    conn->execute("INSERT INTO extra VALUES (100, 'x')");
+    conn->commit("extra");
+    head = db->head();
+    CHECK_EQ(conn->export_table("extra", "", &stream), "");
+    CHECK(!conn->import_arrow("t", &stream, "unknown column").ok());
+    CHECK_EQ(db->head(), head);
+    CHECK_EQ(rows_of(conn->execute("SELECT * FROM t")).size(), size_t{4});
+
+    // Uncommitted changes in the working set, which are kept
+    conn->execute("INSERT INTO t VALUES (50, NULL, NULL, 'pending', NULL, NULL)");
+    CHECK_EQ(conn->export_table("extra", "", &stream), "");
+    CHECK(!conn->import_arrow("fresh", &stream, "dirty").ok());
+    CHECK(stream.release == nullptr);
+    CHECK(conn->has_uncommitted_changes());
+    CHECK_EQ(db->head(), head);
+    CHECK_EQ(rows_of(conn->execute("SELECT * FROM t WHERE id = 50")).size(), size_t{1});
+    CHECK(!conn->execute("SELECT * FROM fresh").ok());
+    conn->execute("DELETE FROM t WHERE id = 50");
+
+    // A producer that fails, released all the same, and no table made for it
+    int releases = 0;
+    stream = BrokenStream::make(&releases);
+    Result broken = conn->import_arrow("fresh", &stream, "broken");
+    CHECK(!broken.ok());
+    CHECK(broken.error().find("disk on fire") != std::string::npos);
+    CHECK_EQ(releases, 1);
+    CHECK_EQ(db->head(), head);
+    CHECK(!conn->execute("SELECT * FROM fresh").ok());
+}
@@ -0,0 +1,80 @@
+/**
+ *  Branch cache: a kept working set is not used once its branch moved
+ */
+
+#include "check.h"
+
+using namespace repono;
+
+namespace
+{
+    Value text(const char *s) { return Value(std::string(s)); }
+};
+
+REPONO_TEST(branch_cache_follows_a_ref_moved_by_another_session)
+{
+    Repository repo;
+    Session ours(repo);
+    RUN_OK(ours, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT)");
+    RUN_OK(ours, "CREATE TABLE u (id INTEGER PRIMARY KEY, v TEXT)");
+    RUN_OK(ours, "INSERT INTO t VALUES (1, 'one'), (2, 'two')");
+    RUN_OK(ours, "INSERT INTO u VALUES (1, 'kept')");
+    RUN_OK(ours, "COMMIT 'base'");
+    RUN_OK(ours, "SELECT * FROM t"); // main's working set is now loaded
+    RUN_OK(ours, "CHECKOUT -b feature");
+
+    // Another session moves main while ours has it cached
+    Session theirs(repo);
+    RUN_OK(theirs, "CHECKOUT main");
+    RUN_OK(theirs, "UPDATE t SET v = 'moved' WHERE id = 2");
+    RUN_OK(theirs, "DROP TABLE u");
+    RUN_OK(theirs, "COMMIT 'moved'");
+    std::string moved = repo.head();
+    RUN_OK(theirs, "CHECKOUT feature");
+
+    RUN_OK(ours, "CHECKOUT main");
+    CHECK_EQ(ours.base_hash(), moved);
+    QueryResult t = RUN_OK(ours, "SELECT v FROM t WHERE id = 2");
+    CHECK_EQ(t.rows.size(), size_t{1});
+    if (!t.rows.empty())
+        CHECK_EQ(t.rows[0][0], text("moved"));
+    CHECK(!ours.execute("SELECT * FROM u").ok());
+
+    // Commits build on the moved head
+    RUN_OK(ours, "INSERT INTO t VALUES (3, 'three')");
+    RUN_OK(ours, "COMMIT 'after'");
+    const CommitRecord *after = repo.get_record(repo.head());
+    CHECK(after != nullptr && after->parent_hash == moved);
+}
+
+REPONO_TEST(branch_cache_follows_a_ref_moved_on_disk)
+{
+    std::string dir = repono_test::temp_dir("branch_cache_disk");
+    Repository repo;
+    repo.open(dir);
+    Session ours(repo);
+    RUN_OK(ours, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT)");
+    RUN_OK(ours, "INSERT INTO t VALUES (1, 'one')");
+    RUN_OK(ours, "COMMIT 'base'");
+    RUN_OK(ours, "CHECKOUT -b feature");
+    repo.flush();
+
+    // Another process commits to main
+    {
+        Repository other;
+        other.open(dir);
+        Session theirs(other);
+        RUN_OK(theirs, "CHECKOUT main");
+        RUN_OK(theirs, "UPDATE t SET v = 'elsewhere' WHERE id = 1");
+        RUN_OK(theirs, "COMMIT 'elsewhere'");
+        RUN_OK(theirs, "CHECKOUT feature");
+        other.flush();
+    }
+
+    CHECK_EQ(repo.reload_refs(), "");
+    RUN_OK(ours, "CHECKOUT main");
+    QueryResult t = RUN_OK(ours, "SELECT v FROM t WHERE id = 1");
+    CHECK_EQ(t.rows.size(), size_t{1});
+    if (!t.rows.empty())
+        CHECK_EQ(t.rows[0][0], text("elsewhere"));
+}
@@ -0,0 +1,92 @@
+/**
+ *  ReponoDB behavioral tests: a minimal registry and assertions
+ *
+ *  Each *_test.cpp file in tests/ registers its cases with REPONO_TEST; the
+ *  driver in tests/main.cpp runs them all (or those whose name contains
+ *  the first argument) and reports every failed CHECK with its location.
+ *
+ *      make test               # behavioral tests, then the difftest
+ *      ./repono_tests merge    # only cases with "merge" in their name
+ */
+
+#ifndef REPONO_TESTS_CHECK_H
+#define REPONO_TESTS_CHECK_H
+
+#include "session.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace repono_test
+{
+    using TestFn = void (*)();
+
+    struct TestCase
+    {
+        const char *name;
+        TestFn run;
+    };
+
+    std::vector<TestCase> &registry();
+
+    struct Register
+    {
+        Register(const char *name, TestFn run) { registry().push_back({name, run}); }
+    };
+
+    /**
+     * Record a failed check (the driver counts them per test)
+     */
+    void fail(const std::string &what, const char *file, int line);
+
+    /**
+     * Checks failed so far, across all tests
+     */
+    int failed_checks();
+
+    /**
+     * A fresh, empty directory for one test to put repositories in
+     */
+    std::string temp_dir(const std::string &name);
+
+    /**
+     * Run a statement that has to succeed, failing the test otherwise
+     */
+    repono::QueryResult run_ok(repono::Session &session, const std::string &sql, const char *file, int line);
+
+    /**
+     * Insert (id, 'r<id>') for ids first..last into a two-column table
+     */
+    void insert_rows(repono::Session &session, const std::string &table, int first, int last);
+
+    /**
+     * The count a SELECT COUNT(*) statement returns (0 if it fails)
+     */
+    size_t count_rows(repono::Session &session, const std::string &sql);
+};
+
+#define REPONO_TEST(name)                                                       \
+    static void name();                                                         \
+    static const repono_test::Register name##_registered(#name, name);          \
+    static void name()
+
+#define CHECK(expr)                                                             \
+    do                                                                          \
+    {                                                                           \
+        if (!(expr))                                                            \
+            repono_test::fail(#expr, __FILE__, __LINE__);                       \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                          \
+    do                                                                          \
+    {                                                                           \
+        auto check_a_ = (a);                                                    \
+        auto check_b_ = (b);                                                    \
+        if (!(check_a_ == check_b_))                                            \
+            repono_test::fail(std::string(#a " == " #b), __FILE__, __LINE__);   \
+    } while (0)
+
+#define RUN_OK(session, sql) repono_test::run_ok((session), (sql), __FILE__, __LINE__)
+
+#endif // REPONO_TESTS_CHECK_H
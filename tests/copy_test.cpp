@@ -0,0 +1,195 @@
+/**
+ *  COPY ... FROM: tricky CSV values survive parsing on one thread or many,
+ *  and a file that cannot be loaded changes nothing
+ */
+
+#include "check.h"
+#include "import.h"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace repono;
+
+namespace
+{
+    Schema make_schema()
+    {
+        Schema schema;
+        schema.add_column(ColumnDef("id", DataType::INTEGER, true, false));
+        schema.add_column(ColumnDef("s", DataType::VARCHAR));
+        schema.add_column(ColumnDef("f", DataType::FLOAT));
+        schema.add_column(ColumnDef("b", DataType::BOOLEAN));
+        schema.add_column(ColumnDef("ts", DataType::TIMESTAMP));
+        return schema;
+    }
+
+    const std::vector<std::string> kStrings = {
+        "plain", "a,b", "\",\"", "\"\"", "say \"hi\"", "two\nlines", "crlf\r\ninside", "", " spaced ", "end\r", "\n",
+    };
+
+    Row make_row(int64_t i)
+    {
+        Row row = {i, Value(), Value(), Value(i % 3 == 0), Value(int64_t{1700000000000} + i)};
+        if (i % 13 != 12)
+            row[1] = kStrings[size_t(i) % kStrings.size()];
+        if (i % 7 != 6)
+            row[2] = double(i) * 0.25 - 1000.0;
+        return row;
+    }
+
+    /**
+     * A field as COPY ... TO writes it: strings always quoted, NULL empty
+     */
+    std::string field(const Value &v)
+    {
+        if (is_null(v))
+            return "";
+        if (const std::string *s = std::get_if<std::string>(&v))
+        {
+            std::string out = "\"";
+            for (char c : *s)
+                out += c == '"' ? "\"\"" : std::string(1, c);
+            return out + "\"";
+        }
+        if (const double *d = std::get_if<double>(&v))
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.17g", *d);
+            return buf;
+        }
+        if (const bool *b = std::get_if<bool>(&v))
+            return *b ? "true" : "F";
+        return std::to_string(std::get<int64_t>(v));
+    }
+
+    /**
+     * CSV with a header, alternating \r\n and \n line ends
+     */
+    std::string to_csv(const std::vector<Row> &rows)
+    {
+        std::string csv = "id,s,f,b,ts\r\n";
+        for (size_t r = 0; r < rows.size(); r++)
+        {
+            for (size_t c = 0; c < rows[r].size(); c++)
+                csv += (c == 0 ? "" : ",") + field(rows[r][c]);
+            csv += r % 2 == 0 ? "\r\n" : "\n";
+        }
+        return csv;
+    }
+
+    std::string write_file(const std::string &path, const std::string &data)
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << data;
+        return path;
+    }
+};
+
+REPONO_TEST(csv_parse_round_trips_tricky_values_on_one_and_many_threads)
+{
+    // Large enough for several slices, so quoted newlines straddle slice edges
+    std::vector<Row> expected;
+    for (int64_t i = 0; i < 120000; i++)
+        expected.push_back(make_row(i));
+    std::string csv = to_csv(expected);
+    CHECK(csv.size() > (size_t{4} << 20));
+
+    for (size_t threads : {size_t{1}, size_t{8}})
+    {
+        CsvOptions options;
+        options.threads = threads;
+        std::vector<std::string> columns;
+        std::vector<Row> rows;
+        CHECK_EQ(parse_csv(csv.data(), csv.size(), make_schema(), options, columns, rows), "");
+        CHECK_EQ(columns, (std::vector<std::string>{"id", "s", "f", "b", "ts"}));
+        CHECK_EQ(rows.size(), expected.size());
+        CHECK(rows == expected);
+    }
+}
+
+REPONO_TEST(csv_parse_reports_bad_records_on_one_and_many_threads)
+{
+    std::vector<Row> good;
+    for (int64_t i = 0; i < 100000; i++)
+        good.push_back(make_row(i));
+    std::string csv = to_csv(good);
+
+    std::vector<std::pair<std::string, std::string>> cases = {
+        {"bad type", "100000,\"x\",not a number,true,1\n"},
+        {"bad boolean", "100000,\"x\",1.5,maybe,1\n"},
+        {"unterminated quote", "100000,\"open,1.5,true,1\n"},
+        {"short record", "100000,\"x\",1.5\n"},
+        {"text after a quote", "100000,\"x\"y,1.5,true,1\n"},
+    };
+    for (const auto &[what, record] : cases)
+    {
+        std::string bad = csv + record;
+        for (size_t threads : {size_t{1}, size_t{8}})
+        {
+            CsvOptions options;
+            options.threads = threads;
+            std::vector<std::string> columns;
+            std::vector<Row> rows;
+            std::string error = parse_csv(bad.data(), bad.size(), make_schema(), options, columns, rows);
+            if (error.empty())
+                repono_test::fail("no error for " + what, __FILE__, __LINE__);
+        }
+    }
+}
+
+REPONO_TEST(copy_from_reads_back_what_copy_to_wrote)
+{
+    std::string dir = repono_test::temp_dir("copy_round_trip");
+    Repository repo;
+    Session session(repo);
+    RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, s VARCHAR, f FLOAT, b BOOLEAN, ts TIMESTAMP)");
+    RUN_OK(session, "CREATE TABLE u (id INTEGER PRIMARY KEY, s VARCHAR, f FLOAT, b BOOLEAN, ts TIMESTAMP)");
+    Statement insert;
+    insert.type = StatementType::INSERT;
+    insert.table = "t";
+    for (int64_t i = 0; i < 5000; i++)
+        insert.rows.push_back(make_row(i));
+    CHECK(session.execute(insert).ok());
+    RUN_OK(session, "COPY t TO '" + dir + "/t.csv'");
+
+    // Without a header, and with \r\n line ends
+    write_file(dir + "/crlf.csv", "9001,\"a\r\nb\",,t,5\r\n9002,,2.5,0,6\r\n\r\n");
+
+    RUN_OK(session, "COPY u FROM '" + dir + "/t.csv'");
+    RUN_OK(session, "COPY u FROM '" + dir + "/crlf.csv' (HEADER false)");
+    QueryResult t = RUN_OK(session, "SELECT * FROM t ORDER BY id");
+    QueryResult u = RUN_OK(session, "SELECT * FROM u WHERE id < 9000 ORDER BY id");
+    CHECK(t.rows == u.rows);
+    QueryResult extra = RUN_OK(session, "SELECT * FROM u WHERE id > 9000 ORDER BY id");
+    CHECK(extra.rows == (std::vector<Row>{{int64_t{9001}, std::string("a\r\nb"), Value(), true, int64_t{5}},
+                                          {int64_t{9002}, Value(), 2.5, false, int64_t{6}}}));
+}
+
+REPONO_TEST(copy_from_that_fails_leaves_the_table_unchanged)
+{
+    std::string dir = repono_test::temp_dir("copy_errors");
+    Repository repo;
+    Session session(repo);
+    RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, s VARCHAR, f FLOAT, b BOOLEAN, ts TIMESTAMP)");
+    RUN_OK(session, "INSERT INTO t VALUES (1, 'one', 1.0, true, 1), (2, 'two', 2.0, false, 2)");
+    RUN_OK(session, "COMMIT 'base'");
+    std::string head = repo.head();
+
+    std::vector<std::string> files = {
+        "id,s\n3,\"three\"\n2,\"taken\"\n",       // duplicate of a stored key
+        "id,s\n3,\"three\"\n3,\"again\"\n",       // duplicate within the file
+        "id,s\n3,\"three\"\nfour,\"four\"\n",     // bad type
+        "id,s\n3,\"three\"\n4,\"unterminated\n",  // unterminated quote
+        "id,nope\n3,\"three\"\n",                 // unknown column
+    };
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        std::string path = write_file(dir + "/bad" + std::to_string(i) + ".csv", files[i]);
+        CHECK(!session.execute("COPY t FROM '" + path + "'").ok());
+        CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t"), size_t{2});
+        CHECK_EQ(repo.head(), head);
+    }
+    QueryResult two = RUN_OK(session, "SELECT s FROM t WHERE id = 2");
+    CHECK(two.rows == (std::vector<Row>{{std::string("two")}}));
+}
@@ -0,0 +1,105 @@
+/**
+ *  diff(): primary key bounds in the WHERE clause limit what is read
+ */
+
+#include "check.h"
+
+using namespace repono;
+
+namespace
+{
+    /**
+     * Two commits of a 3000-row table: an update, a delete and an insert
+     * inside 100..200, and one change outside it
+     *
+     * @returns The hashes of the two commits
+     */
+    std::pair<std::string, std::string> build_two_commits(Repository &repo, const std::string &storage)
+    {
+        Session session(repo);
+        RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT) USING " + storage);
+        std::string sql = "INSERT INTO t VALUES ";
+        for (int id = 1; id <= 3000; id++)
+            sql += (id == 1 ? "(" : ", (") + std::to_string(id) + ", 'v" + std::to_string(id) + "')";
+        RUN_OK(session, sql);
+        RUN_OK(session, "COMMIT 'load'");
+        std::string before = repo.head();
+        RUN_OK(session, "UPDATE t SET v = 'changed' WHERE id BETWEEN 110 AND 120");
+        RUN_OK(session, "DELETE FROM t WHERE id BETWEEN 150 AND 155");
+        RUN_OK(session, "INSERT INTO t VALUES (4000, 'new')");
+        RUN_OK(session, "UPDATE t SET v = 'far' WHERE id = 2500");
+        RUN_OK(session, "COMMIT 'change'");
+        return {before, repo.head()};
+    }
+
+    /**
+     * The rows of an unbounded diff that a predicate on from_id / to_id keeps
+     */
+    std::vector<Row> filtered(const std::vector<Row> &rows, size_t column, int64_t low, int64_t high)
+    {
+        std::vector<Row> kept;
+        for (const auto &row : rows)
+        {
+            const Value &id = row[column];
+            if (std::holds_alternative<int64_t>(id) && std::get<int64_t>(id) >= low && std::get<int64_t>(id) <= high)
+                kept.push_back(row);
+        }
+        return kept;
+    }
+
+    void check_bounded_diff_matches_filter(const std::string &storage)
+    {
+        Repository repo;
+        auto [before, after] = build_two_commits(repo, storage);
+        Session session(repo);
+        std::string source = "SELECT * FROM diff(t, '" + before + "', '" + after + "')";
+        std::vector<Row> all = RUN_OK(session, source).rows;
+        CHECK_EQ(all.size(), size_t{11 + 6 + 1 + 1});
+
+        // Columns: diff_type, from_id, from_v, to_id, to_v
+        CHECK(RUN_OK(session, source + " WHERE to_id BETWEEN 100 AND 200").rows == filtered(all, 3, 100, 200));
+        CHECK(RUN_OK(session, source + " WHERE from_id >= 100 AND from_id < 153").rows == filtered(all, 1, 100, 152));
+        CHECK(RUN_OK(session, source + " WHERE 200 > from_id AND from_id > 149").rows == filtered(all, 1, 150, 199));
+        CHECK(RUN_OK(session, source + " WHERE to_id = 2500").rows == filtered(all, 3, 2500, 2500));
+        CHECK(RUN_OK(session, source + " WHERE from_id = 4000").rows.empty());
+        CHECK(RUN_OK(session, source + " WHERE to_id >= 3999").rows == filtered(all, 3, 3999, 5000));
+        CHECK(RUN_OK(session, source + " WHERE to_id > 200 AND to_id < 100").rows.empty());
+        CHECK_EQ(RUN_OK(session, source + " WHERE to_id = 5 OR to_id = 4000").rows.size(), size_t{1});
+    }
+};
+
+REPONO_TEST(bounded_diff_of_chunked_table_matches_filtered_diff)
+{
+    check_bounded_diff_matches_filter("CHUNKS");
+}
+
+REPONO_TEST(bounded_diff_of_lsm_table_matches_filtered_diff)
+{
+    check_bounded_diff_matches_filter("LSM");
+}
+
+REPONO_TEST(diff_of_one_key_skips_chunks_without_it)
+{
+    Repository repo;
+    auto [before, after] = build_two_commits(repo, "CHUNKS");
+    const TableManifest &from = repo.get_record(before)->tables.at("t");
+    const TableManifest &to = repo.get_record(after)->tables.at("t");
+    auto count = [](RowDiff::Type, const Row *, const Row *)
+    { return true; };
+
+    DiffStats all;
+    CHECK_EQ(diff_table_rows(repo, &from, &to, count, &all), "");
+
+    KeyRange one;
+    one.low = one.high = Value(int64_t{2500});
+    DiffStats bounded;
+    size_t rows = 0;
+    CHECK_EQ(diff_table_rows(repo, &from, &to, [&rows](RowDiff::Type, const Row *, const Row *)
+                             { rows++;
+                               return true; },
+                             &bounded, one),
+             "");
+    CHECK_EQ(rows, size_t{1});
+    CHECK(bounded.chunks_scanned < all.chunks_scanned);
+    CHECK_EQ(bounded.chunks_scanned, size_t{2});
+}
@@ -0,0 +1,162 @@
+/**
+ *  Embedding API: batches and exported streams outlive the Result and the
+ *  Connection they came from, and the C API reads the same values
+ */
+
+#include "check.h"
+#include "repono/repono.h"
+#include "repono/repono_c.h"
+
+#include <cstring>
+
+using namespace repono;
+
+namespace
+{
+    void load(Connection &conn, int rows)
+    {
+        conn.execute("CREATE TABLE t (id INTEGER PRIMARY KEY, name VARCHAR, score FLOAT)");
+        std::string sql = "INSERT INTO t VALUES ";
+        for (int id = 1; id <= rows; id++)
+            sql += (id == 1 ? "(" : ", (") + std::to_string(id) + ", 'n" + std::to_string(id) + "', " +
+                   (id % 10 == 0 ? "NULL" : std::to_string(id) + ".5") + ")";
+        conn.execute(sql);
+        conn.commit("load");
+    }
+
+    /**
+     * Whether batches hold rows 1..rows in order as load() wrote them
+     */
+    bool matches_load(const std::vector<RowBatch> &batches, int rows)
+    {
+        int64_t expected = 1;
+        for (const RowBatch &batch : batches)
+        {
+            ColumnView ids = batch.column(0), names = batch.column(1), scores = batch.column(2);
+            for (size_t r = 0; r < batch.num_rows(); r++, expected++)
+            {
+                if (ids.as_int64(r) != expected || names.as_string(r) != "n" + std::to_string(expected))
+                    return false;
+                if (expected % 10 == 0 ? !scores.is_null(r) : scores.as_double(r) != double(expected) + 0.5)
+                    return false;
+            }
+        }
+        return expected == rows + 1;
+    }
+
+    std::string text(repono_value v)
+    {
+        return v.type == REPONO_STRING ? std::string(v.as.string.data, v.as.string.length) : std::string();
+    }
+};
+
+REPONO_TEST(row_batches_outlive_their_result_and_connection)
+{
+    std::string error;
+    std::unique_ptr<Database> db = Database::open("", error);
+    std::unique_ptr<Connection> conn = db->connect();
+    load(*conn, 5000);
+
+    std::vector<RowBatch> scanned, selected;
+    ArrowArrayStream stream;
+    {
+        Result scan = conn->scan("t");
+        CHECK(scan.ok());
+        CHECK(scan.batches().size() > 1);
+        scanned = scan.batches();
+
+        Result select = conn->execute("SELECT * FROM t ORDER BY id");
+        CHECK(select.ok());
+        selected = select.batches();
+        select.export_arrow(&stream);
+    }
+    conn.reset();
+
+    // Rewrite every row and commit from another connection
+    std::unique_ptr<Connection> writer = db->connect();
+    writer->execute("UPDATE t SET name = 'gone', score = 0");
+    writer->execute("DELETE FROM t WHERE id > 100");
+    writer->commit("rewrite");
+
+    CHECK(matches_load(scanned, 5000));
+    CHECK(matches_load(selected, 5000));
+    CHECK_EQ(selected.at(0).num_columns(), size_t{3});
+
+    // The exported stream still reads the rows it was made from
+    Result imported = writer->import_arrow("copied", &stream, "copy");
+    CHECK(imported.ok());
+    writer.reset();
+    std::unique_ptr<Connection> reader = db->connect(true);
+    Result copy = reader->scan("copied");
+    CHECK_EQ(copy.num_rows(), size_t{5000});
+    Result sorted = reader->execute("SELECT * FROM copied ORDER BY id");
+    CHECK(matches_load(sorted.batches(), 5000));
+    CHECK(!reader->execute("INSERT INTO copied VALUES (0, 'x', 1.0)").ok());
+}
+
+REPONO_TEST(c_api_reads_values_and_exports_past_the_result)
+{
+    char *error = nullptr;
+    repono_database *db = repono_open(nullptr, &error);
+    CHECK(db != nullptr && error == nullptr);
+    if (db == nullptr)
+        return;
+    repono_connection *conn = repono_connect(db, 0);
+
+    const char *statements[] = {
+        "CREATE TABLE t (id INTEGER PRIMARY KEY, name VARCHAR, score FLOAT, ok BOOLEAN)",
+        "INSERT INTO t VALUES (1, 'one', 1.5, true), (2, NULL, NULL, false)",
+    };
+    for (const char *sql : statements)
+    {
+        repono_result *result = repono_execute(conn, sql);
+        CHECK(repono_result_error(result) == nullptr);
+        repono_result_free(result);
+    }
+    repono_result *committed = repono_commit(conn, "load");
+    CHECK(repono_result_error(committed) == nullptr);
+    repono_result_free(committed);
+
+    repono_result *bad = repono_execute(conn, "SELECT * FROM missing");
+    CHECK(repono_result_error(bad) != nullptr);
+    repono_result_free(bad);
+
+    repono_result *scan = repono_scan(conn, "t", nullptr);
+    CHECK(repono_result_error(scan) == nullptr);
+    CHECK_EQ(repono_result_row_count(scan), size_t{2});
+    CHECK_EQ(repono_result_column_count(scan), size_t{4});
+    CHECK(std::strcmp(repono_result_column_name(scan, 1), "name") == 0);
+    CHECK_EQ(repono_result_batch_count(scan), size_t{1});
+
+    repono_value id = repono_batch_value(scan, 0, 0, 0);
+    CHECK(id.type == REPONO_INTEGER && id.as.integer == 1);
+    CHECK_EQ(text(repono_batch_value(scan, 0, 0, 1)), "one");
+    repono_value score = repono_batch_value(scan, 0, 0, 2);
+    CHECK(score.type == REPONO_FLOAT && score.as.real == 1.5);
+    repono_value flag = repono_batch_value(scan, 0, 1, 3);
+    CHECK(flag.type == REPONO_BOOLEAN && flag.as.boolean == 0);
+    CHECK(repono_batch_value(scan, 0, 1, 1).type == REPONO_NULL);
+    CHECK(repono_batch_value(scan, 0, 2, 0).type == REPONO_NULL);
+    CHECK(repono_batch_value(scan, 1, 0, 0).type == REPONO_NULL);
+
+    repono_value names[4];
+    CHECK_EQ(repono_batch_column(scan, 0, 1, names, 4), size_t{2});
+    CHECK_EQ(text(names[0]), "one");
+    CHECK(names[1].type == REPONO_NULL);
+
+    // The stream stays valid once the result is freed
+    ArrowArrayStream stream;
+    repono_result_export(scan, &stream);
+    repono_result_free(scan);
+    repono_result *imported = repono_import(conn, "copied", &stream, "copy");
+    CHECK(repono_result_error(imported) == nullptr);
+    CHECK_EQ(repono_result_rows_affected(imported), size_t{2});
+    repono_result_free(imported);
+
+    repono_result *copy = repono_execute(conn, "SELECT name FROM copied WHERE id = 1");
+    CHECK_EQ(text(repono_batch_value(copy, 0, 0, 0)), "one");
+    repono_result_free(copy);
+
+    repono_disconnect(conn);
+    repono_close(db);
+}
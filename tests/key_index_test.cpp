@@ -0,0 +1,123 @@
+/**
+ *  Primary key checks: the key index follows deletes and key updates
+ *  without being rebuilt
+ */
+
+#include "check.h"
+
+using namespace repono;
+
+namespace
+{
+    void check_delete_then_insert(const std::string &storage)
+    {
+        Repository repo;
+        Session session(repo);
+        RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT) USING " + storage);
+        repono_test::insert_rows(session, "t", 1, 3000);
+        RUN_OK(session, "COMMIT 'load'");
+
+        // A deleted stored key is free again before and after COMMIT
+        RUN_OK(session, "DELETE FROM t WHERE id = 10");
+        RUN_OK(session, "INSERT INTO t VALUES (10, 'again')");
+        CHECK(!session.execute("INSERT INTO t VALUES (10, 'twice')").ok());
+        CHECK(!session.execute("INSERT INTO t VALUES (11, 'taken')").ok());
+        RUN_OK(session, "DELETE FROM t WHERE id = 20");
+        RUN_OK(session, "COMMIT 'reuse'");
+        RUN_OK(session, "INSERT INTO t VALUES (20, 'later')");
+        CHECK(!session.execute("INSERT INTO t VALUES (10, 'committed')").ok());
+
+        // A key inserted since checkout, deleted and inserted again
+        RUN_OK(session, "INSERT INTO t VALUES (5000, 'new')");
+        RUN_OK(session, "DELETE FROM t WHERE id = 5000");
+        RUN_OK(session, "INSERT INTO t VALUES (5000, 'newer')");
+        CHECK(!session.execute("INSERT INTO t VALUES (5000, 'newest')").ok());
+
+        // Deletes spanning whole chunks free every key in them
+        RUN_OK(session, "DELETE FROM t WHERE id > 100 AND id <= 2900");
+        repono_test::insert_rows(session, "t", 101, 2900);
+        CHECK(!session.execute("INSERT INTO t VALUES (1500, 'dup')").ok());
+        RUN_OK(session, "COMMIT 'refill'");
+        RUN_OK(session, "DELETE FROM t WHERE id <= 2900");
+        RUN_OK(session, "COMMIT 'drop'");
+        repono_test::insert_rows(session, "t", 1, 5);
+        CHECK(!session.execute("INSERT INTO t VALUES (2950, 'dup')").ok());
+        CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE id > 0"), size_t{5 + 100 + 1});
+    }
+
+    void check_key_updates(const std::string &storage)
+    {
+        Repository repo;
+        Session session(repo);
+        RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT) USING " + storage);
+        repono_test::insert_rows(session, "t", 1, 3000);
+        RUN_OK(session, "COMMIT 'load'");
+
+        // Swapping keys collides with nothing once both are freed
+        RUN_OK(session, "UPDATE t SET id = 3 - id WHERE id <= 2");
+        CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE id = 1 AND v = 'r2'"), size_t{1});
+
+        // Moving onto a key that stays put fails and changes nothing
+        CHECK(!session.execute("UPDATE t SET id = id + 1 WHERE id = 2999").ok());
+        CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE id = 2999 AND v = 'r2999'"), size_t{1});
+        CHECK(!session.execute("UPDATE t SET id = 7 WHERE id BETWEEN 5 AND 6").ok());
+        CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE id BETWEEN 5 AND 7"), size_t{3});
+
+        // Shifting a run of keys up frees the bottom one
+        RUN_OK(session, "UPDATE t SET id = id + 1 WHERE id >= 2990");
+        RUN_OK(session, "INSERT INTO t VALUES (2990, 'freed')");
+        CHECK(!session.execute("INSERT INTO t VALUES (3001, 'dup')").ok());
+        RUN_OK(session, "COMMIT 'moved'");
+        CHECK(!session.execute("INSERT INTO t VALUES (2991, 'dup')").ok());
+        CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE id > 0"), size_t{3001});
+    }
+};
+
+REPONO_TEST(key_index_follows_delete_then_insert_in_chunked_tables)
+{
+    check_delete_then_insert("CHUNKS");
+}
+
+REPONO_TEST(key_index_follows_delete_then_insert_in_lsm_tables)
+{
+    check_delete_then_insert("LSM");
+}
+
+REPONO_TEST(key_index_follows_key_updates_in_chunked_tables)
+{
+    check_key_updates("CHUNKS");
+}
+
+REPONO_TEST(key_index_follows_key_updates_in_lsm_tables)
+{
+    check_key_updates("LSM");
+}
+
+REPONO_TEST(key_checks_after_reopen_read_summaries_not_chunks)
+{
+    std::string dir = repono_test::temp_dir("key_index_reopen");
+    {
+        Repository repo;
+        repo.open(dir);
+        Session session(repo);
+        RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT)");
+        repono_test::insert_rows(session, "t", 1, 3000);
+        RUN_OK(session, "COMMIT 'load'");
+        CHECK_EQ(repo.flush(), "");
+    }
+
+    Repository repo;
+    repo.open(dir);
+    Session session(repo);
+    Counter &misses = metrics().counter("repono_chunk_cache_misses_total", "");
+    uint64_t before = misses.value();
+    RUN_OK(session, "INSERT INTO t VALUES (5000, 'new')");
+    CHECK_EQ(misses.value(), before);
+
+    // A key that is there still reads the chunk that holds it
+    CHECK(!session.execute("INSERT INTO t VALUES (1500, 'dup')").ok());
+    CHECK(misses.value() > before);
+    repono_test::insert_rows(session, "t", 6001, 9000);
+    CHECK(!session.execute("INSERT INTO t VALUES (2999, 'dup')").ok());
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE id > 0"), size_t{6001});
+}
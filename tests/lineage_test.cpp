@@ -0,0 +1,129 @@
+/**
+ *  Row lineage: BLAME and HISTORY OF ROW across commits that rewrite chunks
+ */
+
+#include "check.h"
+#include "lineage.h"
+
+using namespace repono;
+
+namespace
+{
+    /**
+     * Six commits of a 2000-row table, touching row 700 in four of them
+     */
+    void build_history(const std::string &dir)
+    {
+        Repository repo;
+        repo.open(dir);
+        Session session(repo);
+        RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT)");
+        repono_test::insert_rows(session, "t", 1, 2000);
+        RUN_OK(session, "COMMIT 'load'");
+        RUN_OK(session, "UPDATE t SET v = 'changed' WHERE id = 700");
+        RUN_OK(session, "COMMIT 'update'");
+        RUN_OK(session, "UPDATE t SET v = 'other' WHERE id = 10");
+        RUN_OK(session, "COMMIT 'other row'");
+        RUN_OK(session, "DELETE FROM t WHERE id = 700");
+        RUN_OK(session, "COMMIT 'delete'");
+        RUN_OK(session, "INSERT INTO t VALUES (700, 'back')");
+        RUN_OK(session, "COMMIT 'reinsert'");
+        // Re-cuts chunks around the row without changing it
+        RUN_OK(session, "DELETE FROM t WHERE id < 50");
+        repono_test::insert_rows(session, "t", 2001, 2300);
+        RUN_OK(session, "COMMIT 'recut'");
+        repo.flush();
+    }
+};
+
+REPONO_TEST(history_of_row_follows_updates_deletes_and_reinserts)
+{
+    std::string dir = repono_test::temp_dir("lineage_history");
+    build_history(dir);
+
+    Repository repo;
+    repo.open(dir);
+    Session session(repo);
+    QueryResult history = RUN_OK(session, "HISTORY OF ROW t WHERE id = 700");
+    CHECK_EQ(history.rows.size(), size_t{4});
+    if (history.rows.size() == 4)
+    {
+        const char *messages[] = {"reinsert", "delete", "update", "load"};
+        const char *changes[] = {"ADDED", "DELETED", "MODIFIED", "ADDED"};
+        const char *values[] = {"back", "changed", "changed", "r700"};
+        for (size_t i = 0; i < 4; i++)
+        {
+            CHECK_EQ(history.rows[i][2], Value(std::string(messages[i])));
+            CHECK_EQ(history.rows[i][3], Value(std::string(changes[i])));
+            CHECK_EQ(history.rows[i][5], Value(std::string(values[i])));
+        }
+    }
+
+    QueryResult blame = RUN_OK(session, "BLAME t WHERE id = 700");
+    CHECK_EQ(blame.rows.size(), size_t{1});
+    if (!blame.rows.empty())
+        CHECK_EQ(blame.rows[0][2], Value(std::string("reinsert")));
+
+    QueryResult unchanged = RUN_OK(session, "BLAME t WHERE id = 1500");
+    CHECK_EQ(unchanged.rows.size(), size_t{1});
+    if (!unchanged.rows.empty())
+        CHECK_EQ(unchanged.rows[0][2], Value(std::string("load")));
+
+    CHECK_EQ(RUN_OK(session, "HISTORY OF ROW t WHERE id = 5").rows.size(), size_t{2});
+}
+
+REPONO_TEST(lineage_reads_stored_key_summaries_instead_of_chunks)
+{
+    std::string dir = repono_test::temp_dir("lineage_summaries");
+    build_history(dir);
+
+    Repository repo;
+    repo.open(dir);
+    LineageIndex lineage(repo);
+    std::vector<size_t> key_columns = {0};
+
+    // A key that was never there: every chunk is ruled out by its summary
+    auto none = lineage.row_history(repo.head(), "t", key_columns, encode_key({Value(int64_t{99999})}, key_columns));
+    CHECK(none.empty());
+    CHECK_EQ(lineage.last_stats().commits_walked, size_t{6});
+    CHECK_EQ(lineage.last_stats().chunks_decoded, size_t{0});
+
+    // Only chunks holding the row are read, each once
+    auto versions = lineage.row_history(repo.head(), "t", key_columns, encode_key({Value(int64_t{700})}, key_columns));
+    CHECK_EQ(versions.size(), size_t{4});
+    CHECK(lineage.last_stats().chunks_decoded > 0);
+    CHECK(lineage.last_stats().chunks_decoded <= 2 * lineage.last_stats().commits_walked);
+}
+
+REPONO_TEST(lineage_builds_summaries_for_chunks_committed_without_them)
+{
+    Repository repo;
+    Schema schema;
+    schema.add_column(ColumnDef("id", DataType::INTEGER, true));
+    for (int64_t round = 0; round < 3; round++)
+    {
+        Commit commit;
+        commit.message = "round " + std::to_string(round);
+        commit.table_schemas["t"] = schema;
+        for (int64_t id = 0; id < 1000 + round; id++)
+            commit.table_data["t"].push_back({id});
+        repo.commit(commit);
+    }
+
+    LineageIndex lineage(repo);
+    std::vector<size_t> key_columns = {0};
+    auto versions = lineage.row_history(repo.head(), "t", key_columns, encode_key({Value(int64_t{1001})}, key_columns));
+    CHECK_EQ(versions.size(), size_t{1});
+    CHECK(lineage.row_history(repo.head(), "t", {}, encode_key({Value(int64_t{1001})}, key_columns)).empty());
+}
+
+REPONO_TEST(lineage_rejects_tables_without_a_primary_key)
+{
+    Repository repo;
+    Session session(repo);
+    RUN_OK(session, "CREATE TABLE n (v TEXT)");
+    RUN_OK(session, "INSERT INTO n VALUES ('a')");
+    RUN_OK(session, "COMMIT 'keyless'");
+    CHECK(!session.execute("BLAME n WHERE v = 'a'").ok());
+    CHECK(!session.execute("HISTORY OF ROW n WHERE v = 'a'").ok());
+}
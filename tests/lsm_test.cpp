@@ -0,0 +1,231 @@
+/**
+ *  LSM tables: compaction, tombstones at the bottom level, reopening, and
+ *  commits that validate and merge run by run
+ */
+
+#include "check.h"
+#include "lsm.h"
+#include "repono/hash.h"
+
+#include <set>
+
+using namespace repono;
+
+namespace
+{
+    const std::vector<SortedRun> &head_runs(const Repository &repo, const std::string &table)
+    {
+        static const std::vector<SortedRun> none;
+        const CommitRecord *record = repo.get_record(repo.head());
+        if (record == nullptr || record->tables.count(table) == 0)
+            return none;
+        return record->tables.at(table).runs;
+    }
+
+    /**
+     * Whether a record still decodes once encoded
+     */
+    bool decodes(const CommitRecord &record)
+    {
+        std::string bytes = encode_commit_record(record);
+        ByteReader r(bytes);
+        return decode_commit_record(r).has_value();
+    }
+};
+
+REPONO_TEST(lsm_compaction_keeps_the_run_count_bounded)
+{
+    Repository repo;
+    Session session(repo);
+    RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT) USING LSM");
+    for (int i = 0; i < 200; i++)
+    {
+        repono_test::insert_rows(session, "t", i * 10 + 1, i * 10 + 10);
+        RUN_OK(session, "UPDATE t SET v = 'u' WHERE id = " + std::to_string(i * 5 + 1));
+        RUN_OK(session, "COMMIT 'batch " + std::to_string(i) + "'");
+
+        // Every level holds fewer runs than a merge takes, oldest levels last
+        const std::vector<SortedRun> &runs = head_runs(repo, "t");
+        std::map<uint32_t, size_t> per_level;
+        for (size_t r = 0; r < runs.size(); r++)
+        {
+            per_level[runs[r].level]++;
+            if (r > 0)
+                CHECK(runs[r - 1].level <= runs[r].level);
+        }
+        for (const auto &[level, count] : per_level)
+            CHECK(count < kLsmRunsPerLevel);
+    }
+    CHECK(head_runs(repo, "t").size() < 3 * kLsmRunsPerLevel);
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t"), size_t{2000});
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE v = 'u'"), size_t{200});
+    CHECK(validate_commit(*repo.get_commit(repo.head())));
+}
+
+REPONO_TEST(lsm_tombstones_are_dropped_only_at_the_bottom_level)
+{
+    Repository repo;
+    Session session(repo);
+    RUN_OK(session, "CREATE TABLE small (id INTEGER PRIMARY KEY, v TEXT) USING LSM");
+    RUN_OK(session, "CREATE TABLE large (id INTEGER PRIMARY KEY, v TEXT) USING LSM");
+    repono_test::insert_rows(session, "small", 1, 10);
+    repono_test::insert_rows(session, "large", 1, 3000);
+    RUN_OK(session, "COMMIT 'load'");
+    CHECK_EQ(head_runs(repo, "large").size(), size_t{1});
+    CHECK(head_runs(repo, "large").at(0).level > 0);
+
+    // small's load counts towards level 0, large's does not
+    for (size_t i = 1; i <= kLsmRunsPerLevel; i++)
+    {
+        if (i < kLsmRunsPerLevel)
+            RUN_OK(session, "DELETE FROM small WHERE id = " + std::to_string(i));
+        RUN_OK(session, "DELETE FROM large WHERE id = " + std::to_string(i));
+        RUN_OK(session, "COMMIT 'delete " + std::to_string(i) + "'");
+    }
+
+    // small's deletes merged with its only other run: nothing left to hide
+    const std::vector<SortedRun> &small = head_runs(repo, "small");
+    CHECK_EQ(small.size(), size_t{1});
+    CHECK_EQ(small.at(0).tombstones, size_t{0});
+    CHECK_EQ(small.at(0).rows, 11 - kLsmRunsPerLevel);
+
+    // large's deletes merged above level 0 but its load is still older
+    const std::vector<SortedRun> &large = head_runs(repo, "large");
+    CHECK_EQ(large.size(), size_t{2});
+    CHECK_EQ(large.at(0).tombstones, kLsmRunsPerLevel);
+    CHECK_EQ(large.at(1).rows, size_t{3000});
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM large"), 3000 - kLsmRunsPerLevel);
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM large WHERE id <= 10"), 10 - kLsmRunsPerLevel);
+}
+
+REPONO_TEST(lsm_tables_survive_a_reopen)
+{
+    std::string dir = repono_test::temp_dir("lsm_reopen");
+    {
+        Repository repo;
+        repo.open(dir);
+        Session session(repo);
+        RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT) USING LSM");
+        repono_test::insert_rows(session, "t", 1, 3000);
+        RUN_OK(session, "COMMIT 'load'");
+        RUN_OK(session, "DELETE FROM t WHERE id > 2000");
+        RUN_OK(session, "UPDATE t SET v = 'changed' WHERE id = 42");
+        RUN_OK(session, "COMMIT 'edit'");
+        CHECK_EQ(repo.flush(), "");
+    }
+
+    Repository repo;
+    CHECK_EQ(repo.open(dir), "");
+    CHECK_EQ(head_runs(repo, "t").size(), size_t{2});
+    CHECK(validate_commit(*repo.get_commit(repo.head())));
+    Session session(repo);
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t"), size_t{2000});
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE id = 42 AND v = 'changed'"), size_t{1});
+    CHECK(!session.execute("INSERT INTO t VALUES (1500, 'dup')").ok());
+    RUN_OK(session, "INSERT INTO t VALUES (2500, 'back')");
+    RUN_OK(session, "COMMIT 'after reopen'");
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t"), size_t{2001});
+}
+
+REPONO_TEST(lsm_merge_adds_their_changes_as_one_run)
+{
+    Repository repo;
+    Session session(repo);
+    RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT) USING LSM");
+    repono_test::insert_rows(session, "t", 1, 3000);
+    RUN_OK(session, "COMMIT 'base'");
+    RUN_OK(session, "CHECKOUT -b feature");
+    RUN_OK(session, "UPDATE t SET v = 'feature' WHERE id = 2500");
+    RUN_OK(session, "DELETE FROM t WHERE id = 2600");
+    RUN_OK(session, "COMMIT 'feature'");
+    RUN_OK(session, "CHECKOUT main");
+    RUN_OK(session, "UPDATE t SET v = 'main' WHERE id = 10");
+    RUN_OK(session, "COMMIT 'main'");
+    const CommitRecord *before = repo.get_record(repo.head());
+    CHECK(before != nullptr);
+    if (before == nullptr)
+        return;
+    std::vector<std::string> ours = before->tables.at("t").chunk_hashes;
+
+    RUN_OK(session, "MERGE feature");
+    const CommitRecord *merged = repo.get_record(repo.head());
+    CHECK(merged != nullptr && !merged->merge_parent_hash.empty());
+    if (merged == nullptr)
+        return;
+
+    // Our runs are kept as they were, under one new run of their changes
+    const TableManifest &t = merged->tables.at("t");
+    CHECK_EQ(t.runs.size(), before->tables.at("t").runs.size() + 1);
+    CHECK_EQ(t.runs.at(0).rows + t.runs.at(0).tombstones, size_t{2});
+    std::set<std::string> kept(t.chunk_hashes.begin(), t.chunk_hashes.end());
+    for (const auto &hash : ours)
+        CHECK(kept.count(hash) == 1);
+    CHECK(validate_commit(*repo.get_commit(repo.head())));
+
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t"), size_t{2999});
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE id = 2500 AND v = 'feature'"), size_t{1});
+    CHECK_EQ(repono_test::count_rows(session, "SELECT COUNT(*) FROM t WHERE id = 10 AND v = 'main'"), size_t{1});
+}
+
+REPONO_TEST(lsm_records_with_bad_levels_are_rejected)
+{
+    Repository repo;
+    Session session(repo);
+    RUN_OK(session, "CREATE TABLE t (id INTEGER PRIMARY KEY, v TEXT) USING LSM");
+    repono_test::insert_rows(session, "t", 1, 3000);
+    RUN_OK(session, "COMMIT 'load'");
+    RUN_OK(session, "INSERT INTO t VALUES (5000, 'new')");
+    RUN_OK(session, "COMMIT 'new'");
+    const CommitRecord *record = repo.get_record(repo.head());
+    CHECK(record != nullptr && record->tables.at("t").runs.size() == 2);
+    if (record == nullptr || record->tables.at("t").runs.size() != 2)
+        return;
+    CHECK(decodes(*record));
+
+    // A newer run above an older one
+    CommitRecord inverted = *record;
+    inverted.tables.at("t").runs[0].level = inverted.tables.at("t").runs[1].level + 1;
+    CHECK(!decodes(inverted));
+
+    // A level past the highest one compaction makes
+    CommitRecord too_high = *record;
+    too_high.tables.at("t").runs[0].level = kLsmMaxLevel + 1;
+    too_high.tables.at("t").runs[1].level = kLsmMaxLevel + 1;
+    CHECK(!decodes(too_high));
+}
+
+REPONO_TEST(lsm_bounded_update_and_delete_match_chunked_tables)
+{
+    Repository repo;
+    Session session(repo);
+    for (std::string table : {"c", "l"})
+    {
+        RUN_OK(session, "CREATE TABLE " + table + " (id INTEGER PRIMARY KEY, v TEXT)" +
+                            (table == "l" ? " USING LSM" : ""));
+        repono_test::insert_rows(session, table, 1, 3000);
+    }
+    RUN_OK(session, "COMMIT 'load'");
+
+    std::vector<std::string> steps = {
+        "UPDATE %t SET v = 'a' WHERE id BETWEEN 100 AND 200",
+        "DELETE FROM %t WHERE id > 2500 AND v = 'r2600'",
+        "UPDATE %t SET id = id + 10000 WHERE id >= 2990",
+        "DELETE FROM %t WHERE id < 50 OR id = 1000",
+        "UPDATE %t SET v = 'b' WHERE id = 150",
+        "DELETE FROM %t WHERE id >= 12995",
+    };
+    for (size_t i = 0; i < steps.size(); i++)
+    {
+        for (std::string table : {"c", "l"})
+        {
+            std::string sql = steps[i];
+            sql.replace(sql.find("%t"), 2, table);
+            RUN_OK(session, sql);
+        }
+        if (i % 2 == 1)
+            RUN_OK(session, "COMMIT 'step " + std::to_string(i) + "'");
+        QueryResult c = RUN_OK(session, "SELECT * FROM c ORDER BY id");
+        QueryResult l = RUN_OK(session, "SELECT * FROM l ORDER BY id");
+        CHECK(c.rows == l.rows);
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ *  ReponoDB behavioral test driver (see check.h)
+ */
+
+#include "check.h"
+
+#include <filesystem>
+
+namespace repono_test
+{
+    namespace
+    {
+        int failures = 0;
+    }
+
+    std::vector<TestCase> &registry()
+    {
+        static std::vector<TestCase> cases;
+        return cases;
+    }
+
+    void fail(const std::string &what, const char *file, int line)
+    {
+        failures++;
+        std::cout << "  " << file << ":" << line << ": CHECK failed: " << what << "\n";
+    }
+
+    int failed_checks()
+    {
+        return failures;
+    }
+
+    std::string temp_dir(const std::string &name)
+    {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "repono_tests" / name;
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        return dir.string();
+    }
+
+    repono::QueryResult run_ok(repono::Session &session, const std::string &sql, const char *file, int line)
+    {
+        repono::QueryResult result = session.execute(sql);
+        if (!result.ok())
+            fail(sql + " -> " + result.error, file, line);
+        return result;
+    }
+
+    void insert_rows(repono::Session &session, const std::string &table, int first, int last)
+    {
+        std::string sql = "INSERT INTO " + table + " VALUES ";
+        for (int id = first; id <= last; id++)
+            sql += (id == first ? "(" : ", (") + std::to_string(id) + ", 'r" + std::to_string(id) + "')";
+        RUN_OK(session, sql);
+    }
+
+    size_t count_rows(repono::Session &session, const std::string &sql)
+    {
+        repono::QueryResult result = RUN_OK(session, sql);
+        if (result.rows.empty())
+            return 0;
+        return size_t(std::get<int64_t>(result.rows[0][0]));
+    }
+};
+
+int main(int argc, char **argv)
+{
+    std::string filter = argc > 1 ? argv[1] : "";
+    int run = 0, failing = 0;
+    for (const auto &test : repono_test::registry())
+    {
+        if (!filter.empty() && std::string(test.name).find(filter) == std::string::npos)
+            continue;
+        int before = repono_test::failed_checks();
+        test.run();
+        run++;
+        if (repono_test::failed_checks() != before)
+        {
+            failing++;
+            std::cout << test.name << " FAILED\n";
+        }
+    }
+    std::cout << run << " tests, " << failing << " failing\n";
+    return failing == 0 ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+/**
+ *  Packs and remotes: what a push or fetch may write into a repository
+ */
+
+#include "check.h"
+#include "remote.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace repono;
+
+namespace
+{
+    /**
+     * A repository in dir with one committed table
+     */
+    std::string make_repository(const std::string &dir)
+    {
+        Repository repo;
+        repo.open(dir);
+        Session session(repo);
+        session.execute("CREATE TABLE t (id INTEGER PRIMARY KEY, v VARCHAR)");
+        session.execute("INSERT INTO t VALUES (1, 'a'), (2, 'b')");
+        session.execute("COMMIT 'first'");
+        return repo.head();
+    }
+
+    std::string pack_of(const std::vector<CommitRecord> &records)
+    {
+        ByteWriter w;
+        for (int i = 0; i < 4; i++)
+            w.put_u8(kPackMagic[i]);
+        w.put_u32(0); // no chunks
+        w.put_u32(static_cast<uint32_t>(records.size()));
+        for (const auto &record : records)
+            w.put_string(encode_commit_record(record));
+        return w.take();
+    }
+
+    CommitRecord child_of(const std::string &parent, const std::string &message)
+    {
+        CommitRecord record;
+        record.parent_hash = parent;
+        record.message = message;
+        record.timestamp = 1703619600;
+        record.hash = compute_record_hash(record);
+        return record;
+    }
+};
+
+REPONO_TEST(push_rejects_record_with_path_in_hash)
+{
+    std::string dir = repono_test::temp_dir("push_forged_path");
+    std::string head = make_repository(dir + "/server");
+
+    CommitRecord forged = child_of(head, "pwned");
+    forged.hash = "../../../pwned";
+    DirectoryRemote remote(dir + "/server");
+    std::string error = remote.push_pack(pack_of({forged}), {{"main", {head, forged.hash}}});
+    CHECK(!error.empty());
+    CHECK(!std::filesystem::exists(dir + "/pwned"));
+
+    std::map<std::string, std::string> refs;
+    remote.list_refs(refs);
+    CHECK_EQ(refs["main"], head);
+}
+
+REPONO_TEST(push_rejects_record_whose_hash_does_not_match)
+{
+    std::string dir = repono_test::temp_dir("push_forged_hash");
+    std::string head = make_repository(dir + "/server");
+
+    CommitRecord forged = child_of(head, "honest");
+    forged.message = "changed after hashing";
+    DirectoryRemote remote(dir + "/server");
+    CHECK(!remote.push_pack(pack_of({forged}), {{"main", {head, forged.hash}}}).empty());
+
+    Repository server;
+    server.open(dir + "/server");
+    CHECK(!server.has_commit(forged.hash));
+    CHECK_EQ(*server.branch_head("main"), head);
+}
+
+REPONO_TEST(push_rejects_record_with_missing_parent)
+{
+    std::string dir = repono_test::temp_dir("push_missing_parent");
+    make_repository(dir + "/server");
+
+    CommitRecord orphan = child_of(std::string(64, 'a'), "orphan");
+    DirectoryRemote remote(dir + "/server");
+    CHECK(!remote.push_pack(pack_of({orphan}), {{"orphan", {"", orphan.hash}}}).empty());
+}
+
+REPONO_TEST(push_accepts_parents_earlier_in_the_same_pack)
+{
+    std::string dir = repono_test::temp_dir("push_chain");
+    std::string head = make_repository(dir + "/server");
+
+    CommitRecord first = child_of(head, "one");
+    CommitRecord second = child_of(first.hash, "two");
+    DirectoryRemote remote(dir + "/server");
+    CHECK_EQ(remote.push_pack(pack_of({first, second}), {{"main", {head, second.hash}}}), "");
+
+    std::map<std::string, std::string> refs;
+    remote.list_refs(refs);
+    CHECK_EQ(refs["main"], second.hash);
+}
+
+REPONO_TEST(push_rejects_bad_branch_names)
+{
+    std::string dir = repono_test::temp_dir("push_branch_names");
+    std::string head = make_repository(dir + "/server");
+    CommitRecord next = child_of(head, "next");
+
+    DirectoryRemote remote(dir + "/server");
+    for (std::string branch : {"", "a b", "main\nevil 0", "../x", "a/../b", "a/", "x\t"})
+    {
+        CHECK(!remote.push_pack(pack_of({next}), {{branch, {"", next.hash}}}).empty());
+    }
+    std::map<std::string, std::string> refs;
+    remote.list_refs(refs);
+    CHECK_EQ(refs.size(), size_t{1});
+    CHECK(is_valid_branch_name("origin/main"));
+}
+
+REPONO_TEST(push_and_fetch_round_trip)
+{
+    std::string dir = repono_test::temp_dir("push_fetch");
+    make_repository(dir + "/server");
+
+    Repository local;
+    DirectoryRemote remote(dir + "/server");
+    CHECK_EQ(clone(remote, local), "");
+    Session session(local);
+    RUN_OK(session, "INSERT INTO t VALUES (3, 'c')");
+    RUN_OK(session, "COMMIT 'second'");
+    CHECK_EQ(push(local, remote, "main"), "");
+
+    Repository server;
+    server.open(dir + "/server");
+    CHECK_EQ(*server.branch_head("main"), local.head());
+}
+
+REPONO_TEST(recv_frame_rejects_oversized_length)
+{
+    int fds[2];
+    CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    ByteWriter header;
+    header.put_u32(0xffffffffu);
+    send_all(fds[0], header.data());
+    std::string payload;
+    CHECK(!recv_frame(fds[1], payload).empty());
+    CHECK(payload.empty());
+
+    // A length the peer does not follow up on is not allocated up front
+    ByteWriter short_frame;
+    short_frame.put_u32(kMaxFrameBytes);
+    send_all(fds[0], short_frame.data() + "abc");
+    ::close(fds[0]);
+    CHECK(!recv_frame(fds[1], payload).empty());
+    CHECK(payload.size() <= (size_t{1} << 20));
+    ::close(fds[1]);
+}
+
+REPONO_TEST(server_is_not_blocked_by_idle_client)
+{
+    std::string dir = repono_test::temp_dir("server_idle");
+    Repository repo;
+    repo.open(dir + "/repo");
+    std::string socket_path = dir + "/repo.sock";
+    RepositoryServer server(repo, socket_path);
+    CHECK_EQ(server.start(), "");
+
+    // Connects and never sends a request
+    int idle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    CHECK(::connect(idle, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+
+    auto start = std::chrono::steady_clock::now();
+    SocketRemote remote(socket_path);
+    std::map<std::string, std::string> refs;
+    CHECK_EQ(remote.list_refs(refs), "");
+    server.stop();
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    ::close(idle);
+}
+
+REPONO_TEST(fetch_and_lookups_reject_paths_posing_as_hashes)
+{
+    std::string dir = repono_test::temp_dir("fetch_path");
+    std::string head = make_repository(dir + "/server");
+    std::filesystem::create_directories(dir + "/outside");
+    {
+        std::ofstream out(dir + "/outside/secret");
+        out << "secret";
+    }
+    std::string path = "../../../outside/secret";
+
+    Repository server;
+    server.open(dir + "/server");
+    std::string pack;
+    CHECK_EQ(serve_fetch(server, {path}, {}, pack), "Malformed request");
+    CHECK(pack.empty());
+    CHECK_EQ(serve_fetch(server, {head}, {path}, pack), "Malformed request");
+    CHECK(server.get_record(path) == nullptr);
+    CHECK(server.get_chunk(path) == nullptr);
+    CHECK(!server.has_commit(path));
+    CHECK(!resolve_revision(server, path).has_value());
+    CHECK_EQ(*resolve_revision(server, head), head);
+}
+
+REPONO_TEST(push_rejects_non_fast_forward_without_moving_any_branch)
+{
+    std::string dir = repono_test::temp_dir("push_rewind");
+    std::string head = make_repository(dir + "/server");
+    CommitRecord next = child_of(head, "next");
+    DirectoryRemote remote(dir + "/server");
+    CHECK_EQ(remote.push_pack(pack_of({next}), {{"main", {head, next.hash}}}), "");
+
+    // Rewinding main, or moving it onto a side commit, is not a fast-forward
+    CommitRecord side = child_of(head, "side");
+    CHECK(!remote.push_pack(pack_of({}), {{"main", {next.hash, head}}}).empty());
+    CHECK(!remote.push_pack(pack_of({side}), {{"a", {"", side.hash}}, {"main", {next.hash, side.hash}}}).empty());
+
+    std::map<std::string, std::string> refs;
+    remote.list_refs(refs);
+    CHECK_EQ(refs.size(), size_t{1});
+    CHECK_EQ(refs["main"], next.hash);
+}
+
+REPONO_TEST(directory_remote_requires_an_existing_repository)
+{
+    std::string dir = repono_test::temp_dir("remote_missing") + "/does/not/exist";
+    DirectoryRemote remote(dir);
+    Repository local;
+    CHECK(!clone(remote, local).empty());
+    std::string pack;
+    CHECK(!remote.fetch_pack({}, {}, pack).empty());
+    CHECK(!std::filesystem::exists(dir));
+}
+
+REPONO_TEST(clone_needs_an_empty_repository_and_checks_out_main)
+{
+    std::string dir = repono_test::temp_dir("clone_checkout");
+    std::string head = make_repository(dir + "/server");
+    DirectoryRemote remote(dir + "/server");
+
+    Repository local;
+    local.set_current_branch("other");
+    CHECK_EQ(clone(remote, local), "");
+    CHECK_EQ(local.current_branch(), "main");
+    CHECK_EQ(local.head(), head);
+    CHECK(!clone(remote, local).empty());
+}
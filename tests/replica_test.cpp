@@ -0,0 +1,163 @@
+/**
+ *  Read replicas: what status() reports while the replica catches up
+ */
+
+#include "check.h"
+#include "replica.h"
+
+#include <condition_variable>
+#include <filesystem>
+#include <future>
+#include <mutex>
+
+using namespace repono;
+
+namespace
+{
+    /**
+     * A DirectoryRemote whose fetch_pack waits until release() is called
+     */
+    class BlockingRemote : public Remote
+    {
+    public:
+        explicit BlockingRemote(std::string dir) : inner_(std::move(dir)) {}
+
+        std::string list_refs(std::map<std::string, std::string> &refs) override { return inner_.list_refs(refs); }
+
+        std::string fetch_pack(const std::vector<std::string> &wants, const std::vector<std::string> &haves,
+                               std::string &pack) override
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            fetching_ = true;
+            changed_.notify_all();
+            changed_.wait(lock, [this]
+                          { return released_; });
+            return inner_.fetch_pack(wants, haves, pack);
+        }
+
+        std::string push_pack(const std::string &pack,
+                              const std::map<std::string, std::pair<std::string, std::string>> &updates) override
+        {
+            return inner_.push_pack(pack, updates);
+        }
+
+        void wait_until_fetching()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this]
+                          { return fetching_; });
+        }
+
+        void release()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            released_ = true;
+            changed_.notify_all();
+        }
+
+    private:
+        DirectoryRemote inner_;
+        std::mutex mutex_;
+        std::condition_variable changed_;
+        bool fetching_ = false;
+        bool released_ = false;
+    };
+
+    /**
+     * Commit to dir's main branch with a given timestamp
+     */
+    std::string commit_at(const std::string &dir, int64_t id, int64_t timestamp)
+    {
+        Repository repo;
+        repo.open(dir);
+        Commit commit;
+        commit.message = "row " + std::to_string(id);
+        commit.timestamp = timestamp;
+        Schema schema;
+        schema.add_column(ColumnDef("id", DataType::INTEGER, true));
+        commit.table_schemas["t"] = schema;
+        const CommitRecord *parent = repo.head().empty() ? nullptr : repo.get_record(repo.head());
+        std::vector<Row> rows;
+        if (parent != nullptr)
+            read_table_rows(repo, parent->tables.at("t"), rows);
+        rows.push_back({id});
+        commit.table_data["t"] = rows;
+        repo.commit(commit);
+        repo.flush();
+        return repo.head();
+    }
+};
+
+REPONO_TEST(replica_status_does_not_wait_for_a_poll_in_progress)
+{
+    std::string dir = repono_test::temp_dir("replica_in_progress");
+    std::string head = commit_at(dir + "/primary", 1, now_seconds());
+
+    Repository local;
+    auto remote = std::make_unique<BlockingRemote>(dir + "/primary");
+    BlockingRemote *blocking = remote.get();
+    Replica replica(local, std::move(remote));
+    auto polled = std::async(std::launch::async, [&replica]
+                             { return replica.poll(); });
+    blocking->wait_until_fetching();
+
+    // The new commits are not here yet: behind by an unknown amount
+    ReplicationStatus during = replica.status();
+    CHECK_EQ(during.primary_hash, head);
+    CHECK(during.applied_hash != head);
+    CHECK(!during.lag_commits.has_value());
+    CHECK(!during.lag_ms.has_value());
+
+    blocking->release();
+    CHECK_EQ(polled.get(), "");
+    ReplicationStatus after = replica.status();
+    CHECK_EQ(after.applied_hash, head);
+    CHECK_EQ(after.lag_commits, std::optional<size_t>(0));
+    CHECK_EQ(after.lag_ms, std::optional<int64_t>(0));
+    CHECK_EQ(replica.query("SELECT COUNT(*) FROM t").rows.size(), size_t{1});
+}
+
+REPONO_TEST(replica_lag_counts_from_primary_commit_time)
+{
+    std::string dir = repono_test::temp_dir("replica_lag");
+    int64_t old = now_seconds() - 60;
+    commit_at(dir + "/primary", 1, old);
+    commit_at(dir + "/primary", 2, old + 1);
+    std::string head = commit_at(dir + "/primary", 3, old + 2);
+
+    // The commits arrive, but moving the branch fails: refs cannot be written
+    Repository local;
+    local.open(dir + "/replica");
+    std::filesystem::create_directories(dir + "/replica/refs.tmp");
+    Replica replica(local, std::make_unique<DirectoryRemote>(dir + "/primary"));
+    CHECK(!replica.poll().empty());
+
+    ReplicationStatus status = replica.status();
+    CHECK_EQ(status.primary_hash, head);
+    CHECK(status.applied_hash.empty());
+    CHECK_EQ(status.lag_commits, std::optional<size_t>(3));
+    CHECK(status.lag_ms.value_or(0) >= 59000);
+    CHECK(!local.branch_head("main").has_value() || local.branch_head("main")->empty());
+
+    std::filesystem::remove_all(dir + "/replica/refs.tmp");
+    CHECK_EQ(replica.poll(), "");
+    CHECK_EQ(replica.status().lag_commits, std::optional<size_t>(0));
+}
+
+REPONO_TEST(commit_fails_when_branch_moved_under_dirty_session)
+{
+    Repository repo;
+    Session ours(repo);
+    Session theirs(repo);
+    RUN_OK(ours, "CREATE TABLE t (id INTEGER PRIMARY KEY)");
+    RUN_OK(ours, "COMMIT 'create'");
+    RUN_OK(ours, "INSERT INTO t VALUES (1)");
+
+    RUN_OK(theirs, "INSERT INTO t VALUES (2)");
+    RUN_OK(theirs, "COMMIT 'theirs'");
+    std::string moved = repo.head();
+
+    CHECK(!ours.execute("COMMIT 'ours'").ok());
+    CHECK_EQ(repo.head(), moved);
+    CHECK_EQ(repo.log(moved).size(), size_t{2});
+}
@@ -0,0 +1,50 @@
+/**
+ *  Slow query log: entries recorded while the log stops are not lost
+ */
+
+#include "check.h"
+#include "slow_query_log.h"
+
+#include <fstream>
+#include <thread>
+
+using namespace repono;
+
+REPONO_TEST(slow_query_log_writes_or_drops_every_entry_across_stop)
+{
+    std::string path = repono_test::temp_dir("slow_query_stop") + "/slow.jsonl";
+    Counter &logged = metrics().counter("repono_slow_queries_total", "");
+    Counter &dropped = metrics().counter("repono_slow_queries_dropped_total", "");
+    uint64_t logged_before = logged.value();
+    uint64_t dropped_before = dropped.value();
+
+    constexpr size_t kThreads = 4;
+    constexpr size_t kEntries = 5000;
+    {
+        SlowQueryLog log(path, 0, 64);
+        CHECK_EQ(log.start(), "");
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreads; t++)
+        {
+            threads.emplace_back([&log]
+                                 {
+                for (size_t i = 0; i < kEntries; i++)
+                {
+                    SlowQueryEntry entry;
+                    entry.sql = "SELECT " + std::to_string(i);
+                    log.record(entry);
+                } });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        log.stop();
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    std::ifstream in(path);
+    size_t lines = 0;
+    for (std::string line; std::getline(in, line);)
+        lines++;
+    CHECK_EQ(logged.value() - logged_before, uint64_t{lines});
+    CHECK_EQ(lines + (dropped.value() - dropped_before), uint64_t{kThreads * kEntries});
+}
@@ -0,0 +1,73 @@
+/**
+ *  Copy-on-write working sets: a commit that reuses stored chunks hashes
+ *  the same as one that re-splits every row
+ */
+
+#include "check.h"
+#include "lsm.h"
+
+using namespace repono;
+
+namespace
+{
+    /**
+     * The hash of a commit if each of its tables were materialized and
+     * split into chunks from scratch
+     */
+    std::string rematerialized_hash(const Repository &repo, const std::string &hash)
+    {
+        const CommitRecord *record = repo.get_record(hash);
+        if (record == nullptr)
+            return "";
+        CommitRecord copy = *record;
+        Repository scratch;
+        for (auto &[name, manifest] : copy.tables)
+        {
+            std::vector<Row> rows;
+            if (!read_table_rows(repo, manifest, rows).empty())
+                return "";
+            manifest.chunk_hashes.clear();
+            for (auto &chunk : split_into_chunks(rows))
+                manifest.chunk_hashes.push_back(scratch.put_chunk(std::move(chunk)));
+        }
+        return compute_record_hash(copy);
+    }
+};
+
+REPONO_TEST(copy_on_write_commits_hash_like_full_materialization)
+{
+    Repository repo;
+    Session session(repo);
+    RUN_OK(session, "CREATE TABLE keyed (id INTEGER PRIMARY KEY, v TEXT)");
+    RUN_OK(session, "CREATE TABLE plain (id INTEGER, v TEXT)");
+    repono_test::insert_rows(session, "keyed", 1, 3000);
+    repono_test::insert_rows(session, "plain", 1, 3000);
+    RUN_OK(session, "COMMIT 'load'");
+
+    std::vector<std::vector<std::string>> steps = {
+        {"UPDATE keyed SET v = 'x' WHERE id = 1500", "UPDATE plain SET v = 'x' WHERE id = 1500"},
+        {"DELETE FROM keyed WHERE id < 40", "DELETE FROM plain WHERE id < 40"},
+        {"INSERT INTO keyed VALUES (5000, 'tail')", "INSERT INTO plain VALUES (5000, 'tail')"},
+        {"DELETE FROM keyed WHERE id = 1500", "INSERT INTO keyed VALUES (1500, 'again')"},
+        {"UPDATE keyed SET v = 'wide' WHERE id > 2000", "DELETE FROM plain WHERE id > 2990"},
+        {"DELETE FROM keyed WHERE id > 0", "INSERT INTO keyed VALUES (1, 'only')"},
+    };
+    size_t n = 0;
+    for (const auto &step : steps)
+    {
+        for (const auto &sql : step)
+            RUN_OK(session, sql);
+        RUN_OK(session, "COMMIT 'step " + std::to_string(++n) + "'");
+        CHECK_EQ(rematerialized_hash(repo, repo.head()), repo.head());
+    }
+
+    // The same after switching branches, which reuses the kept working set
+    RUN_OK(session, "CHECKOUT -b other");
+    RUN_OK(session, "UPDATE plain SET v = 'other' WHERE id = 100");
+    RUN_OK(session, "COMMIT 'other'");
+    CHECK_EQ(rematerialized_hash(repo, repo.head()), repo.head());
+    RUN_OK(session, "CHECKOUT main");
+    RUN_OK(session, "INSERT INTO plain VALUES (6000, 'main')");
+    RUN_OK(session, "COMMIT 'main'");
+    CHECK_EQ(rematerialized_hash(repo, repo.head()), repo.head());
+}